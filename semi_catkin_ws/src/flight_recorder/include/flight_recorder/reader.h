@@ -0,0 +1,83 @@
+/**
+ * @file Reads the records back out of a flight recorder ring file, oldest
+ * chunk first. Only records that pass their CRC and belong to their chunk
+ * are returned, so a file that was being written when the truck lost power
+ * can be read up to the last record that reached the disk.
+ */
+
+#ifndef FLIGHT_RECORDER_READER_H
+#define FLIGHT_RECORDER_READER_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "flight_recorder/ring_format.h"
+
+namespace flight_recorder {
+
+struct StreamInfo {
+   std::string topic;
+   std::string datatype;
+   std::string md5sum;
+   std::string definition;
+};
+
+/**
+ * @brief A chunk that holds data. If indexed is false its index slot was not
+ * valid, e.g. because it was the open chunk during a crash, and the time
+ * range and record count are only known after reading it.
+ */
+struct ChunkSummary {
+   uint64_t seq;
+   bool indexed;
+   int64_t first_ns;
+   int64_t last_ns;
+   uint32_t records;
+};
+
+class RingReader {
+public:
+   typedef std::function<void(const StreamInfo &stream, int64_t stamp_ns,
+                              const uint8_t *data, uint32_t size)> Callback;
+
+   RingReader();
+
+   ~RingReader();
+
+   /**
+    * @brief Maps a ring file read only and finds the chunks that hold data.
+    * @return false if the file cannot be read or is not a ring file
+    */
+   bool open(const std::string &path);
+
+   void close();
+
+   /**
+    * @brief The chunks that hold data, oldest first.
+    */
+   const std::vector<ChunkSummary> &chunks() const { return chunks_; }
+
+   /**
+    * @brief Calls callback for every data record in a chunk, in the order
+    * they were recorded, and stops at the first record that is not valid.
+    *
+    * @return the number of data records read
+    */
+   uint32_t read_chunk(const ChunkSummary &chunk,
+                       const Callback &callback) const;
+
+private:
+   const uint8_t *chunk_data(uint64_t seq) const;
+
+   int fd_;
+   const uint8_t *map_;
+   size_t map_size_;
+   FileHeader header_;
+   std::vector<ChunkSummary> chunks_;
+};
+
+} // namespace flight_recorder
+
+#endif //FLIGHT_RECORDER_READER_H
@@ -0,0 +1,190 @@
+/**
+ * @file An in-process flight recorder for sensor and actuator streams. The
+ * node that owns a stream hands each message to the recorder, which
+ * serializes it straight into a memory-mapped ring file (see ring_format.h).
+ * Recording a message is a copy into memory under a mutex; it never does
+ * I/O and never allocates. A background thread syncs the file in batches,
+ * every sync_period seconds, and prepares the next chunk so the recording
+ * threads do not wait on the SD card.
+ *
+ * Unlike rosbag record, nothing goes through a subscription, so recording
+ * does not add serialization over TCP, and a busy SD card cannot make the
+ * recorder drop messages: the file is already allocated, and the ring
+ * overwrites the oldest data once it is full. flight_recorder_to_bag turns
+ * ring files into a bag for offline analysis.
+ */
+
+#ifndef FLIGHT_RECORDER_RECORDER_H
+#define FLIGHT_RECORDER_RECORDER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ros/message_traits.h>
+#include <ros/serialization.h>
+#include <ros/time.h>
+
+#include "flight_recorder/ring_format.h"
+
+namespace flight_recorder {
+
+struct RecorderConfig {
+   RecorderConfig()
+      : chunk_size(1 << 20),
+        num_chunks(64),
+        sync_period(1.0) {}
+
+   std::string path;    // the ring file, created if it does not exist
+   uint32_t chunk_size; // bytes per chunk, rounded up to whole pages
+   uint32_t num_chunks;
+   double sync_period;  // seconds between syncs of the file
+};
+
+/**
+ * @brief Counters since the recorder was opened.
+ */
+struct RecorderStats {
+   uint64_t records;     // data records written
+   uint64_t bytes;       // bytes written, including record headers
+   uint64_t dropped;     // records that were larger than a chunk
+   uint64_t chunks;      // chunks started
+   uint64_t syncs;
+   uint32_t sync_us_max; // longest sync of the file
+   uint64_t record_ns;   // total time spent in record()
+};
+
+class FlightRecorder {
+public:
+   FlightRecorder();
+
+   ~FlightRecorder();
+
+   /**
+    * @brief Opens or creates the ring file. An existing file with the same
+    * geometry is continued after its newest chunk, so the data of earlier
+    * runs is kept until the ring wraps around to it; any other file at the
+    * path is replaced.
+    *
+    * @return false if the file could not be created or mapped
+    */
+   bool open(const RecorderConfig &config);
+
+   /**
+    * @brief Syncs everything that was recorded and closes the file.
+    */
+   void close();
+
+   bool is_open() const { return map_ != NULL; }
+
+   /**
+    * @brief Adds a stream. It is described at the start of every chunk, so
+    * streams can be added at any time.
+    *
+    * @param topic the topic that flight_recorder_to_bag writes it to
+    * @return the id to record the stream's messages with
+    */
+   uint16_t add_stream(const std::string &topic, const std::string &datatype,
+                       const std::string &md5sum,
+                       const std::string &definition);
+
+   template <typename M>
+   uint16_t add_stream(const std::string &topic) {
+      return add_stream(topic, ros::message_traits::datatype<M>(),
+                        ros::message_traits::md5sum<M>(),
+                        ros::message_traits::definition<M>());
+   }
+
+   /**
+    * @brief Records a serialized message.
+    *
+    * @return false if the recorder is not open or the record does not fit
+    * into a chunk
+    */
+   bool record(uint16_t stream, const ros::Time &stamp, const void *data,
+               uint32_t size);
+
+   /**
+    * @brief Serializes a message directly into the ring file.
+    */
+   template <typename M>
+   bool record(uint16_t stream, const ros::Time &stamp, const M &msg) {
+      uint32_t size = ros::serialization::serializationLength(msg);
+      uint8_t *payload = begin_record(stream, stamp, size);
+
+      if (payload == NULL) {
+         return false;
+      }
+      ros::serialization::OStream out(payload, size);
+      ros::serialization::serialize(out, msg);
+      end_record();
+      return true;
+   }
+
+   RecorderStats stats() const;
+
+private:
+   struct Stream {
+      std::string topic;
+      std::string datatype;
+      std::string md5sum;
+      std::string definition;
+   };
+
+   /**
+    * @brief Reserves space for a record and takes the lock, which
+    * end_record() releases. Returns NULL without holding the lock if the
+    * record cannot be written.
+    */
+   uint8_t *begin_record(uint16_t stream, const ros::Time &stamp,
+                         uint32_t size);
+
+   void end_record();
+
+   /**
+    * @brief Returns the start of the chunk that holds a seq. The chunk of
+    * every seq is fixed, so a reader finds a chunk's index slot the same way.
+    */
+   uint8_t *chunk(uint64_t seq) const;
+
+   RecordHeader *append(uint16_t stream, int64_t stamp_ns, uint32_t size);
+
+   void start_chunk();
+
+   void write_stream_info(uint16_t id);
+
+   void sync_loop();
+
+   void sync();
+
+   RecorderConfig config_;
+   int fd_;
+   uint8_t *map_;
+   size_t map_size_;
+   FileHeader *header_;
+   ChunkIndex *index_;
+
+   // the writer state, guarded by mutex_
+   mutable std::mutex mutex_;
+   std::vector<Stream> streams_;
+   uint64_t seq_;         // seq of the open chunk
+   uint32_t used_;        // bytes used in the open chunk
+   ChunkIndex open_;      // index of the open chunk so far
+   std::vector<ChunkIndex> sealed_; // full chunks waiting for a sync
+   RecordHeader *pending_;
+   std::chrono::steady_clock::time_point pending_start_;
+   RecorderStats stats_;
+   bool starting_;        // start_chunk() is writing the stream descriptions
+
+   std::thread sync_thread_;
+   std::condition_variable sync_wake_;
+   bool stopping_;
+};
+
+} // namespace flight_recorder
+
+#endif //FLIGHT_RECORDER_RECORDER_H
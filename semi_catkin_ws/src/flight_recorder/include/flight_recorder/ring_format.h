@@ -0,0 +1,102 @@
+/**
+ * @file The on-disk layout of a flight recorder ring file.
+ *
+ * A ring file is preallocated to its full size when it is created and never
+ * grows. It starts with a header page that holds the FileHeader and the
+ * index, one ChunkIndex slot per chunk, followed by num_chunks chunks of
+ * chunk_size bytes each. The recorder fills the chunks in order and wraps
+ * around to overwrite the oldest one, so the file always holds the latest
+ * num_chunks * chunk_size bytes of data.
+ *
+ * Every chunk starts with a ChunkHeader carrying a sequence number that goes
+ * up by one for every chunk written; the chunk with sequence number seq is
+ * always chunk seq % num_chunks. The header is followed by a STREAM_INFO
+ * record for every stream so that each chunk can be decoded on its own, then
+ * the data records. Each record carries the sequence number of its chunk
+ * and a CRC, so a reader stops at the first record that was left over from
+ * an older pass around the ring or that was torn by a crash.
+ *
+ * An index slot is only written after the data of its chunk has been
+ * synced, so a valid slot always describes data that is on disk. The slots
+ * let a reader find the time range of every chunk without reading it; a
+ * chunk without a valid slot, such as the one that was open during a crash,
+ * is still read record by record.
+ *
+ * All fields are little endian, which is what the Pi and every PC use.
+ */
+
+#ifndef FLIGHT_RECORDER_RING_FORMAT_H
+#define FLIGHT_RECORDER_RING_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace flight_recorder {
+
+const uint64_t FILE_MAGIC = 0x31474e4952524642ULL; // "BFRRING1"
+const uint32_t FILE_VERSION = 1;
+const uint32_t CHUNK_MAGIC = 0x4b4e4843; // "CHNK"
+
+// the stream id of the records that describe the other streams
+const uint16_t STREAM_INFO = 0xFFFF;
+
+const uint32_t RECORD_ALIGN = 8; // records start on multiples of this
+
+struct FileHeader {
+   uint64_t magic;
+   uint32_t version;
+   uint32_t header_size; // bytes before the first chunk
+   uint32_t chunk_size;
+   uint32_t num_chunks;
+};
+
+/**
+ * @brief Describes a chunk whose data has been synced. The slot is valid if
+ * its CRC matches and seq matches the ChunkHeader of the chunk.
+ */
+struct ChunkIndex {
+   uint64_t seq;
+   int64_t first_ns; // stamp of the first data record
+   int64_t last_ns;  // stamp of the last data record
+   uint32_t records; // data records, not counting STREAM_INFO
+   uint32_t bytes;   // bytes used in the chunk, including its header
+   uint32_t reserved;
+   uint32_t crc;     // of the fields above
+};
+
+struct ChunkHeader {
+   uint32_t magic;
+   uint32_t reserved;
+   uint64_t seq; // 0 is never used, so an unwritten chunk has no valid seq
+};
+
+struct RecordHeader {
+   uint32_t size;      // of the payload that follows
+   uint16_t stream;
+   uint16_t reserved;
+   uint32_t chunk_seq; // low 32 bits of the seq of the chunk
+   uint32_t crc;       // of the payload and the fields before it
+   int64_t stamp_ns;
+};
+
+/**
+ * @brief Returns the CRC-32 (the zlib polynomial) of a buffer, continuing
+ * from crc, which is 0 for the first buffer.
+ */
+uint32_t crc32(uint32_t crc, const void *data, size_t size);
+
+/**
+ * @brief Returns the CRC of a record, covering its header up to the crc
+ * field, its stamp and its payload.
+ */
+uint32_t record_crc(const RecordHeader &header, const void *payload);
+
+uint32_t index_crc(const ChunkIndex &index);
+
+inline uint32_t align_record(uint32_t size) {
+   return (size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+}
+
+} // namespace flight_recorder
+
+#endif //FLIGHT_RECORDER_RING_FORMAT_H
@@ -0,0 +1,97 @@
+/**
+ * @file Converts flight recorder ring files into a bag for offline analysis:
+ *
+ *    rosrun flight_recorder flight_recorder_to_bag out.bag truck.ring ...
+ *
+ * Every stream is written to the topic it was recorded under, with its
+ * original message type, and the recorded stamp as the bag time. The rings
+ * of several nodes can be merged into one bag.
+ */
+
+#include "flight_recorder/reader.h"
+
+#include <stdio.h>
+
+#include <ros/time.h>
+#include <rosbag/bag.h>
+#include <topic_tools/shape_shifter.h>
+
+using flight_recorder::ChunkSummary;
+using flight_recorder::RingReader;
+using flight_recorder::StreamInfo;
+
+/**
+ * @brief Writes one recorded message to the bag. The serialized bytes are
+ * copied as they are, so the tool does not need to know any message types.
+ */
+static void write_message(rosbag::Bag *bag, uint64_t *skipped,
+                          const StreamInfo &stream, int64_t stamp_ns,
+                          const uint8_t *data, uint32_t size) {
+   topic_tools::ShapeShifter message;
+   ros::serialization::IStream in((uint8_t*)data, size);
+   ros::Time stamp;
+
+   if (stamp_ns <= 0) {
+      (*skipped)++; // bags cannot hold messages at time zero
+      return;
+   }
+   stamp.fromNSec(stamp_ns);
+
+   message.morph(stream.md5sum, stream.datatype, stream.definition, "");
+   message.read(in);
+   bag->write(stream.topic, stamp, message);
+}
+
+int main(int argc, char **argv) {
+   rosbag::Bag bag;
+   uint64_t total = 0;
+   uint64_t skipped = 0;
+
+   if (argc < 3) {
+      fprintf(stderr, "usage: %s output.bag ring_file...\n", argv[0]);
+      return 1;
+   }
+
+   ros::Time::init();
+   bag.open(argv[1], rosbag::bagmode::Write);
+   bag.setCompression(rosbag::compression::LZ4);
+
+   for (int i = 2; i < argc; i++) {
+      RingReader reader;
+      uint64_t records = 0;
+
+      if (!reader.open(argv[i])) {
+         fprintf(stderr, "%s is not a flight recorder ring file\n", argv[i]);
+         return 1;
+      }
+
+      for (size_t c = 0; c < reader.chunks().size(); c++) {
+         const ChunkSummary &chunk = reader.chunks()[c];
+         uint32_t read = reader.read_chunk(chunk,
+               [&](const StreamInfo &stream, int64_t stamp_ns,
+                   const uint8_t *data, uint32_t size) {
+                  write_message(&bag, &skipped, stream, stamp_ns, data, size);
+               });
+
+         if (chunk.indexed && read < chunk.records) {
+            fprintf(stderr, "%s: chunk %lu is damaged, read %u of %u "
+                    "records\n", argv[i], (unsigned long)chunk.seq, read,
+                    chunk.records);
+         }
+         records += read;
+      }
+
+      printf("%s: %lu records from %lu chunks\n", argv[i],
+             (unsigned long)records, (unsigned long)reader.chunks().size());
+      total += records;
+   }
+
+   bag.close();
+   printf("wrote %lu messages to %s", (unsigned long)(total - skipped),
+          argv[1]);
+   if (skipped > 0) {
+      printf(", skipped %lu without a stamp", (unsigned long)skipped);
+   }
+   printf("\n");
+   return 0;
+}
@@ -0,0 +1,171 @@
+#include "flight_recorder/reader.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace flight_recorder {
+
+RingReader::RingReader() : fd_(-1), map_(NULL), map_size_(0) {
+   memset(&header_, 0, sizeof(header_));
+}
+
+RingReader::~RingReader() {
+   close();
+}
+
+static bool older(const ChunkSummary &a, const ChunkSummary &b) {
+   return a.seq < b.seq;
+}
+
+bool RingReader::open(const std::string &path) {
+   struct stat info;
+
+   close();
+
+   fd_ = ::open(path.c_str(), O_RDONLY);
+   if (fd_ < 0 || fstat(fd_, &info) < 0 ||
+       (size_t)info.st_size < sizeof(FileHeader)) {
+      close();
+      return false;
+   }
+
+   map_size_ = info.st_size;
+   void *map = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+   if (map == MAP_FAILED) {
+      map_ = NULL;
+      close();
+      return false;
+   }
+   map_ = (const uint8_t*)map;
+   madvise((void*)map_, map_size_, MADV_SEQUENTIAL);
+
+   memcpy(&header_, map_, sizeof(header_));
+   if (header_.magic != FILE_MAGIC || header_.version != FILE_VERSION ||
+       header_.num_chunks == 0 ||
+       sizeof(FileHeader) + header_.num_chunks * sizeof(ChunkIndex) >
+       header_.header_size ||
+       header_.header_size + (size_t)header_.num_chunks * header_.chunk_size >
+       map_size_) {
+      close();
+      return false;
+   }
+
+   const ChunkIndex *index = (const ChunkIndex*)(map_ + sizeof(FileHeader));
+   for (uint32_t i = 0; i < header_.num_chunks; i++) {
+      const ChunkHeader *chunk_header = (const ChunkHeader*)(
+            map_ + header_.header_size + (size_t)i * header_.chunk_size);
+      ChunkSummary summary;
+
+      if (chunk_header->magic != CHUNK_MAGIC || chunk_header->seq == 0 ||
+          chunk_header->seq % header_.num_chunks != i) {
+         continue;
+      }
+
+      summary.seq = chunk_header->seq;
+      summary.indexed = index[i].seq == summary.seq &&
+                        index[i].crc == index_crc(index[i]);
+      summary.first_ns = summary.indexed ? index[i].first_ns : 0;
+      summary.last_ns = summary.indexed ? index[i].last_ns : 0;
+      summary.records = summary.indexed ? index[i].records : 0;
+      chunks_.push_back(summary);
+   }
+   std::sort(chunks_.begin(), chunks_.end(), older);
+   return true;
+}
+
+void RingReader::close() {
+   if (map_ != NULL) {
+      munmap((void*)map_, map_size_);
+      map_ = NULL;
+   }
+   if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+   }
+   chunks_.clear();
+}
+
+const uint8_t *RingReader::chunk_data(uint64_t seq) const {
+   return map_ + header_.header_size +
+          (size_t)(seq % header_.num_chunks) * header_.chunk_size;
+}
+
+/**
+ * @brief Parses a STREAM_INFO payload into streams, growing it as needed.
+ */
+static bool parse_stream_info(const uint8_t *data, uint32_t size,
+                              std::vector<StreamInfo> *streams) {
+   std::string *fields[4];
+   uint16_t id;
+   uint32_t offset = sizeof(id);
+
+   if (size < sizeof(id)) {
+      return false;
+   }
+   memcpy(&id, data, sizeof(id));
+   if (id >= streams->size()) {
+      streams->resize(id + 1);
+   }
+
+   StreamInfo &stream = (*streams)[id];
+   fields[0] = &stream.topic;
+   fields[1] = &stream.datatype;
+   fields[2] = &stream.md5sum;
+   fields[3] = &stream.definition;
+
+   for (int i = 0; i < 4; i++) {
+      uint32_t length;
+
+      if (offset + sizeof(length) > size) {
+         return false;
+      }
+      memcpy(&length, data + offset, sizeof(length));
+      offset += sizeof(length);
+      if (length > size - offset) {
+         return false;
+      }
+      fields[i]->assign((const char*)data + offset, length);
+      offset += length;
+   }
+   return true;
+}
+
+uint32_t RingReader::read_chunk(const ChunkSummary &chunk,
+                                const Callback &callback) const {
+   const uint8_t *data = chunk_data(chunk.seq);
+   uint32_t offset = sizeof(ChunkHeader);
+   uint32_t records = 0;
+   std::vector<StreamInfo> streams;
+
+   while (offset + sizeof(RecordHeader) <= header_.chunk_size) {
+      RecordHeader record;
+      const uint8_t *payload = data + offset + sizeof(RecordHeader);
+
+      memcpy(&record, data + offset, sizeof(record));
+      if (record.chunk_seq != (uint32_t)chunk.seq ||
+          record.size > header_.chunk_size - offset - sizeof(RecordHeader) ||
+          record.crc != record_crc(record, payload)) {
+         break;
+      }
+
+      if (record.stream == STREAM_INFO) {
+         if (!parse_stream_info(payload, record.size, &streams)) {
+            break;
+         }
+      }
+      else if (record.stream < streams.size()) {
+         callback(streams[record.stream], record.stamp_ns, payload,
+                  record.size);
+         records++;
+      }
+      offset += align_record(sizeof(RecordHeader) + record.size);
+   }
+   return records;
+}
+
+} // namespace flight_recorder
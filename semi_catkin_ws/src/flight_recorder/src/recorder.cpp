@@ -0,0 +1,393 @@
+#include "flight_recorder/recorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ros/console.h>
+
+namespace flight_recorder {
+
+static size_t round_up(size_t size, size_t multiple) {
+   return (size + multiple - 1) / multiple * multiple;
+}
+
+FlightRecorder::FlightRecorder()
+      : fd_(-1),
+        map_(NULL),
+        map_size_(0),
+        header_(NULL),
+        index_(NULL),
+        seq_(0),
+        used_(0),
+        pending_(NULL),
+        starting_(false),
+        stopping_(false) {
+   memset(&stats_, 0, sizeof(stats_));
+   memset(&open_, 0, sizeof(open_));
+}
+
+FlightRecorder::~FlightRecorder() {
+   close();
+}
+
+bool FlightRecorder::open(const RecorderConfig &config) {
+   size_t page = sysconf(_SC_PAGESIZE);
+   FileHeader expected;
+   FileHeader existing;
+   struct stat info;
+   bool resume;
+   int error;
+
+   close();
+
+   config_ = config;
+   config_.chunk_size = round_up(config.chunk_size, page);
+
+   expected.magic = FILE_MAGIC;
+   expected.version = FILE_VERSION;
+   expected.header_size = round_up(sizeof(FileHeader) +
+                                   config_.num_chunks * sizeof(ChunkIndex),
+                                   page);
+   expected.chunk_size = config_.chunk_size;
+   expected.num_chunks = config_.num_chunks;
+   map_size_ = expected.header_size +
+               (size_t)config_.num_chunks * config_.chunk_size;
+
+   if (config_.num_chunks < 2) {
+      ROS_ERROR("flight recorder: a ring needs at least 2 chunks");
+      return false;
+   }
+
+   fd_ = ::open(config_.path.c_str(), O_RDWR | O_CREAT, 0644);
+   if (fd_ < 0 || fstat(fd_, &info) < 0) {
+      ROS_ERROR("flight recorder: cannot open %s: %s", config_.path.c_str(),
+                strerror(errno));
+      close();
+      return false;
+   }
+
+   resume = (size_t)info.st_size == map_size_ &&
+            pread(fd_, &existing, sizeof(existing), 0) ==
+            (ssize_t)sizeof(existing) &&
+            memcmp(&existing, &expected, sizeof(existing)) == 0;
+
+   if (!resume) {
+      // allocate every block now, so recording never waits for the file
+      // system to find space and never fails for lack of it
+      // posix_fallocate returns the error instead of setting errno
+      error = ftruncate(fd_, 0) < 0 ? errno :
+              posix_fallocate(fd_, 0, map_size_);
+      if (error != 0) {
+         ROS_ERROR("flight recorder: cannot allocate %lu bytes for %s: %s",
+                   (unsigned long)map_size_, config_.path.c_str(),
+                   strerror(error));
+         close();
+         return false;
+      }
+   }
+
+   void *map = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                    0);
+   if (map == MAP_FAILED) {
+      ROS_ERROR("flight recorder: cannot map %s: %s", config_.path.c_str(),
+                strerror(errno));
+      close();
+      return false;
+   }
+   map_ = (uint8_t*)map;
+   header_ = (FileHeader*)map_;
+   index_ = (ChunkIndex*)(map_ + sizeof(FileHeader));
+   madvise(map_ + expected.header_size, map_size_ - expected.header_size,
+           MADV_SEQUENTIAL);
+
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   seq_ = 0;
+   if (resume) {
+      for (uint32_t i = 0; i < config_.num_chunks; i++) {
+         const ChunkHeader *chunk_header = (const ChunkHeader*)(
+               map_ + expected.header_size + (size_t)i * config_.chunk_size);
+         if (chunk_header->magic == CHUNK_MAGIC &&
+             chunk_header->seq % config_.num_chunks == i &&
+             chunk_header->seq > seq_) {
+            seq_ = chunk_header->seq;
+         }
+      }
+   }
+   else {
+      *header_ = expected;
+   }
+   seq_++;
+
+   memset(&stats_, 0, sizeof(stats_));
+   sealed_.clear();
+   sealed_.reserve(config_.num_chunks);
+   start_chunk();
+
+   stopping_ = false;
+   sync_thread_ = std::thread(&FlightRecorder::sync_loop, this);
+
+   ROS_INFO("flight recorder: %s %s, %u chunks of %u KiB, starting at "
+            "chunk %lu", resume ? "continuing" : "created",
+            config_.path.c_str(), config_.num_chunks,
+            config_.chunk_size / 1024, (unsigned long)seq_);
+   return true;
+}
+
+void FlightRecorder::close() {
+   if (sync_thread_.joinable()) {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         stopping_ = true;
+         open_.bytes = used_;
+         sealed_.push_back(open_);
+      }
+      sync_wake_.notify_all();
+      sync_thread_.join();
+
+      // the first sync makes the data durable, the second the index slots
+      // that the first one wrote
+      sync();
+      fdatasync(fd_);
+   }
+
+   if (map_ != NULL) {
+      munmap(map_, map_size_);
+      map_ = NULL;
+      header_ = NULL;
+      index_ = NULL;
+   }
+   if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+   }
+}
+
+uint16_t FlightRecorder::add_stream(const std::string &topic,
+                                    const std::string &datatype,
+                                    const std::string &md5sum,
+                                    const std::string &definition) {
+   std::lock_guard<std::mutex> lock(mutex_);
+   Stream stream;
+   uint16_t id = streams_.size();
+
+   stream.topic = topic;
+   stream.datatype = datatype;
+   stream.md5sum = md5sum;
+   stream.definition = definition;
+   streams_.push_back(stream);
+
+   if (map_ != NULL) {
+      write_stream_info(id);
+   }
+   return id;
+}
+
+bool FlightRecorder::record(uint16_t stream, const ros::Time &stamp,
+                            const void *data, uint32_t size) {
+   uint8_t *payload = begin_record(stream, stamp, size);
+
+   if (payload == NULL) {
+      return false;
+   }
+   memcpy(payload, data, size);
+   end_record();
+   return true;
+}
+
+RecorderStats FlightRecorder::stats() const {
+   std::lock_guard<std::mutex> lock(mutex_);
+   return stats_;
+}
+
+uint8_t *FlightRecorder::begin_record(uint16_t stream, const ros::Time &stamp,
+                                      uint32_t size) {
+   mutex_.lock();
+   pending_start_ = std::chrono::steady_clock::now();
+
+   if (map_ == NULL || stream >= streams_.size() ||
+       (pending_ = append(stream, stamp.toNSec(), size)) == NULL) {
+      stats_.dropped++;
+      mutex_.unlock();
+      return NULL;
+   }
+   return (uint8_t*)(pending_ + 1);
+}
+
+void FlightRecorder::end_record() {
+   pending_->crc = record_crc(*pending_, pending_ + 1);
+   stats_.records++;
+   stats_.bytes += sizeof(RecordHeader) + pending_->size;
+   stats_.record_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - pending_start_).count();
+   pending_ = NULL;
+   mutex_.unlock();
+}
+
+uint8_t *FlightRecorder::chunk(uint64_t seq) const {
+   return map_ + header_->header_size +
+          (size_t)(seq % config_.num_chunks) * config_.chunk_size;
+}
+
+/**
+ * @brief Reserves a record in the open chunk, moving on to the next chunk if
+ * it does not fit. The caller fills in the payload and the CRC.
+ */
+RecordHeader *FlightRecorder::append(uint16_t stream, int64_t stamp_ns,
+                                     uint32_t size) {
+   uint32_t total = align_record(sizeof(RecordHeader) + size);
+   RecordHeader *record;
+
+   if (total > config_.chunk_size - sizeof(ChunkHeader)) {
+      return NULL;
+   }
+   if (total > config_.chunk_size - used_) {
+      if (starting_) {
+         return NULL; // the stream descriptions alone overflow a chunk
+      }
+      open_.bytes = used_;
+      sealed_.push_back(open_);
+      seq_++;
+      start_chunk();
+      if (total > config_.chunk_size - used_) {
+         return NULL;
+      }
+   }
+
+   record = (RecordHeader*)(chunk(seq_) + used_);
+   record->size = size;
+   record->stream = stream;
+   record->reserved = 0;
+   record->chunk_seq = (uint32_t)seq_;
+   record->stamp_ns = stamp_ns;
+   used_ += total;
+
+   if (stream != STREAM_INFO) {
+      if (open_.records == 0) {
+         open_.first_ns = stamp_ns;
+      }
+      open_.last_ns = stamp_ns;
+      open_.records++;
+   }
+   return record;
+}
+
+/**
+ * @brief Starts the chunk for seq_ with its header and the description of
+ * every stream. The index slot of the chunk still describes the data that
+ * is being overwritten, but its seq no longer matches the chunk header, so
+ * readers ignore it until the chunk is sealed and synced.
+ */
+void FlightRecorder::start_chunk() {
+   ChunkHeader *chunk_header = (ChunkHeader*)chunk(seq_);
+
+   chunk_header->magic = CHUNK_MAGIC;
+   chunk_header->reserved = 0;
+   chunk_header->seq = seq_;
+   used_ = sizeof(ChunkHeader);
+
+   memset(&open_, 0, sizeof(open_));
+   open_.seq = seq_;
+   stats_.chunks++;
+
+   starting_ = true;
+   for (uint16_t i = 0; i < streams_.size(); i++) {
+      write_stream_info(i);
+   }
+   starting_ = false;
+}
+
+/**
+ * @brief Writes a STREAM_INFO record: the stream id followed by the topic,
+ * datatype, md5sum and definition, each as a 32 bit length and the bytes.
+ */
+void FlightRecorder::write_stream_info(uint16_t id) {
+   const Stream &stream = streams_[id];
+   const std::string *fields[] = {&stream.topic, &stream.datatype,
+                                  &stream.md5sum, &stream.definition};
+   uint32_t size = sizeof(id);
+   RecordHeader *record;
+   uint8_t *out;
+
+   for (int i = 0; i < 4; i++) {
+      size += sizeof(uint32_t) + fields[i]->size();
+   }
+
+   record = append(STREAM_INFO, 0, size);
+   if (record == NULL) {
+      return;
+   }
+
+   out = (uint8_t*)(record + 1);
+   memcpy(out, &id, sizeof(id));
+   out += sizeof(id);
+   for (int i = 0; i < 4; i++) {
+      uint32_t length = fields[i]->size();
+      memcpy(out, &length, sizeof(length));
+      memcpy(out + sizeof(length), fields[i]->data(), length);
+      out += sizeof(length) + length;
+   }
+   record->crc = record_crc(*record, record + 1);
+}
+
+void FlightRecorder::sync_loop() {
+   std::unique_lock<std::mutex> lock(mutex_);
+
+   while (!stopping_) {
+      sync_wake_.wait_for(lock, std::chrono::duration<double>(
+            config_.sync_period));
+      if (stopping_) {
+         break;
+      }
+      lock.unlock();
+      sync();
+      lock.lock();
+   }
+}
+
+/**
+ * @brief Syncs the file and then writes the index slots of the chunks that
+ * were sealed before the sync, so a slot never describes data that is not on
+ * disk. The slots themselves reach the disk with the next sync. Also asks
+ * the kernel to bring in the next chunk before the writer gets to it.
+ */
+void FlightRecorder::sync() {
+   std::vector<ChunkIndex> sealed;
+   std::chrono::steady_clock::time_point start;
+   uint32_t sync_us;
+   uint64_t next_seq;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      sealed.assign(sealed_.begin(), sealed_.end());
+      sealed_.clear();
+      next_seq = seq_ + 1;
+   }
+
+   start = std::chrono::steady_clock::now();
+   fdatasync(fd_);
+   sync_us = std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now() - start).count();
+
+   for (size_t i = 0; i < sealed.size(); i++) {
+      ChunkIndex &slot = index_[sealed[i].seq % config_.num_chunks];
+
+      sealed[i].reserved = 0;
+      sealed[i].crc = index_crc(sealed[i]);
+      slot = sealed[i];
+   }
+
+   madvise(chunk(next_seq), config_.chunk_size, MADV_WILLNEED);
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   stats_.syncs++;
+   if (sync_us > stats_.sync_us_max) {
+      stats_.sync_us_max = sync_us;
+   }
+}
+
+} // namespace flight_recorder
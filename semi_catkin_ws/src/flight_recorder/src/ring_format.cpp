@@ -0,0 +1,47 @@
+#include "flight_recorder/ring_format.h"
+
+#include <stddef.h>
+
+namespace flight_recorder {
+
+/**
+ * @brief The CRC-32 lookup table. It is built the first time it is used,
+ * which C++11 makes safe from any thread.
+ */
+struct CrcTable {
+   CrcTable() {
+      for (uint32_t i = 0; i < 256; i++) {
+         uint32_t crc = i;
+         for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+         }
+         entries[i] = crc;
+      }
+   }
+
+   uint32_t entries[256];
+};
+
+uint32_t crc32(uint32_t crc, const void *data, size_t size) {
+   static const CrcTable table;
+   const uint8_t *bytes = (const uint8_t*)data;
+
+   crc = ~crc;
+   for (size_t i = 0; i < size; i++) {
+      crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+   }
+   return ~crc;
+}
+
+uint32_t record_crc(const RecordHeader &header, const void *payload) {
+   uint32_t crc = crc32(0, &header, offsetof(RecordHeader, crc));
+
+   crc = crc32(crc, &header.stamp_ns, sizeof(header.stamp_ns));
+   return crc32(crc, payload, header.size);
+}
+
+uint32_t index_crc(const ChunkIndex &index) {
+   return crc32(0, &index, offsetof(ChunkIndex, crc));
+}
+
+} // namespace flight_recorder
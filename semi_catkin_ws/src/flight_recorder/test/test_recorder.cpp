@@ -0,0 +1,197 @@
+/**
+ * @file Records into a ring file and reads it back with the RingReader, and
+ * measures what record() costs the thread that calls it.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "flight_recorder/reader.h"
+#include "flight_recorder/recorder.h"
+
+using flight_recorder::ChunkSummary;
+using flight_recorder::FlightRecorder;
+using flight_recorder::RecorderConfig;
+using flight_recorder::RingReader;
+using flight_recorder::StreamInfo;
+
+namespace {
+
+/**
+ * @brief A ring file in /tmp that is removed again after the test.
+ */
+class RecorderTest : public ::testing::Test {
+protected:
+   void SetUp() override {
+      char path[] = "/tmp/flight_recorder_testXXXXXX";
+      int fd = mkstemp(path);
+      ASSERT_GE(fd, 0);
+      close(fd);
+      config_.path = path;
+      config_.chunk_size = 64 * 1024;
+      config_.num_chunks = 4;
+   }
+
+   void TearDown() override {
+      unlink(config_.path.c_str());
+   }
+
+   /**
+    * @brief Every record in the file, oldest first, as the value of its
+    * first word and its size.
+    */
+   std::vector<std::pair<uint32_t, uint32_t> > read_back() {
+      std::vector<std::pair<uint32_t, uint32_t> > records;
+      RingReader reader;
+
+      EXPECT_TRUE(reader.open(config_.path));
+      for (const ChunkSummary &chunk : reader.chunks()) {
+         reader.read_chunk(chunk, [&](const StreamInfo &stream,
+                                      int64_t stamp_ns, const uint8_t *data,
+                                      uint32_t size) {
+            uint32_t value;
+
+            EXPECT_EQ(stream.topic, "test");
+            memcpy(&value, data, sizeof(value));
+            EXPECT_EQ(stamp_ns, (int64_t)value * 1000000000);
+            records.push_back(std::make_pair(value, size));
+         });
+      }
+      return records;
+   }
+
+   RecorderConfig config_;
+};
+
+/**
+ * @brief Records count records of size bytes, numbered from first, each
+ * stamped with its number in seconds.
+ */
+void record(FlightRecorder *recorder, uint16_t stream, uint32_t first,
+            uint32_t count, uint32_t size) {
+   std::vector<uint8_t> data(size, 0x5a);
+
+   for (uint32_t i = first; i < first + count; i++) {
+      memcpy(data.data(), &i, sizeof(i));
+      ASSERT_TRUE(recorder->record(stream, ros::Time(i, 0), data.data(),
+                                   size));
+   }
+}
+
+} // namespace
+
+TEST_F(RecorderTest, RoundTrip) {
+   FlightRecorder recorder;
+   ASSERT_TRUE(recorder.open(config_));
+   uint16_t stream = recorder.add_stream("test", "test/Bytes", "0", "");
+
+   record(&recorder, stream, 1, 1000, 22);
+   record(&recorder, stream, 1001, 10, 1000);
+   recorder.close();
+
+   auto records = read_back();
+   ASSERT_EQ(records.size(), 1010u);
+   for (uint32_t i = 0; i < records.size(); i++) {
+      EXPECT_EQ(records[i].first, i + 1);
+      EXPECT_EQ(records[i].second, i < 1000 ? 22u : 1000u);
+   }
+}
+
+TEST_F(RecorderTest, WrapsAroundKeepingTheNewest) {
+   FlightRecorder recorder;
+   ASSERT_TRUE(recorder.open(config_));
+   uint16_t stream = recorder.add_stream("test", "test/Bytes", "0", "");
+
+   // about three times what the ring holds
+   record(&recorder, stream, 1, 800, 1000);
+   recorder.close();
+
+   auto records = read_back();
+   ASSERT_FALSE(records.empty());
+   EXPECT_LT(records.size(), 800u);
+   EXPECT_EQ(records.back().first, 800u);
+   for (size_t i = 1; i < records.size(); i++) {
+      EXPECT_EQ(records[i].first, records[i - 1].first + 1);
+   }
+}
+
+TEST_F(RecorderTest, ContinuesAnExistingRing) {
+   FlightRecorder recorder;
+   ASSERT_TRUE(recorder.open(config_));
+   uint16_t stream = recorder.add_stream("test", "test/Bytes", "0", "");
+   record(&recorder, stream, 1, 10, 22);
+   recorder.close();
+
+   ASSERT_TRUE(recorder.open(config_));
+   stream = recorder.add_stream("test", "test/Bytes", "0", "");
+   record(&recorder, stream, 11, 10, 22);
+   recorder.close();
+
+   auto records = read_back();
+   ASSERT_EQ(records.size(), 20u);
+   EXPECT_EQ(records.front().first, 1u);
+   EXPECT_EQ(records.back().first, 20u);
+}
+
+TEST_F(RecorderTest, RejectsRecordLargerThanChunk) {
+   FlightRecorder recorder;
+   ASSERT_TRUE(recorder.open(config_));
+   uint16_t stream = recorder.add_stream("test", "test/Bytes", "0", "");
+   std::vector<uint8_t> data(config_.chunk_size);
+
+   EXPECT_FALSE(recorder.record(stream, ros::Time(1, 0), data.data(),
+                                data.size()));
+   EXPECT_EQ(recorder.stats().dropped, 1u);
+}
+
+TEST_F(RecorderTest, RecordCost) {
+   // the default geometry, so the ring wraps as it would on the truck
+   config_.chunk_size = 1 << 20;
+   config_.num_chunks = 16;
+   config_.sync_period = 0.1;
+
+   FlightRecorder recorder;
+   ASSERT_TRUE(recorder.open(config_));
+   uint16_t stream = recorder.add_stream("test", "test/Bytes", "0", "");
+
+   // a sensor frame's worth of data, and a compact scan's
+   for (uint32_t size : {22u, 2048u}) {
+      const int N = size < 1000 ? 200000 : 20000;
+      std::vector<uint8_t> data(size, 0x5a);
+      std::vector<double> ns(N);
+
+      for (int i = 0; i < N; i++) {
+         auto start = std::chrono::steady_clock::now();
+         recorder.record(stream, ros::Time(i, 0), data.data(), size);
+         ns[i] = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+      }
+      std::sort(ns.begin(), ns.end());
+      double median = ns[N / 2];
+      double p999 = ns[N - N / 1000];
+
+      // record() is a copy under a mutex; the syncs run on their own thread
+      printf("FlightRecorder::record, %u bytes: median %.0f ns, "
+             "99.9%% %.0f ns, max %.0f ns\n", size, median, p999,
+             ns[N - 1]);
+      RecordProperty("record_" + std::to_string(size) + "_median_ns",
+                     (int)median);
+      RecordProperty("record_" + std::to_string(size) + "_p999_ns",
+                     (int)p999);
+      EXPECT_LT(median, 100000.0);
+   }
+
+   auto stats = recorder.stats();
+   recorder.close();
+   printf("%lu syncs, longest %u us\n", (unsigned long)stats.syncs,
+          stats.sync_us_max);
+   EXPECT_EQ(stats.dropped, 0u);
+}
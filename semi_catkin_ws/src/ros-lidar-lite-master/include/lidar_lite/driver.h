@@ -24,6 +24,8 @@
 
 #include <boost/optional.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <ratio>
@@ -85,8 +87,71 @@ public:
   uint16_t uint_id();
 
   using centimeters = lidar_lite::distance<uint16_t, std::centi>;
+
+  // Takes a single measurement and waits for it to complete. In continuous
+  // mode no measurement is triggered and the latest result is returned, unless
+  // bias_correction is set, which restarts the measurements with correction.
+  // Reading faster than the measurement rate returns the same result again.
   boost::optional<centimeters> distance(bool bias_correction);
 
+  // Same as above, but applies receiver bias correction only when the
+  // BiasCorrection policy says it is due.
+  boost::optional<centimeters> distance();
+
+  // Bias correction is the slow path of a measurement and only has to be
+  // repeated to track drift, so it is applied every few samples and/or after
+  // some time. A field of 0 disables that trigger.
+  struct BiasCorrection {
+    uint32_t every_samples = 100; // correct after this many uncorrected samples
+    double every_seconds = 0.;    // correct when the last one is this old
+  };
+
+  void set_bias_correction(BiasCorrection const& policy) { bias_policy_ = policy; }
+
+  // Applies bias correction on the next distance() call. Safe to call from
+  // another thread.
+  void request_bias_correction() { bias_requested_ = true; }
+
+  // Switches the device into free-running mode: it repeats measurements on its
+  // own every 1/rate_hz seconds (up to ~500Hz) and distance() only reads the
+  // result registers. The first measurement uses receiver bias correction.
+  bool start_continuous(double rate_hz);
+
+  // Lets the current measurement finish and returns to single-shot mode.
+  bool stop_continuous();
+
+  bool continuous() const { return continuous_; }
+
+  // Actual measurement rate of the device in continuous mode.
+  double measurement_rate() const;
+
+  // In single-shot mode every distance read is a new measurement. In
+  // continuous mode a read is counted as new when its distance or velocity
+  // differs from the previous read; a target that holds still reads the same
+  // both times, so new_samples and sample_rate are a lower bound then.
+  struct Stats {
+    uint64_t samples = 0;       // distances successfully read
+    uint64_t new_samples = 0;   // distances that were new measurements
+    uint64_t i2c_errors = 0;    // failed register reads or writes
+    uint64_t busy_timeouts = 0; // single-shot measurements that never finished
+    double poll_rate = 0.;      // distances read per second over the last window
+    double sample_rate = 0.;    // new measurements per second over the last window
+
+    // Time distance() takes, split by whether bias correction was applied.
+    struct Latency {
+      uint64_t count = 0;
+      double total = 0.; // seconds
+      double max = 0.;   // seconds
+      double mean() const { return count ? total / count : 0.; }
+    };
+    Latency corrected;
+    Latency uncorrected;
+  };
+
+  // Returns the counters and updates the achieved poll and sample rates. The
+  // rates are averaged over at least one second between calls.
+  Stats const& stats();
+
 private:
   bool write(uint8_t addr, uint8_t value);
 
@@ -98,9 +163,40 @@ private:
     return read(addr, reinterpret_cast<uint8_t*>(value), sizeof(*value), monitor_busy_flag);
   }
 
+  boost::optional<centimeters> measure(bool bias_correction);
+
+  boost::optional<centimeters> read_distance(uint8_t addr, bool monitor_busy_flag);
+
+  boost::optional<centimeters> read_latest();
+
+  void count_sample(bool is_new);
+
+  bool bias_correction_due() const;
+
   uint8_t i2c_bus_;
   uint8_t i2c_address_;
   std::unique_ptr<simple_io::I2C> i2c_;
+
+  uint8_t acq_config_;
+  uint8_t measure_delay_;
+  bool continuous_;
+
+  using clock = std::chrono::steady_clock;
+
+  BiasCorrection bias_policy_;
+  std::atomic<bool> bias_requested_;
+  uint32_t samples_since_bias_;
+  clock::time_point last_bias_;
+
+  // The previous continuous mode read, to tell new measurements from repeats.
+  bool have_latest_;
+  uint16_t latest_distance_;
+  int8_t latest_velocity_;
+
+  Stats stats_;
+  uint64_t window_samples_;
+  uint64_t window_new_samples_;
+  clock::time_point window_start_;
 };
 
 } // namespace lidar_lite
@@ -26,20 +26,105 @@
 
 #include <ros/ros.h>
 
+#include <array>
+#include <cstdio>
+#include <cstring>
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 
 namespace simple_io {
 
 class I2C
 {
 public:
+  // Largest payload of a single register write, not counting the register.
+  enum : size_t { MAX_WRITE_SIZE = 32 };
+
+  /*
+   * A list of register reads and writes that is submitted to the device in a
+   * single I2C_RDWR ioctl, with repeated starts between the accesses and one
+   * STOP at the end. Read buffers are only valid once I2C::transfer() returns
+   * true. The batch owns copies of the write data, so it can be reused and
+   * kept around without referring to the caller's buffers.
+   */
+  class Batch
+  {
+  public:
+    enum : size_t { MAX_OPS = 8 };
+
+    Batch() : count_(0) {}
+
+    bool read(uint8_t reg, uint8_t* data, size_t size)
+    {
+      if (count_ == MAX_OPS) {
+        ROS_ERROR("I2C: Batch is full - reading reg=0x%02x", reg);
+        return false;
+      }
+
+      Op& op = ops_[count_++];
+      op.is_read = true;
+      op.reg = reg;
+      op.data = data;
+      op.size = size;
+      return true;
+    }
+
+    template <typename T>
+    bool read(uint8_t reg, T* data)
+    {
+      return read(reg, reinterpret_cast<uint8_t*>(data), sizeof(T));
+    }
+
+    bool write(uint8_t reg, uint8_t const* data, size_t size)
+    {
+      if (count_ == MAX_OPS || size > MAX_WRITE_SIZE) {
+        ROS_ERROR("I2C: Batch is full or %zu byte(s) too many - writing reg=0x%02x",
+                  size, reg);
+        return false;
+      }
+
+      Op& op = ops_[count_++];
+      op.is_read = false;
+      op.buf[0] = reg;
+      memcpy(op.buf + 1, data, size);
+      op.size = size;
+      return true;
+    }
+
+    template <typename T>
+    bool write(uint8_t reg, T const& data)
+    {
+      return write(reg, reinterpret_cast<uint8_t const*>(&data), sizeof(T));
+    }
+
+    void clear() { count_ = 0; }
+
+    size_t size() const { return count_; }
+
+  private:
+    friend class I2C;
+
+    struct Op {
+      bool is_read;
+      uint8_t reg;                      // register to read from
+      uint8_t* data;                    // destination of a read
+      uint8_t buf[1 + MAX_WRITE_SIZE];  // register and data of a write
+      size_t size;
+    };
+
+    std::array<Op, MAX_OPS> ops_;
+    size_t count_;
+  };
+
   I2C(uint8_t bus, uint8_t address)
     : bus_(bus)
     , address_(address)
     , file_(0)
+    , combined_(false)
   {}
 
   ~I2C()
@@ -64,6 +149,14 @@ public:
       return false;
     }
 
+    // Adapters that only support SMBus cannot do combined transactions, fall
+    // back to separate write() and read() calls for those.
+    unsigned long funcs = 0;
+    combined_ = ioctl(file_, I2C_FUNCS, &funcs) == 0 && (funcs & I2C_FUNC_I2C);
+    if (!combined_) {
+      ROS_WARN("I2C: Adapter does not support I2C_RDWR, using plain read/write");
+    }
+
     ROS_INFO("I2C: Successfully initialized [%s 0x%02x]", filename, address_);
     return true;
   }
@@ -71,18 +164,8 @@ public:
 
   bool write(uint8_t reg, uint8_t const* data, size_t size)
   {
-    uint8_t buf[1 + size];
-    buf[0] = reg;
-    memcpy(buf + 1, data, size);
-
-    if (::write(file_, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
-      ROS_ERROR("I2C: Failed to write data to register 0x%02x: %i-%s",
-                reg, errno, strerror(errno));
-      return false;
-    }
-
-    ROS_DEBUG("I2C: Successfully wrote %zu byte(s) to reg=0x%02x", size, reg);
-    return true;
+    Batch batch;
+    return batch.write(reg, data, size) && transfer(batch);
   }
 
   template <typename T>
@@ -103,20 +186,8 @@ public:
 
   bool read(uint8_t reg, uint8_t* data, size_t size)
   {
-    if (::write(file_, &reg, sizeof(reg)) != sizeof(reg)) {
-      ROS_ERROR("I2C: Failed to read byte(s) - writing reg=0x%02x: %i-%s",
-                reg, errno, strerror(errno));
-      return false;
-    }
-
-    if (::read(file_, data, (ssize_t)size) != (ssize_t)size) {
-      ROS_ERROR("I2C: Failed to read byte(s) - reading reg=0x%02x: %i-%s",
-                reg, errno, strerror(errno));
-      return false;
-    }
-
-    ROS_DEBUG("I2C: Successfully read %zu byte(s) from reg=0x%02x", size, reg);
-    return true;
+    Batch batch;
+    return batch.read(reg, data, size) && transfer(batch);
   }
 
   template <typename T>
@@ -131,11 +202,83 @@ public:
     return read(reg, reinterpret_cast<uint8_t*>(data), sizeof(T) * N);
   }
 
+
+  // Submits all accesses of the batch. A read is a write of the register
+  // followed by a read after a repeated start, so it costs one message pair
+  // instead of two syscalls with a STOP in between.
+  bool transfer(Batch& batch)
+  {
+    if (!combined_) {
+      return transfer_separately(batch);
+    }
+
+    std::array<i2c_msg, 2 * Batch::MAX_OPS> msgs;
+    size_t count = 0;
+
+    for (size_t i = 0; i < batch.count_; ++i) {
+      Batch::Op& op = batch.ops_[i];
+      if (op.is_read) {
+        msgs[count++] = i2c_msg{address_, 0, 1, &op.reg};
+        msgs[count++] = i2c_msg{address_, I2C_M_RD, (uint16_t)op.size, op.data};
+      }
+      else {
+        msgs[count++] = i2c_msg{address_, 0, (uint16_t)(1 + op.size), op.buf};
+      }
+    }
+
+    i2c_rdwr_ioctl_data data{msgs.data(), (uint32_t)count};
+    if (ioctl(file_, I2C_RDWR, &data) != (int)count) {
+      ROS_ERROR("I2C: Failed to transfer %zu access(es) starting at reg=0x%02x: %i-%s",
+                batch.count_, batch.count_ ? first_reg(batch.ops_[0]) : 0,
+                errno, strerror(errno));
+      return false;
+    }
+
+    ROS_DEBUG("I2C: Successfully transferred %zu access(es)", batch.count_);
+    return true;
+  }
+
 private:
+  static uint8_t first_reg(Batch::Op const& op)
+  {
+    return op.is_read ? op.reg : op.buf[0];
+  }
+
+  bool transfer_separately(Batch& batch)
+  {
+    for (size_t i = 0; i < batch.count_; ++i) {
+      Batch::Op& op = batch.ops_[i];
+      if (!op.is_read) {
+        if (::write(file_, op.buf, 1 + op.size) != (ssize_t)(1 + op.size)) {
+          ROS_ERROR("I2C: Failed to write data to register 0x%02x: %i-%s",
+                    op.buf[0], errno, strerror(errno));
+          return false;
+        }
+        continue;
+      }
+
+      if (::write(file_, &op.reg, sizeof(op.reg)) != sizeof(op.reg)) {
+        ROS_ERROR("I2C: Failed to read byte(s) - writing reg=0x%02x: %i-%s",
+                  op.reg, errno, strerror(errno));
+        return false;
+      }
+
+      if (::read(file_, op.data, op.size) != (ssize_t)op.size) {
+        ROS_ERROR("I2C: Failed to read byte(s) - reading reg=0x%02x: %i-%s",
+                  op.reg, errno, strerror(errno));
+        return false;
+      }
+    }
+
+    ROS_DEBUG("I2C: Successfully transferred %zu access(es)", batch.count_);
+    return true;
+  }
+
   const uint8_t bus_;
   const uint8_t address_;
 
   int file_;
+  bool combined_;
 };
 
 } // namespace simple_io
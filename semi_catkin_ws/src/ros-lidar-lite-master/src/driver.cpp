@@ -28,6 +28,9 @@
 
 #include <ros/ros.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace lidar_lite {
 
 enum ControlRegisters : uint8_t {
@@ -44,6 +47,8 @@ enum ControlRegisters : uint8_t {
   FULL_DELAY_HIGH          = 0x0f, // R    [--    ] Distance measurement high byte
   FULL_DELAY_LOW           = 0x10, // R    [--    ] Distance measurement low byte
   OUTER_LOOP_COUNT         = 0x11, // R/W  [0x01  ] Burst measurement count control
+  OUTER_LOOP_COUNT_DEFAULT = 0x01,
+  OUTER_LOOP_COUNT_FREE    = 0xff, //                 Repeat measurements indefinitely
   REF_COUNT_VAL            = 0x12, // R/W  [0x05  ] Reference acquisition count
   LAST_DELAY_HIGH          = 0x14, // R    [--    ] Previous distance measurement high byte
   LAST_DELAY_LOW           = 0x15, // R    [--    ] Previous distance measurement low byte
@@ -57,6 +62,8 @@ enum ControlRegisters : uint8_t {
   I2C_CONFIG               = 0x1e, // R/W  [0x00  ] Default address response control
   COMMAND                  = 0x40, // R/W  [--    ] State command
   MEASURE_DELAY            = 0x45, // R/W  [0x14  ] Delay between automatic measurements
+  MEASURE_DELAY_DEFAULT    = 0x14,
+  MEASURE_DELAY_MIN        = 0x04, //                 ~500Hz, the fastest the device can measure
   PEAK_BCK                 = 0x4c, // R    [--    ] Second largest peak value in correlation record
   CORR_DATA                = 0x52, // R    [--    ] Correlation record data low byte
   CORR_DATA_SIGN           = 0x53, // R    [--    ] Correlation record data high byte
@@ -72,6 +79,15 @@ enum ReadFlags : uint8_t {
   READ_AUTO_INC_ADDR = 1 << 7,
 };
 
+enum AcqConfigFlags : uint8_t {
+  // 0: Use the default delay (~10Hz) for burst and free running modes
+  // 1: Use the delay from MEASURE_DELAY
+  ACQ_CONFIG_USE_MEASURE_DELAY = 1 << 5,
+};
+
+// MEASURE_DELAY counts in units of 0.5ms, 0x14 corresponds to 100Hz.
+constexpr double MEASURE_DELAY_TICKS_PER_SECOND = 2000.;
+
 enum class AcqCommand : uint8_t {
   RESET                        = 0x00, // Reset FPGA, all registers return to default values
   MEASURE_WO_BIAS_CORRECTION   = 0x03, // Take distance measurement without receiver bias correction
@@ -153,6 +169,18 @@ char const* to_cstr(LidarLiteDriver::OperationMode op_mode)
  */
 LidarLiteDriver::LidarLiteDriver(uint8_t i2c_bus, uint8_t i2c_address)
   : i2c_(new simple_io::I2C(i2c_bus, i2c_address))
+  , acq_config_(ACQ_CONFIG_REG_DEFAULT)
+  , measure_delay_(MEASURE_DELAY_DEFAULT)
+  , continuous_(false)
+  , bias_requested_(true)
+  , samples_since_bias_(0)
+  , last_bias_(clock::now())
+  , have_latest_(false)
+  , latest_distance_(0)
+  , latest_velocity_(0)
+  , window_samples_(0)
+  , window_new_samples_(0)
+  , window_start_(clock::now())
 {
   ROS_INFO("Created");
 
@@ -181,41 +209,46 @@ LidarLiteDriver::configure(OperationMode op_mode)
   switch (op_mode) {
     case OperationMode::DEFAULT:
       write(SIG_COUNT_VAL, SIG_COUNT_VAL_DEFAULT);
-      write(ACQ_CONFIG_REG, ACQ_CONFIG_REG_DEFAULT);
+      acq_config_ = ACQ_CONFIG_REG_DEFAULT;
       write(THRESHOLD_BYPASS, THRESHOLD_BYPASS_DEFAULT);
       break;
 
     case OperationMode::SHORT_RANGE_HIGH_SPEED:
       write(SIG_COUNT_VAL, 0x1d);
-      write(ACQ_CONFIG_REG, ACQ_CONFIG_REG_DEFAULT);
+      acq_config_ = ACQ_CONFIG_REG_DEFAULT;
       write(THRESHOLD_BYPASS, THRESHOLD_BYPASS_DEFAULT);
       break;
 
     case OperationMode::DEFAULT_RANGE_HIGHER_SPEED_SHORT_RANGE:
       write(SIG_COUNT_VAL, SIG_COUNT_VAL_DEFAULT);
-      write(ACQ_CONFIG_REG, 0x00);
+      acq_config_ = 0x00;
       write(THRESHOLD_BYPASS, THRESHOLD_BYPASS_DEFAULT);
       break;
 
     case OperationMode::MAXIMUM_RANGE:
       write(SIG_COUNT_VAL, 0xff);
-      write(ACQ_CONFIG_REG, ACQ_CONFIG_REG_DEFAULT);
+      acq_config_ = ACQ_CONFIG_REG_DEFAULT;
       write(THRESHOLD_BYPASS, THRESHOLD_BYPASS_DEFAULT);
       break;
 
     case OperationMode::HIGH_SENSITIVITY_DETECTION:
       write(SIG_COUNT_VAL, SIG_COUNT_VAL_DEFAULT);
-      write(ACQ_CONFIG_REG, ACQ_CONFIG_REG_DEFAULT);
+      acq_config_ = ACQ_CONFIG_REG_DEFAULT;
       write(THRESHOLD_BYPASS, 0x80);
       break;
 
     case OperationMode::LOW_SENSITIVITY_DETECTION:
       write(SIG_COUNT_VAL, SIG_COUNT_VAL_DEFAULT);
-      write(ACQ_CONFIG_REG, ACQ_CONFIG_REG_DEFAULT);
+      acq_config_ = ACQ_CONFIG_REG_DEFAULT;
       write(THRESHOLD_BYPASS, 0xb0);
       break;
   }
 
+  // Keep using MEASURE_DELAY if the device is already free running.
+  write(ACQ_CONFIG_REG, continuous_
+        ? (uint8_t)(acq_config_ | ACQ_CONFIG_USE_MEASURE_DELAY)
+        : acq_config_);
+
   return true;
 }
 
@@ -240,9 +273,81 @@ LidarLiteDriver::uint_id()
   return uint_id;
 }
 
+boost::optional<LidarLiteDriver::centimeters>
+LidarLiteDriver::distance()
+{
+  bool bias_correction = bias_correction_due();
+  auto result = distance(bias_correction);
+
+  // A requested correction stands until a corrected measurement succeeds.
+  if (bias_correction && result) {
+    bias_requested_ = false;
+  }
+
+  return result;
+}
+
+bool
+LidarLiteDriver::bias_correction_due() const
+{
+  if (bias_requested_) {
+    return true;
+  }
+
+  if (bias_policy_.every_samples &&
+      samples_since_bias_ >= bias_policy_.every_samples) {
+    return true;
+  }
+
+  return bias_policy_.every_seconds > 0. &&
+         std::chrono::duration<double>(clock::now() - last_bias_).count()
+           >= bias_policy_.every_seconds;
+}
+
 boost::optional<LidarLiteDriver::centimeters>
 LidarLiteDriver::distance(bool bias_correction)
 {
+  auto start = clock::now();
+
+  auto distance = measure(bias_correction);
+  if (!distance) {
+    return {};
+  }
+
+  auto now = clock::now();
+  double latency = std::chrono::duration<double>(now - start).count();
+
+  Stats::Latency& stats = bias_correction ? stats_.corrected : stats_.uncorrected;
+  ++stats.count;
+  stats.total += latency;
+  stats.max = std::max(stats.max, latency);
+
+  if (bias_correction) {
+    samples_since_bias_ = 0;
+    last_bias_ = now;
+  }
+  else {
+    ++samples_since_bias_;
+  }
+
+  return distance;
+}
+
+boost::optional<LidarLiteDriver::centimeters>
+LidarLiteDriver::measure(bool bias_correction)
+{
+  if (continuous_) {
+    // Re-triggering restarts the free-running measurements, the first of
+    // which is corrected.
+    if (bias_correction &&
+        !write(ACQ_COMMAND, (uint8_t)AcqCommand::MEASURE_WITH_BIAS_CORRECTION)) {
+      ROS_ERROR("Failed to read distance - setting bias correction");
+      return {};
+    }
+
+    return read_latest();
+  }
+
   if (!write(ACQ_COMMAND, bias_correction
              ? (uint8_t)AcqCommand::MEASURE_WITH_BIAS_CORRECTION
              : (uint8_t)AcqCommand::MEASURE_WO_BIAS_CORRECTION
@@ -251,8 +356,14 @@ LidarLiteDriver::distance(bool bias_correction)
     return {};
   }
 
+  return read_distance(FULL_DELAY_HIGH | READ_AUTO_INC_ADDR, true);
+}
+
+boost::optional<LidarLiteDriver::centimeters>
+LidarLiteDriver::read_distance(uint8_t addr, bool monitor_busy_flag)
+{
   uint16_t distance = -1;
-  if (!read(FULL_DELAY_HIGH | READ_AUTO_INC_ADDR, &distance, true)) {
+  if (!read(addr, &distance, monitor_busy_flag)) {
     ROS_ERROR("Failed to read distance");
     return {};
   }
@@ -260,13 +371,126 @@ LidarLiteDriver::distance(bool bias_correction)
   distance = (distance << 8) | (distance >> 8);
   ROS_DEBUG("Distance: %u cm", distance);
 
+  count_sample(true);
   return centimeters{distance};
 }
 
+boost::optional<LidarLiteDriver::centimeters>
+LidarLiteDriver::read_latest()
+{
+  // LAST_DELAY holds the previous complete measurement, so it can be read at
+  // any time without waiting for the busy flag. The result is at most one
+  // measurement period old. VELOCITY is the difference between the last two
+  // measurements, which is read along to tell a new measurement at the same
+  // distance from the old one read again.
+  uint16_t distance = -1;
+  int8_t velocity = 0;
+  simple_io::I2C::Batch batch;
+  batch.read(LAST_DELAY_HIGH | READ_AUTO_INC_ADDR, &distance);
+  batch.read(VELOCITY, &velocity);
+
+  if (!i2c_->transfer(batch)) {
+    ++stats_.i2c_errors;
+    ROS_ERROR("Failed to read distance");
+    return {};
+  }
+
+  distance = (distance << 8) | (distance >> 8);
+  ROS_DEBUG("Distance: %u cm, velocity: %i", distance, velocity);
+
+  count_sample(!have_latest_ || distance != latest_distance_ ||
+               velocity != latest_velocity_);
+  have_latest_ = true;
+  latest_distance_ = distance;
+  latest_velocity_ = velocity;
+  return centimeters{distance};
+}
+
+void
+LidarLiteDriver::count_sample(bool is_new)
+{
+  ++stats_.samples;
+  ++window_samples_;
+  if (is_new) {
+    ++stats_.new_samples;
+    ++window_new_samples_;
+  }
+}
+
+bool
+LidarLiteDriver::start_continuous(double rate_hz)
+{
+  double delay = std::round(MEASURE_DELAY_TICKS_PER_SECOND / rate_hz);
+  measure_delay_ = (uint8_t)std::min(std::max(delay, (double)MEASURE_DELAY_MIN), 255.);
+
+  // Configure and trigger in one bus transaction.
+  simple_io::I2C::Batch batch;
+  batch.write(MEASURE_DELAY, measure_delay_);
+  batch.write(ACQ_CONFIG_REG, (uint8_t)(acq_config_ | ACQ_CONFIG_USE_MEASURE_DELAY));
+  batch.write(OUTER_LOOP_COUNT, (uint8_t)OUTER_LOOP_COUNT_FREE);
+  batch.write(ACQ_COMMAND, (uint8_t)AcqCommand::MEASURE_WITH_BIAS_CORRECTION);
+
+  if (!i2c_->transfer(batch)) {
+    ++stats_.i2c_errors;
+    ROS_ERROR("Failed to start continuous mode");
+    return false;
+  }
+
+  continuous_ = true;
+  bias_requested_ = false;
+  samples_since_bias_ = 0;
+  last_bias_ = clock::now();
+  have_latest_ = false;
+  window_samples_ = 0;
+  window_new_samples_ = 0;
+  window_start_ = clock::now();
+
+  ROS_INFO("Continuous mode at %.1fHz (MEASURE_DELAY=0x%02x)",
+           measurement_rate(), measure_delay_);
+  return true;
+}
+
+bool
+LidarLiteDriver::stop_continuous()
+{
+  if (!write(OUTER_LOOP_COUNT, OUTER_LOOP_COUNT_DEFAULT) ||
+      !write(ACQ_CONFIG_REG, acq_config_)) {
+    ROS_ERROR("Failed to stop continuous mode");
+    return false;
+  }
+
+  continuous_ = false;
+  ROS_INFO("Single measurement mode");
+  return true;
+}
+
+double
+LidarLiteDriver::measurement_rate() const
+{
+  return MEASURE_DELAY_TICKS_PER_SECOND / measure_delay_;
+}
+
+LidarLiteDriver::Stats const&
+LidarLiteDriver::stats()
+{
+  auto now = clock::now();
+  double elapsed = std::chrono::duration<double>(now - window_start_).count();
+  if (elapsed >= 1.) {
+    stats_.poll_rate = window_samples_ / elapsed;
+    stats_.sample_rate = window_new_samples_ / elapsed;
+    window_samples_ = 0;
+    window_new_samples_ = 0;
+    window_start_ = now;
+  }
+
+  return stats_;
+}
+
 bool
 LidarLiteDriver::write(uint8_t addr, uint8_t value)
 {
   if (!i2c_->write(addr, value)) {
+    ++stats_.i2c_errors;
     ROS_ERROR("Failed to write 0x%02x to 0x%02x", value, addr);
     return false;
   }
@@ -281,20 +505,25 @@ LidarLiteDriver::read(uint8_t addr, uint8_t* value, size_t bytes, bool monitor_b
   for (size_t count = 0; count < 100 && busy_flag; ++count) {
     uint8_t status;
     if (!i2c_->read(STATUS, &status)) {
+      ++stats_.i2c_errors;
       ROS_ERROR("Failed to read STATUS register");
       return false;
     }
     ROS_DEBUG("Status: 0x%02x %s", status, to_string((StatusFlags)status).c_str());
     busy_flag = !!(status & StatusFlags::BUSY);
-    usleep(1000);
+    if (busy_flag) {
+      usleep(1000);
+    }
   }
 
   if (busy_flag) {
+    ++stats_.busy_timeouts;
     ROS_ERROR("Failed to read %zu byte(s) from 0x%02x - busy", bytes, addr);
     return false;
   }
 
   if (!i2c_->read(addr, value, bytes)) {
+    ++stats_.i2c_errors;
     ROS_ERROR("Failed to read %zu byte(s) from 0x%02x", bytes, addr);
     return false;
   }
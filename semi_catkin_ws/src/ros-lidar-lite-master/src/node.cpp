@@ -25,12 +25,143 @@
 #include "lidar_lite/driver.h"
 
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Range.h>
+#include <std_srvs/Trigger.h>
 
 #include <boost/lexical_cast.hpp>
 #include <ros/ros.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <semaphore.h>
+#include <thread>
+
 namespace lidar_lite {
 
+struct Sample {
+  uint16_t centimeters;
+  ros::Time stamp;
+};
+
+/*
+ * SampleQueue
+ *
+ * Single producer, single consumer ring buffer between the acquisition thread
+ * and the publisher. push() and pop() never block or allocate, so a slow
+ * publisher cannot delay a measurement; when the ring is full the newest
+ * sample is dropped and counted. The semaphore only wakes the consumer up.
+ */
+class SampleQueue
+{
+public:
+  enum : size_t { CAPACITY = 64 };
+
+  SampleQueue() : head_(0), tail_(0), dropped_(0) { sem_init(&ready_, 0, 0); }
+  ~SampleQueue() { sem_destroy(&ready_); }
+
+  void push(Sample const& sample)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == CAPACITY) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    samples_[head % CAPACITY] = sample;
+    head_.store(head + 1, std::memory_order_release);
+    sem_post(&ready_);
+  }
+
+  bool pop(Sample* sample)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    *sample = samples_[tail % CAPACITY];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Waits up to timeout_ms for a sample to be pushed.
+  void wait(long timeout_ms)
+  {
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += timeout_ms * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    sem_timedwait(&ready_, &deadline);
+  }
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  std::array<Sample, CAPACITY> samples_;
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+  std::atomic<uint64_t> dropped_;
+  sem_t ready_;
+};
+
+/*
+ * Reads the sensor at the target rate until running is cleared. After a
+ * failed read the thread backs off, doubling the delay up to max_backoff,
+ * instead of hammering a sensor that is not responding.
+ */
+void
+acquire(LidarLiteDriver& driver, SampleQueue& queue, double rate,
+        double max_backoff, std::atomic<bool> const& running)
+{
+  using clock = std::chrono::steady_clock;
+
+  auto const period = std::chrono::duration_cast<clock::duration>(
+    std::chrono::duration<double>(1. / rate));
+  auto const max_delay = std::chrono::duration_cast<clock::duration>(
+    std::chrono::duration<double>(max_backoff));
+  auto backoff = period;
+  auto next = clock::now();
+
+  while (running) {
+    auto const& stats = driver.stats();
+    ROS_INFO_THROTTLE(10., "Stats: {rate: %.1fHz, polls: %.1fHz, samples: %lu,"
+                      " new: %lu, i2c_errors: %lu,"
+                      " busy_timeouts: %lu, corrected: %lu avg %.3fms max %.3fms,"
+                      " uncorrected: %lu avg %.3fms max %.3fms}",
+                      stats.sample_rate, stats.poll_rate,
+                      (unsigned long)stats.samples,
+                      (unsigned long)stats.new_samples,
+                      (unsigned long)stats.i2c_errors,
+                      (unsigned long)stats.busy_timeouts,
+                      (unsigned long)stats.corrected.count,
+                      stats.corrected.mean() * 1000., stats.corrected.max * 1000.,
+                      (unsigned long)stats.uncorrected.count,
+                      stats.uncorrected.mean() * 1000., stats.uncorrected.max * 1000.);
+
+    auto distance = driver.distance();
+    if (distance) {
+      queue.push(Sample{distance->value, ros::Time::now()});
+      backoff = period;
+      next += period;
+    }
+    else {
+      backoff = std::min(backoff * 2, max_delay);
+      next = clock::now() + backoff;
+    }
+
+    // Don't try to catch up on missed periods, just restart from now.
+    auto now = clock::now();
+    if (next < now) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
 int
 run(int argc, char **argv)
 {
@@ -39,6 +170,11 @@ run(int argc, char **argv)
   std::string frame_id = "lidar_lite";
   int32_t i2c_bus = LidarLiteDriver::DEFAULT_I2C_BUS;
   uint8_t i2c_address = LidarLiteDriver::DEFAULT_I2C_ADDR;
+  bool continuous = false;
+  double rate = 100.;
+  double max_backoff = 1.;
+  bool publish_range = false;
+  LidarLiteDriver::BiasCorrection bias_correction;
 
   ros::NodeHandle nh;
   try {
@@ -51,42 +187,140 @@ run(int argc, char **argv)
 
     i2c_address = (uint8_t)std::stoul(i2c_address_str, nullptr, 0);
 
-    ROS_INFO("Read params: {frame_id: %s, i2c_bus: %i, i2c_address: 0x%0x}",
-             frame_id.c_str(), i2c_bus, i2c_address);
+    nh_.param("continuous", continuous, continuous);
+    nh_.param("rate", rate, rate);
+    nh_.param("max_backoff", max_backoff, max_backoff);
+    nh_.param("publish_range", publish_range, publish_range);
+
+    int bias_every_samples = bias_correction.every_samples;
+    nh_.param("bias_every_samples", bias_every_samples, bias_every_samples);
+    bias_correction.every_samples = (uint32_t)std::max(bias_every_samples, 0);
+    nh_.param("bias_every_seconds", bias_correction.every_seconds,
+              bias_correction.every_seconds);
+
+    ROS_INFO("Read params: {frame_id: %s, i2c_bus: %i, i2c_address: 0x%0x,"
+             " continuous: %i, rate: %.1f, max_backoff: %.3f, publish_range: %i,"
+             " bias_every_samples: %u, bias_every_seconds: %.1f}",
+             frame_id.c_str(), i2c_bus, i2c_address, continuous, rate,
+             max_backoff, publish_range, bias_correction.every_samples,
+             bias_correction.every_seconds);
   }
   catch (boost::bad_lexical_cast const& ex) {
     ROS_ERROR("Failed to read params: %s", ex.what());
     return 1;
   }
 
-  ros::Publisher publisher = nh.advertise<sensor_msgs::LaserScan>("scan_lidar_lite", 1024);
+  if (rate <= 0.) {
+    ROS_ERROR("rate must be positive");
+    return 1;
+  }
+
+  ros::Publisher publisher = publish_range
+    ? nh.advertise<sensor_msgs::Range>("range_lidar_lite", 1024)
+    : nh.advertise<sensor_msgs::LaserScan>("scan_lidar_lite", 1024);
 
   LidarLiteDriver driver((uint8_t)i2c_bus, i2c_address);
   driver.configure(LidarLiteDriver::OperationMode::DEFAULT);
+  driver.set_bias_correction(bias_correction);
+
+  // Forces bias correction on the next sample, e.g. after the sensor warmed up.
+  ros::NodeHandle private_nh("~");
+  ros::ServiceServer correct_bias = private_nh.advertiseService(
+    "correct_bias",
+    boost::function<bool(std_srvs::Trigger::Request&, std_srvs::Trigger::Response&)>(
+      [&driver](std_srvs::Trigger::Request&, std_srvs::Trigger::Response& res) {
+        driver.request_bias_correction();
+        res.success = true;
+        res.message = "Bias correction scheduled for the next sample";
+        return true;
+      }));
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  // In continuous mode the device measures on its own, so poll its result
+  // registers at the measurement rate instead of the requested one.
+  if (continuous) {
+    if (!driver.start_continuous(rate)) {
+      return 1;
+    }
+    rate = driver.measurement_rate();
+  }
+
+  // The messages are filled in once and only the reading changes. publish()
+  // serializes them right away, so they can be reused for the next sample.
+  sensor_msgs::LaserScan scan;
+  scan.header.frame_id = frame_id;
+  scan.angle_min = 0.;
+  scan.angle_max = 0.;
+  scan.angle_increment = 1.;
+  scan.time_increment = 0.;
+  scan.scan_time = 1. / rate;
+  scan.range_min = 0.;
+  scan.range_max = 40.;
+  scan.ranges.resize(1);
+  scan.intensities.resize(1);
+
+  sensor_msgs::Range range;
+  range.header.frame_id = frame_id;
+  range.radiation_type = sensor_msgs::Range::INFRARED;
+  range.field_of_view = 0.008; // beam divergence of the LIDAR-Lite v3
+  range.min_range = 0.;
+  range.max_range = 40.;
+
+  SampleQueue queue;
+  std::atomic<bool> running(true);
+  std::thread acquisition(acquire, std::ref(driver), std::ref(queue), rate,
+                          max_backoff, std::cref(running));
+
+  uint64_t published = 0;
+  double latency_sum = 0.;
+  double latency_max = 0.;
+  ros::WallTime window_start = ros::WallTime::now();
 
   while (ros::ok()) {
-    auto distance = driver.distance(true);
-    if (!distance) {
-      continue;
+    queue.wait(100);
+
+    Sample sample;
+    while (queue.pop(&sample)) {
+      float distance_in_meters = sample.centimeters / 100.0;
+
+      if (publish_range) {
+        range.header.stamp = sample.stamp;
+        range.range = distance_in_meters;
+        publisher.publish(range);
+      }
+      else {
+        scan.header.stamp = sample.stamp;
+        scan.ranges[0] = distance_in_meters;
+        scan.intensities[0] = sample.centimeters;
+        publisher.publish(scan);
+      }
+
+      double latency = (ros::Time::now() - sample.stamp).toSec();
+      latency_sum += latency;
+      latency_max = std::max(latency_max, latency);
+      ++published;
     }
 
-    sensor_msgs::LaserScan msg;
-    msg.header.frame_id = frame_id;
-    msg.header.stamp = ros::Time::now();
+    double elapsed = (ros::WallTime::now() - window_start).toSec();
+    if (elapsed >= 10.) {
+      ROS_INFO("Published %.1fHz, latency avg %.3fms max %.3fms, dropped %lu",
+               published / elapsed,
+               published ? latency_sum / published * 1000. : 0.,
+               latency_max * 1000., (unsigned long)queue.dropped());
 
-    float distance_in_meters = distance->value / 100.0;
+      published = 0;
+      latency_sum = 0.;
+      latency_max = 0.;
+      window_start = ros::WallTime::now();
+    }
+  }
 
-    msg.angle_min = 0.;
-    msg.angle_max = 0.;
-    msg.angle_increment = 1.;
-    msg.time_increment = 0.;
-    //msg.scan_time = 0.;
-    msg.range_min = 0.;
-    msg.range_max = 40.;
-    msg.ranges.push_back(distance_in_meters);
-    msg.intensities.push_back(distance->value);
+  running = false;
+  acquisition.join();
 
-    publisher.publish(msg);
+  if (continuous) {
+    driver.stop_continuous();
   }
 
   return 0;
@@ -0,0 +1,195 @@
+/*
+ * Fake I2C bus for the tests, see fake_i2c.h.
+ *
+ * Only headers without fortified wrappers of open(), read() and write() are
+ * included here, so the definitions below can replace the libc ones.
+ */
+
+#include "fake_i2c.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+
+namespace fake_i2c {
+
+void
+Device::write(uint8_t const* data, size_t size)
+{
+  if (size == 0) {
+    return;
+  }
+
+  pointer_ = data[0] & 0x7f;
+  auto_inc_ = data[0] & 0x80;
+  for (size_t i = 1; i < size; ++i) {
+    regs[pointer_] = data[i];
+    writes.push_back(Write{pointer_, data[i]});
+    on_write(pointer_);
+    if (auto_inc_) {
+      ++pointer_;
+    }
+  }
+}
+
+void
+Device::read(uint8_t* data, size_t size)
+{
+  for (size_t i = 0; i < size; ++i) {
+    on_read(pointer_);
+    data[i] = regs[pointer_];
+    if (auto_inc_) {
+      ++pointer_;
+    }
+  }
+}
+
+static Device* device = nullptr;
+static bool combined = true;
+static int device_fd = -1;
+static Counters counters_;
+
+void
+attach(Device* dev, bool comb)
+{
+  device = dev;
+  combined = comb;
+}
+
+void
+detach()
+{
+  device = nullptr;
+}
+
+Counters&
+counters()
+{
+  return counters_;
+}
+
+template <typename Fn>
+static Fn
+next(char const* name)
+{
+  return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+} // namespace fake_i2c
+
+using namespace fake_i2c;
+
+extern "C" {
+
+int
+open(char const* path, int flags, ...)
+{
+  static auto real_open = next<int (*)(char const*, int, ...)>("open");
+
+  if (device != nullptr && strncmp(path, "/dev/i2c-", 9) == 0) {
+    device_fd = eventfd(0, 0);
+    return device_fd;
+  }
+
+  va_list args;
+  va_start(args, flags);
+  int mode = va_arg(args, int);
+  va_end(args);
+  return real_open(path, flags, mode);
+}
+
+int
+close(int fd)
+{
+  static auto real_close = next<int (*)(int)>("close");
+
+  if (fd == device_fd) {
+    device_fd = -1;
+  }
+  return real_close(fd);
+}
+
+ssize_t
+write(int fd, void const* buf, size_t count)
+{
+  static auto real_write = next<ssize_t (*)(int, void const*, size_t)>("write");
+
+  if (fd != device_fd || device == nullptr) {
+    return real_write(fd, buf, count);
+  }
+
+  ++counters_.writes;
+  device->write(static_cast<uint8_t const*>(buf), count);
+  return count;
+}
+
+ssize_t
+read(int fd, void* buf, size_t count)
+{
+  static auto real_read = next<ssize_t (*)(int, void*, size_t)>("read");
+
+  if (fd != device_fd || device == nullptr) {
+    return real_read(fd, buf, count);
+  }
+
+  ++counters_.reads;
+  device->read(static_cast<uint8_t*>(buf), count);
+  return count;
+}
+
+int
+ioctl(int fd, unsigned long request, ...) __THROW
+{
+  static auto real_ioctl = next<int (*)(int, unsigned long, ...)>("ioctl");
+
+  va_list args;
+  va_start(args, request);
+  void* arg = va_arg(args, void*);
+  va_end(args);
+
+  if (fd != device_fd || device == nullptr) {
+    return real_ioctl(fd, request, arg);
+  }
+
+  switch (request) {
+    case I2C_SLAVE:
+      return 0;
+
+    case I2C_FUNCS:
+      *static_cast<unsigned long*>(arg) = combined ? I2C_FUNC_I2C : I2C_FUNC_SMBUS_BYTE;
+      return 0;
+
+    case I2C_RDWR: {
+      if (!combined) {
+        errno = EOPNOTSUPP;
+        return -1;
+      }
+
+      auto data = static_cast<i2c_rdwr_ioctl_data*>(arg);
+      ++counters_.rdwr_ioctls;
+      counters_.rdwr_msgs += data->nmsgs;
+      for (uint32_t i = 0; i < data->nmsgs; ++i) {
+        i2c_msg& msg = data->msgs[i];
+        if (msg.flags & I2C_M_RD) {
+          device->read(msg.buf, msg.len);
+        }
+        else {
+          device->write(msg.buf, msg.len);
+        }
+      }
+      return data->nmsgs;
+    }
+
+    default:
+      errno = ENOTTY;
+      return -1;
+  }
+}
+
+} // extern "C"
@@ -0,0 +1,76 @@
+/*
+ * Fake I2C bus for the tests.
+ *
+ * simple_io::I2C talks to /dev/i2c-N with open(), ioctl(), read() and
+ * write(). fake_i2c.cpp interposes those calls: while a Device is attached,
+ * opening any /dev/i2c-N connects to it instead of the kernel, and every
+ * other file goes to libc as usual. The driver and simple_io are tested
+ * unmodified.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fake_i2c {
+
+/*
+ * A device with 256 byte registers behind a register pointer. A write sets
+ * the pointer from its first byte and stores the rest from there on; a read
+ * reads from the pointer on. Like on the LIDAR-Lite, the pointer only
+ * increments between the bytes of one access when bit 7 of the register
+ * address is set, and that bit is not part of the address.
+ */
+class Device
+{
+public:
+  Device() : regs{}, pointer_(0), auto_inc_(false) {}
+  virtual ~Device() {}
+
+  void write(uint8_t const* data, size_t size);
+  void read(uint8_t* data, size_t size);
+
+  void set16(uint8_t reg, uint16_t value)
+  {
+    regs[reg] = value >> 8;
+    regs[reg + 1] = value & 0xff;
+  }
+
+  uint8_t regs[256];
+
+  // Every write of a register, in order.
+  struct Write {
+    uint8_t reg;
+    uint8_t value;
+  };
+  std::vector<Write> writes;
+
+protected:
+  // Hooks for a device that does something when a register is accessed.
+  virtual void on_write(uint8_t /*reg*/) {}
+  virtual void on_read(uint8_t /*reg*/) {}
+
+private:
+  uint8_t pointer_;
+  bool auto_inc_;
+};
+
+// System calls that reached an attached device.
+struct Counters {
+  uint64_t rdwr_ioctls = 0; // I2C_RDWR ioctls
+  uint64_t rdwr_msgs = 0;   // messages in those
+  uint64_t writes = 0;      // plain write() calls
+  uint64_t reads = 0;       // plain read() calls
+};
+
+// Connects the next opens of /dev/i2c-N to device. An adapter that is not
+// combined only does plain read() and write(), like an SMBus-only one.
+void attach(Device* device, bool combined = true);
+
+void detach();
+
+Counters& counters();
+
+} // namespace fake_i2c
@@ -0,0 +1,239 @@
+/*
+ * Runs LidarLiteDriver against a fake LIDAR-Lite on the fake I2C bus.
+ */
+
+#include "fake_i2c.h"
+#include "lidar_lite/driver.h"
+
+#include <gtest/gtest.h>
+
+using lidar_lite::LidarLiteDriver;
+
+namespace {
+
+enum : uint8_t {
+  ACQ_COMMAND = 0x00,
+  STATUS = 0x01,
+  ACQ_CONFIG_REG = 0x04,
+  VELOCITY = 0x09,
+  FULL_DELAY_HIGH = 0x0f,
+  OUTER_LOOP_COUNT = 0x11,
+  LAST_DELAY_HIGH = 0x14,
+  MEASURE_DELAY = 0x45,
+};
+
+enum : uint8_t {
+  MEASURE_WO_BIAS_CORRECTION = 0x03,
+  MEASURE_WITH_BIAS_CORRECTION = 0x04,
+};
+
+/*
+ * The registers that the driver uses. A triggered single measurement is busy
+ * for busy_polls reads of STATUS and then shows next_distance; in free
+ * running mode the test finishes measurements with measure().
+ */
+class FakeLidarLite : public fake_i2c::Device
+{
+public:
+  FakeLidarLite() : next_distance(0), busy_polls(1), busy_left_(0)
+  {
+    regs[STATUS] = 0x20; // HEALTH
+    regs[OUTER_LOOP_COUNT] = 0x01;
+    set16(0x16, 0x1234); // UNIT_ID
+    fake_i2c::attach(this);
+  }
+
+  ~FakeLidarLite() { fake_i2c::detach(); }
+
+  void measure(uint16_t distance, int8_t velocity)
+  {
+    set16(LAST_DELAY_HIGH, distance);
+    regs[VELOCITY] = (uint8_t)velocity;
+  }
+
+  // The commands written to ACQ_COMMAND, in order.
+  std::vector<uint8_t> commands() const
+  {
+    std::vector<uint8_t> commands;
+    for (auto const& w : writes) {
+      if (w.reg == ACQ_COMMAND) {
+        commands.push_back(w.value);
+      }
+    }
+    return commands;
+  }
+
+  uint16_t next_distance;
+  int busy_polls;
+
+protected:
+  void on_write(uint8_t reg) override
+  {
+    if (reg == ACQ_COMMAND && regs[OUTER_LOOP_COUNT] != 0xff) {
+      set16(FULL_DELAY_HIGH, next_distance);
+      busy_left_ = busy_polls;
+    }
+  }
+
+  void on_read(uint8_t reg) override
+  {
+    if (reg == STATUS) {
+      regs[STATUS] = busy_left_ != 0 ? 0x21 : 0x20;
+      if (busy_left_ > 0) {
+        --busy_left_;
+      }
+    }
+  }
+
+private:
+  int busy_left_;
+};
+
+} // namespace
+
+TEST(Driver, SingleShotEveryReadIsNew)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+
+  for (uint16_t cm : {120, 120, 121}) {
+    lidar.next_distance = cm;
+    auto distance = driver.distance(false);
+    ASSERT_TRUE(distance);
+    EXPECT_EQ(distance->value, cm);
+  }
+
+  auto const& stats = driver.stats();
+  EXPECT_EQ(stats.samples, 3u);
+  EXPECT_EQ(stats.new_samples, 3u);
+}
+
+TEST(Driver, SingleShotWaitsWhileBusy)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+
+  lidar.next_distance = 300;
+  lidar.busy_polls = 3;
+  auto distance = driver.distance(false);
+  ASSERT_TRUE(distance);
+  EXPECT_EQ(distance->value, 300);
+
+  lidar.busy_polls = 1000;
+  EXPECT_FALSE(driver.distance(false));
+  EXPECT_EQ(driver.stats().busy_timeouts, 1u);
+}
+
+TEST(Driver, BiasCorrectionPolicy)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+  LidarLiteDriver::BiasCorrection policy;
+  policy.every_samples = 2;
+  driver.set_bias_correction(policy);
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(driver.distance());
+  }
+  driver.request_bias_correction();
+  ASSERT_TRUE(driver.distance());
+
+  // the first sample is corrected, then one in every_samples + 1, and on
+  // request
+  EXPECT_EQ(lidar.commands(), (std::vector<uint8_t>{
+    MEASURE_WITH_BIAS_CORRECTION, MEASURE_WO_BIAS_CORRECTION,
+    MEASURE_WO_BIAS_CORRECTION, MEASURE_WITH_BIAS_CORRECTION,
+    MEASURE_WITH_BIAS_CORRECTION}));
+}
+
+TEST(Driver, FailedCorrectionStaysRequested)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+  LidarLiteDriver::BiasCorrection policy;
+  policy.every_samples = 0;
+  policy.every_seconds = 0.;
+  driver.set_bias_correction(policy);
+  ASSERT_TRUE(driver.distance());
+
+  driver.request_bias_correction();
+  lidar.busy_polls = 1000;
+  EXPECT_FALSE(driver.distance());
+  lidar.busy_polls = 1;
+  ASSERT_TRUE(driver.distance());
+  ASSERT_TRUE(driver.distance());
+
+  // the failed corrected measurement is retried, and then it is done
+  EXPECT_EQ(lidar.commands(), (std::vector<uint8_t>{
+    MEASURE_WITH_BIAS_CORRECTION, MEASURE_WITH_BIAS_CORRECTION,
+    MEASURE_WITH_BIAS_CORRECTION, MEASURE_WO_BIAS_CORRECTION}));
+}
+
+TEST(Driver, StartContinuousConfiguresDevice)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+  driver.configure(LidarLiteDriver::OperationMode::DEFAULT);
+
+  fake_i2c::counters() = fake_i2c::Counters();
+  ASSERT_TRUE(driver.start_continuous(100.));
+  EXPECT_TRUE(driver.continuous());
+  EXPECT_EQ(fake_i2c::counters().rdwr_ioctls, 1u);
+
+  EXPECT_EQ(lidar.regs[MEASURE_DELAY], 20);
+  EXPECT_EQ(lidar.regs[ACQ_CONFIG_REG], 0x08 | 0x20);
+  EXPECT_EQ(lidar.regs[OUTER_LOOP_COUNT], 0xff);
+  EXPECT_EQ(lidar.commands().back(), MEASURE_WITH_BIAS_CORRECTION);
+  EXPECT_DOUBLE_EQ(driver.measurement_rate(), 100.);
+
+  ASSERT_TRUE(driver.stop_continuous());
+  EXPECT_EQ(lidar.regs[OUTER_LOOP_COUNT], 0x01);
+  EXPECT_EQ(lidar.regs[ACQ_CONFIG_REG], 0x08);
+}
+
+TEST(Driver, ContinuousTellsNewSamplesFromPolls)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+  LidarLiteDriver::BiasCorrection policy;
+  policy.every_samples = 0;
+  driver.set_bias_correction(policy);
+  ASSERT_TRUE(driver.start_continuous(100.));
+
+  // polled three times per measurement
+  lidar.measure(150, 0);
+  for (int i = 0; i < 3; ++i) {
+    auto distance = driver.distance();
+    ASSERT_TRUE(distance);
+    EXPECT_EQ(distance->value, 150);
+  }
+  lidar.measure(148, -2);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(driver.distance()->value, 148);
+  }
+  // the same distance, but the velocity shows it is a new measurement
+  lidar.measure(148, 0);
+  EXPECT_EQ(driver.distance()->value, 148);
+
+  auto const& stats = driver.stats();
+  EXPECT_EQ(stats.samples, 7u);
+  EXPECT_EQ(stats.new_samples, 3u);
+}
+
+TEST(Driver, ContinuousReadIsOneTransaction)
+{
+  FakeLidarLite lidar;
+  LidarLiteDriver driver;
+  LidarLiteDriver::BiasCorrection policy;
+  policy.every_samples = 0;
+  driver.set_bias_correction(policy);
+  ASSERT_TRUE(driver.start_continuous(200.));
+
+  fake_i2c::counters() = fake_i2c::Counters();
+  lidar.measure(500, 0);
+  ASSERT_TRUE(driver.distance());
+  EXPECT_EQ(fake_i2c::counters().rdwr_ioctls, 1u);
+  EXPECT_EQ(fake_i2c::counters().writes + fake_i2c::counters().reads, 0u);
+  // no new measurement is triggered
+  EXPECT_EQ(lidar.commands().size(), 1u);
+}
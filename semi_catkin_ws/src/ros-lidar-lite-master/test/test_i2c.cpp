@@ -0,0 +1,146 @@
+/*
+ * Runs simple_io::I2C and its Batch against the fake I2C bus, and counts the
+ * system calls that each kind of adapter needs.
+ */
+
+#include "fake_i2c.h"
+
+#include <simple_io/i2c.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/*
+ * Attaches a plain register device, with or without I2C_RDWR, and starts
+ * the counters from zero once the bus is open.
+ */
+class I2CTest : public ::testing::TestWithParam<bool>
+{
+protected:
+  I2CTest() : i2c(1, 0x62)
+  {
+    fake_i2c::attach(&device, GetParam());
+    init = i2c.init();
+    fake_i2c::counters() = fake_i2c::Counters();
+  }
+
+  ~I2CTest() { fake_i2c::detach(); }
+
+  fake_i2c::Device device;
+  simple_io::I2C i2c;
+  bool init;
+};
+
+} // namespace
+
+TEST_P(I2CTest, WriteAndRead)
+{
+  ASSERT_TRUE(init);
+
+  uint8_t const data[] = {1, 2, 3};
+  ASSERT_TRUE(i2c.write(0x10 | 0x80, data));
+  EXPECT_EQ(device.regs[0x10], 1);
+  EXPECT_EQ(device.regs[0x12], 3);
+
+  uint16_t value = 0;
+  ASSERT_TRUE(i2c.read(0x11 | 0x80, &value));
+  EXPECT_EQ(value, 0x0302);
+
+  uint8_t byte = 0;
+  ASSERT_TRUE(i2c.read(0x10, &byte));
+  EXPECT_EQ(byte, 1);
+}
+
+TEST_P(I2CTest, BatchKeepsOrder)
+{
+  ASSERT_TRUE(init);
+
+  uint8_t before = 0xaa, after = 0xaa;
+  simple_io::I2C::Batch batch;
+  batch.read(0x20, &before);
+  batch.write(0x20, (uint8_t)7);
+  batch.read(0x20, &after);
+  ASSERT_TRUE(i2c.transfer(batch));
+
+  EXPECT_EQ(before, 0);
+  EXPECT_EQ(after, 7);
+
+  // the batch can be submitted again and reads into the same buffers
+  device.regs[0x20] = 9;
+  ASSERT_TRUE(i2c.transfer(batch));
+  EXPECT_EQ(before, 9);
+  EXPECT_EQ(after, 7);
+}
+
+TEST_P(I2CTest, BatchOwnsWriteData)
+{
+  ASSERT_TRUE(init);
+
+  simple_io::I2C::Batch batch;
+  {
+    uint8_t value = 5;
+    batch.write(0x30, value);
+    value = 6;
+  }
+  ASSERT_TRUE(i2c.transfer(batch));
+  EXPECT_EQ(device.regs[0x30], 5);
+}
+
+TEST_P(I2CTest, BatchRejectsTooMuch)
+{
+  simple_io::I2C::Batch batch;
+  uint8_t big[simple_io::I2C::MAX_WRITE_SIZE + 1] = {};
+  uint8_t byte;
+
+  EXPECT_FALSE(batch.write(0x00, big, sizeof(big)));
+  for (size_t i = 0; i < simple_io::I2C::Batch::MAX_OPS; ++i) {
+    EXPECT_TRUE(batch.read(0x00, &byte));
+  }
+  EXPECT_FALSE(batch.read(0x00, &byte));
+  EXPECT_FALSE(batch.write(0x00, byte));
+  EXPECT_EQ(batch.size(), (size_t)simple_io::I2C::Batch::MAX_OPS);
+}
+
+TEST_P(I2CTest, SystemCallsPerBatch)
+{
+  ASSERT_TRUE(init);
+
+  // what LidarLiteDriver::start_continuous() and a continuous read submit
+  simple_io::I2C::Batch start;
+  start.write(0x45, (uint8_t)20);
+  start.write(0x04, (uint8_t)0x28);
+  start.write(0x11, (uint8_t)0xff);
+  start.write(0x00, (uint8_t)0x04);
+
+  uint16_t distance;
+  uint8_t velocity;
+  simple_io::I2C::Batch poll;
+  poll.read(0x14 | 0x80, &distance);
+  poll.read(0x09, &velocity);
+
+  ASSERT_TRUE(i2c.transfer(start));
+  auto start_calls = fake_i2c::counters();
+  fake_i2c::counters() = fake_i2c::Counters();
+  ASSERT_TRUE(i2c.transfer(poll));
+  auto poll_calls = fake_i2c::counters();
+
+  if (GetParam()) {
+    // one ioctl each, with a message per write and two per read
+    EXPECT_EQ(start_calls.rdwr_ioctls, 1u);
+    EXPECT_EQ(start_calls.rdwr_msgs, 4u);
+    EXPECT_EQ(poll_calls.rdwr_ioctls, 1u);
+    EXPECT_EQ(poll_calls.rdwr_msgs, 4u);
+    EXPECT_EQ(start_calls.writes + start_calls.reads +
+              poll_calls.writes + poll_calls.reads, 0u);
+  }
+  else {
+    // a write() per write, and a write() and a read() per read
+    EXPECT_EQ(start_calls.writes, 4u);
+    EXPECT_EQ(poll_calls.writes, 2u);
+    EXPECT_EQ(poll_calls.reads, 2u);
+    EXPECT_EQ(start_calls.rdwr_ioctls + poll_calls.rdwr_ioctls, 0u);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Adapters, I2CTest, ::testing::Values(true, false));
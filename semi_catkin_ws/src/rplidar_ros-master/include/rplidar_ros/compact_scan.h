@@ -0,0 +1,91 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Conversion between rplidar_ros/CompactScan and sensor_msgs/LaserScan.
+ *  See node.cpp for the license.
+ */
+
+#ifndef RPLIDAR_ROS_COMPACT_SCAN_H
+#define RPLIDAR_ROS_COMPACT_SCAN_H
+
+#include <limits>
+#include "sensor_msgs/LaserScan.h"
+#include "rplidar_ros/CompactScan.h"
+
+namespace rplidar_ros {
+
+/**
+ * Fills in a LaserScan from a CompactScan. A range of 0 mm becomes infinity,
+ * as in the scans that the node publishes. The vectors of scan are resized,
+ * so converting into the same message repeatedly does not allocate once it
+ * has held the largest scan.
+ */
+inline void toLaserScan(const CompactScan &compact, sensor_msgs::LaserScan &scan)
+{
+    size_t count = compact.ranges_mm.size();
+
+    scan.header = compact.header;
+    scan.angle_min = compact.angle_min;
+    scan.angle_increment = compact.angle_increment;
+    scan.angle_max = compact.angle_min +
+        compact.angle_increment * (count > 0 ? count - 1 : 0);
+    scan.time_increment = compact.time_increment;
+    scan.scan_time = compact.scan_time;
+    scan.range_min = compact.range_min;
+    scan.range_max = compact.range_max;
+
+    scan.ranges.resize(count);
+    scan.intensities.resize(compact.quality.size());
+    for (size_t i = 0; i < count; i++) {
+        uint16_t range_mm = compact.ranges_mm[i];
+        scan.ranges[i] = range_mm == 0 ?
+            std::numeric_limits<float>::infinity() : range_mm / 1000.0f;
+    }
+    for (size_t i = 0; i < compact.quality.size(); i++) {
+        scan.intensities[i] = compact.quality[i];
+    }
+}
+
+/**
+ * Converts a range in meters to millimeters for a CompactScan. Infinite,
+ * NaN and non-positive ranges become 0, and ranges that do not fit are
+ * clamped to the largest one that does.
+ */
+inline uint16_t toRangeMm(float range)
+{
+    if (!(range > 0.0f) || range == std::numeric_limits<float>::infinity())
+        return 0;
+
+    float range_mm = range * 1000.0f + 0.5f;
+    return range_mm >= 65535.0f ? 65535 : (uint16_t)range_mm;
+}
+
+/**
+ * Packs a LaserScan into a CompactScan, e.g. for scans that were recorded
+ * before the node could publish CompactScan.
+ */
+inline void toCompactScan(const sensor_msgs::LaserScan &scan, CompactScan &compact)
+{
+    compact.header = scan.header;
+    compact.angle_min = scan.angle_min;
+    compact.angle_increment = scan.angle_increment;
+    compact.time_increment = scan.time_increment;
+    compact.scan_time = scan.scan_time;
+    compact.range_min = scan.range_min;
+    compact.range_max = scan.range_max;
+
+    compact.ranges_mm.resize(scan.ranges.size());
+    compact.quality.resize(scan.intensities.size());
+    for (size_t i = 0; i < scan.ranges.size(); i++) {
+        compact.ranges_mm[i] = toRangeMm(scan.ranges[i]);
+    }
+    for (size_t i = 0; i < scan.intensities.size(); i++) {
+        float quality = scan.intensities[i];
+        compact.quality[i] = quality <= 0.0f ? 0 :
+            (quality >= 255.0f ? 255 : (uint8_t)quality);
+    }
+}
+
+}
+
+#endif
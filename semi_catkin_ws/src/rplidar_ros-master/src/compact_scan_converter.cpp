@@ -0,0 +1,36 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Republishes rplidar_ros/CompactScan as sensor_msgs/LaserScan for tools
+ *  such as rviz, either on the far side of a telemetry link or when playing
+ *  back a bag that only recorded scan_rplidar_compact. See node.cpp for the
+ *  license.
+ */
+
+#include "ros/ros.h"
+#include "rplidar_ros/compact_scan.h"
+
+ros::Publisher scan_pub;
+
+void compactScanCallback(const rplidar_ros::CompactScan::ConstPtr& compact)
+{
+    sensor_msgs::LaserScanPtr scan(new sensor_msgs::LaserScan);
+
+    rplidar_ros::toLaserScan(*compact, *scan);
+    scan_pub.publish(scan);
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "rplidar_compact_scan_converter");
+    ros::NodeHandle n;
+
+    scan_pub = n.advertise<sensor_msgs::LaserScan>("scan_rplidar", 10);
+    ros::Subscriber sub = n.subscribe<rplidar_ros::CompactScan>(
+        "scan_rplidar_compact", 10, compactScanCallback,
+        ros::TransportHints().tcpNoDelay());
+
+    ros::spin();
+
+    return 0;
+}
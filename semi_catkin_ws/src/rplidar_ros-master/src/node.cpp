@@ -32,10 +32,23 @@
  *
  */
 
+#include <algorithm>
 #include "ros/ros.h"
 #include "sensor_msgs/LaserScan.h"
+#include "geometry_msgs/TwistStamped.h"
+#include "rplidar_ros/CompactScan.h"
+#include "rplidar_ros/SectorRanges.h"
 #include "std_srvs/Empty.h"
 #include "rplidar.h"
+#include "rplidar_node.h"
+#include "scan_deskew.h"
+#include "scan_filter.h"
+#include "scan_pack.h"
+#include "sector_tracker.h"
+#include <flight_recorder/recorder.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 #ifndef _countof
 #define _countof(_Array) (int)(sizeof(_Array) / sizeof(_Array[0]))
@@ -47,61 +60,142 @@ using namespace rp::standalone::rplidar;
 
 RPlidarDriver * drv = NULL;
 
-void publish_scan(ros::Publisher *pub,
+/**
+ * The topics that scans are published on. A publisher that was not
+ * advertised, or that has no subscribers, is skipped, so each format only
+ * costs CPU time when somebody listens to it. If recorder is set, every scan
+ * is also recorded in the compact format.
+ */
+struct ScanPublishers {
+    ros::Publisher scan;
+    ros::Publisher compact;
+    flight_recorder::FlightRecorder *recorder;
+    uint16_t compact_stream;
+};
+
+static bool wanted(const ros::Publisher &pub)
+{
+    return pub && pub.getNumSubscribers() > 0;
+}
+
+/**
+ * Publishes a scan that started at start. A de-skewed scan is stamped with
+ * the time of its last point instead, the pose that all of its points were
+ * moved to, and its time_increment is 0 so that nothing corrects it again.
+ */
+void publish_scan(ScanPublishers *pubs,
                   rplidar_response_measurement_node_hq_t *nodes,
                   size_t node_count, ros::Time start,
                   double scan_time, bool inverted,
                   float angle_min, float angle_max,
                   float max_distance,
-                  std::string frame_id)
+                  std::string frame_id, bool deskewed)
 {
     static int scan_count = 0;
-    sensor_msgs::LaserScan scan_msg;
+    float scan_angle_min, scan_angle_max, angle_increment;
 
-    scan_msg.header.stamp = start;
-    scan_msg.header.frame_id = frame_id;
     scan_count++;
 
     bool reversed = (angle_max > angle_min);
     if ( reversed ) {
-      scan_msg.angle_min =  M_PI - angle_max;
-      scan_msg.angle_max =  M_PI - angle_min;
+      scan_angle_min =  M_PI - angle_max;
+      scan_angle_max =  M_PI - angle_min;
     } else {
-      scan_msg.angle_min =  M_PI - angle_min;
-      scan_msg.angle_max =  M_PI - angle_max;
+      scan_angle_min =  M_PI - angle_min;
+      scan_angle_max =  M_PI - angle_max;
     }
-    scan_msg.angle_increment =
-        (scan_msg.angle_max - scan_msg.angle_min) / (double)(node_count-1);
-
-    scan_msg.scan_time = scan_time;
-    scan_msg.time_increment = scan_time / (double)(node_count-1);
-    scan_msg.range_min = 0.15;
-    scan_msg.range_max = max_distance;//8.0;
+    angle_increment =
+        (scan_angle_max - scan_angle_min) / (double)(node_count-1);
 
-    scan_msg.intensities.resize(node_count);
-    scan_msg.ranges.resize(node_count);
     bool reverse_data = (!inverted && reversed) || (inverted && !reversed);
-    if (!reverse_data) {
-        for (size_t i = 0; i < node_count; i++) {
-            float read_value = (float) nodes[i].dist_mm_q2/4.0f/1000;
-            if (read_value == 0.0)
-                scan_msg.ranges[i] = std::numeric_limits<float>::infinity();
-            else
-                scan_msg.ranges[i] = read_value;
-            scan_msg.intensities[i] = (float) (nodes[i].quality >> 2);
+
+    ros::Time stamp = start;
+    double time_increment = scan_time / (double)(node_count-1);
+    if (deskewed) {
+        stamp = start + ros::Duration(scan_time);
+        time_increment = 0.0;
+    }
+
+    if (wanted(pubs->scan)) {
+        // a new message per scan, so that subscribers in the same process can
+        // keep the pointer that is published without copying the scan
+        sensor_msgs::LaserScanPtr scan_msg(new sensor_msgs::LaserScan);
+
+        scan_msg->header.stamp = stamp;
+        scan_msg->header.frame_id = frame_id;
+        scan_msg->angle_min = scan_angle_min;
+        scan_msg->angle_max = scan_angle_max;
+        scan_msg->angle_increment = angle_increment;
+        scan_msg->scan_time = scan_time;
+        scan_msg->time_increment = time_increment;
+        scan_msg->range_min = 0.15;
+        scan_msg->range_max = max_distance;//8.0;
+        rplidar_ros::packScan(nodes, node_count, reverse_data, *scan_msg);
+
+        pubs->scan.publish(scan_msg);
+    }
+
+    if (wanted(pubs->compact) || pubs->recorder) {
+        rplidar_ros::CompactScanPtr compact_msg(new rplidar_ros::CompactScan);
+
+        compact_msg->header.stamp = stamp;
+        compact_msg->header.frame_id = frame_id;
+        compact_msg->angle_min = scan_angle_min;
+        compact_msg->angle_increment = angle_increment;
+        compact_msg->scan_time = scan_time;
+        compact_msg->time_increment = time_increment;
+        compact_msg->range_min = 0.15;
+        compact_msg->range_max = max_distance;
+        rplidar_ros::packCompactScan(nodes, node_count, reverse_data,
+                                     *compact_msg);
+
+        if (pubs->recorder)
+            pubs->recorder->record(pubs->compact_stream, stamp, *compact_msg);
+        if (wanted(pubs->compact))
+            pubs->compact.publish(compact_msg);
+    }
+}
+
+/**
+ * Feeds the points to a SectorTracker as the driver receives them, instead
+ * of waiting for complete scans, and publishes the sector ranges after every
+ * revolution or, if per_sector is set, after every sector. The driver keeps
+ * a separate buffer for getScanDataWithIntervalHq(), so this runs alongside
+ * the grabScanDataHq() loop without taking points away from it.
+ */
+void track_sectors(ros::Publisher pub, rplidar_ros::SectorTracker *tracker,
+                   std::string frame_id, bool per_sector, int poll_ms,
+                   const boost::atomic<bool> *running)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(8192);
+
+    while (*running) {
+        size_t count = nodes.size();
+
+        if (!drv || IS_FAIL(drv->getScanDataWithIntervalHq(&nodes[0], count))) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(poll_ms));
+            continue;
         }
-    } else {
-        for (size_t i = 0; i < node_count; i++) {
-            float read_value = (float)nodes[i].dist_mm_q2/4.0f/1000;
-            if (read_value == 0.0)
-                scan_msg.ranges[node_count-1-i] = std::numeric_limits<float>::infinity();
-            else
-                scan_msg.ranges[node_count-1-i] = read_value;
-            scan_msg.intensities[node_count-1-i] = (float) (nodes[i].quality >> 2);
+
+        ros::Time now = ros::Time::now();
+        for (size_t i = 0; i < count; i++) {
+            int events = tracker->add(nodes[i]);
+            int wanted_event = per_sector ? rplidar_ros::SectorTracker::SECTOR_DONE
+                                          : rplidar_ros::SectorTracker::SCAN_DONE;
+
+            if (events & wanted_event) {
+                rplidar_ros::SectorRangesPtr msg(new rplidar_ros::SectorRanges);
+
+                msg->header.stamp = now;
+                msg->header.frame_id = frame_id;
+                msg->sector = tracker->lastSector();
+                for (int j = 0; j < rplidar_ros::SectorTracker::NUM_SECTORS; j++) {
+                    msg->range_mm[j] = tracker->ranges()[j];
+                }
+                pub.publish(msg);
+            }
         }
     }
-
-    pub->publish(scan_msg);
 }
 
 bool getRPLIDARDeviceInfo(RPlidarDriver * drv)
@@ -174,14 +268,20 @@ bool start_motor(std_srvs::Empty::Request &req,
   return true;
 }
 
+static void deskew_twist_cb(rplidar_ros::ScanDeskew *deskew,
+                            const geometry_msgs::TwistStamped::ConstPtr &msg)
+{
+    deskew->setTwist(msg->header.stamp, msg->twist.linear.x,
+                     msg->twist.angular.z);
+}
+
 static float getAngle(const rplidar_response_measurement_node_hq_t& node)
 {
     return node.angle_z_q14 * 90.f / 16384.f;
 }
 
-int main(int argc, char * argv[]) {
-    ros::init(argc, argv, "rplidar_node");
-
+int run_rplidar(ros::NodeHandle &nh, ros::NodeHandle &nh_private,
+                const boost::function<bool()> &ok) {
     std::string serial_port;
     int serial_baudrate = 115200;
     std::string frame_id;
@@ -190,15 +290,53 @@ int main(int argc, char * argv[]) {
     float max_distance = 8.0;
     int angle_compensate_multiple = 1;//it stand of angle compensate at per 1 degree
     std::string scan_mode;
-    ros::NodeHandle nh;
-    ros::Publisher scan_pub = nh.advertise<sensor_msgs::LaserScan>("scan_rplidar", 1000);
-    ros::NodeHandle nh_private("~");
+    bool publish_laser_scan = true;
+    bool publish_compact_scan = false;
+    ScanPublishers scan_pubs;
+    rplidar_ros::ScanFilterConfig filter_config;
+    bool deskew_enabled = false;
+    rplidar_ros::ScanDeskewConfig deskew_config;
+    bool publish_sector_ranges = false;
+    bool sector_ranges_per_sector = false;
+    double sector_offset = 0.0;
+    int sector_poll_ms = 5;
+    flight_recorder::FlightRecorder recorder;
+    flight_recorder::RecorderConfig record_config;
+    int record_chunk_kb = 1024;
+    int record_chunks = 64;
     nh_private.param<std::string>("serial_port", serial_port, "/dev/ttyUSB0"); 
     nh_private.param<int>("serial_baudrate", serial_baudrate, 115200/*256000*/);//ros run for A1 A2, change to 256000 if A3
     nh_private.param<std::string>("frame_id", frame_id, "laser_frame");
     nh_private.param<bool>("inverted", inverted, false);
     nh_private.param<bool>("angle_compensate", angle_compensate, false);
     nh_private.param<std::string>("scan_mode", scan_mode, std::string());
+    nh_private.param<bool>("publish_laser_scan", publish_laser_scan, true);
+    nh_private.param<bool>("publish_compact_scan", publish_compact_scan, false);
+    nh_private.param<int>("filter_min_quality", filter_config.min_quality, 0);
+    nh_private.param<int>("filter_median_window", filter_config.median_window, 1);
+    nh_private.param<int>("filter_downsample", filter_config.downsample, 1);
+    nh_private.param<float>("filter_min_range", filter_config.min_range, 0.0f);
+    nh_private.param<float>("filter_max_range", filter_config.max_range, 0.0f);
+    nh_private.getParam("filter_roi_sectors", filter_config.roi_sectors);
+    nh_private.param<bool>("deskew", deskew_enabled, false);
+    nh_private.param<float>("deskew_front_offset", deskew_config.front_offset, 0.0f);
+    nh_private.param<float>("deskew_lidar_x", deskew_config.lidar_x, 0.0f);
+    nh_private.param<float>("deskew_twist_timeout", deskew_config.twist_timeout, 0.5f);
+    deskew_config.inverted = inverted;
+    nh_private.param<bool>("publish_sector_ranges", publish_sector_ranges, false);
+    nh_private.param<bool>("sector_ranges_per_sector", sector_ranges_per_sector, false);
+    nh_private.param<double>("sector_offset", sector_offset, 0.0);
+    nh_private.param<int>("sector_poll_ms", sector_poll_ms, 5);
+    nh_private.param<std::string>("record_path", record_config.path, std::string());
+    nh_private.param<int>("record_chunk_kb", record_chunk_kb, 1024);
+    nh_private.param<int>("record_chunks", record_chunks, 64);
+    nh_private.param<double>("record_sync_period", record_config.sync_period, 1.0);
+
+    if (publish_laser_scan)
+        scan_pubs.scan = nh.advertise<sensor_msgs::LaserScan>("scan_rplidar", 1000);
+    if (publish_compact_scan)
+        scan_pubs.compact = nh.advertise<rplidar_ros::CompactScan>("scan_rplidar_compact", 1000);
+    scan_pubs.recorder = NULL;
 
     ROS_INFO("RPLIDAR running on ROS package rplidar_ros. SDK Version:"RPLIDAR_SDK_VERSION"");
 
@@ -279,10 +417,51 @@ int main(int argc, char * argv[]) {
         ROS_ERROR("Can not start scan: %08x!", op_result);
     }
 
+    rplidar_ros::SectorTracker sector_tracker(sector_offset, 0.15f, inverted);
+    boost::atomic<bool> sectors_running(publish_sector_ranges);
+    boost::thread sector_thread;
+    if (publish_sector_ranges) {
+        ros::Publisher sector_pub =
+            nh.advertise<rplidar_ros::SectorRanges>("sector_ranges_rplidar", 10);
+        sector_thread = boost::thread(track_sectors, sector_pub, &sector_tracker,
+                                      frame_id, sector_ranges_per_sector,
+                                      std::max(1, sector_poll_ms),
+                                      &sectors_running);
+    }
+
+    // every scan goes to the flight recorder as a CompactScan, a quarter of
+    // the size of a LaserScan; rplidarCompactScanConverter expands it again
+    if (!record_config.path.empty()) {
+        record_config.chunk_size = record_chunk_kb * 1024;
+        record_config.num_chunks = record_chunks;
+        if (recorder.open(record_config)) {
+            scan_pubs.recorder = &recorder;
+            scan_pubs.compact_stream = recorder.add_stream<rplidar_ros::CompactScan>(
+                nh.resolveName("scan_rplidar_compact"));
+        }
+    }
+
+    // with deskew set, every scan is moved into the pose at its end using
+    // the latest twist on deskew_twist, e.g. the wheel speed and yaw rate
+    // that pi_comm_node publishes
+    rplidar_ros::ScanDeskew deskew(deskew_config);
+    ros::Subscriber deskew_sub;
+    double point_period = 0.0;
+    if (deskew_enabled) {
+        deskew_sub = nh.subscribe<geometry_msgs::TwistStamped>(
+            "deskew_twist", 1, boost::bind(deskew_twist_cb, &deskew, _1));
+        if (IS_OK(op_result))
+            point_period = current_scan_mode.us_per_sample * 1e-6;
+    }
+
+    // sized for the largest scan of either branch below
+    rplidar_ros::ScanFilter filter(filter_config,
+                                   360*std::max(8, angle_compensate_multiple));
+
     ros::Time start_scan_time;
     ros::Time end_scan_time;
     double scan_duration;
-    while (ros::ok()) {
+    while (ok()) {
         rplidar_response_measurement_node_hq_t nodes[360*8];
         size_t   count = _countof(nodes);
 
@@ -292,6 +471,23 @@ int main(int argc, char * argv[]) {
         scan_duration = (end_scan_time - start_scan_time).toSec();
 
         if (op_result == RESULT_OK) {
+            // the driver returns the points in the order they were measured,
+            // one sample period apart, and the last one just before
+            // grabScanDataHq() returned; ascendScanData() reorders them
+            bool deskewed = false;
+            if (deskew_enabled && count > 1) {
+                double period = point_period > 0.0 ?
+                    point_period : scan_duration / (count - 1);
+                deskewed = deskew.deskew(nodes, count, end_scan_time, period);
+                if (deskewed) {
+                    scan_duration = period * (count - 1);
+                    start_scan_time = end_scan_time - ros::Duration(scan_duration);
+                } else {
+                    ROS_WARN_THROTTLE(5.0, "No recent twist on %s, publishing scans without de-skewing",
+                                      deskew_sub.getTopic().c_str());
+                }
+            }
+
             op_result = drv->ascendScanData(nodes, count);
             float angle_min = DEG2RAD(0.0f);
             float angle_max = DEG2RAD(359.0f);
@@ -315,10 +511,14 @@ int main(int argc, char * argv[]) {
                         }
                     }
   
-                    publish_scan(&scan_pub, angle_compensate_nodes, angle_compensate_nodes_count,
+                    size_t filtered_count = angle_compensate_nodes_count;
+                    if (filter.enabled())
+                        filtered_count = filter.filter(angle_compensate_nodes, angle_compensate_nodes_count);
+
+                    publish_scan(&scan_pubs, angle_compensate_nodes, filtered_count,
                              start_scan_time, scan_duration, inverted,
                              angle_min, angle_max, max_distance,
-                             frame_id);
+                             frame_id, deskewed);
                 } else {
                     int start_node = 0, end_node = 0;
                     int i = 0;
@@ -332,29 +532,38 @@ int main(int argc, char * argv[]) {
                     angle_min = DEG2RAD(getAngle(nodes[start_node]));
                     angle_max = DEG2RAD(getAngle(nodes[end_node]));
 
-                    publish_scan(&scan_pub, &nodes[start_node], end_node-start_node +1,
+                    size_t filtered_count = end_node-start_node +1;
+                    if (filter.enabled())
+                        filtered_count = filter.filter(&nodes[start_node], filtered_count);
+
+                    publish_scan(&scan_pubs, &nodes[start_node], filtered_count,
                              start_scan_time, scan_duration, inverted,
                              angle_min, angle_max, max_distance,
-                             frame_id);
+                             frame_id, deskewed);
                }
             } else if (op_result == RESULT_OPERATION_FAIL) {
                 // All the data is invalid, just publish them
                 float angle_min = DEG2RAD(0.0f);
                 float angle_max = DEG2RAD(359.0f);
 
-                publish_scan(&scan_pub, nodes, count,
+                publish_scan(&scan_pubs, nodes, count,
                              start_scan_time, scan_duration, inverted,
                              angle_min, angle_max, max_distance,
-                             frame_id);
+                             frame_id, false);
             }
         }
-
-        ros::spinOnce();
     }
 
     // done!
+    sectors_running = false;
+    if (sector_thread.joinable())
+        sector_thread.join();
+
+    recorder.close();
+
     drv->stop();
     drv->stopMotor();
     RPlidarDriver::DisposeDriver(drv);
+    drv = NULL;
     return 0;
 }
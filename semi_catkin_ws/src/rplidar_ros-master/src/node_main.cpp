@@ -0,0 +1,21 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Entry point of the rplidarNode executable. See node.cpp for the license.
+ */
+
+#include "ros/ros.h"
+#include "rplidar_node.h"
+
+int main(int argc, char * argv[]) {
+    ros::init(argc, argv, "rplidar_node");
+
+    ros::NodeHandle nh;
+    ros::NodeHandle nh_private("~");
+
+    // the scan loop blocks, so the services are served from another thread
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
+    return run_rplidar(nh, nh_private, &ros::ok);
+}
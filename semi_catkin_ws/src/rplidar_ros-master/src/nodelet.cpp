@@ -0,0 +1,55 @@
+/*
+ *  RPLIDAR ROS NODELET
+ *
+ *  Runs the rplidar scan loop inside a nodelet manager, so that subscribers
+ *  loaded into the same manager receive the published scans without them
+ *  being serialized. See node.cpp for the license.
+ */
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "rplidar_node.h"
+
+namespace rplidar_ros {
+
+class RplidarNodelet : public nodelet::Nodelet
+{
+public:
+    RplidarNodelet() : running_(false) {}
+
+    ~RplidarNodelet()
+    {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+private:
+    virtual void onInit()
+    {
+        running_ = true;
+        thread_ = boost::thread(&RplidarNodelet::run, this);
+    }
+
+    void run()
+    {
+        run_rplidar(getNodeHandle(), getPrivateNodeHandle(),
+                    boost::bind(&RplidarNodelet::ok, this));
+    }
+
+    bool ok() const
+    {
+        return running_ && ros::ok();
+    }
+
+    boost::atomic<bool> running_;
+    boost::thread thread_;
+};
+
+} // namespace rplidar_ros
+
+PLUGINLIB_EXPORT_CLASS(rplidar_ros::RplidarNodelet, nodelet::Nodelet)
@@ -0,0 +1,24 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  The scan loop of the rplidar node, shared by the rplidarNode executable
+ *  and the RplidarNodelet.
+ */
+
+#ifndef RPLIDAR_NODE_H
+#define RPLIDAR_NODE_H
+
+#include <boost/function.hpp>
+#include "ros/ros.h"
+
+/**
+ * Connects to the lidar, publishes scan_rplidar on nh and serves the
+ * start_motor and stop_motor services, reading its parameters from
+ * nh_private. Returns once ok() returns false, or with a negative value if
+ * the lidar could not be set up. The caller is responsible for spinning the
+ * callback queue of nh.
+ */
+int run_rplidar(ros::NodeHandle &nh, ros::NodeHandle &nh_private,
+                const boost::function<bool()> &ok);
+
+#endif
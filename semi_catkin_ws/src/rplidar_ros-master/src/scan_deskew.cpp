@@ -0,0 +1,114 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Motion compensation of the raw scan points. See node.cpp for the
+ *  license.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "scan_deskew.h"
+
+namespace rplidar_ros {
+
+// below this yaw rate [rad/s] the arc is taken as a straight line
+static const double MIN_YAW_RATE = 1e-4;
+
+ScanDeskew::ScanDeskew(const ScanDeskewConfig &config)
+    : config_(config), linear_(0.0), angular_(0.0)
+{
+}
+
+void ScanDeskew::setTwist(const ros::Time &stamp, double linear,
+                          double angular)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+
+    twist_stamp_ = stamp;
+    linear_ = linear;
+    angular_ = angular;
+}
+
+bool ScanDeskew::deskew(rplidar_response_measurement_node_hq_t *nodes,
+                        size_t count, const ros::Time &end,
+                        double point_period)
+{
+    ros::Time stamp;
+    double linear, angular;
+
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        stamp = twist_stamp_;
+        linear = linear_;
+        angular = angular_;
+    }
+
+    if (stamp.isZero() ||
+        std::fabs((end - stamp).toSec()) > config_.twist_timeout) {
+        return false;
+    }
+    if (count == 0 || (linear == 0.0 && angular == 0.0)) {
+        return true;
+    }
+
+    // the velocity of the lidar in mm/s, which also moves sideways when the
+    // vehicle turns if it is not mounted at the point the twist is for
+    const double vx = linear * 1000.0;
+    const double vy = angular * config_.lidar_x * 1000.0;
+    const bool turning = std::fabs(angular) > MIN_YAW_RATE;
+
+    // the lidar angles run clockwise, y runs to the left
+    const float mirror = config_.inverted ? 1.0f : -1.0f;
+    const float to_rad = (float)(M_PI / 180.0) * 90.0f / 16384.0f;
+    const float front_rad = config_.front_offset * (float)(M_PI / 180.0);
+    const float to_q14 = 16384.0f / 90.0f * (float)(180.0 / M_PI);
+
+    // the rotation of the vehicle between a point and the end of the scan,
+    // one point_period further back for every point
+    const double step_c = std::cos(angular * point_period);
+    const double step_s = std::sin(angular * point_period);
+    double c = 1.0;
+    double s = 0.0;
+
+    for (size_t n = 0; n < count; n++) {
+        rplidar_response_measurement_node_hq_t &node = nodes[count - 1 - n];
+
+        if (node.dist_mm_q2 != 0) {
+            // where the lidar is at the end of the scan, as seen from where
+            // it was when it measured this point
+            double dx, dy;
+            if (turning) {
+                dx = (vx * s - vy * (1.0 - c)) / angular;
+                dy = (vx * (1.0 - c) + vy * s) / angular;
+            } else {
+                double age = n * point_period;
+                dx = vx * age;
+                dy = vy * age;
+            }
+
+            float range = node.dist_mm_q2 / 4.0f;
+            float angle = node.angle_z_q14 * to_rad - front_rad;
+            float x = range * std::cos(angle) - (float)dx;
+            float y = mirror * range * std::sin(angle) - (float)dy;
+            float end_x = (float)c * x + (float)s * y;
+            float end_y = (float)c * y - (float)s * x;
+
+            float q14 = (std::atan2(mirror * end_y, end_x) + front_rad) * to_q14;
+            q14 = std::fmod(q14, 65536.0f);
+            if (q14 < 0.0f) {
+                q14 += 65536.0f;
+            }
+            node.angle_z_q14 = (_u16)((_u32)(q14 + 0.5f) & 0xFFFF);
+            // a return never becomes a missing one
+            node.dist_mm_q2 = std::max<_u32>(1,
+                (_u32)(std::sqrt(end_x * end_x + end_y * end_y) * 4.0f + 0.5f));
+        }
+
+        double next_c = c * step_c - s * step_s;
+        s = s * step_c + c * step_s;
+        c = next_c;
+    }
+    return true;
+}
+
+} // namespace rplidar_ros
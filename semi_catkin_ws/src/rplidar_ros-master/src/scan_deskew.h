@@ -0,0 +1,90 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Motion compensation of the raw scan points. See node.cpp for the
+ *  license.
+ */
+
+#ifndef RPLIDAR_SCAN_DESKEW_H
+#define RPLIDAR_SCAN_DESKEW_H
+
+#include <stddef.h>
+#include <boost/thread/mutex.hpp>
+#include "ros/ros.h"
+#include "rplidar.h"
+
+namespace rplidar_ros {
+
+/**
+ * The settings of a ScanDeskew.
+ */
+struct ScanDeskewConfig
+{
+    ScanDeskewConfig()
+        : front_offset(0.0f), lidar_x(0.0f), twist_timeout(0.5f),
+          inverted(false) {}
+
+    // lidar angle in degrees that the vehicle drives towards
+    float front_offset;
+
+    // how far ahead of the point that the twist is measured at the lidar is
+    // mounted [m], e.g. ahead of the rear axle
+    float lidar_x;
+
+    // a twist older or newer than this at the end of a scan is not used [s]
+    float twist_timeout;
+
+    // the lidar is mounted upside down, so its angles run counterclockwise
+    bool inverted;
+};
+
+/**
+ * Moves every point of a scan into the pose that the lidar had when the
+ * last point was measured. The lidar measures the points of one revolution
+ * one after the other over 100-200 ms, during which the vehicle drives and
+ * turns, so without this a straight wall comes out bent and an obstacle
+ * appears where it was up to a scan period earlier.
+ *
+ * The motion is the latest odometry twist, taken as constant over the scan:
+ * a forward speed and a yaw rate, so the lidar moves along an arc. Each
+ * point is converted to x and y, moved by the rest of the arc from its own
+ * time to the end of the scan, and converted back to a distance and angle,
+ * all in one pass over the points. The rotation of the arc is stepped from
+ * point to point, so the only trigonometry per point is for its own angle.
+ */
+class ScanDeskew
+{
+public:
+    explicit ScanDeskew(const ScanDeskewConfig &config);
+
+    /**
+     * Sets the motion of the vehicle: forward speed [m/s] and yaw rate
+     * [rad/s, counterclockwise], as measured at stamp. Called from the
+     * subscriber thread.
+     */
+    void setTwist(const ros::Time &stamp, double linear, double angular);
+
+    /**
+     * De-skews count points in place. They must be in the order that the
+     * driver returned them in, before ascendScanData(), one point_period
+     * [s] apart and the last one measured at end. Points without a return
+     * are left alone.
+     *
+     * Returns false, without touching the points, if there is no twist
+     * within twist_timeout of end.
+     */
+    bool deskew(rplidar_response_measurement_node_hq_t *nodes, size_t count,
+                const ros::Time &end, double point_period);
+
+private:
+    ScanDeskewConfig config_;
+
+    boost::mutex mutex_;
+    ros::Time twist_stamp_;
+    double linear_;
+    double angular_;
+};
+
+} // namespace rplidar_ros
+
+#endif
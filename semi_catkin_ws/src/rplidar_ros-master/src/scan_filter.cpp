@@ -0,0 +1,176 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Preprocessing of the raw scan points before they are published. See
+ *  node.cpp for the license.
+ */
+
+#include <algorithm>
+#include "ros/ros.h"
+#include "scan_filter.h"
+
+namespace rplidar_ros {
+
+ScanFilter::ScanFilter(const ScanFilterConfig &config, size_t capacity)
+    : config_(config), dist_q2_(capacity), window_count_(0)
+{
+    if (config_.median_window < 1) {
+        config_.median_window = 1;
+    }
+    if (config_.median_window > MAX_MEDIAN_WINDOW) {
+        ROS_WARN("Median window of %d points is too large, using %d",
+                 config_.median_window, MAX_MEDIAN_WINDOW);
+        config_.median_window = MAX_MEDIAN_WINDOW;
+    }
+    if (config_.median_window % 2 == 0) {
+        config_.median_window++;
+    }
+    if (config_.downsample < 1) {
+        config_.downsample = 1;
+    }
+    if (config_.roi_sectors.size() % 2 != 0) {
+        ROS_WARN("ROI sectors must be pairs of angles, ignoring the last one");
+        config_.roi_sectors.pop_back();
+    }
+
+    min_dist_q2_ = (_u32)(config_.min_range * 4000.0f);
+    max_dist_q2_ = config_.max_range > 0.0f ?
+        (_u32)(config_.max_range * 4000.0f) : (_u32)-1;
+}
+
+bool ScanFilter::enabled() const
+{
+    return config_.min_quality > 0 || config_.median_window > 1 ||
+           config_.downsample > 1 || !config_.roi_sectors.empty() ||
+           min_dist_q2_ > 0 || max_dist_q2_ != (_u32)-1;
+}
+
+size_t ScanFilter::filter(rplidar_response_measurement_node_hq_t *nodes,
+                          size_t count)
+{
+    if (count > dist_q2_.size()) {
+        // cannot happen with the capacity that the node passes in, but never
+        // write past the buffers
+        ROS_WARN_ONCE("Scan of %u points is larger than the filter capacity, "
+                      "filtering only the first %u",
+                      (unsigned)count, (unsigned)dist_q2_.size());
+        count = dist_q2_.size();
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i].dist_mm_q2 != 0 && !keep(nodes[i])) {
+            nodes[i].dist_mm_q2 = 0;
+        }
+    }
+
+    if (config_.median_window > 1) {
+        median(nodes, count);
+    }
+
+    if (config_.downsample > 1) {
+        count = downsample(nodes, count);
+    }
+    return count;
+}
+
+bool ScanFilter::keep(const rplidar_response_measurement_node_hq_t &node) const
+{
+    if ((node.quality >> 2) < config_.min_quality) {
+        return false;
+    }
+    if (node.dist_mm_q2 < min_dist_q2_ || node.dist_mm_q2 > max_dist_q2_) {
+        return false;
+    }
+    if (config_.roi_sectors.empty()) {
+        return true;
+    }
+
+    float angle = node.angle_z_q14 * 90.f / 16384.f;
+    for (size_t i = 0; i + 1 < config_.roi_sectors.size(); i += 2) {
+        float start = config_.roi_sectors[i];
+        float end = config_.roi_sectors[i + 1];
+
+        if (start <= end ? (angle >= start && angle <= end)
+                         : (angle >= start || angle <= end)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A sliding median over the valid points. The window is kept sorted: every
+ * step removes the point that leaves it and inserts the point that enters
+ * it, each by a search and a shift within the window, so a scan costs
+ * O(count * window) no matter how many points are missing. The windows at
+ * either end of the scan are truncated rather than wrapped.
+ */
+void ScanFilter::median(rplidar_response_measurement_node_hq_t *nodes,
+                        size_t count)
+{
+    const size_t half = config_.median_window / 2;
+
+    for (size_t i = 0; i < count; i++) {
+        dist_q2_[i] = nodes[i].dist_mm_q2;
+    }
+
+    window_count_ = 0;
+    for (size_t i = 0; i < half && i < count; i++) {
+        if (dist_q2_[i] != 0) {
+            _u32 *pos = std::upper_bound(window_, window_ + window_count_,
+                                         dist_q2_[i]);
+            std::copy_backward(pos, window_ + window_count_,
+                               window_ + window_count_ + 1);
+            *pos = dist_q2_[i];
+            window_count_++;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        // the point that enters the window on the right
+        if (i + half < count && dist_q2_[i + half] != 0) {
+            _u32 value = dist_q2_[i + half];
+            _u32 *pos = std::upper_bound(window_, window_ + window_count_, value);
+            std::copy_backward(pos, window_ + window_count_,
+                               window_ + window_count_ + 1);
+            *pos = value;
+            window_count_++;
+        }
+
+        if (dist_q2_[i] != 0) {
+            nodes[i].dist_mm_q2 = window_[window_count_ / 2];
+        }
+
+        // the point that leaves the window on the left
+        if (i >= half && dist_q2_[i - half] != 0) {
+            _u32 value = dist_q2_[i - half];
+            _u32 *pos = std::lower_bound(window_, window_ + window_count_, value);
+            std::copy(pos + 1, window_ + window_count_, pos);
+            window_count_--;
+        }
+    }
+}
+
+size_t ScanFilter::downsample(rplidar_response_measurement_node_hq_t *nodes,
+                              size_t count)
+{
+    const size_t group = config_.downsample;
+    size_t out = 0;
+
+    for (size_t start = 0; start < count; start += group) {
+        size_t end = std::min(start + group, count);
+        size_t closest = start;
+
+        for (size_t i = start; i < end; i++) {
+            if (nodes[i].dist_mm_q2 != 0 &&
+                (nodes[closest].dist_mm_q2 == 0 ||
+                 nodes[i].dist_mm_q2 < nodes[closest].dist_mm_q2)) {
+                closest = i;
+            }
+        }
+        nodes[out++] = nodes[closest];
+    }
+    return out;
+}
+
+} // namespace rplidar_ros
@@ -0,0 +1,103 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Preprocessing of the raw scan points before they are published. See
+ *  node.cpp for the license.
+ */
+
+#ifndef RPLIDAR_SCAN_FILTER_H
+#define RPLIDAR_SCAN_FILTER_H
+
+#include <stddef.h>
+#include <vector>
+#include "rplidar.h"
+
+namespace rplidar_ros {
+
+/**
+ * The settings of a ScanFilter. The defaults turn every stage off.
+ */
+struct ScanFilterConfig
+{
+    ScanFilterConfig()
+        : min_quality(0), median_window(1), downsample(1),
+          min_range(0.0f), max_range(0.0f) {}
+
+    // points with a lower quality, on the scale of LaserScan intensities
+    // (0-63), are dropped
+    int min_quality;
+
+    // odd number of neighbouring points that the median is taken over
+    int median_window;
+
+    // number of neighbouring points merged into one
+    int downsample;
+
+    // region of interest: sectors as pairs of [start, end] angles in the
+    // degrees that the lidar reports (0 at the front of the lidar,
+    // clockwise). A sector may wrap through 0, e.g. [330, 30]. Points outside
+    // every sector are dropped; an empty list keeps every angle.
+    std::vector<float> roi_sectors;
+
+    // points closer or further than this are dropped [m]; 0 turns it off
+    float min_range;
+    float max_range;
+};
+
+/**
+ * Cleans up a scan in place, between ascendScanData() and publish_scan().
+ * Dropped points get a distance of 0, which is how the lidar reports a
+ * missing return, so the spacing of the remaining points and the scan
+ * angles stay valid. The stages run in this order:
+ *
+ *  1. quality threshold, ROI sectors and range limits drop points
+ *  2. a sliding median over the remaining points removes single-point
+ *     outliers; missing points are not filled in
+ *  3. downsampling merges every group of neighbouring points into the
+ *     closest one of them, so obstacles are never thinned out
+ *
+ * The buffers are sized once in the constructor; filter() never allocates.
+ */
+class ScanFilter
+{
+public:
+    static const int MAX_MEDIAN_WINDOW = 15;
+
+    /**
+     * capacity is the largest number of points that filter() will be given.
+     */
+    ScanFilter(const ScanFilterConfig &config, size_t capacity);
+
+    /**
+     * Whether any stage is turned on. If not, filter() need not be called.
+     */
+    bool enabled() const;
+
+    /**
+     * Filters count points in place and returns how many are left, which is
+     * less than count only when downsampling.
+     */
+    size_t filter(rplidar_response_measurement_node_hq_t *nodes, size_t count);
+
+private:
+    bool keep(const rplidar_response_measurement_node_hq_t &node) const;
+
+    void median(rplidar_response_measurement_node_hq_t *nodes, size_t count);
+
+    size_t downsample(rplidar_response_measurement_node_hq_t *nodes,
+                      size_t count);
+
+    ScanFilterConfig config_;
+    _u32 min_dist_q2_;
+    _u32 max_dist_q2_;
+
+    // the distances before the median, and the sorted distances in the
+    // current window
+    std::vector<_u32> dist_q2_;
+    _u32 window_[MAX_MEDIAN_WINDOW];
+    int window_count_;
+};
+
+} // namespace rplidar_ros
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Packing of the points of a scan into the messages that the node
+ *  publishes. See node.cpp for the license.
+ */
+
+#include <limits>
+#include "scan_pack.h"
+
+namespace rplidar_ros {
+
+void packScan(const rplidar_response_measurement_node_hq_t *nodes,
+              size_t count, bool reverse, sensor_msgs::LaserScan &scan)
+{
+    scan.intensities.resize(count);
+    scan.ranges.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t index = reverse ? count-1-i : i;
+        float read_value = (float) nodes[i].dist_mm_q2/4.0f/1000;
+        if (read_value == 0.0)
+            scan.ranges[index] = std::numeric_limits<float>::infinity();
+        else
+            scan.ranges[index] = read_value;
+        scan.intensities[index] = (float) (nodes[i].quality >> 2);
+    }
+}
+
+void packCompactScan(const rplidar_response_measurement_node_hq_t *nodes,
+                     size_t count, bool reverse, CompactScan &compact)
+{
+    compact.ranges_mm.resize(count);
+    compact.quality.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t index = reverse ? count-1-i : i;
+        _u32 range_mm = (nodes[i].dist_mm_q2 + 2) >> 2;
+        compact.ranges_mm[index] = range_mm > 0xFFFF ? 0xFFFF : range_mm;
+        compact.quality[index] = nodes[i].quality >> 2;
+    }
+}
+
+}
@@ -0,0 +1,36 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Packing of the points of a scan into the messages that the node
+ *  publishes. See node.cpp for the license.
+ */
+
+#ifndef RPLIDAR_SCAN_PACK_H
+#define RPLIDAR_SCAN_PACK_H
+
+#include <stddef.h>
+#include "sensor_msgs/LaserScan.h"
+#include "rplidar_ros/CompactScan.h"
+#include "rplidar.h"
+
+namespace rplidar_ros {
+
+/**
+ * Fills in the ranges [m] and intensities of a LaserScan from the points of
+ * a scan, the last point first if reverse is set. A point without a return
+ * becomes infinity, and the intensity is the quality on a scale of 0-63.
+ */
+void packScan(const rplidar_response_measurement_node_hq_t *nodes,
+              size_t count, bool reverse, sensor_msgs::LaserScan &scan);
+
+/**
+ * The same for a CompactScan, in whole millimeters straight from the q2
+ * fixed point distances and without going through float. Ranges beyond
+ * 0xFFFF mm are clamped to it.
+ */
+void packCompactScan(const rplidar_response_measurement_node_hq_t *nodes,
+                     size_t count, bool reverse, CompactScan &compact);
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  The closest return per sector, kept up to date point by point. See
+ *  node.cpp for the license.
+ */
+
+#include <math.h>
+#include "sector_tracker.h"
+
+// angle_z_q14 counts a full turn as 360 * 16384 / 90
+#define FULL_TURN_Q14 (4 * 16384)
+#define SECTOR_Q14 (FULL_TURN_Q14 / NUM_SECTORS)
+
+namespace rplidar_ros {
+
+SectorTracker::SectorTracker(float offset_deg, float min_range_m,
+                             bool inverted)
+    : inverted_(inverted), sector_(-1), last_sector_(0)
+{
+    float offset = fmodf(offset_deg, 360.0f);
+    if (offset < 0) {
+        offset += 360.0f;
+    }
+
+    // shift the angles by half a sector so sector 0 is centered on the offset
+    offset_q14_ = ((_u32)(offset * 16384.f / 90.f) + FULL_TURN_Q14 -
+                   SECTOR_Q14 / 2) % FULL_TURN_Q14;
+    min_dist_q2_ = min_range_m > 0 ? (_u32)(min_range_m * 4000.0f) : 1;
+
+    for (int i = 0; i < NUM_SECTORS; i++) {
+        pass_min_q2_[i] = 0;
+        ranges_[i] = 0;
+    }
+}
+
+int SectorTracker::add(const rplidar_response_measurement_node_hq_t &node)
+{
+    int events = 0;
+    int sector = ((node.angle_z_q14 + FULL_TURN_Q14 - offset_q14_) %
+                  FULL_TURN_Q14) / SECTOR_Q14;
+
+    if (node.flag & RPLIDAR_RESP_HQ_FLAG_SYNCBIT) {
+        events |= SCAN_DONE;
+    }
+
+    if (sector_ < 0) {
+        sector_ = sector;
+    } else if (sector != sector_ &&
+               (sector - sector_ + NUM_SECTORS) % NUM_SECTORS <= NUM_SECTORS / 2) {
+        // moved on: the pass over the previous sector is complete
+        _u32 range_mm = (pass_min_q2_[sector_] + 2) >> 2;
+
+        last_sector_ = counterclockwise(sector_);
+        ranges_[last_sector_] = range_mm > 0xFFFF ? 0xFFFF : range_mm;
+        pass_min_q2_[sector_] = 0;
+        sector_ = sector;
+        events |= SECTOR_DONE;
+    }
+
+    if (node.dist_mm_q2 >= min_dist_q2_ && node.quality != 0 &&
+        (pass_min_q2_[sector] == 0 || node.dist_mm_q2 < pass_min_q2_[sector])) {
+        pass_min_q2_[sector] = node.dist_mm_q2;
+    }
+    return events;
+}
+
+int SectorTracker::counterclockwise(int sweep_sector) const
+{
+    return inverted_ ? sweep_sector : (NUM_SECTORS - sweep_sector) % NUM_SECTORS;
+}
+
+} // namespace rplidar_ros
@@ -0,0 +1,79 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  The closest return per sector, kept up to date point by point. See
+ *  node.cpp for the license.
+ */
+
+#ifndef RPLIDAR_SECTOR_TRACKER_H
+#define RPLIDAR_SECTOR_TRACKER_H
+
+#include <stddef.h>
+#include "rplidar.h"
+
+namespace rplidar_ros {
+
+/**
+ * Keeps the closest return in each of NUM_SECTORS equal sectors as the
+ * points arrive from the lidar, so the value for a sector is ready as soon
+ * as the lidar has swept past it instead of after the whole scan was
+ * collected and walked. Every point costs O(1).
+ *
+ * The range of a sector is the minimum over its latest complete pass. A pass
+ * ends when the points move on to the next sector; a point that arrives
+ * slightly out of order for the sector before still counts towards it.
+ *
+ * The sectors are numbered counterclockwise from the front, like
+ * SectorRanges. The lidar reports its angles clockwise, or counterclockwise
+ * when it is mounted upside down, so it sweeps through the sectors
+ * backwards unless inverted.
+ */
+class SectorTracker
+{
+public:
+    static const int NUM_SECTORS = 8;
+
+    enum Events {
+        SECTOR_DONE = 1 << 0, // a sector pass completed, see lastSector()
+        SCAN_DONE = 1 << 1,   // the lidar started a new revolution
+    };
+
+    /**
+     * offset_deg is the lidar angle at the center of sector 0. Points closer
+     * than min_range_m are ignored. inverted is the inverted parameter of
+     * the node.
+     */
+    SectorTracker(float offset_deg, float min_range_m, bool inverted);
+
+    /**
+     * Adds one point and returns the Events that it caused.
+     */
+    int add(const rplidar_response_measurement_node_hq_t &node);
+
+    /**
+     * The range of every sector in mm, 0 for no return, counterclockwise
+     * from the front.
+     */
+    const _u16 *ranges() const { return ranges_; }
+
+    int lastSector() const { return last_sector_; }
+
+private:
+    int counterclockwise(int sweep_sector) const;
+
+    _u32 offset_q14_;
+    _u32 min_dist_q2_;
+    bool inverted_;
+
+    // the sector that the lidar is sweeping and the closest return in each
+    // sector so far, in the order that the lidar sweeps them
+    int sector_;
+    _u32 pass_min_q2_[NUM_SECTORS];
+
+    int last_sector_;
+    _u16 ranges_[NUM_SECTORS];
+};
+
+} // namespace rplidar_ros
+
+#endif
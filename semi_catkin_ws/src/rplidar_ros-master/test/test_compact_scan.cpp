@@ -0,0 +1,224 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Tests of the scans that the node packs from the lidar points, as a
+ *  LaserScan and as a CompactScan, and of the conversion between the two.
+ *  See node.cpp for the license.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdlib.h>
+#include <vector>
+
+#include "ros/serialization.h"
+#include "rplidar_ros/compact_scan.h"
+#include "scan_pack.h"
+
+using rplidar_ros::CompactScan;
+using rplidar_ros::packCompactScan;
+using rplidar_ros::packScan;
+using rplidar_ros::toCompactScan;
+using rplidar_ros::toLaserScan;
+using rplidar_ros::toRangeMm;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+
+const float INF = std::numeric_limits<float>::infinity();
+
+Node point(_u32 dist_mm_q2, _u8 quality)
+{
+    Node node;
+    node.angle_z_q14 = 0;
+    node.dist_mm_q2 = dist_mm_q2;
+    node.quality = quality;
+    node.flag = 0;
+    return node;
+}
+
+/**
+ * An angle compensated A2 scan, with a tenth of the points without a return
+ * and ranges up to 16 m in quarter millimeters.
+ */
+std::vector<Node> make_scan(size_t count)
+{
+    std::vector<Node> scan(count);
+
+    srand(1);
+    for (size_t i = 0; i < count; i++) {
+        scan[i] = point(rand() % 10 == 0 ? 0 : 600 + rand() % 64000,
+                        (_u8)(rand() % 256));
+    }
+    return scan;
+}
+
+} // namespace
+
+TEST(CompactScan, RoundTripMatchesLaserScan)
+{
+    std::vector<Node> nodes = make_scan(720);
+    sensor_msgs::LaserScan direct, expanded;
+    CompactScan compact;
+
+    for (bool reverse : {false, true}) {
+        packScan(nodes.data(), nodes.size(), reverse, direct);
+        packCompactScan(nodes.data(), nodes.size(), reverse, compact);
+        compact.angle_min = 0.5f;
+        compact.angle_increment = 0.01f;
+        toLaserScan(compact, expanded);
+
+        ASSERT_EQ(expanded.ranges.size(), direct.ranges.size());
+        ASSERT_EQ(expanded.intensities.size(), direct.intensities.size());
+        EXPECT_FLOAT_EQ(expanded.angle_max, 0.5f + 0.01f * 719);
+        for (size_t i = 0; i < direct.ranges.size(); i++) {
+            if (std::isinf(direct.ranges[i])) {
+                EXPECT_TRUE(std::isinf(expanded.ranges[i])) << i;
+            } else {
+                // rounded to the nearest millimeter, in float
+                EXPECT_NEAR(expanded.ranges[i], direct.ranges[i], 0.000502f) << i;
+            }
+            EXPECT_EQ(expanded.intensities[i], direct.intensities[i]) << i;
+        }
+
+        // and back again to the same millimeters
+        CompactScan repacked;
+        toCompactScan(expanded, repacked);
+        EXPECT_EQ(repacked.ranges_mm, compact.ranges_mm);
+        EXPECT_EQ(repacked.quality, compact.quality);
+    }
+}
+
+TEST(CompactScan, NoReturnIsZeroAndInfinity)
+{
+    std::vector<Node> nodes = {point(0, 40 << 2), point(4000, 40 << 2)};
+    sensor_msgs::LaserScan scan;
+    CompactScan compact;
+
+    packCompactScan(nodes.data(), nodes.size(), false, compact);
+    EXPECT_EQ(compact.ranges_mm[0], 0u);
+    EXPECT_EQ(compact.ranges_mm[1], 1000u);
+
+    toLaserScan(compact, scan);
+    EXPECT_EQ(scan.ranges[0], INF);
+    EXPECT_EQ(scan.ranges[1], 1.0f);
+
+    // everything that is not a range is no return
+    EXPECT_EQ(toRangeMm(INF), 0u);
+    EXPECT_EQ(toRangeMm(std::numeric_limits<float>::quiet_NaN()), 0u);
+    EXPECT_EQ(toRangeMm(0.0f), 0u);
+    EXPECT_EQ(toRangeMm(-1.0f), 0u);
+    EXPECT_EQ(toRangeMm(0.0004f), 0u);
+    EXPECT_EQ(toRangeMm(0.0006f), 1u);
+}
+
+TEST(CompactScan, ClampsFarRanges)
+{
+    // 65535 mm fits, half a millimeter more rounds up past it
+    std::vector<Node> nodes = {point(65535 * 4, 0), point(65535 * 4 + 2, 0),
+                               point(100000 * 4, 0)};
+    CompactScan compact;
+
+    packCompactScan(nodes.data(), nodes.size(), false, compact);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        EXPECT_EQ(compact.ranges_mm[i], 0xFFFF) << i;
+    }
+
+    EXPECT_EQ(toRangeMm(65.534f), 65534u);
+    EXPECT_EQ(toRangeMm(65.535f), 65535u);
+    EXPECT_EQ(toRangeMm(100.0f), 65535u);
+}
+
+TEST(CompactScan, ReverseDataPutsTheLastPointFirst)
+{
+    std::vector<Node> nodes;
+    for (_u32 m = 1; m <= 5; m++) {
+        nodes.push_back(point(m * 4000, (_u8)(m << 2)));
+    }
+    sensor_msgs::LaserScan scan;
+    CompactScan compact;
+
+    packScan(nodes.data(), nodes.size(), false, scan);
+    packCompactScan(nodes.data(), nodes.size(), false, compact);
+    EXPECT_EQ(compact.ranges_mm, (std::vector<uint16_t>{1000, 2000, 3000, 4000, 5000}));
+    EXPECT_EQ(compact.quality, (std::vector<uint8_t>{1, 2, 3, 4, 5}));
+    EXPECT_EQ(scan.ranges, (std::vector<float>{1, 2, 3, 4, 5}));
+
+    packScan(nodes.data(), nodes.size(), true, scan);
+    packCompactScan(nodes.data(), nodes.size(), true, compact);
+    EXPECT_EQ(compact.ranges_mm, (std::vector<uint16_t>{5000, 4000, 3000, 2000, 1000}));
+    EXPECT_EQ(compact.quality, (std::vector<uint8_t>{5, 4, 3, 2, 1}));
+    EXPECT_EQ(scan.ranges, (std::vector<float>{5, 4, 3, 2, 1}));
+    EXPECT_EQ(scan.intensities, (std::vector<float>{5, 4, 3, 2, 1}));
+}
+
+TEST(CompactScan, QualityIsTheTopSixBits)
+{
+    // the lowest two bits of the quality are flags, not signal
+    std::vector<Node> nodes = {point(4000, 0xFF), point(4000, (47 << 2) | 3),
+                               point(4000, 3)};
+    sensor_msgs::LaserScan scan;
+    CompactScan compact;
+
+    packScan(nodes.data(), nodes.size(), false, scan);
+    packCompactScan(nodes.data(), nodes.size(), false, compact);
+    EXPECT_EQ(compact.quality, (std::vector<uint8_t>{63, 47, 0}));
+    EXPECT_EQ(scan.intensities, (std::vector<float>{63, 47, 0}));
+
+    // intensities from elsewhere are clamped to a byte
+    scan.intensities = {-1.0f, 47.9f, 300.0f};
+    toCompactScan(scan, compact);
+    EXPECT_EQ(compact.quality, (std::vector<uint8_t>{0, 47, 255}));
+}
+
+TEST(CompactScan, PackCost)
+{
+    // a scan the size of an angle compensated A2 scan
+    const size_t count = 360 * 8;
+    const int N = 1000;
+    std::vector<Node> nodes = make_scan(count);
+    sensor_msgs::LaserScan scan, expanded;
+    CompactScan compact;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        packScan(nodes.data(), nodes.size(), true, scan);
+        asm volatile("" : : "r"(scan.ranges.data()) : "memory");
+    }
+    auto pack_compact = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        packCompactScan(nodes.data(), nodes.size(), true, compact);
+        asm volatile("" : : "r"(compact.ranges_mm.data()) : "memory");
+    }
+    auto expand = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        toLaserScan(compact, expanded);
+        asm volatile("" : : "r"(expanded.ranges.data()) : "memory");
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double scan_us = std::chrono::duration<double, std::micro>(
+        pack_compact - start).count() / N;
+    double compact_us = std::chrono::duration<double, std::micro>(
+        expand - pack_compact).count() / N;
+    double expand_us = std::chrono::duration<double, std::micro>(
+        end - expand).count() / N;
+    uint32_t scan_bytes = ros::serialization::serializationLength(scan);
+    uint32_t compact_bytes = ros::serialization::serializationLength(compact);
+
+    printf("%u points: LaserScan %.1f us, %u bytes; CompactScan %.1f us, "
+           "%u bytes; toLaserScan %.1f us\n", (unsigned)count, scan_us,
+           scan_bytes, compact_us, compact_bytes, expand_us);
+    RecordProperty("pack_scan_us", (int)scan_us);
+    RecordProperty("pack_compact_scan_us", (int)compact_us);
+    RecordProperty("to_laser_scan_us", (int)expand_us);
+    RecordProperty("scan_bytes", (int)scan_bytes);
+    RecordProperty("compact_scan_bytes", (int)compact_bytes);
+    // 3 bytes per point instead of 8
+    EXPECT_LT(compact_bytes * 2, scan_bytes);
+    EXPECT_LT(compact_us, 10000.0);
+}
@@ -0,0 +1,273 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Tests of the ScanDeskew on scans of known points, taken by a lidar that
+ *  drives along an arc. See node.cpp for the license.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdlib.h>
+#include <vector>
+
+#include "scan_deskew.h"
+
+using rplidar_ros::ScanDeskew;
+using rplidar_ros::ScanDeskewConfig;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+
+// an A2 revolution at 10 Hz, two points per degree
+const size_t POINTS = 720;
+const double SCAN_PERIOD = 0.1;
+const double POINT_PERIOD = SCAN_PERIOD / POINTS;
+
+const ros::Time END(100, 0);
+
+struct Point
+{
+    double x;
+    double y;
+};
+
+/**
+ * A point in the vehicle frame at the end of the scan [mm] seen from a
+ * lidar that is age [s] earlier on the arc of a constant twist, as the
+ * lidar reports it.
+ */
+Node measure(const ScanDeskewConfig &config, double linear, double angular,
+             double age, const Point &point)
+{
+    const double lidar_x = config.lidar_x * 1000.0;
+    const double mirror = config.inverted ? 1.0 : -1.0;
+    double heading = -angular * age;
+    double px, py;
+
+    // where the point the twist is measured at was, in the end frame
+    if (std::fabs(angular) > 1e-9) {
+        double fx = linear * 1000.0 * std::sin(angular * age) / angular;
+        double fy = linear * 1000.0 * (1.0 - std::cos(angular * age)) / angular;
+        px = -(std::cos(heading) * fx - std::sin(heading) * fy);
+        py = -(std::sin(heading) * fx + std::cos(heading) * fy);
+    } else {
+        px = -linear * 1000.0 * age;
+        py = 0.0;
+    }
+
+    double lx = px + std::cos(heading) * lidar_x;
+    double ly = py + std::sin(heading) * lidar_x;
+    double dx = point.x - lx;
+    double dy = point.y - ly;
+    double x = std::cos(heading) * dx + std::sin(heading) * dy;
+    double y = -std::sin(heading) * dx + std::cos(heading) * dy;
+
+    double deg = std::atan2(mirror * y, x) * 180.0 / M_PI + config.front_offset;
+    deg = std::fmod(deg + 720.0, 360.0);
+
+    Node node;
+    node.angle_z_q14 = (_u16)((_u32)(deg * 16384.0 / 90.0 + 0.5) & 0xFFFF);
+    node.dist_mm_q2 = (_u32)(std::sqrt(x * x + y * y) * 4.0 + 0.5);
+    node.quality = 40 << 2;
+    node.flag = 0;
+    return node;
+}
+
+/**
+ * Where a point is in the vehicle frame [mm] if the lidar was at its pose
+ * at the end of the scan.
+ */
+Point place(const ScanDeskewConfig &config, const Node &node)
+{
+    const double mirror = config.inverted ? 1.0 : -1.0;
+    double range = node.dist_mm_q2 / 4.0;
+    double angle = (node.angle_z_q14 * 90.0 / 16384.0 - config.front_offset) *
+                   M_PI / 180.0;
+    Point point = {config.lidar_x * 1000.0 + range * std::cos(angle),
+                   mirror * range * std::sin(angle)};
+    return point;
+}
+
+/**
+ * Points around the lidar at 1 to 6 m, in the order a clockwise sweep
+ * meets them, in the vehicle frame at the end of the scan [mm].
+ */
+std::vector<Point> make_world(const ScanDeskewConfig &config)
+{
+    std::vector<Point> world(POINTS);
+
+    srand(1);
+    for (size_t i = 0; i < POINTS; i++) {
+        double mirror = config.inverted ? 1.0 : -1.0;
+        double angle = mirror * (i * 2.0 * M_PI / POINTS);
+        double range = 1000.0 + rand() % 5000;
+        world[i].x = config.lidar_x * 1000.0 + range * std::cos(angle);
+        world[i].y = range * std::sin(angle);
+    }
+    return world;
+}
+
+struct Errors
+{
+    double raw;      // largest distance of a raw point from the truth [mm]
+    double deskewed; // the same after deskew()
+};
+
+/**
+ * Scans the world while driving and de-skews the scan.
+ */
+Errors scan_error(const ScanDeskewConfig &config, double linear,
+                  double angular)
+{
+    std::vector<Point> world = make_world(config);
+    std::vector<Node> scan(POINTS);
+    Errors errors = {0.0, 0.0};
+
+    for (size_t i = 0; i < POINTS; i++) {
+        double age = (POINTS - 1 - i) * POINT_PERIOD;
+        scan[i] = measure(config, linear, angular, age, world[i]);
+        Point raw = place(config, scan[i]);
+        errors.raw = std::max(errors.raw, std::hypot(raw.x - world[i].x,
+                                                     raw.y - world[i].y));
+    }
+
+    ScanDeskew deskew(config);
+    deskew.setTwist(END, linear, angular);
+    EXPECT_TRUE(deskew.deskew(scan.data(), scan.size(), END, POINT_PERIOD));
+
+    for (size_t i = 0; i < POINTS; i++) {
+        Point point = place(config, scan[i]);
+        errors.deskewed = std::max(errors.deskewed,
+                                   std::hypot(point.x - world[i].x,
+                                              point.y - world[i].y));
+    }
+    return errors;
+}
+
+} // namespace
+
+TEST(ScanDeskew, StraightLine)
+{
+    ScanDeskewConfig config;
+
+    // 2 m/s moves the first point 200 mm
+    Errors errors = scan_error(config, 2.0, 0.0);
+    EXPECT_GT(errors.raw, 150.0);
+    EXPECT_LT(errors.deskewed, 1.0);
+}
+
+TEST(ScanDeskew, TurnInPlace)
+{
+    ScanDeskewConfig config;
+
+    // 2 rad/s turns the first point 11 degrees, up to 1.2 m at 6 m
+    Errors errors = scan_error(config, 0.0, 2.0);
+    EXPECT_GT(errors.raw, 1000.0);
+    EXPECT_LT(errors.deskewed, 1.0);
+}
+
+TEST(ScanDeskew, ArcWithLidarAhead)
+{
+    ScanDeskewConfig config;
+    config.lidar_x = 0.3f;
+
+    // the lidar also moves sideways as the truck turns
+    Errors errors = scan_error(config, 1.5, -1.0);
+    EXPECT_GT(errors.raw, 500.0);
+    EXPECT_LT(errors.deskewed, 1.0);
+}
+
+TEST(ScanDeskew, InvertedAndTurnedLidar)
+{
+    ScanDeskewConfig config;
+    config.lidar_x = 0.2f;
+    config.front_offset = 180.0f;
+    config.inverted = true;
+
+    Errors errors = scan_error(config, 1.0, 1.5);
+    EXPECT_GT(errors.raw, 500.0);
+    EXPECT_LT(errors.deskewed, 1.0);
+}
+
+TEST(ScanDeskew, NeedsAFreshTwist)
+{
+    ScanDeskewConfig config;
+    ScanDeskew deskew(config);
+    std::vector<Point> world = make_world(config);
+    std::vector<Node> scan(POINTS);
+    for (size_t i = 0; i < POINTS; i++) {
+        scan[i] = measure(config, 0.0, 0.0, 0.0, world[i]);
+    }
+    std::vector<Node> copy = scan;
+
+    EXPECT_FALSE(deskew.deskew(scan.data(), scan.size(), END, POINT_PERIOD));
+
+    deskew.setTwist(END - ros::Duration(config.twist_timeout + 0.1), 2.0, 0.0);
+    EXPECT_FALSE(deskew.deskew(scan.data(), scan.size(), END, POINT_PERIOD));
+
+    for (size_t i = 0; i < POINTS; i++) {
+        EXPECT_EQ(scan[i].angle_z_q14, copy[i].angle_z_q14);
+        EXPECT_EQ(scan[i].dist_mm_q2, copy[i].dist_mm_q2);
+    }
+}
+
+TEST(ScanDeskew, LeavesMissingReturnsAlone)
+{
+    ScanDeskewConfig config;
+    ScanDeskew deskew(config);
+    std::vector<Point> world = make_world(config);
+    std::vector<Node> scan(POINTS);
+    for (size_t i = 0; i < POINTS; i++) {
+        scan[i] = measure(config, 2.0, 1.0, (POINTS - 1 - i) * POINT_PERIOD,
+                          world[i]);
+    }
+    scan[10].dist_mm_q2 = 0;
+    _u16 angle = scan[10].angle_z_q14;
+
+    deskew.setTwist(END, 2.0, 1.0);
+    ASSERT_TRUE(deskew.deskew(scan.data(), scan.size(), END, POINT_PERIOD));
+    EXPECT_EQ(scan[10].dist_mm_q2, 0u);
+    EXPECT_EQ(scan[10].angle_z_q14, angle);
+    for (size_t i = 0; i < POINTS; i++) {
+        if (i != 10) {
+            EXPECT_NE(scan[i].dist_mm_q2, 0u);
+        }
+    }
+}
+
+TEST(ScanDeskew, DeskewCost)
+{
+    // a scan the size of an angle compensated A2 scan, while turning
+    ScanDeskewConfig config;
+    config.lidar_x = 0.3f;
+
+    const size_t count = 360 * 8;
+    const int N = 1000;
+    std::vector<Node> scan(count), work(count);
+    srand(1);
+    for (size_t i = 0; i < count; i++) {
+        scan[i].angle_z_q14 = (_u16)(i * 16384 / (count / 4));
+        scan[i].dist_mm_q2 = rand() % 10 == 0 ? 0 : 4000 + rand() % 20000;
+        scan[i].quality = 40 << 2;
+        scan[i].flag = 0;
+    }
+
+    ScanDeskew deskew(config);
+    deskew.setTwist(END, 1.5, 1.0);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        work = scan;
+        deskew.deskew(work.data(), work.size(), END, SCAN_PERIOD / count);
+    }
+    double us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / N;
+
+    // a revolution takes 100 ms at the fastest
+    printf("ScanDeskew::deskew, %u points: %.1f us\n", (unsigned)count, us);
+    RecordProperty("deskew_us", (int)us);
+    EXPECT_LT(us, 10000.0);
+}
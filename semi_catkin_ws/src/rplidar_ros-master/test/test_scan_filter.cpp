@@ -0,0 +1,278 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Tests of the ScanFilter stages on synthetic scans. See node.cpp for the
+ *  license.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include <vector>
+
+#include "scan_filter.h"
+
+using rplidar_ros::ScanFilter;
+using rplidar_ros::ScanFilterConfig;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+
+const size_t POINTS = 360;
+
+/**
+ * An angle in the lidar's Q14 format, rounded to the nearest step.
+ */
+_u16 q14(size_t deg)
+{
+    return (_u16)((deg * 16384 + 45) / 90);
+}
+
+/**
+ * A scan with one point per degree, all at the same range and quality.
+ */
+std::vector<Node> make_scan(float range_m, int quality)
+{
+    std::vector<Node> scan(POINTS);
+
+    for (size_t i = 0; i < POINTS; i++) {
+        scan[i].angle_z_q14 = q14(i);
+        scan[i].dist_mm_q2 = (_u32)(range_m * 4000.0f);
+        scan[i].quality = (_u8)(quality << 2);
+        scan[i].flag = 0;
+    }
+    return scan;
+}
+
+size_t run(const ScanFilterConfig &config, std::vector<Node> &scan)
+{
+    ScanFilter filter(config, scan.size());
+    return filter.filter(scan.data(), scan.size());
+}
+
+/**
+ * The median of the valid distances in [i - half, i + half], truncated at
+ * the ends of the scan, the slow way.
+ */
+_u32 reference_median(const std::vector<_u32> &dist, size_t i, size_t half)
+{
+    std::vector<_u32> window;
+    size_t start = i >= half ? i - half : 0;
+    size_t end = std::min(i + half + 1, dist.size());
+
+    for (size_t j = start; j < end; j++) {
+        if (dist[j] != 0) {
+            window.push_back(dist[j]);
+        }
+    }
+    std::sort(window.begin(), window.end());
+    return window[window.size() / 2];
+}
+
+} // namespace
+
+TEST(ScanFilter, DefaultsAreOff)
+{
+    ScanFilterConfig config;
+    ScanFilter filter(config, POINTS);
+    EXPECT_FALSE(filter.enabled());
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    std::vector<Node> copy = scan;
+    ASSERT_EQ(filter.filter(scan.data(), scan.size()), POINTS);
+    for (size_t i = 0; i < POINTS; i++) {
+        EXPECT_EQ(scan[i].dist_mm_q2, copy[i].dist_mm_q2);
+    }
+}
+
+TEST(ScanFilter, QualityThreshold)
+{
+    ScanFilterConfig config;
+    config.min_quality = 10;
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    scan[5].quality = 9 << 2;
+    scan[6].quality = 10 << 2;
+    ASSERT_EQ(run(config, scan), POINTS);
+
+    EXPECT_EQ(scan[5].dist_mm_q2, 0u);
+    EXPECT_NE(scan[6].dist_mm_q2, 0u);
+    EXPECT_NE(scan[7].dist_mm_q2, 0u);
+}
+
+TEST(ScanFilter, RangeLimits)
+{
+    ScanFilterConfig config;
+    config.min_range = 0.5f;
+    config.max_range = 5.0f;
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    scan[10].dist_mm_q2 = 0.4f * 4000;
+    scan[11].dist_mm_q2 = 5.1f * 4000;
+    scan[12].dist_mm_q2 = 5.0f * 4000;
+    run(config, scan);
+
+    EXPECT_EQ(scan[10].dist_mm_q2, 0u);
+    EXPECT_EQ(scan[11].dist_mm_q2, 0u);
+    EXPECT_EQ(scan[12].dist_mm_q2, (_u32)(5.0f * 4000));
+}
+
+TEST(ScanFilter, RoiSectorWrapsThroughZero)
+{
+    ScanFilterConfig config;
+    config.roi_sectors = {330.0f, 30.0f, 90.0f, 100.0f};
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    run(config, scan);
+
+    for (size_t i = 0; i < POINTS; i++) {
+        bool inside = i <= 30 || i >= 330 || (i >= 90 && i <= 100);
+        EXPECT_EQ(scan[i].dist_mm_q2 != 0, inside) << "at " << i << " deg";
+    }
+}
+
+TEST(ScanFilter, OddSectorListIgnoresLastAngle)
+{
+    ScanFilterConfig config;
+    config.roi_sectors = {0.0f, 10.0f, 200.0f};
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    run(config, scan);
+
+    EXPECT_NE(scan[5].dist_mm_q2, 0u);
+    EXPECT_EQ(scan[250].dist_mm_q2, 0u);
+}
+
+TEST(ScanFilter, MedianRemovesSpikesAndKeepsGaps)
+{
+    ScanFilterConfig config;
+    config.median_window = 5;
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    scan[100].dist_mm_q2 = 100;      // a single close outlier
+    scan[200].dist_mm_q2 = 0;        // a missing return
+    scan[201].dist_mm_q2 = 1000000;  // next to a gap, far away
+    run(config, scan);
+
+    EXPECT_EQ(scan[100].dist_mm_q2, 8000u);
+    EXPECT_EQ(scan[200].dist_mm_q2, 0u);
+    EXPECT_EQ(scan[201].dist_mm_q2, 8000u);
+}
+
+TEST(ScanFilter, MedianMatchesReference)
+{
+    srand(1);
+    for (int window = 3; window <= ScanFilter::MAX_MEDIAN_WINDOW; window += 2) {
+        ScanFilterConfig config;
+        config.median_window = window;
+
+        std::vector<Node> scan = make_scan(1.0f, 40);
+        std::vector<_u32> dist(POINTS);
+        for (size_t i = 0; i < POINTS; i++) {
+            // a quarter missing, and many repeated values
+            dist[i] = rand() % 4 == 0 ? 0 : 1 + rand() % 50;
+            scan[i].dist_mm_q2 = dist[i];
+        }
+        run(config, scan);
+
+        for (size_t i = 0; i < POINTS; i++) {
+            _u32 expected = dist[i] == 0 ? 0 :
+                reference_median(dist, i, window / 2);
+            ASSERT_EQ(scan[i].dist_mm_q2, expected)
+                << "window " << window << " at " << i;
+        }
+    }
+}
+
+TEST(ScanFilter, EvenMedianWindowIsRoundedUp)
+{
+    ScanFilterConfig config;
+    config.median_window = 2;
+
+    // a window of 2 would average or pick one side; 3 removes the spike
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    scan[50].dist_mm_q2 = 100;
+    run(config, scan);
+    EXPECT_EQ(scan[50].dist_mm_q2, 8000u);
+}
+
+TEST(ScanFilter, DownsampleKeepsClosestPoint)
+{
+    ScanFilterConfig config;
+    config.downsample = 4;
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    scan[6].dist_mm_q2 = 4000;
+    scan[8].dist_mm_q2 = 0;
+    scan[9].dist_mm_q2 = 0;
+    scan[10].dist_mm_q2 = 0;
+    scan[11].dist_mm_q2 = 0;
+    ASSERT_EQ(run(config, scan), POINTS / 4);
+
+    // group 1 holds degrees 4 to 7; its closest point keeps its own angle
+    EXPECT_EQ(scan[1].dist_mm_q2, 4000u);
+    EXPECT_EQ(scan[1].angle_z_q14, q14(6));
+    // a group with no returns stays a missing return
+    EXPECT_EQ(scan[2].dist_mm_q2, 0u);
+    EXPECT_EQ(scan[3].dist_mm_q2, 8000u);
+}
+
+TEST(ScanFilter, DownsampleKeepsPartialLastGroup)
+{
+    ScanFilterConfig config;
+    config.downsample = 7;
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    EXPECT_EQ(run(config, scan), (POINTS + 6) / 7);
+}
+
+TEST(ScanFilter, NeverWritesPastCapacity)
+{
+    ScanFilterConfig config;
+    config.median_window = 5;
+    ScanFilter filter(config, 100);
+
+    std::vector<Node> scan = make_scan(2.0f, 40);
+    scan[150].dist_mm_q2 = 100;
+    EXPECT_EQ(filter.filter(scan.data(), scan.size()), 100u);
+    EXPECT_EQ(scan[150].dist_mm_q2, 100u);
+}
+
+TEST(ScanFilter, FilterCost)
+{
+    // every stage on, over a scan the size of an angle compensated A2 scan
+    ScanFilterConfig config;
+    config.min_quality = 5;
+    config.roi_sectors = {330.0f, 30.0f, 150.0f, 210.0f};
+    config.max_range = 8.0f;
+    config.median_window = ScanFilter::MAX_MEDIAN_WINDOW;
+    config.downsample = 2;
+
+    const size_t count = 360 * 8;
+    const int N = 1000;
+    std::vector<Node> scan(count), work(count);
+    srand(1);
+    for (size_t i = 0; i < count; i++) {
+        scan[i].angle_z_q14 = (_u16)(i * 16384 / (count / 4));
+        scan[i].dist_mm_q2 = rand() % 10 == 0 ? 0 : 4000 + rand() % 20000;
+        scan[i].quality = (_u8)((rand() % 64) << 2);
+        scan[i].flag = 0;
+    }
+
+    ScanFilter filter(config, count);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) {
+        work = scan;
+        filter.filter(work.data(), work.size());
+    }
+    double us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / N;
+
+    // a revolution takes 100 ms at the fastest
+    printf("ScanFilter::filter, %u points: %.1f us\n", (unsigned)count, us);
+    RecordProperty("filter_us", (int)us);
+    EXPECT_LT(us, 10000.0);
+}
@@ -0,0 +1,109 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Tests of the sector numbering of the SectorTracker. See node.cpp for the
+ *  license.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "rplidar_ros/SectorRanges.h"
+#include "sector_tracker.h"
+
+using rplidar_ros::SectorRanges;
+using rplidar_ros::SectorTracker;
+
+namespace {
+
+/**
+ * Sweeps one and a half revolutions, one point per degree of lidar angle,
+ * with a return at 1 m everywhere except at obstacle_deg, where it is at
+ * 0.5 m, so every sector has completed a pass.
+ */
+void sweep(SectorTracker *tracker, int obstacle_deg)
+{
+    for (int i = 0; i < 540; i++) {
+        rplidar_response_measurement_node_hq_t node;
+        int deg = i % 360;
+
+        node.angle_z_q14 = (_u16)(deg * 16384 / 90);
+        node.dist_mm_q2 = deg == obstacle_deg ? 2000 : 4000;
+        node.quality = 40 << 2;
+        node.flag = deg == 0 ? RPLIDAR_RESP_HQ_FLAG_SYNCBIT : 0;
+        tracker->add(node);
+    }
+}
+
+int closest(const SectorTracker &tracker)
+{
+    int sector = 0;
+    for (int i = 1; i < SectorTracker::NUM_SECTORS; i++) {
+        if (tracker.ranges()[i] < tracker.ranges()[sector]) {
+            sector = i;
+        }
+    }
+    return sector;
+}
+
+} // namespace
+
+TEST(SectorTracker, CounterclockwiseFromFront)
+{
+    // the lidar angles run clockwise, so 90 degrees is to the right
+    const struct {
+        int deg;
+        int sector;
+    } cases[] = {
+        {0, SectorRanges::FRONT},
+        {45, SectorRanges::FRONT_RIGHT},
+        {90, SectorRanges::RIGHT},
+        {180, SectorRanges::REAR},
+        {270, SectorRanges::LEFT},
+        {315, SectorRanges::FRONT_LEFT},
+    };
+
+    for (const auto &c : cases) {
+        SectorTracker tracker(0.0f, 0.15f, false);
+        sweep(&tracker, c.deg);
+        EXPECT_EQ(closest(tracker), c.sector) << "at " << c.deg << " deg";
+        EXPECT_EQ(tracker.ranges()[c.sector], 500);
+    }
+}
+
+TEST(SectorTracker, InvertedRunsCounterclockwise)
+{
+    SectorTracker tracker(0.0f, 0.15f, true);
+    sweep(&tracker, 90);
+    EXPECT_EQ(closest(tracker), SectorRanges::LEFT);
+}
+
+TEST(SectorTracker, OffsetMovesFront)
+{
+    SectorTracker tracker(180.0f, 0.15f, false);
+    sweep(&tracker, 170);
+    EXPECT_EQ(closest(tracker), SectorRanges::FRONT);
+}
+
+TEST(SectorTracker, LastSectorFollowsTheSweep)
+{
+    SectorTracker tracker(0.0f, 0.15f, false);
+    rplidar_response_measurement_node_hq_t node = {};
+    std::vector<int> done;
+
+    // from the middle of FRONT clockwise into REAR
+    node.dist_mm_q2 = 4000;
+    node.quality = 40 << 2;
+    for (int deg = 0; deg <= 160; deg++) {
+        node.angle_z_q14 = (_u16)(deg * 16384 / 90);
+        if (tracker.add(node) & SectorTracker::SECTOR_DONE) {
+            done.push_back(tracker.lastSector());
+        }
+    }
+
+    EXPECT_EQ(done, (std::vector<int>{SectorRanges::FRONT,
+                                      SectorRanges::FRONT_RIGHT,
+                                      SectorRanges::RIGHT,
+                                      SectorRanges::REAR_RIGHT}));
+}
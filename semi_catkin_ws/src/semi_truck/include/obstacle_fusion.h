@@ -0,0 +1,313 @@
+/**
+ * @file Aligns the RPLIDAR, LIDAR-Lite and ToF ranges to one time. The three
+ * sources arrive on their own callbacks at their own rates, and the ToF
+ * ranges come with the Teensy sensor data without a stamp of their own, so
+ * the latest value of each was read at a different time. An ObstacleFusion
+ * keeps the last few samples of every source, stamped, and assembles an
+ * ObstacleFrame for a given time: scalar ranges are interpolated between the
+ * samples on either side of it, or held from the nearest one, and the
+ * RPLIDAR scan nearest to it is reduced to sectors. Samples older than a
+ * limit are left out, so a source that stopped does not look like a clear
+ * path.
+ */
+
+#ifndef DAIMTRONICS_OBSTACLE_FUSION_H
+#define DAIMTRONICS_OBSTACLE_FUSION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include <ros/time.h>
+
+#include "truck_state.h"
+
+#define FUSION_RPLIDAR_DEPTH 4     // scans kept, at 5-15 Hz
+#define FUSION_LIDAR_LITE_DEPTH 64 // LIDAR-Lite readings kept
+#define FUSION_TOF_DEPTH 16        // sets of ToF ranges kept, at 20 Hz
+
+/**
+ * @brief A bounded ring of timestamped samples with one writer and any
+ * number of readers. Every slot is a SeqLock, so the writer never waits and
+ * a reader copies single samples, not the whole ring. T must have a
+ * ros::Time stamp and be pushed in stamp order.
+ */
+template <typename T, size_t N>
+class SampleRing {
+public:
+   SampleRing() : count_(0) {}
+
+   /**
+    * @brief Adds a sample, replacing the oldest one once the ring is full.
+    * Must only be called from one thread at a time.
+    */
+   void push(const T &sample) {
+      uint64_t count = count_.load(std::memory_order_relaxed);
+
+      slots_[count % N].store(sample);
+      count_.store(count + 1, std::memory_order_release);
+   }
+
+   /**
+    * @brief Finds the newest sample at or before a time and the oldest one
+    * after it. If the writer laps the reader, the search stops at the slot
+    * that was overwritten, as if the ring held no older samples.
+    *
+    * @return a bit for each sample found, 1 for before and 2 for after
+    */
+   int bracket(const ros::Time &time, T *before, T *after) const {
+      uint64_t count = count_.load(std::memory_order_acquire);
+      uint64_t oldest = count > N ? count - N : 0;
+      ros::Time newer;
+      int found = 0;
+      T sample;
+
+      for (uint64_t i = count; i > oldest; i--) {
+         sample = slots_[(i - 1) % N].load();
+         if ((found & 2) && sample.stamp > newer) {
+            break; // overwritten by a newer sample while searching
+         }
+         if (sample.stamp <= time) {
+            *before = sample;
+            return found | 1;
+         }
+         *after = sample;
+         newer = sample.stamp;
+         found = 2;
+      }
+      return found;
+   }
+
+private:
+   std::atomic<uint64_t> count_;
+   SeqLock<T> slots_[N];
+};
+
+/**
+ * @brief The ToF ranges of one set of Teensy sensor data, in meters.
+ */
+struct TofSample {
+   ros::Time stamp;
+   float left;
+   float right;
+   float rear;
+};
+
+struct FusionConfig {
+   FusionConfig()
+      : delay(0),
+        rplidar_max_age(0.3),
+        lidar_lite_max_age(0.2),
+        tof_max_age(0.2),
+        sector_offset(0) {}
+
+   // seconds that a ControlExecutor aligns its frames before the tick, so
+   // the slower sources are interpolated instead of held
+   double delay;
+   // seconds between the time of a frame and the nearest sample of a
+   // source before the source is left out
+   double rplidar_max_age;
+   double lidar_lite_max_age;
+   double tof_max_age;
+   // scan angle in degrees at the center of the FRONT sector
+   float sector_offset;
+};
+
+/**
+ * @brief Keeps the recent samples of every range sensor and assembles them
+ * into ObstacleFrames. The add_* functions are called by the subscriber
+ * callbacks, one thread per source at most, and assemble() by any number of
+ * readers. configure() must be called before any of them.
+ */
+class ObstacleFusion {
+public:
+   void configure(const FusionConfig &config) {
+      config_ = config;
+   }
+
+   void add_rplidar(const RplidarState &scan) {
+      rplidar_.push(scan);
+   }
+
+   void add_lidar_lite(const LidarLiteState &reading) {
+      lidar_lite_.push(reading);
+   }
+
+   /**
+    * @brief Adds the ToF ranges of a set of Teensy sensor data. The Teensy
+    * reports them in mm, with 0 for no return.
+    */
+   void add_tof(const TeensyState &sensors) {
+      TofSample sample;
+
+      sample.stamp = sensors.stamp;
+      sample.left = tof_meters(sensors.left_TOF);
+      sample.right = tof_meters(sensors.right_TOF);
+      sample.rear = tof_meters(sensors.rear_TOF);
+      tof_.push(sample);
+   }
+
+   /**
+    * @brief Assembles the ranges of every source at a time.
+    */
+   void assemble(const ros::Time &stamp, ObstacleFrame *frame) const {
+      RplidarState before_scan, after_scan;
+      LidarLiteState before_reading, after_reading;
+      TofSample before_tof, after_tof;
+      const RplidarState *scan;
+      double weight;
+      int found;
+
+      frame->stamp = stamp;
+      frame->valid = 0;
+
+      // scans are not interpolated, the nearest one is used
+      found = rplidar_.bracket(stamp, &before_scan, &after_scan);
+      scan = nearest(stamp, found, before_scan, after_scan,
+                     &frame->rplidar_age);
+      if (scan != NULL && frame->rplidar_age <= config_.rplidar_max_age) {
+         sectors(*scan, frame->sector);
+         frame->valid |= ObstacleFrame::RPLIDAR;
+      }
+      else {
+         for (int i = 0; i < ObstacleFrame::NUM_SECTORS; i++) {
+            frame->sector[i] = std::numeric_limits<float>::infinity();
+         }
+      }
+
+      found = lidar_lite_.bracket(stamp, &before_reading, &after_reading);
+      weight = interpolation(stamp, found, before_reading.stamp,
+                             after_reading.stamp, &frame->lidar_lite_age);
+      frame->lidar_lite = std::numeric_limits<float>::infinity();
+      if (found && frame->lidar_lite_age <= config_.lidar_lite_max_age) {
+         frame->lidar_lite = mix(before_reading.range, after_reading.range,
+                                 weight);
+         frame->valid |= ObstacleFrame::LIDAR_LITE;
+      }
+
+      found = tof_.bracket(stamp, &before_tof, &after_tof);
+      weight = interpolation(stamp, found, before_tof.stamp, after_tof.stamp,
+                             &frame->tof_age);
+      frame->left_tof = std::numeric_limits<float>::infinity();
+      frame->right_tof = std::numeric_limits<float>::infinity();
+      frame->rear_tof = std::numeric_limits<float>::infinity();
+      if (found && frame->tof_age <= config_.tof_max_age) {
+         frame->left_tof = mix(before_tof.left, after_tof.left, weight);
+         frame->right_tof = mix(before_tof.right, after_tof.right, weight);
+         frame->rear_tof = mix(before_tof.rear, after_tof.rear, weight);
+         frame->valid |= ObstacleFrame::TOF;
+      }
+   }
+
+private:
+   static float tof_meters(int16_t range_mm) {
+      return range_mm > 0 ? range_mm / 1000.0f :
+             std::numeric_limits<float>::infinity();
+   }
+
+   /**
+    * @brief Picks the sample nearest to a time out of the ones found by
+    * SampleRing::bracket().
+    *
+    * @param age set to the seconds between the time and the sample
+    * @return the sample, or NULL if none was found
+    */
+   template <typename T>
+   static const T *nearest(const ros::Time &time, int found, const T &before,
+                           const T &after, float *age) {
+      double before_age = (found & 1) ? (time - before.stamp).toSec() : 0;
+      double after_age = (found & 2) ? (after.stamp - time).toSec() : 0;
+
+      *age = std::numeric_limits<float>::infinity();
+      if (found == 3) {
+         *age = std::min(before_age, after_age);
+         return before_age <= after_age ? &before : &after;
+      }
+      if (found == 1) {
+         *age = before_age;
+         return &before;
+      }
+      if (found == 2) {
+         *age = after_age;
+         return &after;
+      }
+      return NULL;
+   }
+
+   /**
+    * @brief Works out how to combine the samples found by
+    * SampleRing::bracket() for a time: the weight of the after sample,
+    * between 0 and 1. A single sample is held, with the seconds to it as
+    * its age; two samples are interpolated, with the seconds to the nearer
+    * one as the age, so a long gap between them is not taken as fresh.
+    */
+   static double interpolation(const ros::Time &time, int found,
+                               const ros::Time &before,
+                               const ros::Time &after, float *age) {
+      double span;
+
+      *age = std::numeric_limits<float>::infinity();
+      if (found == 3) {
+         span = (after - before).toSec();
+         *age = std::min((time - before).toSec(), (after - time).toSec());
+         return span > 0 ? (time - before).toSec() / span : 0;
+      }
+      if (found == 1) {
+         *age = (time - before).toSec();
+         return 0;
+      }
+      if (found == 2) {
+         *age = (after - time).toSec();
+         return 1;
+      }
+      return 0;
+   }
+
+   /**
+    * @brief Interpolates between two ranges. A missing return cannot be
+    * interpolated, so the nearer of the two samples is used instead.
+    */
+   static float mix(float before, float after, double weight) {
+      if (weight <= 0) {
+         return before;
+      }
+      if (weight >= 1) {
+         return after;
+      }
+      if (std::isinf(before) || std::isinf(after)) {
+         return weight < 0.5 ? before : after;
+      }
+      return (float)(before + (after - before) * weight);
+   }
+
+   /**
+    * @brief Reduces a binned scan to the closest return in each sector.
+    */
+   void sectors(const RplidarState &scan, float *sector) const {
+      float start = config_.sector_offset - 180.0f / ObstacleFrame::NUM_SECTORS;
+
+      for (int i = 0; i < ObstacleFrame::NUM_SECTORS; i++) {
+         sector[i] = std::numeric_limits<float>::infinity();
+      }
+      for (int degree = 0; degree < RplidarState::NUM_BINS; degree++) {
+         int i = (int)std::floor((degree + 0.5f - start) *
+                                 ObstacleFrame::NUM_SECTORS / 360.0f);
+
+         i %= ObstacleFrame::NUM_SECTORS;
+         if (i < 0) {
+            i += ObstacleFrame::NUM_SECTORS;
+         }
+         if (scan.range[degree] < sector[i]) {
+            sector[i] = scan.range[degree];
+         }
+      }
+   }
+
+   FusionConfig config_;
+   SampleRing<RplidarState, FUSION_RPLIDAR_DEPTH> rplidar_;
+   SampleRing<LidarLiteState, FUSION_LIDAR_LITE_DEPTH> lidar_lite_;
+   SampleRing<TofSample, FUSION_TOF_DEPTH> tof_;
+};
+
+#endif //DAIMTRONICS_OBSTACLE_FUSION_H
@@ -0,0 +1,362 @@
+/**
+ * @file A lock-free store of the latest data from every sensor on the truck
+ * and of the actuator command that the algorithm wants to send. Subscriber
+ * callbacks write into a TruckState and algorithm code reads a consistent,
+ * timestamped TruckSnapshot of all of it at once, without taking a lock and
+ * without keeping its own copies of the messages fresh.
+ */
+
+#ifndef DAIMTRONICS_TRUCK_STATE_H
+#define DAIMTRONICS_TRUCK_STATE_H
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <ros/time.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Range.h>
+
+#include "semi_truck/Teensy_Actuators.h"
+#include "semi_truck/Teensy_Sensors.h"
+
+/**
+ * @brief A single-writer, multi-reader sequence lock around a trivially
+ * copyable value. The writer never waits. A reader copies the value and
+ * retries if the writer was active in the meantime, which is rare because
+ * the values are small and written at sensor rates.
+ *
+ * The value is stored as an array of atomic words so concurrent reads and
+ * writes are well defined; the sequence counter only tells the reader
+ * whether the words it read belong to the same write.
+ */
+template <typename T>
+class SeqLock {
+public:
+   static_assert(std::is_trivially_copyable<T>::value,
+                 "SeqLock values are copied word by word");
+
+   SeqLock() : seq_(0) {
+      store(T());
+   }
+
+   /**
+    * @brief Replaces the value. Must only be called from one thread at a time.
+    */
+   void store(const T &value) {
+      uint64_t words[NUM_WORDS] = {};
+      uint32_t seq = seq_.load(std::memory_order_relaxed);
+
+      std::memcpy(words, &value, sizeof(value));
+
+      seq_.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < NUM_WORDS; i++) {
+         words_[i].store(words[i], std::memory_order_relaxed);
+      }
+      seq_.store(seq + 2, std::memory_order_release);
+   }
+
+   /**
+    * @brief Starts a read. The returned sequence number is odd while a write
+    * is in progress.
+    */
+   uint32_t begin() const {
+      return seq_.load(std::memory_order_acquire);
+   }
+
+   /**
+    * @brief Copies the value out. It is only valid if validate() returns true
+    * for the sequence number that begin() returned.
+    */
+   void copy(T *value) const {
+      uint64_t words[NUM_WORDS];
+
+      for (size_t i = 0; i < NUM_WORDS; i++) {
+         words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::memcpy(value, words, sizeof(*value));
+   }
+
+   bool validate(uint32_t seq) const {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return !(seq & 1) && seq == seq_.load(std::memory_order_relaxed);
+   }
+
+   T load() const {
+      T value;
+      uint32_t seq;
+
+      do {
+         seq = begin();
+         copy(&value);
+      } while (!validate(seq));
+      return value;
+   }
+
+private:
+   static const size_t NUM_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) /
+                                   sizeof(uint64_t);
+
+   std::atomic<uint32_t> seq_;
+   std::atomic<uint64_t> words_[NUM_WORDS];
+};
+
+/**
+ * @brief The latest Teensy_Sensors message and the time it was received.
+ */
+struct TeensyState {
+   ros::Time stamp;
+   int16_t wheel_speed;
+   int16_t imu_angle;
+   int16_t right_TOF;
+   int16_t left_TOF;
+   int16_t rear_TOF;
+   int16_t drive_mode;
+   uint16_t cmd_latency_us;
+   uint16_t rx_seq;
+   int16_t link_state;
+   uint16_t link_reaction_ms;
+};
+
+/**
+ * @brief The latest LIDAR-Lite reading in meters.
+ */
+struct LidarLiteState {
+   ros::Time stamp;
+   float range;
+};
+
+/**
+ * @brief The latest RPLIDAR scan reduced to the closest return in each
+ * whole degree, indexed by the angle in degrees from 0 to 359. Bins without
+ * a valid return hold infinity.
+ */
+struct RplidarState {
+   static const int NUM_BINS = 360;
+
+   ros::Time stamp;
+   float range[NUM_BINS];
+};
+
+/**
+ * @brief Reduces a scan to the closest return in each whole degree.
+ */
+inline void bin_rplidar_scan(const sensor_msgs::LaserScan &msg,
+                             RplidarState *state) {
+   state->stamp = msg.header.stamp;
+   for (int i = 0; i < RplidarState::NUM_BINS; i++) {
+      state->range[i] = std::numeric_limits<float>::infinity();
+   }
+
+   for (size_t i = 0; i < msg.ranges.size(); i++) {
+      float range = msg.ranges[i];
+      if (!(range >= msg.range_min && range <= msg.range_max)) {
+         continue;
+      }
+
+      double degrees = (msg.angle_min + i * msg.angle_increment) * 180.0 /
+                       M_PI;
+      int bin = (int)std::floor(degrees) % RplidarState::NUM_BINS;
+      if (bin < 0) {
+         bin += RplidarState::NUM_BINS;
+      }
+      if (range < state->range[bin]) {
+         state->range[bin] = range;
+      }
+   }
+}
+
+/**
+ * @brief The ranges around the truck from every range sensor, aligned to one
+ * time, usually a control tick: the closest RPLIDAR return in each of 8
+ * sectors, the LIDAR-Lite and the three ToF sensors, all in meters.
+ * Infinity means no return or no recent enough sample. Assembled by an
+ * ObstacleFusion, see obstacle_fusion.h.
+ */
+struct ObstacleFrame {
+   // sectors of 45 degrees centered on FRONT, in the direction the scan
+   // angles go, counterclockwise as in every LaserScan
+   enum Sector {
+      FRONT,
+      FRONT_LEFT,
+      LEFT,
+      REAR_LEFT,
+      REAR,
+      REAR_RIGHT,
+      RIGHT,
+      FRONT_RIGHT,
+      NUM_SECTORS
+   };
+
+   // bits of valid, set for each source that had a recent enough sample
+   enum Source {
+      RPLIDAR = 1,
+      LIDAR_LITE = 2,
+      TOF = 4
+   };
+
+   ros::Time stamp;  // the time that every range is aligned to
+   float sector[NUM_SECTORS];
+   float lidar_lite;
+   float left_tof;
+   float right_tof;
+   float rear_tof;
+   // seconds between stamp and the nearest sample used
+   float rplidar_age;
+   float lidar_lite_age;
+   float tof_age;
+   uint8_t valid;
+};
+
+/**
+ * @brief The actuator command that the algorithm wants to send.
+ */
+struct ActuatorState {
+   ros::Time stamp;
+   int16_t motor_output;
+   int16_t steer_output;
+   int16_t fifth_output;
+   int16_t motor_mode;
+};
+
+/**
+ * @brief A copy of every part of the TruckState taken at one instant. A stamp
+ * of zero means that part has not been received yet. The obstacles are not
+ * part of the TruckState; a ControlExecutor fills them in for its tick.
+ */
+struct TruckSnapshot {
+   TeensyState teensy;
+   LidarLiteState lidar_lite;
+   RplidarState rplidar;
+   ActuatorState actuators;
+   ObstacleFrame obstacles;
+};
+
+/**
+ * @brief The shared state of the truck. Each part has exactly one writer,
+ * normally the subscriber callback for that sensor, and any number of
+ * readers. Writers never block; snapshot() retries until it has read every
+ * part without any of them changing in between, so all of the values in a
+ * snapshot were current at the same time.
+ */
+class TruckState {
+public:
+   /**
+    * @brief Takes a set of Teensy sensor data, stamped with the time it is
+    * received. pi_comm_node only publishes data that it has just read, so
+    * that is also close to when the Teensy sent it.
+    */
+   void update_teensy(const semi_truck::Teensy_Sensors &msg) {
+      TeensyState state;
+
+      state.stamp = ros::Time::now();
+      state.wheel_speed = msg.wheel_speed;
+      state.imu_angle = msg.imu_angle;
+      state.right_TOF = msg.right_TOF;
+      state.left_TOF = msg.left_TOF;
+      state.rear_TOF = msg.rear_TOF;
+      state.drive_mode = msg.drive_mode;
+      state.cmd_latency_us = msg.cmd_latency_us;
+      state.rx_seq = msg.rx_seq;
+      state.link_state = msg.link_state;
+      state.link_reaction_ms = msg.link_reaction_ms;
+      teensy_.store(state);
+   }
+
+   /**
+    * @brief Takes the LIDAR-Lite reading from the single point scan that
+    * lidar_lite_node publishes by default.
+    */
+   void update_lidar_lite(const sensor_msgs::LaserScan &msg) {
+      LidarLiteState state;
+
+      state.stamp = msg.header.stamp;
+      state.range = msg.ranges.empty() ?
+                    std::numeric_limits<float>::infinity() : msg.ranges[0];
+      lidar_lite_.store(state);
+   }
+
+   void update_lidar_lite(const sensor_msgs::Range &msg) {
+      LidarLiteState state;
+
+      state.stamp = msg.header.stamp;
+      state.range = msg.range;
+      lidar_lite_.store(state);
+   }
+
+   /**
+    * @brief Bins a scan by whole degrees. This is the only part of the store
+    * that is linear in the size of the input, and it runs in the writer.
+    */
+   void update_rplidar(const sensor_msgs::LaserScan &msg) {
+      RplidarState state;
+
+      bin_rplidar_scan(msg, &state);
+      rplidar_.store(state);
+   }
+
+   /**
+    * @brief Stores a scan that the writer has already binned, e.g. to hand
+    * the same bins to an ObstacleFusion.
+    */
+   void update_rplidar(const RplidarState &state) {
+      rplidar_.store(state);
+   }
+
+   void update_actuators(const semi_truck::Teensy_Actuators &msg) {
+      ActuatorState state;
+
+      state.stamp = ros::Time::now();
+      state.motor_output = msg.motor_output;
+      state.steer_output = msg.steer_output;
+      state.fifth_output = msg.fifth_output;
+      state.motor_mode = msg.motor_mode;
+      actuators_.store(state);
+   }
+
+   /**
+    * @brief Fills in a Teensy_Actuators message with the current command.
+    */
+   void actuators(semi_truck::Teensy_Actuators *msg) const {
+      ActuatorState state = actuators_.load();
+
+      msg->motor_output = state.motor_output;
+      msg->steer_output = state.steer_output;
+      msg->fifth_output = state.fifth_output;
+      msg->motor_mode = state.motor_mode;
+   }
+
+   void snapshot(TruckSnapshot *snapshot) const {
+      uint32_t teensy_seq, lidar_lite_seq, rplidar_seq, actuators_seq;
+
+      do {
+         teensy_seq = teensy_.begin();
+         lidar_lite_seq = lidar_lite_.begin();
+         rplidar_seq = rplidar_.begin();
+         actuators_seq = actuators_.begin();
+
+         teensy_.copy(&snapshot->teensy);
+         lidar_lite_.copy(&snapshot->lidar_lite);
+         rplidar_.copy(&snapshot->rplidar);
+         actuators_.copy(&snapshot->actuators);
+      } while (!teensy_.validate(teensy_seq) ||
+               !lidar_lite_.validate(lidar_lite_seq) ||
+               !rplidar_.validate(rplidar_seq) ||
+               !actuators_.validate(actuators_seq));
+   }
+
+   TeensyState teensy() const { return teensy_.load(); }
+
+   LidarLiteState lidar_lite() const { return lidar_lite_.load(); }
+
+private:
+   SeqLock<TeensyState> teensy_;
+   SeqLock<LidarLiteState> lidar_lite_;
+   SeqLock<RplidarState> rplidar_;
+   SeqLock<ActuatorState> actuators_;
+};
+
+#endif //DAIMTRONICS_TRUCK_STATE_H
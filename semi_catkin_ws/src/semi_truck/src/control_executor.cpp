@@ -0,0 +1,295 @@
+#include "control_executor.h"
+
+#include <thread>
+
+#define DEFAULT_MAX_CATCH_UP 3 // missed cycles that RUN_MISSED will run
+#define DEFAULT_REPORT_PERIOD 10.0 // seconds between statistics logs
+#define STEER_STRAIGHT 90 // steer output that keeps the wheels straight
+#define SIM_POLL_US 50 // how often simulated time is checked while sleeping
+
+DurationHistogram::DurationHistogram(uint32_t bin_us)
+      : bin_us_(bin_us > 0 ? bin_us : 1) {
+   reset();
+}
+
+void DurationHistogram::record(uint32_t duration_us) {
+   uint32_t bin = duration_us / bin_us_;
+
+   bins_[bin < NUM_BINS ? bin : NUM_BINS]++;
+   count_++;
+   if (duration_us > max_us_) {
+      max_us_ = duration_us;
+   }
+}
+
+uint32_t DurationHistogram::percentile(double fraction) const {
+   uint64_t target = (uint64_t)(fraction * count_);
+   uint64_t seen = 0;
+
+   for (int i = 0; i < NUM_BINS; i++) {
+      seen += bins_[i];
+      if (seen > target) {
+         return (i + 1) * bin_us_;
+      }
+   }
+   return max_us_;
+}
+
+void DurationHistogram::reset() {
+   for (int i = 0; i <= NUM_BINS; i++) {
+      bins_[i] = 0;
+   }
+   count_ = 0;
+   max_us_ = 0;
+}
+
+/**
+ * @brief Converts a duration to whole microseconds, clamping negative
+ * durations to 0.
+ */
+template <typename Duration>
+static uint32_t to_us(Duration duration) {
+   int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+         duration).count();
+   return us > 0 ? (uint32_t)us : 0;
+}
+
+/**
+ * @brief Sleeps until a time on the monotonic clock.
+ */
+static void sleep_until(std::chrono::steady_clock::time_point time) {
+   std::this_thread::sleep_until(time);
+}
+
+/**
+ * @brief Sleeps until a ROS time. ros::Time::sleepUntil() only checks
+ * simulated time once a millisecond, which would cap a fast simulation, so
+ * this checks it more often.
+ */
+static void sleep_until(RosClock::time_point time) {
+   while (ros::ok() && RosClock::now() < time) {
+      std::this_thread::sleep_for(std::chrono::microseconds(SIM_POLL_US));
+   }
+}
+
+/**
+ * @brief Sets up the inputs and the output of the executor. The sensor
+ * subscriptions only keep the newest message, and their callbacks run on a
+ * separate thread so that they update the TruckState while compute() runs.
+ * The histogram bins are sized so the 64 bins cover two periods, and four
+ * for the scan to command latency, which includes the wait for the cycle.
+ *
+ * The ~lidar_lite_range parameter must match publish_range of the
+ * lidar_lite node: if set, the LIDAR-Lite is read as a sensor_msgs/Range
+ * from range_lidar_lite instead of a LaserScan from scan_lidar_lite.
+ */
+ControlExecutor::ControlExecutor(ros::NodeHandle &nh, double rate_hz,
+                                 CatchUpPolicy policy)
+      : input_spinner_(1, &input_queue_),
+        period_(std::chrono::duration_cast<Clock::duration>(
+              period_of(rate_hz))),
+        policy_(policy),
+        max_catch_up_(DEFAULT_MAX_CATCH_UP),
+        report_period_s_(DEFAULT_REPORT_PERIOD),
+        stopped_(false),
+        overruns_(0),
+        skipped_(0),
+        execution_us_(2 * to_us(period_) / DurationHistogram::NUM_BINS),
+        wakeup_us_(2 * to_us(period_) / DurationHistogram::NUM_BINS),
+        scan_end_ns_(0),
+        commanded_scan_end_ns_(0),
+        scan_to_command_us_(4 * to_us(period_) / DurationHistogram::NUM_BINS) {
+   ros::NodeHandle input_nh(nh);
+   ros::NodeHandle private_nh("~");
+   bool lidar_lite_range;
+
+   input_nh.setCallbackQueue(&input_queue_);
+   private_nh.param("lidar_lite_range", lidar_lite_range, false);
+
+   rplidar_subscriber_ = input_nh.subscribe(
+         "scan_rplidar", 1, &ControlExecutor::rplidar_cb, this);
+   if (lidar_lite_range) {
+      lidar_lite_subscriber_ = input_nh.subscribe(
+            "range_lidar_lite", 1, &ControlExecutor::lidar_lite_range_cb, this);
+   }
+   else {
+      lidar_lite_subscriber_ = input_nh.subscribe(
+            "scan_lidar_lite", 1, &ControlExecutor::lidar_lite_cb, this);
+   }
+   teensy_sensors_subscriber_ = input_nh.subscribe(
+         "pi_comm_node/teensy_sensor_data", 1,
+         &ControlExecutor::teensy_sensors_cb, this);
+   actuator_publisher_ = nh.advertise<semi_truck::Teensy_Actuators>(
+         "pi_comm_node/teensy_actuator_data", 1);
+
+   command_.motor_mode = semi_truck::Teensy_Actuators::MOTOR_MODE_THROTTLE;
+   command_.motor_output = 0;
+   command_.steer_output = STEER_STRAIGHT;
+   command_.fifth_output = 0;
+   state_.update_actuators(command_);
+}
+
+std::chrono::nanoseconds ControlExecutor::period_of(double rate_hz) {
+   // also rejects NaN
+   if (!(rate_hz > 0)) {
+      throw std::invalid_argument("ControlExecutor rate must be above 0 Hz");
+   }
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::duration<double>(1.0 / rate_hz));
+}
+
+ControlExecutor::~ControlExecutor() {
+   input_spinner_.stop();
+}
+
+/**
+ * @brief Runs the control loop on ROS time when it is simulated, and on the
+ * monotonic clock otherwise.
+ */
+void ControlExecutor::run() {
+   input_spinner_.start();
+
+   if (ros::Time::isSimTime()) {
+      ros::Time::waitForValid();
+      run_loop<RosClock>();
+   }
+   else {
+      run_loop<Clock>();
+   }
+
+   input_spinner_.stop();
+}
+
+/**
+ * @brief The control loop. Every cycle takes a snapshot, runs compute() and
+ * publishes the command. A cycle that ends after the next one was due is an
+ * overrun, and the catch up policy decides when the next cycle starts.
+ */
+template <typename LoopClock>
+void ControlExecutor::run_loop() {
+   typedef typename LoopClock::time_point TimePoint;
+   typename LoopClock::duration period =
+         std::chrono::duration_cast<typename LoopClock::duration>(period_);
+   TimePoint next = LoopClock::now();
+   TimePoint report_start = next;
+
+   while (ros::ok() && !stopped_) {
+      sleep_until(next);
+
+      TimePoint start = LoopClock::now();
+      wakeup_us_.record(to_us(start - next));
+
+      state_.snapshot(&snapshot_);
+      assemble_obstacles();
+      compute(snapshot_, command_);
+      state_.update_actuators(command_);
+      // a new message per cycle, so that a pi_comm nodelet in the same
+      // process can keep the published pointer instead of getting a copy
+      actuator_publisher_.publish(semi_truck::Teensy_ActuatorsPtr(
+            new semi_truck::Teensy_Actuators(command_)));
+      record_scan_to_command();
+
+      TimePoint end = LoopClock::now();
+      execution_us_.record(to_us(end - start));
+
+      ScheduleStep step = schedule(policy_, max_catch_up_, period, end, &next);
+      overruns_ += step.overrun;
+      skipped_ += step.skipped;
+
+      double elapsed_s = std::chrono::duration<double>(end - report_start).count();
+      if (report_period_s_ > 0 && elapsed_s >= report_period_s_) {
+         report(elapsed_s);
+         report_start = end;
+      }
+   }
+}
+
+/**
+ * @brief Records how long after the last point of a scan the first command
+ * that was computed from it was published. The latency includes the
+ * driver, the hand over of the scan to this node and the wait for the next
+ * cycle, so it is what changes between the nodelet and the multi-process
+ * launch. It is on ROS time like the stamps of the scans: wall time on the
+ * truck, and simulated time under truck_sim_node.
+ */
+void ControlExecutor::record_scan_to_command() {
+   int64_t scan_end_ns = scan_end_ns_;
+
+   if (scan_end_ns != 0 && scan_end_ns != commanded_scan_end_ns_) {
+      int64_t latency_ns = (int64_t)ros::Time::now().toNSec() - scan_end_ns;
+
+      scan_to_command_us_.record(
+            to_us(std::chrono::nanoseconds(latency_ns)));
+      commanded_scan_end_ns_ = scan_end_ns;
+   }
+}
+
+/**
+ * @brief Logs the execution statistics since the last report and starts a
+ * new reporting window.
+ */
+void ControlExecutor::report(double elapsed_s) {
+   ROS_INFO("Control loop: %.1f Hz, %lu overruns, %lu skipped cycles, "
+            "execution p50 %u us p99 %u us max %u us, "
+            "wakeup p99 %u us max %u us, "
+            "scan to command p50 %u us p99 %u us max %u us",
+            execution_us_.count() / elapsed_s,
+            (unsigned long)overruns_, (unsigned long)skipped_,
+            execution_us_.percentile(0.5), execution_us_.percentile(0.99),
+            execution_us_.max(), wakeup_us_.percentile(0.99),
+            wakeup_us_.max(), scan_to_command_us_.percentile(0.5),
+            scan_to_command_us_.percentile(0.99), scan_to_command_us_.max());
+
+   overruns_ = 0;
+   skipped_ = 0;
+   execution_us_.reset();
+   wakeup_us_.reset();
+   scan_to_command_us_.reset();
+}
+
+/**
+ * @brief Aligns the obstacle frame of the snapshot to the start of the
+ * cycle, less the fusion delay. ROS time can be close to 0 under a
+ * simulator, and ros::Time cannot go below it.
+ */
+void ControlExecutor::assemble_obstacles() {
+   ros::Time tick = ros::Time::now();
+
+   if (tick.toSec() > fusion_delay_.toSec()) {
+      tick -= fusion_delay_;
+   }
+   fusion_.assemble(tick, &snapshot_.obstacles);
+}
+
+/**
+ * @brief The sensor callbacks update the TruckState and hand the same
+ * samples to the ObstacleFusion. Scans are binned once for both.
+ */
+void ControlExecutor::rplidar_cb(const sensor_msgs::LaserScan::ConstPtr &msg) {
+   bin_rplidar_scan(*msg, &scan_);
+   state_.update_rplidar(scan_);
+   fusion_.add_rplidar(scan_);
+
+   // a de-skewed scan has a time_increment of 0 and is stamped at its end
+   ros::Time end = msg->header.stamp;
+   if (!msg->ranges.empty()) {
+      end += ros::Duration(msg->time_increment * (msg->ranges.size() - 1));
+   }
+   scan_end_ns_ = end.toNSec();
+}
+
+void ControlExecutor::lidar_lite_cb(const sensor_msgs::LaserScan::ConstPtr &msg) {
+   state_.update_lidar_lite(*msg);
+   fusion_.add_lidar_lite(state_.lidar_lite());
+}
+
+void ControlExecutor::lidar_lite_range_cb(const sensor_msgs::Range::ConstPtr &msg) {
+   state_.update_lidar_lite(*msg);
+   fusion_.add_lidar_lite(state_.lidar_lite());
+}
+
+void ControlExecutor::teensy_sensors_cb(
+      const semi_truck::Teensy_Sensors::ConstPtr &msg) {
+   state_.update_teensy(*msg);
+   fusion_.add_tof(state_.teensy());
+}
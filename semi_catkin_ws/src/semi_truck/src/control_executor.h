@@ -0,0 +1,267 @@
+/**
+ * @file A fixed-rate executor for the autonomous algorithms. It keeps only
+ * the latest message from every sensor in a TruckState, wakes up on a
+ * monotonic clock, hands the algorithm one consistent snapshot per cycle and
+ * publishes the Teensy_Actuators command that the algorithm computes. The
+ * snapshot also holds an ObstacleFrame with the ranges of every range sensor
+ * aligned to the start of the cycle, see obstacle_fusion.h. It also
+ * keeps track of how long every cycle takes and of cycles that missed their
+ * deadline. Algorithm nodes subclass ControlExecutor and implement compute().
+ *
+ * With /use_sim_time set, e.g. under truck_sim_node, it wakes up on ROS time
+ * instead, so it runs at its rate in simulated time however fast the
+ * simulation goes.
+ */
+
+#ifndef DAIMTRONICS_CONTROL_EXECUTOR_H
+#define DAIMTRONICS_CONTROL_EXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Range.h>
+
+#include "semi_truck/Teensy_Actuators.h"
+#include "semi_truck/Teensy_Sensors.h"
+#include "truck_state.h"
+#include "obstacle_fusion.h"
+
+/**
+ * @brief A histogram of durations in microseconds with fixed width bins and
+ * one overflow bin. Recording is O(1) and never allocates.
+ */
+class DurationHistogram {
+public:
+   static const int NUM_BINS = 64;
+
+   explicit DurationHistogram(uint32_t bin_us);
+
+   void record(uint32_t duration_us);
+
+   /**
+    * @brief Returns the upper edge of the bin that holds the given fraction
+    * of the recorded durations, e.g. 0.99 for the 99th percentile. Durations
+    * in the overflow bin are reported as the largest one seen.
+    */
+   uint32_t percentile(double fraction) const;
+
+   uint32_t max() const { return max_us_; }
+
+   uint64_t count() const { return count_; }
+
+   void reset();
+
+private:
+   uint32_t bin_us_;
+   uint64_t bins_[NUM_BINS + 1];
+   uint64_t count_;
+   uint32_t max_us_;
+};
+
+/**
+ * @brief A std::chrono clock that reads ROS time, which follows /clock when
+ * /use_sim_time is set.
+ */
+struct RosClock {
+   typedef std::chrono::nanoseconds duration;
+   typedef duration::rep rep;
+   typedef duration::period period;
+   typedef std::chrono::time_point<RosClock> time_point;
+   static const bool is_steady = false;
+
+   static time_point now() {
+      return time_point(duration(ros::Time::now().toNSec()));
+   }
+};
+
+/**
+ * @brief The base class for algorithm nodes that run at a fixed rate.
+ */
+class ControlExecutor {
+public:
+   /**
+    * @brief What to do when a cycle finishes after the next one should have
+    * started.
+    * SKIP_MISSED: drop the missed cycles and stay on the original schedule.
+    * RUN_MISSED: run the missed cycles back to back, at most max_catch_up of
+    * them, and skip the rest.
+    * RESTART: start a new schedule one period after the late cycle ended.
+    */
+   enum CatchUpPolicy {
+      SKIP_MISSED,
+      RUN_MISSED,
+      RESTART,
+   };
+
+   /**
+    * @brief What a cycle did to the schedule.
+    */
+   struct ScheduleStep {
+      bool overrun;     // the cycle ended after the next one was due
+      uint32_t skipped; // cycles dropped from the schedule
+   };
+
+   /**
+    * @param nh the node handle used to subscribe to the sensor topics and to
+    * advertise the actuator topic
+    * @param rate_hz how often compute() is called, must be above 0
+    * @param policy what to do after a cycle overran its period
+    * @throws std::invalid_argument if rate_hz is not above 0
+    */
+   ControlExecutor(ros::NodeHandle &nh, double rate_hz,
+                   CatchUpPolicy policy = SKIP_MISSED);
+
+   /**
+    * @brief The period of a rate.
+    *
+    * @throws std::invalid_argument if rate_hz is not above 0
+    */
+   static std::chrono::nanoseconds period_of(double rate_hz);
+
+   /**
+    * @brief Moves the start of the next cycle on by a period after a cycle
+    * that ended at end, and applies the catch up policy if that is past it.
+    *
+    * @param next the start of the cycle that just ran on entry, the start of
+    * the next one on return
+    */
+   template <typename TimePoint>
+   static ScheduleStep schedule(CatchUpPolicy policy, uint32_t max_catch_up,
+                                typename TimePoint::duration period,
+                                TimePoint end, TimePoint *next);
+
+   virtual ~ControlExecutor();
+
+   /**
+    * @brief Runs the control loop until ROS shuts down or stop() is called.
+    */
+   void run();
+
+   /**
+    * @brief Makes run() return after the current cycle. Safe to call from any
+    * thread.
+    */
+   void stop() { stopped_ = true; }
+
+   void set_max_catch_up(uint32_t cycles) { max_catch_up_ = cycles; }
+
+   /**
+    * @brief How often the execution statistics are logged. 0 disables it.
+    */
+   void set_report_period(double seconds) { report_period_s_ = seconds; }
+
+   /**
+    * @brief Sets how the obstacle frames are assembled. Must be called
+    * before run().
+    */
+   void set_fusion_config(const FusionConfig &config) {
+      fusion_.configure(config);
+      fusion_delay_ = ros::Duration(config.delay);
+   }
+
+protected:
+   /**
+    * @brief Computes one actuator command. Called once per cycle with a
+    * snapshot of the latest sensor data.
+    *
+    * @param snapshot the sensor data and the previous command, all taken at
+    * the same instant, and the obstacles around the truck at the start of
+    * the cycle
+    * @param command the command to send, holding the previous command on entry
+    */
+   virtual void compute(const TruckSnapshot &snapshot,
+                        semi_truck::Teensy_Actuators &command) = 0;
+
+   TruckState &state() { return state_; }
+
+private:
+   typedef std::chrono::steady_clock Clock;
+
+   void rplidar_cb(const sensor_msgs::LaserScan::ConstPtr &msg);
+
+   void lidar_lite_cb(const sensor_msgs::LaserScan::ConstPtr &msg);
+
+   void lidar_lite_range_cb(const sensor_msgs::Range::ConstPtr &msg);
+
+   void teensy_sensors_cb(const semi_truck::Teensy_Sensors::ConstPtr &msg);
+
+   template <typename LoopClock>
+   void run_loop();
+
+   void assemble_obstacles();
+
+   void record_scan_to_command();
+
+   void report(double elapsed_s);
+
+   TruckState state_;
+   ObstacleFusion fusion_;
+   ros::Duration fusion_delay_;
+   RplidarState scan_; // binned by the input thread
+   TruckSnapshot snapshot_;
+   semi_truck::Teensy_Actuators command_;
+
+   ros::CallbackQueue input_queue_;
+   ros::AsyncSpinner input_spinner_;
+   ros::Subscriber rplidar_subscriber_;
+   ros::Subscriber lidar_lite_subscriber_;
+   ros::Subscriber teensy_sensors_subscriber_;
+   ros::Publisher actuator_publisher_;
+
+   Clock::duration period_;
+   CatchUpPolicy policy_;
+   uint32_t max_catch_up_;
+   double report_period_s_;
+   std::atomic<bool> stopped_;
+
+   uint64_t overruns_;
+   uint64_t skipped_;
+   DurationHistogram execution_us_;
+   DurationHistogram wakeup_us_;
+
+   // ROS time of the last point of the newest RPLIDAR scan, written by the
+   // input thread, and of the scan that the last command was computed from
+   std::atomic<int64_t> scan_end_ns_;
+   int64_t commanded_scan_end_ns_;
+   DurationHistogram scan_to_command_us_;
+};
+
+template <typename TimePoint>
+ControlExecutor::ScheduleStep ControlExecutor::schedule(
+      CatchUpPolicy policy, uint32_t max_catch_up,
+      typename TimePoint::duration period, TimePoint end, TimePoint *next) {
+   ScheduleStep step = {false, 0};
+
+   *next += period;
+   if (end > *next) {
+      uint32_t missed = (uint32_t)((end - *next) / period);
+
+      step.overrun = true;
+      switch (policy) {
+         case SKIP_MISSED:
+            *next += (missed + 1) * period;
+            step.skipped = missed + 1;
+            break;
+         case RUN_MISSED:
+            // the cycles that are due start back to back, without
+            // sleeping; beyond max_catch_up the oldest ones are dropped
+            if (missed + 1 > max_catch_up) {
+               *next += (missed + 1 - max_catch_up) * period;
+               step.skipped = missed + 1 - max_catch_up;
+            }
+            break;
+         case RESTART:
+            *next = end + period;
+            step.skipped = missed + 1;
+            break;
+      }
+   }
+   return step;
+}
+
+#endif //DAIMTRONICS_CONTROL_EXECUTOR_H
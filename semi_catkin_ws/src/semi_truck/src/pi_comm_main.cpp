@@ -0,0 +1,19 @@
+#include "pi_comm_node.h"
+
+#include <ros/ros.h>
+
+/**
+ * @brief The main function for the ROS node to communicate with the Teensy
+ * over UART. The bridge runs on its own spinner threads, see
+ * pi_comm_start().
+ */
+int main(int argc, char **argv) {
+   ros::init(argc, argv, "pi_comm_node");
+
+   ros::NodeHandle nh;
+   ros::NodeHandle private_nh("~");
+
+   pi_comm_start(nh, private_nh);
+   ros::waitForShutdown();
+   pi_comm_stop();
+}
@@ -2,104 +2,440 @@
 #include "system_data.h"
 #include "semi_truck/Teensy_Sensors.h"
 #include "semi_truck/Teensy_Actuators.h"
+#include "semi_truck/Uart_Bytes.h"
 
 #include <wiringSerial.h>
 #include <wiringPi.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <memory>
 #include <ros/ros.h>
-#include <sensor_msgs/LaserScan.h>
+#include <ros/callback_queue.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <flight_recorder/recorder.h>
+// last, since its LINK_* and MOTOR_MODE_* macros have the names of constants
+// in the messages
+#include "teensy_protocol.h"
 
 #define SHORT_SIZE 2
 
 #define RELAY_PIN_1 7
 #define RELAY_PIN_2 0
 
-// the value that the teensy sends over to sync communication
-#define SYNC_VALUE -32000
-// number of bytes in a full set of sensors including sync data
-#define SENSOR_DATA_SIZE_W_SYNC 14
 // number of bytes in a full set of sensors excluding sync data
-#define SENSOR_DATA_SIZE 12
+#define SENSOR_DATA_SIZE (SENSOR_FRAME_SIZE - SHORT_SIZE)
 
 #define UART "/dev/ttyS0"
-#define BAUDRATE 9600
 
-// in hz; should match with simulation rate control block of simulink model
-#define LOOP_FREQUENCY 20
+// seconds without a full set of sensor data before the Teensy is reported
+// as silent
+#define TEENSY_TIMEOUT 0.5
+// seconds between link diagnostics when the link status is not changing
+#define DIAGNOSTIC_PERIOD 1.0
 
 //#define DEBUG
 
 using namespace std;
 static int serial;
+static bool use_relay = true;
 
+/**
+ * @brief The sequence number written with every set of actuator data. The
+ * Teensy echoes the last one it received in the sensor data. It is written
+ * by the TX thread and read by the RX thread for diagnostics.
+ */
+static std::atomic<uint16_t> tx_seq(0);
+
+/**
+ * @brief State owned by the RX callback queue: the latest set of sensor
+ * data, the publishers for it and for diagnostics, and the link timing.
+ */
+static semi_truck::Teensy_Sensors sensor_data;
+static ros::Publisher sensor_publisher;
+static ros::Publisher diagnostic_publisher;
+static ros::WallTime last_rx_time;
+static ros::WallTime last_diagnostic_time;
+static unsigned char last_level = diagnostic_msgs::DiagnosticStatus::STALE;
+
+/**
+ * @brief The odometry published on ~odom_twist, e.g. for de-skewing the
+ * RPLIDAR scans: the wheel speed converted to m/s and the yaw rate worked
+ * out from the IMU headings over the last ~yaw_rate_window seconds, since
+ * the heading only comes in whole degrees. Owned by the RX callback queue.
+ */
+static ros::Publisher odom_publisher;
+static double meters_per_tick = 0.002;
+static double wheel_speed_period = 0.1;
+static double yaw_rate_window = 0.25;
+static std::deque<std::pair<ros::Time, int16_t> > headings;
 
 /**
- * @brief The main function for the ROS node to communicate with the Teensy
+ * @brief Topic-to-UART latency of the actuator data, measured on the wall
+ * clock from the time ROS received each message to the time it was written
+ * to the UART, see actuator_cb(). Written by the TX thread and read by the
+ * RX thread for diagnostics.
+ */
+static std::atomic<uint32_t> tx_latency_us(0);
+static std::atomic<uint32_t> tx_latency_max_us(0);
+
+/**
+ * @brief Records the sensor data as it is read and the actuator data as it
+ * is written, when ~record_path is set. Used by both the RX and TX threads;
+ * the recorder does its own locking.
+ */
+static flight_recorder::FlightRecorder recorder;
+static uint16_t sensor_stream;
+static uint16_t actuator_stream;
+
+/**
+ * @brief With ~record_uart set, the raw bytes that the RX thread reads and
+ * the TX thread writes are collected here and recorded as well, so that
+ * uart_replay can feed the exact byte stream back through a pseudo
+ * terminal. Each buffer is only used by its own thread.
+ */
+static bool record_uart = false;
+static uint16_t uart_rx_stream;
+static uint16_t uart_tx_stream;
+static semi_truck::Uart_Bytes uart_rx_bytes;
+static semi_truck::Uart_Bytes uart_tx_bytes;
+
+/**
+ * @brief The callback queues, spinner threads, timer and subscriptions of a
+ * running bridge. They live from pi_comm_start() to pi_comm_stop().
+ */
+struct pi_comm_handles {
+   pi_comm_handles()
+      : rx_spinner(1, &rx_queue),
+        tx_spinner(1, &tx_queue),
+        relay_spinner(1, &relay_queue) {}
+
+   ros::CallbackQueue rx_queue;
+   ros::CallbackQueue tx_queue;
+   ros::CallbackQueue relay_queue;
+   ros::AsyncSpinner rx_spinner;
+   ros::AsyncSpinner tx_spinner;
+   ros::AsyncSpinner relay_spinner;
+   ros::WallTimer rx_timer;
+   ros::Timer rx_sim_timer;
+   ros::Subscriber actuator_subscriber;
+   ros::Subscriber relay_subscriber;
+};
+static std::unique_ptr<pi_comm_handles> handles;
+
+
+/**
+ * @brief Starts the bridge that lets ROS communicate with the Teensy
  * over UART. It receives sensor data from the Teensy and publishes this
  * data to the teensy_sensor_data topic. It also subscribes to the
  * teensy_actuator_data topic and writes the values it gets to the Teensy
  * over UART.
+ *
+ * Each job has its own callback queue and spinner thread, so none of them
+ * can delay the others:
+ * - RX: a wall timer at LOOP_FREQUENCY reads the sensor data, publishes it
+ *   and reports on the link. With /use_sim_time set it is a ROS timer
+ *   instead, so it keeps up with a simulator that runs faster than real
+ *   time.
+ * - TX: the actuator subscription writes each message to the UART as soon
+ *   as it arrives.
+ * - Relay: a subscription to our own sensor data switches the relay only
+ *   when the drive mode changes.
+ *
+ * It is used by both the pi_comm_node executable and the PiCommNodelet.
+ * The ~port parameter overrides the UART, e.g. with the terminal of
+ * truck_sim_node, and ~relay set to false leaves the relay pins alone on
+ * machines that are not the Pi.
+ *
+ * The wheel speed and IMU heading are also published as a twist on
+ * ~odom_twist. ~meters_per_tick and ~wheel_speed_period convert the wheel
+ * speed, which the Teensy reports as hall sensor ticks per period, and the
+ * yaw rate is taken over ~yaw_rate_window seconds of headings.
+ *
+ * With ~record_path set, every set of sensor data read and every set of
+ * actuator data written is kept in a flight recorder ring file of
+ * ~record_chunks chunks of ~record_chunk_kb KiB, synced every
+ * ~record_sync_period seconds. With ~record_uart set as well, the raw bytes
+ * of the UART are recorded too, for uart_replay.
+ *
+ * @param nh the node handle that diagnostics are published on
+ * @param private_nh the node handle that the sensor and actuator topics live
+ * under, e.g. /pi_comm_node
  */
-int main(int argc, char **argv) {
-   short waiting_bytes;
-	serial = serialOpen(UART, BAUDRATE);
+void pi_comm_start(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh) {
+   std::string port;
+   private_nh.param<std::string>("port", port, UART);
+   private_nh.param("relay", use_relay, true);
+   private_nh.param("meters_per_tick", meters_per_tick, 0.002);
+   private_nh.param("wheel_speed_period", wheel_speed_period, 0.1);
+   private_nh.param("yaw_rate_window", yaw_rate_window, 0.25);
+
+   // a simulator may not have created its terminal yet
+   while ((serial = serialOpen(port.c_str(), SERIAL_BAUD)) < 0 && ros::ok()) {
+      ROS_WARN_THROTTLE(5.0, "cannot open %s, retrying", port.c_str());
+      ros::WallDuration(0.5).sleep();
+   }
 
-	// Set the pins on the Pi that toggle the relay between automatic and manual
-   wiringPiSetup();
-   pinMode(RELAY_PIN_1, OUTPUT);
-   pinMode(RELAY_PIN_2, OUTPUT);
+   if (use_relay) {
+      // Set the pins on the Pi that toggle the relay between automatic and
+      // manual
+      wiringPiSetup();
+      pinMode(RELAY_PIN_1, OUTPUT);
+      pinMode(RELAY_PIN_2, OUTPUT);
+   }
+
+   handles.reset(new pi_comm_handles);
 
-   ros::init(argc, argv, "pi_comm_node");
-   ros::NodeHandle nh("~");
+   ros::NodeHandle rx_nh(private_nh);
+   ros::NodeHandle tx_nh(private_nh);
+   ros::NodeHandle relay_nh(private_nh);
+   ros::NodeHandle nh_global(nh);
+   rx_nh.setCallbackQueue(&handles->rx_queue);
+   tx_nh.setCallbackQueue(&handles->tx_queue);
+   relay_nh.setCallbackQueue(&handles->relay_queue);
 
-   semi_truck::Teensy_Sensors sensor_data;
-   ros::Publisher publisher = nh.advertise<semi_truck::Teensy_Sensors>
+   sensor_publisher = rx_nh.advertise<semi_truck::Teensy_Sensors>
     ("teensy_sensor_data", 10);
+   diagnostic_publisher = nh_global.advertise
+    <diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+   odom_publisher = rx_nh.advertise<geometry_msgs::TwistStamped>
+    ("odom_twist", 10);
+   last_rx_time = ros::WallTime::now();
+
+   start_recorder(private_nh);
 
-   semi_truck::Teensy_Actuators actuator_data;
-   ros::Subscriber subscriber = nh.subscribe("teensy_actuator_data", 1,
-    actuator_cb);
+   if (ros::Time::isSimTime()) {
+      handles->rx_sim_timer = rx_nh.createTimer(
+       ros::Duration(1.0 / LOOP_FREQUENCY), rx_sim_cb);
+   }
+   else {
+      handles->rx_timer = rx_nh.createWallTimer(
+       ros::WallDuration(1.0 / LOOP_FREQUENCY), rx_cb);
+   }
 
-   ros::WallRate loop_rate(LOOP_FREQUENCY);
+   handles->actuator_subscriber = tx_nh.subscribe(
+    "teensy_actuator_data", 1, actuator_cb, ros::TransportHints().tcpNoDelay());
 
-   while (ros::ok()) {
+   if (use_relay) {
+      handles->relay_subscriber = relay_nh.subscribe(
+       "teensy_sensor_data", 1, relay_cb);
+   }
 
-      // reads the number of full sets of sensor values coming from the teensy
-      waiting_bytes = serialDataAvail(serial);
-      for (int i = 0; i < waiting_bytes/SENSOR_DATA_SIZE_W_SYNC; i++) {
-         pi_sync();  // prevents data becoming mismatched
+   handles->rx_spinner.start();
+   handles->tx_spinner.start();
+   handles->relay_spinner.start();
+}
+
+
+/**
+ * @brief Opens the flight recorder if ~record_path is set. Both streams are
+ * recorded under the topics that they are published and subscribed on, so a
+ * converted ring file can be used in place of a bag of those topics.
+ */
+void start_recorder(const ros::NodeHandle &private_nh) {
+   flight_recorder::RecorderConfig config;
+   int chunk_kb;
+   int chunks;
+
+   private_nh.param<std::string>("record_path", config.path, "");
+   private_nh.param("record_chunk_kb", chunk_kb, 1024);
+   private_nh.param("record_chunks", chunks, 64);
+   private_nh.param("record_sync_period", config.sync_period, 1.0);
+   private_nh.param("record_uart", record_uart, false);
+   config.chunk_size = chunk_kb * 1024;
+   config.num_chunks = chunks;
+
+   if (config.path.empty() || !recorder.open(config)) {
+      record_uart = false;
+      return;
+   }
+   sensor_stream = recorder.add_stream<semi_truck::Teensy_Sensors>(
+    private_nh.resolveName("teensy_sensor_data"));
+   actuator_stream = recorder.add_stream<semi_truck::Teensy_Actuators>(
+    private_nh.resolveName("teensy_actuator_data"));
+   if (record_uart) {
+      uart_rx_stream = recorder.add_stream<semi_truck::Uart_Bytes>(
+       private_nh.resolveName("uart_rx"));
+      uart_tx_stream = recorder.add_stream<semi_truck::Uart_Bytes>(
+       private_nh.resolveName("uart_tx"));
+   }
+}
 
-         // don't want to read any sensor data unless there is a full set
-         waiting_bytes = serialDataAvail(serial);
-         if (waiting_bytes >= SENSOR_DATA_SIZE) {
-            read_from_teensy(serial, sensor_data);
+
+/**
+ * @brief Stops the spinner threads, closes the flight recorder and releases
+ * the UART.
+ */
+void pi_comm_stop() {
+   if (handles) {
+      handles->rx_spinner.stop();
+      handles->tx_spinner.stop();
+      handles->relay_spinner.stop();
+      handles.reset();
+      recorder.close();
+      serialClose(serial);
+   }
+}
+
+
+/**
+ * @brief The callback for the RX timer on wall time, see rx_poll().
+ */
+void rx_cb(const ros::WallTimerEvent &event) {
+   rx_poll();
+}
+
+
+/**
+ * @brief The callback for the RX timer on simulated time, see rx_poll().
+ */
+void rx_sim_cb(const ros::TimerEvent &event) {
+   rx_poll();
+}
+
+
+/**
+ * @brief Runs on every tick of the RX timer. It reads every full set of
+ * sensor values waiting from the Teensy, publishes the latest one and
+ * reports on the health of the UART link in both directions.
+ */
+void rx_poll() {
+   short waiting_bytes;
+   bool received = false;
+
+   // reads the number of full sets of sensor values coming from the teensy
+   waiting_bytes = serialDataAvail(serial);
+   for (int i = 0; i < waiting_bytes/SENSOR_FRAME_SIZE; i++) {
+      pi_sync();  // prevents data becoming mismatched
+
+      // don't want to read any sensor data unless there is a full set
+      waiting_bytes = serialDataAvail(serial);
+      if (waiting_bytes >= SENSOR_DATA_SIZE) {
+         read_from_teensy(serial, sensor_data);
+         received = true;
+         last_rx_time = ros::WallTime::now();
+         publish_odom(sensor_data, ros::Time::now());
+         if (recorder.is_open()) {
+            recorder.record(sensor_stream, ros::Time::now(), sensor_data);
          }
+      }
+
+      print_sensors(sensor_data);
+   }
+
+   // every byte read in this poll, including any skipped by pi_sync()
+   if (record_uart && !uart_rx_bytes.data.empty()) {
+      recorder.record(uart_rx_stream, ros::Time::now(), uart_rx_bytes);
+      uart_rx_bytes.data.clear();
+   }
+
+   // only data that was just read is published, so that subscribers can
+   // take the time a message arrives as the time of the data, and see the
+   // data age when the Teensy goes silent. A new message per publish, so
+   // that nodelets in the same process can keep the published pointer
+   // instead of getting a copy
+   if (received) {
+      sensor_publisher.publish(semi_truck::Teensy_SensorsPtr(
+       new semi_truck::Teensy_Sensors(sensor_data)));
+   }
 
-         print_sensors(sensor_data);
+   diagnostic_msgs::DiagnosticStatus status = link_status(sensor_data,
+    (ros::WallTime::now() - last_rx_time).toSec());
+   if (status.level != last_level ||
+       (ros::WallTime::now() - last_diagnostic_time).toSec() >=
+       DIAGNOSTIC_PERIOD) {
+      diagnostic_msgs::DiagnosticArray diagnostics;
+      diagnostics.header.stamp = ros::Time::now();
+      diagnostics.status.push_back(status);
+      if (recorder.is_open()) {
+         diagnostics.status.push_back(recorder_status());
       }
+      diagnostic_publisher.publish(diagnostics);
+      last_diagnostic_time = ros::WallTime::now();
+      last_level = status.level;
+      tx_latency_max_us = 0;
+   }
+}
 
-	   publisher.publish(sensor_data);
 
-      // toggles the relay by setting the connected output pins to the relay
-      digitalWrite(RELAY_PIN_1, sensor_data.drive_mode);
-      digitalWrite(RELAY_PIN_2, !sensor_data.drive_mode);
-      
-      ros::spinOnce();
-      loop_rate.sleep();
+/**
+ * @brief Publishes the motion of the truck from a set of sensor data that was
+ * just read: forward speed in m/s and yaw rate in rad/s, counterclockwise.
+ * The IMU heading runs clockwise in whole degrees, so the yaw rate is the
+ * change in heading across the window rather than from the last reading.
+ *
+ * @param sensors the sensor data that was read
+ * @param stamp when it was read
+ */
+void publish_odom(const semi_truck::Teensy_Sensors &sensors,
+                  const ros::Time &stamp) {
+   double yaw_rate = 0;
+
+   headings.push_back(std::make_pair(stamp, sensors.imu_angle));
+   while (headings.size() > 2 &&
+          (stamp - headings[1].first).toSec() >= yaw_rate_window) {
+      headings.pop_front();
+   }
+
+   double span = (stamp - headings.front().first).toSec();
+   if (span > 0) {
+      int change = (sensors.imu_angle - headings.front().second) % 360;
+
+      // the shorter way around
+      if (change > 180) {
+         change -= 360;
+      }
+      else if (change < -180) {
+         change += 360;
+      }
+      yaw_rate = -change * M_PI / 180.0 / span;
+   }
+
+   if (odom_publisher.getNumSubscribers() == 0) {
+      return;
+   }
+
+   geometry_msgs::TwistStampedPtr twist(new geometry_msgs::TwistStamped);
+   twist->header.stamp = stamp;
+   twist->header.frame_id = "base_link";
+   twist->twist.linear.x =
+    sensors.wheel_speed * meters_per_tick / wheel_speed_period;
+   twist->twist.angular.z = yaw_rate;
+   odom_publisher.publish(twist);
+}
+
+
+/**
+ * @brief The callback for the relay subscription. It toggles the relay
+ * between automatic and manual by setting the connected output pins, but
+ * only when the drive mode reported by the Teensy changes.
+ *
+ * @param msg The sensor data that this node has just published
+ */
+void relay_cb(const semi_truck::Teensy_Sensors &msg) {
+   static int drive_mode = -1;
+
+   if (msg.drive_mode != drive_mode) {
+      drive_mode = msg.drive_mode;
+      digitalWrite(RELAY_PIN_1, drive_mode);
+      digitalWrite(RELAY_PIN_2, !drive_mode);
+      ROS_INFO("drive mode changed to %i", drive_mode);
    }
 }
 
 /**
  * @brief Called before reading sensor data from the Teensy. It will read the
- * buffer until it encounters the SYNC_VALUE that has been defined. Once
+ * buffer until it encounters the CMD_FRAME_SYNC that has been defined. Once
  * this happens, the next set of bytes are the set of sensor values.
  */
 void pi_sync() {
    int16_t data;
    int16_t avail;
 
-   while ((data = read_sensor_msg(serial, 2)) != SYNC_VALUE){
+   while ((data = read_sensor_msg(serial, 2)) != CMD_FRAME_SYNC){
       printf("error\n");
    }
 }
@@ -117,6 +453,9 @@ short read_sensor_msg(int serial, char num_bytes) {
 
    for (char i = 0; i < num_bytes; i++) {
       byte = serialGetchar(serial);
+      if (record_uart) {
+         uart_rx_bytes.data.push_back(byte);
+      }
       byte <<= 8*i; 
       sensor_msg |= byte;
    }
@@ -139,6 +478,10 @@ void read_from_teensy(int serial, semi_truck::Teensy_Sensors &sensors) {
    sensors.right_TOF = read_sensor_msg(serial, SHORT_SIZE);
    sensors.left_TOF = read_sensor_msg(serial, SHORT_SIZE);
    sensors.rear_TOF = read_sensor_msg(serial, SHORT_SIZE);
+   sensors.cmd_latency_us = read_sensor_msg(serial, SHORT_SIZE);
+   sensors.rx_seq = read_sensor_msg(serial, SHORT_SIZE);
+   sensors.link_state = read_sensor_msg(serial, SHORT_SIZE);
+   sensors.link_reaction_ms = read_sensor_msg(serial, SHORT_SIZE);
    sensors.drive_mode = read_sensor_msg(serial, SHORT_SIZE);
 }
 
@@ -154,6 +497,9 @@ void write_actuator_msg(int serial, short actuator_val, char num_bytes) {
    char *byte_ptr = (char*)&actuator_val;
 
    for (char i = 0; i < num_bytes; i++) {
+      if (record_uart) {
+         uart_tx_bytes.data.push_back(*byte_ptr);
+      }
       serialPutchar(serial, *byte_ptr++); // write 1 byte for each byte in val
    }
 }
@@ -166,10 +512,122 @@ void write_actuator_msg(int serial, short actuator_val, char num_bytes) {
  * @param actuators The object that holds all of the actuator data
  */
 void write_to_teensy(int serial, const semi_truck::Teensy_Actuators &actuators) {
-   write_actuator_msg(serial, SYNC_VALUE, SHORT_SIZE);
+   write_actuator_msg(serial, CMD_FRAME_SYNC, SHORT_SIZE);
    write_actuator_msg(serial, actuators.motor_output, SHORT_SIZE);
    write_actuator_msg(serial, actuators.steer_output, SHORT_SIZE);
    write_actuator_msg(serial, actuators.fifth_output, SHORT_SIZE);
+   write_actuator_msg(serial, actuators.motor_mode, SHORT_SIZE);
+   write_actuator_msg(serial, tx_seq++, SHORT_SIZE);
+}
+
+
+/**
+ * @brief Builds a diagnostic status for the UART link to the Teensy. The
+ * link is an error if the Teensy has gone silent or has fallen back to
+ * braking because it stopped receiving actuator data, and a warning while it
+ * is holding or coasting on old actuator data.
+ *
+ * @param sensors the last set of sensor data read from the Teensy
+ * @param silence seconds since the last full set of sensor data was read
+ * @return the status to publish on /diagnostics
+ */
+diagnostic_msgs::DiagnosticStatus link_status(
+ const semi_truck::Teensy_Sensors &sensors, double silence) {
+   diagnostic_msgs::DiagnosticStatus status;
+   diagnostic_msgs::KeyValue value;
+
+   status.name = "pi_comm_node: Teensy link";
+   status.hardware_id = UART;
+
+   if (silence > TEENSY_TIMEOUT) {
+      status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      status.message = "Teensy silent";
+   }
+   else if (sensors.link_state == LINK_BRAKE) {
+      status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      status.message = "Teensy braking, no actuator data";
+   }
+   else if (sensors.link_state != LINK_OK) {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Teensy holding old actuator data";
+   }
+   else {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "OK";
+   }
+
+   value.key = "seconds since sensor data";
+   value.value = std::to_string(silence);
+   status.values.push_back(value);
+   value.key = "actuator seq sent";
+   value.value = std::to_string((uint16_t)(tx_seq - 1));
+   status.values.push_back(value);
+   value.key = "actuator seq received by Teensy";
+   value.value = std::to_string(sensors.rx_seq);
+   status.values.push_back(value);
+   value.key = "Teensy link state";
+   value.value = std::to_string(sensors.link_state);
+   status.values.push_back(value);
+   value.key = "last loss to brake (ms)";
+   value.value = std::to_string(sensors.link_reaction_ms);
+   status.values.push_back(value);
+   value.key = "command latency (us)";
+   value.value = std::to_string(sensors.cmd_latency_us);
+   status.values.push_back(value);
+   value.key = "topic to UART latency (us)";
+   value.value = std::to_string(tx_latency_us);
+   status.values.push_back(value);
+   value.key = "max topic to UART latency (us)";
+   value.value = std::to_string(tx_latency_max_us);
+   status.values.push_back(value);
+
+   return status;
+}
+
+
+/**
+ * @brief Builds a diagnostic status for the flight recorder. It is a warning
+ * if records were dropped, which only happens to records larger than a
+ * chunk.
+ *
+ * @return the status to publish on /diagnostics
+ */
+diagnostic_msgs::DiagnosticStatus recorder_status() {
+   flight_recorder::RecorderStats stats = recorder.stats();
+   diagnostic_msgs::DiagnosticStatus status;
+   diagnostic_msgs::KeyValue value;
+
+   status.name = "pi_comm_node: flight recorder";
+   if (stats.dropped > 0) {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "records dropped";
+   }
+   else {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "OK";
+   }
+
+   value.key = "records";
+   value.value = std::to_string(stats.records);
+   status.values.push_back(value);
+   value.key = "bytes";
+   value.value = std::to_string(stats.bytes);
+   status.values.push_back(value);
+   value.key = "dropped";
+   value.value = std::to_string(stats.dropped);
+   status.values.push_back(value);
+   value.key = "chunks";
+   value.value = std::to_string(stats.chunks);
+   status.values.push_back(value);
+   value.key = "mean record time (ns)";
+   value.value = std::to_string(stats.records > 0 ?
+                                stats.record_ns / stats.records : 0);
+   status.values.push_back(value);
+   value.key = "max sync time (us)";
+   value.value = std::to_string(stats.sync_us_max);
+   status.values.push_back(value);
+
+   return status;
 }
 
 
@@ -185,6 +643,9 @@ void print_sensors(const semi_truck::Teensy_Sensors &sensors) {
    ROS_INFO("right_TOF:\t [%i]", sensors.right_TOF);
    ROS_INFO("left_TOF:\t [%i]", sensors.left_TOF);
    ROS_INFO("rear_TOF:\t [%i]", sensors.rear_TOF);
+   ROS_INFO("cmd latency:\t [%u us]", sensors.cmd_latency_us);
+   ROS_INFO("rx seq:\t [%u]", sensors.rx_seq);
+   ROS_INFO("link state:\t [%i]", sensors.link_state);
    ROS_INFO("drive_mode:\t [%i]", sensors.drive_mode);
 }
 
@@ -197,20 +658,35 @@ void print_sensors(const semi_truck::Teensy_Sensors &sensors) {
 void print_actuators(const semi_truck::Teensy_Actuators &actuators) {
    ROS_INFO("motor output:\t [%i]", actuators.motor_output);
    ROS_INFO("steer output:\t [%hu]", actuators.steer_output);
-   ROS_INFO("fifth output:\t [%hu]\n", actuators.fifth_output);
+   ROS_INFO("fifth output:\t [%hu]", actuators.fifth_output);
+   ROS_INFO("motor mode:\t [%i]\n", actuators.motor_mode);
 }
 
 
 /**
  * @brief The callback function the the subscriber to the teensy_actuator_data
- * topic. This function will run every time ROS::spinOnce is called. It reads
- * the set of data from the topic and immediately writes these values to the
- * Teensy via UART.
+ * topic. It runs on its own callback queue and spinner thread, so it is
+ * called as soon as a message arrives. It reads the set of data from the
+ * topic and immediately writes these values to the Teensy via UART, and
+ * records how long the message took from arriving to being written.
  *
- * @param msg A set of actuator data that has come from the actuator topic
- * and needs to be written to the Teensy.
+ * @param event A set of actuator data that has come from the actuator topic
+ * and needs to be written to the Teensy, along with its receipt time.
  */
-void actuator_cb(const semi_truck::Teensy_Actuators &msg) {
+void actuator_cb(
+ const ros::MessageEvent<semi_truck::Teensy_Actuators const> &event) {
+   const semi_truck::Teensy_Actuators &msg = *event.getMessage();
+   ros::WallTime received = ros::WallTime::now();
+   uint32_t latency_us;
+
+   // the receipt time is on the ROS clock, which only matches wall time
+   // without /use_sim_time; on a simulated clock the time the message
+   // waited in the queue is not known, and only the write is measured
+   if (!ros::Time::isSimTime()) {
+      received = ros::WallTime(event.getReceiptTime().sec,
+                               event.getReceiptTime().nsec);
+   }
+
    #ifdef DEBUG
    ROS_INFO("Got Actuator Message!");
    print_actuators(msg);
@@ -218,4 +694,17 @@ void actuator_cb(const semi_truck::Teensy_Actuators &msg) {
    printf("Time: %lf\n", ros::WallTime::now().toSec());
    #endif
    write_to_teensy(serial, msg);
+   if (recorder.is_open()) {
+      recorder.record(actuator_stream, event.getReceiptTime(), msg);
+   }
+   if (record_uart) {
+      recorder.record(uart_tx_stream, ros::Time::now(), uart_tx_bytes);
+      uart_tx_bytes.data.clear();
+   }
+
+   latency_us = (ros::WallTime::now() - received).toNSec() / 1000;
+   tx_latency_us = latency_us;
+   if (latency_us > tx_latency_max_us) {
+      tx_latency_max_us = latency_us;
+   }
 }
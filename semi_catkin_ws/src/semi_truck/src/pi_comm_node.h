@@ -3,7 +3,19 @@
 
 #include "semi_truck/Teensy_Sensors.h"
 #include "semi_truck/Teensy_Actuators.h"
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <ros/ros.h>
 
+// in hz; should match with simulation rate control block of simulink model.
+// uart_replay steps the clock by the same period
+#define LOOP_FREQUENCY 20
+
+// Starting and stopping the UART bridge
+void pi_comm_start(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh);
+
+void pi_comm_stop();
+
+void start_recorder(const ros::NodeHandle &private_nh);
 
 // Functions for serial communication over UART
 short read_sensor_msg(int serial, char num_bytes);
@@ -18,12 +30,27 @@ void update_sensors(semi_truck::Teensy_Sensors &sensors);
 
 void pi_sync();
 
+diagnostic_msgs::DiagnosticStatus link_status(
+ const semi_truck::Teensy_Sensors &sensors, double silence);
+
+diagnostic_msgs::DiagnosticStatus recorder_status();
+
 void print_sensors(const semi_truck::Teensy_Sensors &sensors);
 
 void print_actuators(const semi_truck::Teensy_Actuators &actuators);
 
-void sensor_cb(const semi_truck::Teensy_Sensors &msg);
+void rx_poll();
+
+void rx_cb(const ros::WallTimerEvent &event);
+
+void rx_sim_cb(const ros::TimerEvent &event);
+
+void relay_cb(const semi_truck::Teensy_Sensors &msg);
+
+void publish_odom(const semi_truck::Teensy_Sensors &sensors,
+                  const ros::Time &stamp);
 
-void actuator_cb(const semi_truck::Teensy_Actuators &msg);
+void actuator_cb(
+ const ros::MessageEvent<semi_truck::Teensy_Actuators const> &event);
 
 #endif
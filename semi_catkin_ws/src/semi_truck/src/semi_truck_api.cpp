@@ -1,9 +1,15 @@
 #include "semi_truck_api.h"
 
 void set_motor_output(semi_truck::Teensy_Actuators &actuators, int16_t motor_output){
+   actuators.motor_mode = semi_truck::Teensy_Actuators::MOTOR_MODE_THROTTLE;
    actuators.motor_output = motor_output;
 }
 
+void set_speed_setpoint(semi_truck::Teensy_Actuators &actuators, int16_t speed) {
+   actuators.motor_mode = semi_truck::Teensy_Actuators::MOTOR_MODE_SPEED;
+   actuators.motor_output = speed;
+}
+
 void set_steer_output(semi_truck::Teensy_Actuators &actuators, int16_t steer_output) {
    actuators.steer_output = steer_output;
 }
@@ -32,3 +38,71 @@ int16_t get_rear_TOF(semi_truck::Teensy_Sensors &sensors) {
    return sensors.rear_TOF;
 }
 
+/**
+ * @brief applies one of the message setters to the command in the store. Only
+ * the algorithm writes the command, so reading it back and storing the
+ * modified copy does not race with another writer.
+ */
+template <typename Value>
+static void update_actuators(TruckState &state,
+                             void (*setter)(semi_truck::Teensy_Actuators &, Value),
+                             Value value) {
+   semi_truck::Teensy_Actuators actuators;
+
+   state.actuators(&actuators);
+   setter(actuators, value);
+   state.update_actuators(actuators);
+}
+
+void set_motor_output(TruckState &state, int16_t motor_output) {
+   update_actuators<int16_t>(state, set_motor_output, motor_output);
+}
+
+void set_speed_setpoint(TruckState &state, int16_t speed) {
+   update_actuators<int16_t>(state, set_speed_setpoint, speed);
+}
+
+void set_steer_output(TruckState &state, int16_t steer_output) {
+   update_actuators<int16_t>(state, set_steer_output, steer_output);
+}
+
+void set_fifth_output(TruckState &state, uint16_t fifth_output) {
+   update_actuators<uint16_t>(state, set_fifth_output, fifth_output);
+}
+
+int16_t get_wheel_speed(const TruckSnapshot &snapshot) {
+   return snapshot.teensy.wheel_speed;
+}
+
+int16_t get_imu_angle(const TruckSnapshot &snapshot) {
+   return snapshot.teensy.imu_angle;
+}
+
+int16_t get_right_TOF(const TruckSnapshot &snapshot) {
+   return snapshot.teensy.right_TOF;
+}
+
+int16_t get_left_TOF(const TruckSnapshot &snapshot) {
+   return snapshot.teensy.left_TOF;
+}
+
+int16_t get_rear_TOF(const TruckSnapshot &snapshot) {
+   return snapshot.teensy.rear_TOF;
+}
+
+float get_lidar_lite_range(const TruckSnapshot &snapshot) {
+   return snapshot.lidar_lite.range;
+}
+
+float get_rplidar_range(const TruckSnapshot &snapshot, int degrees) {
+   int bin = degrees % RplidarState::NUM_BINS;
+
+   if (bin < 0) {
+      bin += RplidarState::NUM_BINS;
+   }
+   return snapshot.rplidar.range[bin];
+}
+
+const ObstacleFrame &get_obstacles(const TruckSnapshot &snapshot) {
+   return snapshot.obstacles;
+}
@@ -1,17 +1,23 @@
 /**
  * @file This is the application layer for interfacing with the semi_truck
- * platform. There are three 'setter' functions for setting values to output to
+ * platform. There are four 'setter' functions for setting values to output to
  * the actuators hooked up to the system. There are also five 'getter'
  * functions that read data from sensors hooked up to the system. These
  * functions are designed to be called in the autonomous algorithms
  * implemented in a ROS node file.
+ *
+ * Every function exists twice: once for the raw messages, and once on top of
+ * the TruckState store, where the setters update the shared actuator command
+ * and the getters read from a TruckSnapshot so that all values an algorithm
+ * uses in one step come from the same instant.
  */
 
 #ifndef DAIMTRONICS_SEMI_TRUCK_API_H
 #define DAIMTRONICS_SEMI_TRUCK_API_H
 
-#include "../include/Teensy_Actuators.h"
-#include "../include/Teensy_Sensors.h"
+#include "semi_truck/Teensy_Actuators.h"
+#include "semi_truck/Teensy_Sensors.h"
+#include "truck_state.h"
 
 /**
  * @brief sets the motor output of the actuators object to the passed in value
@@ -21,6 +27,16 @@
  */
 void set_motor_output(semi_truck::Teensy_Actuators &actuators, int16_t value);
 
+/**
+ * @brief puts the motor of the actuators object in closed-loop speed mode,
+ * where the Teensy runs a PID controller to hold the wheel speed at the
+ * passed in value instead of applying a raw throttle.
+ * @param actuators a reference to a TeensyActuators object to alter
+ * @param value the wheel speed setpoint, in the same units as
+ * get_wheel_speed().
+ */
+void set_speed_setpoint(semi_truck::Teensy_Actuators &actuators, int16_t value);
+
 /**
  * @brief sets the steer output of the actuators object to the passed in value
  * @param actuators a reference to a TeensyActuators object to alter
@@ -67,5 +83,48 @@ int16_t get_left_TOF(semi_truck::Teensy_Sensors &sensors);
  */
 int16_t get_rear_TOF(semi_truck::Teensy_Sensors &sensors);
 
+/* The same setters on the shared actuator command of a TruckState. */
+
+void set_motor_output(TruckState &state, int16_t value);
+
+void set_speed_setpoint(TruckState &state, int16_t value);
+
+void set_steer_output(TruckState &state, int16_t value);
+
+void set_fifth_output(TruckState &state, uint16_t value);
+
+/* The same getters on a snapshot of a TruckState. */
+
+int16_t get_wheel_speed(const TruckSnapshot &snapshot);
+
+int16_t get_imu_angle(const TruckSnapshot &snapshot);
+
+int16_t get_right_TOF(const TruckSnapshot &snapshot);
+
+int16_t get_left_TOF(const TruckSnapshot &snapshot);
+
+int16_t get_rear_TOF(const TruckSnapshot &snapshot);
+
+/**
+ * @brief reads the LIDAR-Lite distance (m) of a snapshot
+ * @param snapshot a snapshot taken with TruckState::snapshot()
+ */
+float get_lidar_lite_range(const TruckSnapshot &snapshot);
+
+/**
+ * @brief reads the closest RPLIDAR return (m) within a whole degree of a
+ * snapshot. Returns infinity if there was no return at that angle.
+ * @param snapshot a snapshot taken with TruckState::snapshot()
+ * @param degrees the angle of the scan, wrapped to 0 to 359
+ */
+float get_rplidar_range(const TruckSnapshot &snapshot, int degrees);
+
+/**
+ * @brief reads the ranges (m) of every range sensor around the truck, all
+ * aligned to the start of the control cycle, see obstacle_fusion.h
+ * @param snapshot a snapshot handed to ControlExecutor::compute()
+ */
+const ObstacleFrame &get_obstacles(const TruckSnapshot &snapshot);
+
 
 #endif //DAIMTRONICS_SEMI_TRUCK_API_H
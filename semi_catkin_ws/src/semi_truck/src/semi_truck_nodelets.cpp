@@ -0,0 +1,63 @@
+/**
+ * @file Nodelet versions of pi_comm_node and truck_template_node. Loaded into
+ * the same nodelet manager as the RPLIDAR nodelet, the scans, sensor data and
+ * actuator commands are passed between them as shared pointers instead of
+ * being serialized over TCP. See launch/semi_truck_nodelets.launch.
+ */
+
+#include "pi_comm_node.h"
+#include "template_controller.h"
+
+#include <memory>
+#include <thread>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+namespace semi_truck {
+
+/**
+ * @brief Runs the Teensy UART bridge. The bridge has its own spinner
+ * threads, so the nodelet only starts and stops it.
+ */
+class PiCommNodelet : public nodelet::Nodelet {
+public:
+   ~PiCommNodelet() {
+      pi_comm_stop();
+   }
+
+private:
+   void onInit() override {
+      pi_comm_start(getNodeHandle(), getPrivateNodeHandle());
+   }
+};
+
+/**
+ * @brief Runs the template algorithm on its own thread, since
+ * ControlExecutor::run() does not return until it is stopped.
+ */
+class TemplateNodelet : public nodelet::Nodelet {
+public:
+   ~TemplateNodelet() {
+      if (controller_) {
+         controller_->stop();
+         thread_.join();
+      }
+   }
+
+private:
+   void onInit() override {
+      ros::NodeHandle &nh = getNodeHandle();
+
+      controller_.reset(new TemplateController(nh));
+      thread_ = std::thread(&TemplateController::run, controller_.get());
+   }
+
+   std::unique_ptr<TemplateController> controller_;
+   std::thread thread_;
+};
+
+} // namespace semi_truck
+
+PLUGINLIB_EXPORT_CLASS(semi_truck::PiCommNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(semi_truck::TemplateNodelet, nodelet::Nodelet)
@@ -0,0 +1,371 @@
+/**
+ * @file Reads out and controls the black box on the Teensy over its UART,
+ * and decodes the dumps into CSV. This does not need ROS, and pi_comm_node
+ * must be stopped before it uses the UART.
+ *
+ *    teensy_black_box dump [--force] PORT FILE [RECORDS]
+ *    teensy_black_box trigger PORT
+ *    teensy_black_box rearm PORT
+ *    teensy_black_box decimate PORT KIND N
+ *    teensy_black_box decode FILE
+ *
+ * A dump is written to FILE as the raw dump frames, the same as the
+ * BBOXnnn.BIN files that the Teensy writes to its SD card, so decode reads
+ * both. A full ring is 8192 records and takes about 80 s at 9600 baud;
+ * RECORDS dumps only the newest ones. For as long as the dump runs the
+ * Teensy sends dump frames in place of its sensor frames and the black box
+ * logs nothing. So that this never happens while the truck is driven, dump
+ * refuses to start while the Teensy reports commands coming in, unless
+ * --force is given.
+ */
+
+#include "bbox_frame.h"
+#include "teensy_protocol.h"
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#define UART "/dev/ttyS0"
+#define BAUDRATE B9600
+
+// seconds without a dump frame before a dump is given up
+#define DUMP_TIMEOUT 3.0
+// seconds of sensor frames looked at for a live command stream
+#define LINK_CHECK_S (3 * LINK_HOLD_MS / 1000.0)
+
+static const char *kind_names[] = {
+   "hall", "rc", "imu", "tof", "wheel_speed", "motor", "steer", "command",
+   "link", "deadman", "trigger"
+};
+static_assert(sizeof(kind_names) / sizeof(kind_names[0]) == BBOX_NUM_KINDS,
+              "a kind of record in teensy_protocol.h has no name");
+
+static const char *trigger_names[] = {
+   "none", "deadman", "link", "imu", "pi"
+};
+
+static int16_t get_int16(const uint8_t *bytes) {
+   return (int16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static void put_int16(uint8_t *bytes, int16_t value) {
+   bytes[0] = (uint16_t)value & 0xff;
+   bytes[1] = (uint16_t)value >> 8;
+}
+
+static double now_s() {
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Opens the UART in raw mode at the rate the Teensy uses.
+ */
+static int open_uart(const char *port) {
+   struct termios options;
+   int fd = open(port, O_RDWR | O_NOCTTY);
+
+   if (fd < 0 || tcgetattr(fd, &options) < 0) {
+      fprintf(stderr, "cannot open %s: %s\n", port, strerror(errno));
+      exit(1);
+   }
+   cfmakeraw(&options);
+   cfsetispeed(&options, BAUDRATE);
+   cfsetospeed(&options, BAUDRATE);
+   options.c_cc[VMIN] = 0;
+   options.c_cc[VTIME] = 1; // reads return after 0.1 s without data
+   tcsetattr(fd, TCSANOW, &options);
+   tcflush(fd, TCIOFLUSH);
+   return fd;
+}
+
+/**
+ * @brief Sends a request frame: the request sync and 5 words, the same
+ * length as a command frame.
+ */
+static void send_request(int fd, uint16_t code, uint16_t arg0,
+                         uint16_t arg1) {
+   uint8_t bytes[CMD_FRAME_SIZE_W_SYNC] = {0};
+
+   put_int16(bytes, CMD_FRAME_REQUEST_SYNC);
+   put_int16(bytes + 2, code);
+   put_int16(bytes + 4, arg0);
+   put_int16(bytes + 6, arg1);
+   if (write(fd, bytes, sizeof(bytes)) != sizeof(bytes)) {
+      fprintf(stderr, "cannot write the request: %s\n", strerror(errno));
+      exit(1);
+   }
+   tcdrain(fd);
+}
+
+/**
+ * @brief Listens to the sensor frames for LINK_CHECK_S and tells whether
+ * any of them has the link to the Pi as LINK_OK or LINK_HOLD, i.e. something
+ * else is sending the Teensy commands.
+ */
+static bool commands_live(int fd) {
+   std::vector<uint8_t> buffer;
+   uint8_t bytes[256];
+   double start_s = now_s();
+
+   while (now_s() - start_s < LINK_CHECK_S) {
+      ssize_t received = read(fd, bytes, sizeof(bytes));
+      size_t i = 0;
+
+      if (received > 0) {
+         buffer.insert(buffer.end(), bytes, bytes + received);
+      }
+      for (; i + SENSOR_FRAME_SIZE <= buffer.size(); i++) {
+         int16_t link_state;
+
+         if (get_int16(&buffer[i]) != CMD_FRAME_SYNC) {
+            continue;
+         }
+         link_state = get_int16(&buffer[i + SENSOR_FRAME_LINK_STATE]);
+         if (link_state == LINK_OK || link_state == LINK_HOLD) {
+            return true;
+         }
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + i);
+   }
+   return false;
+}
+
+/**
+ * @brief Asks for a dump and writes the frames to a file as they come in,
+ * until all of them are in or the Teensy goes quiet.
+ */
+static int dump(int fd, const char *path, uint16_t max_records) {
+   std::vector<uint8_t> buffer;
+   uint8_t bytes[256];
+   FILE *file;
+   bbox_dump_header_t header;
+   bool have_header = false;
+   uint32_t frames = 0;
+   uint32_t expected = 1;
+   double last_frame_s;
+
+   file = fopen(path, "wb");
+   if (file == NULL) {
+      fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+      return 1;
+   }
+
+   send_request(fd, BBOX_REQ_DUMP, max_records, 0);
+   last_frame_s = now_s();
+
+   while (frames < expected && now_s() - last_frame_s < DUMP_TIMEOUT) {
+      ssize_t received = read(fd, bytes, sizeof(bytes));
+      bbox_frame_t frame;
+      size_t used;
+
+      if (received > 0) {
+         buffer.insert(buffer.end(), bytes, bytes + received);
+      }
+
+      while (true) {
+         bool found = bbox_next_frame(buffer.data(), buffer.size(), &frame,
+                                      &used);
+
+         if (found) {
+            size_t frame_size = BBOX_FRAME_HEADER_SIZE + frame.size + 2;
+
+            if (frame.index == 0 && frame.size == sizeof(header)) {
+               memcpy(&header, frame.payload, sizeof(header));
+               have_header = true;
+               expected = 1 + (header.records + BBOX_DUMP_RECORDS - 1) /
+                          BBOX_DUMP_RECORDS;
+            }
+            fwrite(buffer.data() + used - frame_size, 1, frame_size, file);
+            frames++;
+            last_frame_s = now_s();
+            if (have_header && frames % 100 == 0) {
+               fprintf(stderr, "\r%u / %u frames", frames, expected);
+            }
+         }
+         buffer.erase(buffer.begin(), buffer.begin() + used);
+         if (!found) {
+            break;
+         }
+      }
+   }
+   fclose(file);
+
+   if (!have_header) {
+      fprintf(stderr, "no dump from the Teensy\n");
+      return 1;
+   }
+   fprintf(stderr, "\r%u / %u frames, %u records, trigger %s%s\n", frames,
+           expected, header.records,
+           header.trigger < sizeof(trigger_names) / sizeof(*trigger_names) ?
+           trigger_names[header.trigger] : "?",
+           header.frozen ? ", frozen" : "");
+   if (frames < expected) {
+      fprintf(stderr, "%u frames were lost, dump again to get them\n",
+              expected - frames);
+      return 1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Prints the records in a dump file as CSV, with times in ms relative
+ * to the trigger, or to the start of the dump if nothing triggered.
+ */
+static int decode(const char *path) {
+   std::vector<uint8_t> data;
+   uint8_t bytes[4096];
+   size_t offset = 0;
+   size_t used;
+   FILE *file;
+   bbox_frame_t frame;
+   bbox_dump_header_t header;
+   uint32_t zero_us = 0;
+   size_t count;
+
+   file = fopen(path, "rb");
+   if (file == NULL) {
+      fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+      return 1;
+   }
+   while ((count = fread(bytes, 1, sizeof(bytes), file)) > 0) {
+      data.insert(data.end(), bytes, bytes + count);
+   }
+   fclose(file);
+
+   while (bbox_next_frame(data.data() + offset, data.size() - offset,
+                          &frame, &used)) {
+      offset += used;
+
+      if (frame.index == 0) {
+         if (frame.size != sizeof(header)) {
+            fprintf(stderr, "unknown dump header\n");
+            return 1;
+         }
+         memcpy(&header, frame.payload, sizeof(header));
+         if (header.version != BBOX_DUMP_VERSION) {
+            fprintf(stderr, "dump version %u, expected %u\n", header.version,
+                    BBOX_DUMP_VERSION);
+            return 1;
+         }
+         zero_us = header.trigger != BBOX_TRIG_NONE ? header.trigger_us :
+                   header.now_us;
+         printf("# %u records, trigger %s, %s, %u lost\n", header.records,
+                header.trigger < sizeof(trigger_names) /
+                sizeof(*trigger_names) ? trigger_names[header.trigger] : "?",
+                header.frozen ? "frozen" : "not frozen", header.lost);
+         printf("# decimation");
+         for (int i = 0; i < BBOX_NUM_KINDS; i++) {
+            printf(" %s=%u", kind_names[i], header.decimation[i]);
+         }
+         printf("\ntime_ms,kind,channel,value\n");
+         continue;
+      }
+
+      for (int i = 0; i < frame.records; i++) {
+         bbox_record_t record;
+
+         memcpy(&record, frame.payload + i * sizeof(record), sizeof(record));
+         // the difference wraps with micros(), every 71 minutes
+         printf("%.3f,", (int32_t)(record.time_us - zero_us) / 1000.0);
+         if (record.kind < BBOX_NUM_KINDS) {
+            printf("%s,", kind_names[record.kind]);
+         }
+         else {
+            printf("%u,", record.kind);
+         }
+         if (record.kind == BBOX_IMU) {
+            printf("%u,%.4f\n", record.channel, record.value / 16.0);
+         }
+         else {
+            printf("%u,%d\n", record.channel, record.value);
+         }
+      }
+   }
+   return 0;
+}
+
+static int usage() {
+   fprintf(stderr,
+           "usage: teensy_black_box dump [--force] PORT FILE [RECORDS]\n"
+           "       teensy_black_box trigger PORT\n"
+           "       teensy_black_box rearm PORT\n"
+           "       teensy_black_box decimate PORT KIND N\n"
+           "       teensy_black_box decode FILE\n"
+           "PORT is the Teensy's UART, " UART " on the Pi\n");
+   return 2;
+}
+
+int main(int argc, char **argv) {
+   std::string command;
+   int fd;
+
+   if (argc < 3) {
+      return usage();
+   }
+   command = argv[1];
+
+   if (command == "decode") {
+      return argc == 3 ? decode(argv[2]) : usage();
+   }
+   else if (command == "dump") {
+      bool force = strcmp(argv[2], "--force") == 0;
+
+      if (force) {
+         argv++;
+         argc--;
+      }
+      if (argc < 4 || argc > 5) {
+         return usage();
+      }
+      fd = open_uart(argv[2]);
+      if (!force && commands_live(fd)) {
+         fprintf(stderr, "the Teensy is receiving commands, stop "
+                 "pi_comm_node first: a dump replaces the sensor frames and "
+                 "pauses the black box for up to 80 s (--force dumps "
+                 "anyway)\n");
+         return 1;
+      }
+      return dump(fd, argv[3], argc > 4 ? atoi(argv[4]) : 0);
+   }
+   else if (command == "trigger" || command == "rearm") {
+      if (argc != 3) {
+         return usage();
+      }
+      fd = open_uart(argv[2]);
+      send_request(fd, command == "trigger" ? BBOX_REQ_TRIGGER :
+                   BBOX_REQ_REARM, 0, 0);
+   }
+   else if (command == "decimate") {
+      int kind = 0;
+
+      if (argc != 5) {
+         return usage();
+      }
+      while (kind < BBOX_NUM_KINDS && strcmp(argv[3], kind_names[kind]) != 0) {
+         kind++;
+      }
+      if (kind == BBOX_NUM_KINDS) {
+         fprintf(stderr, "unknown kind %s\n", argv[3]);
+         return 2;
+      }
+      fd = open_uart(argv[2]);
+      send_request(fd, BBOX_REQ_DECIMATE, kind, atoi(argv[4]));
+   }
+   else {
+      return usage();
+   }
+
+   close(fd);
+   return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file This is a template file for writing autonomous algorithms in
+ * ROS. There are messages throughout this file that suggest how
+ * to add additional code.
+ *
+ * The algorithm runs inside a ControlExecutor, which subscribes to the
+ * sensors, calls compute() at a fixed rate with a snapshot of the latest
+ * sensor data and sends the resulting command to the Teensy. The same
+ * controller runs in the truck_template_node executable and in the
+ * TemplateNodelet.
+ */
+
+#ifndef DAIMTRONICS_TEMPLATE_CONTROLLER_H
+#define DAIMTRONICS_TEMPLATE_CONTROLLER_H
+
+#include "system_data.h"
+#include "semi_truck_api.h"
+#include "control_executor.h"
+
+#include <ros/ros.h>
+
+#define LOOP_FREQUENCY 50 // rate in Hz that the algorithm runs at
+
+class TemplateController : public ControlExecutor {
+public:
+   TemplateController(ros::NodeHandle &nh)
+         : ControlExecutor(nh, LOOP_FREQUENCY, ControlExecutor::SKIP_MISSED) {
+
+      /* ANY ADDITIONAL SUBSCRIBERS TO TOPICS SHOULD BE INITIALIZED HERE */
+
+      /* HOW THE RANGE SENSORS ARE ALIGNED INTO get_obstacles(snapshot) CAN
+       * BE CHANGED HERE WITH set_fusion_config() */
+   }
+
+protected:
+   void compute(const TruckSnapshot &snapshot,
+                semi_truck::Teensy_Actuators &command) override {
+
+      /* ALGORITHMS TO CONTROL VEHICLE SHOULD BE WRITTEN HERE, READING THE
+       * SENSORS FROM snapshot WITH THE get_* FUNCTIONS AND SETTING THE
+       * ACTUATORS IN command WITH THE set_* FUNCTIONS */
+   }
+
+   /* ANY ADDITIONAL SUBSCRIBER CALLBACKS SHOULD BE IMPLEMENTED HERE */
+};
+
+#endif //DAIMTRONICS_TEMPLATE_CONTROLLER_H
@@ -0,0 +1,275 @@
+#include "truck_sim.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#define TOF_OUT_OF_RANGE 8190 // what the VL53L0X reports without a target
+#define TOF_NOT_CONNECTED 0 // what the Teensy reports for a missing sensor
+#define STEER_CENTER 90 // steer output that keeps the wheels straight
+
+const SensorMount RIGHT_TOF_MOUNT = {false, 0.15, -0.095, -M_PI / 2};
+const SensorMount LEFT_TOF_MOUNT = {false, 0.15, 0.095, M_PI / 2};
+// at the back of the default trailer, see trailer_rear
+const SensorMount REAR_TOF_MOUNT = {true, -0.15, 0.0, M_PI};
+const SensorMount RPLIDAR_MOUNT = {false, 0.2, 0.0, 0.0};
+
+TruckParams default_truck_params() {
+   TruckParams params;
+
+   params.wheelbase = 0.32;
+   params.tractor_front = 0.45;
+   params.tractor_rear = 0.1;
+   params.hitch_offset = 0.02;
+   params.trailer_length = 0.6;
+   params.trailer_front = 0.1;
+   params.trailer_rear = 0.15;
+   params.width = 0.19;
+   params.max_steer = 20.0 * M_PI / 180.0;
+   params.max_articulation = 80.0 * M_PI / 180.0;
+   params.max_speed = 2.0;
+   params.speed_tau = 0.3;
+   params.coast_tau = 2.0;
+   params.brake_decel = 3.0;
+   params.couple_distance = 0.03;
+   params.ticks_per_meter = 500.0;
+   params.tof_max_range = 2.0;
+   return params;
+}
+
+bool SimMap::load(const std::string &path) {
+   std::ifstream file(path.c_str());
+   std::string line;
+
+   if (!file) {
+      return false;
+   }
+
+   while (std::getline(file, line)) {
+      std::istringstream words(line);
+      std::string first;
+      Segment segment;
+
+      if (!(words >> first) || first[0] == '#') {
+         continue;
+      }
+      words.clear();
+      words.seekg(0);
+      if (!(words >> segment.x1 >> segment.y1 >> segment.x2 >> segment.y2)) {
+         return false;
+      }
+      segments_.push_back(segment);
+   }
+   return true;
+}
+
+/**
+ * @brief Wraps an angle to [-pi, pi).
+ */
+static double wrap_angle(double angle) {
+   return angle - 2 * M_PI * std::floor((angle + M_PI) / (2 * M_PI));
+}
+
+/**
+ * @brief Returns the distance along a ray from (x, y) in direction (dx, dy),
+ * a unit vector, to a segment, or a negative value if the ray misses it.
+ */
+static double intersect(double x, double y, double dx, double dy,
+                        const Segment &segment) {
+   double sx = segment.x2 - segment.x1;
+   double sy = segment.y2 - segment.y1;
+   double denominator = dx * sy - dy * sx;
+   double ox = segment.x1 - x;
+   double oy = segment.y1 - y;
+   double t, u;
+
+   if (std::fabs(denominator) < 1e-12) {
+      return -1.0;
+   }
+   t = (ox * sy - oy * sx) / denominator;
+   u = (ox * dy - oy * dx) / denominator;
+   return (u >= 0.0 && u <= 1.0) ? t : -1.0;
+}
+
+/**
+ * @brief Shortens range to the closest segment that the ray hits.
+ */
+static void cast(const std::vector<Segment> &segments, double x, double y,
+                 double dx, double dy, double *range) {
+   for (size_t i = 0; i < segments.size(); i++) {
+      double t = intersect(x, y, dx, dy, segments[i]);
+      if (t >= 0.0 && t < *range) {
+         *range = t;
+      }
+   }
+}
+
+/**
+ * @brief Appends the outline of a rectangle that spans from rear to front
+ * along the heading and is centered across it.
+ */
+static void add_box(std::vector<Segment> *body, double x, double y,
+                    double heading, double front, double rear, double width) {
+   double c = std::cos(heading);
+   double s = std::sin(heading);
+   double half = width / 2;
+   double corners[4][2] = {{front, half}, {front, -half},
+                           {-rear, -half}, {-rear, half}};
+   double px[4], py[4];
+
+   for (int i = 0; i < 4; i++) {
+      px[i] = x + c * corners[i][0] - s * corners[i][1];
+      py[i] = y + s * corners[i][0] + c * corners[i][1];
+   }
+   for (int i = 0; i < 4; i++) {
+      Segment side = {px[i], py[i], px[(i + 1) % 4], py[(i + 1) % 4]};
+      body->push_back(side);
+   }
+}
+
+TruckSim::TruckSim(const TruckParams &params, const SimMap &map)
+      : params_(params), map_(map) {
+   reset(0.0, 0.0, 0.0, true);
+}
+
+void TruckSim::reset(double x, double y, double theta, bool coupled) {
+   x_ = x;
+   y_ = y;
+   theta_ = theta;
+   v_ = 0.0;
+   steer_ = 0.0;
+   ticks_ = 0.0;
+   trailer_theta_ = theta;
+   kingpin_x_ = x - params_.hitch_offset * std::cos(theta);
+   kingpin_y_ = y - params_.hitch_offset * std::sin(theta);
+   coupled_ = coupled;
+   update_bodies();
+}
+
+void TruckSim::step(double dt, DriveMode mode, double target_speed,
+                    int16_t steer_output, bool fifth_locked) {
+   double hitch_x, hitch_y, yaw_rate, articulation;
+
+   switch (mode) {
+      case DRIVE_POWER:
+         v_ += (target_speed - v_) * (1.0 - std::exp(-dt / params_.speed_tau));
+         break;
+      case DRIVE_COAST:
+         v_ -= v_ * (1.0 - std::exp(-dt / params_.coast_tau));
+         break;
+      case DRIVE_BRAKE:
+         if (std::fabs(v_) <= params_.brake_decel * dt) {
+            v_ = 0.0;
+         }
+         else {
+            v_ -= std::copysign(params_.brake_decel * dt, v_);
+         }
+         break;
+   }
+
+   // the Teensy has already slew limited the servo, so only map it
+   steer_ = (STEER_CENTER - steer_output) * params_.max_steer / STEER_CENTER;
+   yaw_rate = v_ * std::tan(steer_) / params_.wheelbase;
+
+   x_ += v_ * std::cos(theta_) * dt;
+   y_ += v_ * std::sin(theta_) * dt;
+   theta_ = wrap_angle(theta_ + yaw_rate * dt);
+   ticks_ += v_ * dt * params_.ticks_per_meter;
+
+   hitch_x = x_ - params_.hitch_offset * std::cos(theta_);
+   hitch_y = y_ - params_.hitch_offset * std::sin(theta_);
+
+   if (coupled_ && !fifth_locked && v_ > 0) {
+      coupled_ = false; // the tractor pulls out from under the trailer
+   }
+   else if (!coupled_ && fifth_locked &&
+            std::hypot(hitch_x - kingpin_x_, hitch_y - kingpin_y_) <=
+            params_.couple_distance &&
+            std::fabs(wrap_angle(theta_ - trailer_theta_)) <=
+            params_.max_articulation) {
+      coupled_ = true;
+   }
+
+   if (coupled_) {
+      articulation = wrap_angle(theta_ - trailer_theta_);
+      trailer_theta_ += (v_ * std::sin(articulation) -
+                         params_.hitch_offset * yaw_rate *
+                         std::cos(articulation)) /
+                        params_.trailer_length * dt;
+
+      // the trailer hits the tractor before it can fold any further
+      articulation = wrap_angle(theta_ - trailer_theta_);
+      if (articulation > params_.max_articulation) {
+         trailer_theta_ = theta_ - params_.max_articulation;
+      }
+      else if (articulation < -params_.max_articulation) {
+         trailer_theta_ = theta_ + params_.max_articulation;
+      }
+      trailer_theta_ = wrap_angle(trailer_theta_);
+      kingpin_x_ = hitch_x;
+      kingpin_y_ = hitch_y;
+   }
+
+   update_bodies();
+}
+
+void TruckSim::update_bodies() {
+   tractor_body_.clear();
+   add_box(&tractor_body_, x_, y_, theta_, params_.tractor_front,
+           params_.tractor_rear, params_.width);
+
+   trailer_body_.clear();
+   add_box(&trailer_body_, kingpin_x_, kingpin_y_, trailer_theta_,
+           params_.trailer_front,
+           params_.trailer_length + params_.trailer_rear, params_.width);
+}
+
+int16_t TruckSim::imu_angle() const {
+   int16_t degrees = (int16_t)std::lround(-theta_ * 180.0 / M_PI);
+
+   degrees %= 360;
+   return degrees < 0 ? degrees + 360 : degrees;
+}
+
+void TruckSim::mount_pose(const SensorMount &mount, double *x, double *y,
+                          double *angle) const {
+   double base_x = x_, base_y = y_, heading = theta_;
+
+   if (mount.on_trailer) {
+      heading = trailer_theta_;
+      base_x = kingpin_x_ - params_.trailer_length * std::cos(heading);
+      base_y = kingpin_y_ - params_.trailer_length * std::sin(heading);
+   }
+
+   *x = base_x + mount.x * std::cos(heading) - mount.y * std::sin(heading);
+   *y = base_y + mount.x * std::sin(heading) + mount.y * std::cos(heading);
+   *angle = heading + mount.angle;
+}
+
+double TruckSim::range(const SensorMount &mount, double angle,
+                       double max_range) const {
+   double x, y, heading;
+   double range = max_range;
+
+   mount_pose(mount, &x, &y, &heading);
+   heading += angle;
+
+   cast(map_.segments(), x, y, std::cos(heading), std::sin(heading), &range);
+   cast(mount.on_trailer ? tractor_body_ : trailer_body_, x, y,
+        std::cos(heading), std::sin(heading), &range);
+   return range;
+}
+
+int16_t TruckSim::tof_mm(const SensorMount &mount) const {
+   double range;
+
+   if (mount.on_trailer && !coupled_) {
+      return TOF_NOT_CONNECTED;
+   }
+
+   range = this->range(mount, 0.0, params_.tof_max_range);
+   if (range >= params_.tof_max_range) {
+      return TOF_OUT_OF_RANGE;
+   }
+   return (int16_t)std::lround(range * 1000.0);
+}
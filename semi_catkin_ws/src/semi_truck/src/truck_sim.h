@@ -0,0 +1,190 @@
+/**
+ * @file The vehicle model of the simulator: a kinematic tractor with
+ * Ackermann steering, a trailer that rides on the fifth wheel and a 2D map of
+ * walls that the sensors see. Everything is in meters, seconds and radians,
+ * in a map frame whose angles are counterclockwise from the x axis. The
+ * sensors produce the same raw values that the Teensy reads from the real
+ * ones, so truck_sim_node only has to put them into frames.
+ */
+
+#ifndef DAIMTRONICS_TRUCK_SIM_H
+#define DAIMTRONICS_TRUCK_SIM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A wall from (x1, y1) to (x2, y2).
+ */
+struct Segment {
+   double x1, y1, x2, y2;
+};
+
+/**
+ * @brief The walls of the simulated world. A map file holds one segment per
+ * line as "x1 y1 x2 y2" in meters; blank lines and lines starting with #
+ * are skipped.
+ */
+class SimMap {
+public:
+   /**
+    * @brief Adds the segments in a map file.
+    * @return false if the file could not be read or a line is malformed
+    */
+   bool load(const std::string &path);
+
+   void add(const Segment &segment) { segments_.push_back(segment); }
+
+   const std::vector<Segment> &segments() const { return segments_; }
+
+private:
+   std::vector<Segment> segments_;
+};
+
+/**
+ * @brief The dimensions and dynamics of the truck. The tractor pose is the
+ * center of its rear axle.
+ */
+struct TruckParams {
+   double wheelbase;        // front axle to rear axle of the tractor
+   double tractor_front;    // rear axle to the front bumper
+   double tractor_rear;     // rear axle to the back of the tractor
+   double hitch_offset;     // rear axle to the fifth wheel, positive behind
+   double trailer_length;   // kingpin to the trailer axle
+   double trailer_front;    // kingpin to the front of the trailer
+   double trailer_rear;     // trailer axle to the back of the trailer
+   double width;            // of both the tractor and the trailer
+   double max_steer;        // wheel angle at a steer output of 0 or 180
+   double max_articulation; // largest angle between tractor and trailer
+   double max_speed;        // speed at a throttle of 100
+   double speed_tau;        // time constant of the drivetrain under power
+   double coast_tau;        // time constant of the drivetrain without power
+   double brake_decel;      // deceleration when braking to a stop
+   double couple_distance;  // kingpin to fifth wheel distance that couples
+   double ticks_per_meter;  // hall sensor ticks per meter traveled
+   double tof_max_range;    // beyond this the ToF sensors report nothing
+};
+
+/**
+ * @brief Returns parameters close to the 1:14 scale truck.
+ */
+TruckParams default_truck_params();
+
+/**
+ * @brief How the drivetrain is driven during one step.
+ * POWER: towards the target speed with speed_tau.
+ * COAST: no torque, slowing down with coast_tau.
+ * BRAKE: towards a stop at brake_decel.
+ */
+enum DriveMode {
+   DRIVE_POWER,
+   DRIVE_COAST,
+   DRIVE_BRAKE,
+};
+
+/**
+ * @brief Where a range sensor is mounted, relative to the rear axle of the
+ * tractor or the axle of the trailer, facing the given angle.
+ */
+struct SensorMount {
+   bool on_trailer;
+   double x, y, angle;
+};
+
+extern const SensorMount RIGHT_TOF_MOUNT;
+extern const SensorMount LEFT_TOF_MOUNT;
+extern const SensorMount REAR_TOF_MOUNT;
+extern const SensorMount RPLIDAR_MOUNT;
+
+/**
+ * @brief The simulated truck.
+ *
+ * The trailer follows the fifth wheel with the usual off-axle hitch
+ * kinematics while it is coupled. Unlocking the fifth wheel does not drop
+ * the trailer by itself: it is left behind once the tractor drives forward
+ * with the fifth wheel unlocked. A parked trailer is coupled again when the
+ * fifth wheel is locked within couple_distance of its kingpin.
+ */
+class TruckSim {
+public:
+   TruckSim(const TruckParams &params, const SimMap &map);
+
+   /**
+    * @brief Puts the tractor at a pose with the trailer straight behind it.
+    */
+   void reset(double x, double y, double theta, bool coupled);
+
+   /**
+    * @brief Advances the model by dt seconds.
+    *
+    * @param mode how the drivetrain is driven
+    * @param target_speed the speed in m/s that DRIVE_POWER drives towards
+    * @param steer_output the steering servo output, 0 to 180 with 90
+    * straight ahead and 0 turning left
+    * @param fifth_locked true if the fifth wheel is locked
+    */
+   void step(double dt, DriveMode mode, double target_speed,
+             int16_t steer_output, bool fifth_locked);
+
+   /**
+    * @brief The heading that the BNO055 reports: whole degrees from 0 to 359,
+    * clockwise from the x axis of the map.
+    */
+   int16_t imu_angle() const;
+
+   /**
+    * @brief The hall sensor count, which wraps like the Teensy's 16 bit
+    * counter.
+    */
+   int16_t ticks() const { return (int16_t)(int64_t)ticks_; }
+
+   /**
+    * @brief The ToF reading in millimeters, or 0 for a sensor on a trailer
+    * that is not coupled, which is what the Teensy reports for a sensor it
+    * cannot reach. Returns 8190, the VL53L0X out of range value, when
+    * nothing is within tof_max_range.
+    */
+   int16_t tof_mm(const SensorMount &mount) const;
+
+   /**
+    * @brief The distance from a sensor to the closest wall or body part
+    * along a ray, or max_range if there is none closer.
+    *
+    * @param angle the angle of the ray relative to the mount
+    */
+   double range(const SensorMount &mount, double angle,
+                double max_range) const;
+
+   double x() const { return x_; }
+   double y() const { return y_; }
+   double theta() const { return theta_; }
+   double speed() const { return v_; }
+   double steer_angle() const { return steer_; }
+   double trailer_heading() const { return trailer_theta_; }
+   bool coupled() const { return coupled_; }
+
+private:
+   void update_bodies();
+
+   void mount_pose(const SensorMount &mount, double *x, double *y,
+                   double *angle) const;
+
+   TruckParams params_;
+   const SimMap &map_;
+
+   double x_, y_, theta_;  // rear axle of the tractor
+   double v_;              // speed of the rear axle, positive forwards
+   double steer_;          // wheel angle, positive to the left
+   double ticks_;          // hall sensor ticks, unwrapped
+   double kingpin_x_, kingpin_y_;
+   double trailer_theta_;
+   bool coupled_;
+
+   // the outlines of the tractor and the trailer, which the sensors on the
+   // other body can see
+   std::vector<Segment> tractor_body_;
+   std::vector<Segment> trailer_body_;
+};
+
+#endif //DAIMTRONICS_TRUCK_SIM_H
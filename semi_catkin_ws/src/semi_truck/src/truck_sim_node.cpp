@@ -0,0 +1,594 @@
+/**
+ * @file Software-in-the-loop simulator that stands in for the Teensy and the
+ * sensors, so that algorithm nodes and pi_comm_node can run without the
+ * truck. It opens a pseudo terminal and speaks the protocol of
+ * teensy_protocol.h on it, so pi_comm_node only needs its ~port pointed at
+ * the terminal. Commands are applied at CONTROL_RATE_HZ with the link
+ * grading, slew limits and motor controller decimation of
+ * actuator_control_loop_fn(). The truck itself is the kinematic model in
+ * truck_sim.h; its RPLIDAR scans are published on scan_rplidar like
+ * rplidarNode does.
+ *
+ * The simulator owns time. It publishes /clock, so every other node has to
+ * run with /use_sim_time set (see launch/semi_truck_sim.launch), and it
+ * advances the model in fixed steps of 1 / ~physics_rate, which should be a
+ * multiple of CONTROL_RATE_HZ:
+ * - By default simulated time runs ~rate times as fast as the wall clock.
+ * - With ~lockstep set it runs as fast as it can, but at the end of every
+ *   control period, 1 / ~control_rate, it waits until a new command has
+ *   come in over the terminal, so the algorithm and the bridge see the same
+ *   sequence of inputs no matter how fast the machine is. If no command
+ *   comes within ~lockstep_timeout seconds of wall time the step goes ahead
+ *   anyway, which also lets the simulation start before the rest of the
+ *   stack is up.
+ */
+
+#include "truck_sim.h"
+#include "teensy_protocol.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+#include <sensor_msgs/LaserScan.h>
+
+// how often the Teensy threads sample each sensor, in seconds
+#define IMU_PERIOD 0.05
+#define WHEEL_SPEED_PERIOD 0.1 // wheel_speed is the tick count per period
+#define TOF_PERIOD 0.1
+
+// the RPLIDAR scan that rplidarNode publishes
+#define SCAN_SAMPLES 360
+#define SCAN_RANGE_MIN 0.15
+#define SCAN_RANGE_MAX 8.0
+
+#define REPORT_PERIOD 10.0 // wall seconds between statistics logs
+
+/**
+ * @brief An output that is slew-rate limited like slew_t in
+ * actuator_control.cpp, moved once per control tick.
+ */
+struct SimSlew {
+   int16_t output;
+   int16_t rate_per_s;
+   int32_t carry;
+};
+
+/**
+ * @brief The last command from the Pi and the state of the emulated Teensy
+ * around it.
+ */
+struct SimTeensy {
+   int16_t motor_output;
+   int16_t steer_output;
+   int16_t fifth_output;
+   int16_t motor_mode;
+   uint16_t seq;
+   double cmd_time;     // simulated time the command arrived, < 0 for none
+   double applied_time; // cmd_time of the last command that was applied
+
+   SimSlew motor;       // the slew limited motor output, -100 to 100
+   SimSlew steer;       // the slew limited servo output
+   int16_t motor_target; // motor output of the last controller run
+   uint32_t controller_ticks; // ticks since the last raw throttle
+   int16_t link_state;
+   uint16_t link_reaction_ms;
+   uint16_t cmd_latency_us;
+
+   int16_t imu_angle;
+   int16_t wheel_speed;
+   int16_t right_tof;
+   int16_t left_tof;
+   int16_t rear_tof;
+   int16_t last_ticks;
+};
+
+/**
+ * @brief The reading end of the pseudo terminal: the bytes that have not
+ * made up a full command frame yet.
+ */
+struct CommandParser {
+   std::vector<uint8_t> bytes;
+   uint64_t frames;
+   uint64_t skipped; // bytes thrown away while looking for a sync
+};
+
+static int pty = -1;
+static int pty_slave = -1;
+
+/**
+ * @brief Opens a pseudo terminal and links link_path to its slave end. The
+ * slave is kept open and in raw mode, so nothing is echoed or translated
+ * before pi_comm_node opens it, and the master does not see a hang up when
+ * pi_comm_node closes it again.
+ */
+static bool open_pty(const std::string &link_path) {
+   struct termios options;
+   const char *slave_path;
+
+   pty = posix_openpt(O_RDWR | O_NOCTTY);
+   if (pty < 0 || grantpt(pty) < 0 || unlockpt(pty) < 0 ||
+       (slave_path = ptsname(pty)) == NULL) {
+      ROS_ERROR("cannot open a pseudo terminal: %s", strerror(errno));
+      return false;
+   }
+
+   pty_slave = open(slave_path, O_RDWR | O_NOCTTY);
+   if (pty_slave < 0 || tcgetattr(pty_slave, &options) < 0) {
+      ROS_ERROR("cannot open %s: %s", slave_path, strerror(errno));
+      return false;
+   }
+   cfmakeraw(&options);
+   tcsetattr(pty_slave, TCSANOW, &options);
+   fcntl(pty, F_SETFL, fcntl(pty, F_GETFL) | O_NONBLOCK);
+
+   if (!link_path.empty()) {
+      unlink(link_path.c_str());
+      if (symlink(slave_path, link_path.c_str()) < 0) {
+         ROS_ERROR("cannot link %s to %s: %s", link_path.c_str(), slave_path,
+                   strerror(errno));
+         return false;
+      }
+   }
+   ROS_INFO("Teensy UART on %s (%s)", slave_path, link_path.c_str());
+   return true;
+}
+
+static int16_t get_int16(const uint8_t *bytes) {
+   return (int16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static void put_int16(uint8_t *bytes, int16_t value) {
+   bytes[0] = (uint16_t)value & 0xff;
+   bytes[1] = (uint16_t)value >> 8;
+}
+
+/**
+ * @brief Reads everything waiting on the terminal and applies every full
+ * command frame, in the order they came, like teensy_serial_poll() does.
+ * Bytes before a sync are skipped one at a time so the parser resyncs after
+ * a broken frame.
+ *
+ * @return the number of frames received
+ */
+static int receive_commands(CommandParser *parser, SimTeensy *teensy,
+                            double now) {
+   uint8_t buffer[256];
+   ssize_t count;
+   size_t start = 0;
+   int frames = 0;
+
+   while ((count = read(pty, buffer, sizeof(buffer))) > 0) {
+      parser->bytes.insert(parser->bytes.end(), buffer, buffer + count);
+   }
+
+   while (parser->bytes.size() - start >= CMD_FRAME_SIZE_W_SYNC) {
+      const uint8_t *frame = &parser->bytes[start];
+
+      if (get_int16(frame) != CMD_FRAME_SYNC) {
+         start++;
+         parser->skipped++;
+         continue;
+      }
+
+      teensy->motor_output = get_int16(frame + 2);
+      teensy->steer_output = get_int16(frame + 4);
+      teensy->fifth_output = get_int16(frame + 6);
+      teensy->motor_mode = get_int16(frame + 8);
+      teensy->seq = (uint16_t)get_int16(frame + 10);
+      teensy->cmd_time = now;
+      start += CMD_FRAME_SIZE_W_SYNC;
+      parser->frames++;
+      frames++;
+   }
+
+   parser->bytes.erase(parser->bytes.begin(), parser->bytes.begin() + start);
+   return frames;
+}
+
+/**
+ * @brief Waits up to timeout seconds of wall time for at least one command
+ * frame.
+ *
+ * @return true if a frame came in
+ */
+static bool wait_for_command(CommandParser *parser, SimTeensy *teensy,
+                             double now, double timeout) {
+   ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+
+   while (ros::ok()) {
+      double remaining = (deadline - ros::WallTime::now()).toSec();
+      struct timeval tv;
+      fd_set fds;
+
+      if (remaining <= 0) {
+         return false;
+      }
+      tv.tv_sec = (time_t)remaining;
+      tv.tv_usec = (suseconds_t)((remaining - tv.tv_sec) * 1e6);
+      FD_ZERO(&fds);
+      FD_SET(pty, &fds);
+      if (select(pty + 1, &fds, NULL, NULL, &tv) > 0 &&
+          receive_commands(parser, teensy, now) > 0) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * @brief Writes one sensor frame. A frame that does not fit into the
+ * terminal, because nothing is reading it, is dropped.
+ *
+ * @return false if the frame was dropped
+ */
+static bool send_sensors(const SimTeensy &teensy, int16_t drive_mode) {
+   uint8_t frame[SENSOR_FRAME_SIZE];
+
+   put_int16(frame, CMD_FRAME_SYNC);
+   put_int16(frame + 2, teensy.imu_angle);
+   put_int16(frame + 4, teensy.wheel_speed);
+   put_int16(frame + 6, teensy.right_tof);
+   put_int16(frame + 8, teensy.left_tof);
+   put_int16(frame + 10, teensy.rear_tof);
+   put_int16(frame + 12, (int16_t)teensy.cmd_latency_us);
+   put_int16(frame + 14, (int16_t)teensy.seq);
+   put_int16(frame + 16, teensy.link_state);
+   put_int16(frame + 18, (int16_t)teensy.link_reaction_ms);
+   put_int16(frame + 20, drive_mode);
+
+   if (write(pty, frame, sizeof(frame)) != (ssize_t)sizeof(frame)) {
+      // drop anything partial so the next frame starts on a sync
+      tcflush(pty, TCOFLUSH);
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief Moves an output one control tick towards target, the same way as
+ * slew_limit() in actuator_control.cpp.
+ */
+static int16_t slew_limit(SimSlew *slew, int16_t target) {
+   int32_t budget = slew->carry + slew->rate_per_s;
+   int16_t max_step = budget / CONTROL_RATE_HZ;
+
+   if (target > slew->output + max_step) {
+      slew->output += max_step;
+   }
+   else if (target < slew->output - max_step) {
+      slew->output -= max_step;
+   }
+   else {
+      slew->output = target;
+      slew->carry = 0;
+      return slew->output;
+   }
+   slew->carry = budget - (int32_t)max_step * CONTROL_RATE_HZ;
+   return slew->output;
+}
+
+/**
+ * @brief What motor_control_fn() outputs, as a throttle from -100 to 100.
+ * The stop controller is left to the model's brake, and the speed
+ * controller is taken to reach its setpoint, so it outputs the throttle
+ * that drives at that speed.
+ */
+static int16_t motor_control(const TruckParams &params, bool deadman,
+                             int16_t motor_mode, int16_t motor_output) {
+   double throttle = motor_output;
+
+   if (!deadman) {
+      return 0;
+   }
+   if (motor_mode == MOTOR_MODE_SPEED) {
+      throttle = motor_output / WHEEL_SPEED_PERIOD / params.ticks_per_meter *
+                 100.0 / params.max_speed;
+   }
+   return (int16_t)std::max(-100.0, std::min(100.0, std::round(throttle)));
+}
+
+/**
+ * @brief One tick of the Teensy control thread, run at CONTROL_RATE_HZ:
+ * grades the link by the age of the last command and turns the command into
+ * a drive mode, a target speed and a steering output for the model, the way
+ * actuator_control_loop_fn() does. A raw throttle is applied every tick,
+ * the speed and stop controllers only every MOTOR_DECIMATION ticks, and
+ * both outputs are slew limited.
+ */
+static DriveMode control_tick(SimTeensy *teensy, const TruckParams &params,
+                              bool deadman, double now,
+                              double *target_speed) {
+   double age_ms = (now - teensy->cmd_time) * 1000.0;
+   int16_t state, steer_target;
+   DriveMode mode;
+
+   if (teensy->cmd_time < 0 || age_ms >= LINK_BRAKE_MS) {
+      state = LINK_BRAKE;
+   }
+   else if (age_ms >= LINK_COAST_MS) {
+      state = LINK_COAST;
+   }
+   else if (age_ms >= LINK_HOLD_MS) {
+      state = LINK_HOLD;
+   }
+   else {
+      state = LINK_OK;
+   }
+   if (state == LINK_BRAKE && teensy->link_state != LINK_BRAKE &&
+       teensy->cmd_time >= 0) {
+      teensy->link_reaction_ms = (uint16_t)std::min(age_ms, 65535.0);
+   }
+   teensy->link_state = state;
+
+   bool linked = state == LINK_OK || state == LINK_HOLD;
+   bool motor_deadman = deadman && linked;
+   int16_t motor_mode = teensy->motor_mode;
+   int16_t motor_command = teensy->motor_output;
+   bool motor_applied = true;
+
+   if (state == LINK_COAST) {
+      motor_deadman = deadman;
+      motor_mode = MOTOR_MODE_THROTTLE;
+      motor_command = 0;
+   }
+   if (motor_deadman && motor_mode != MOTOR_MODE_SPEED) {
+      teensy->motor_target = motor_control(params, motor_deadman, motor_mode,
+                                           motor_command);
+      teensy->controller_ticks = 0;
+   }
+   else if (teensy->controller_ticks++ % MOTOR_DECIMATION == 0) {
+      teensy->motor_target = motor_control(params, motor_deadman, motor_mode,
+                                           motor_command);
+   }
+   else {
+      motor_applied = false;
+   }
+
+   if (state == LINK_COAST) {
+      steer_target = teensy->steer.output;
+   }
+   else if (!linked || teensy->steer_output > 180 ||
+            teensy->steer_output < 0) {
+      steer_target = STEER_FAILSAFE;
+   }
+   else {
+      steer_target = teensy->steer_output;
+   }
+
+   slew_limit(&teensy->motor, teensy->motor_target);
+   slew_limit(&teensy->steer, steer_target);
+
+   // the coasting motor keeps driving until its output has slewed to 0
+   if (motor_deadman && (state != LINK_COAST || teensy->motor.output != 0)) {
+      mode = DRIVE_POWER;
+   }
+   else {
+      mode = state == LINK_COAST && deadman ? DRIVE_COAST : DRIVE_BRAKE;
+   }
+   *target_speed = teensy->motor.output * params.max_speed / 100.0;
+
+   if (state == LINK_OK && teensy->cmd_time != teensy->applied_time &&
+       motor_applied) {
+      teensy->applied_time = teensy->cmd_time;
+      teensy->cmd_latency_us = (uint16_t)std::min(
+            (now - teensy->cmd_time) * 1e6, 65535.0);
+   }
+   return mode;
+}
+
+/**
+ * @brief Returns a period in whole steps, at least one.
+ */
+static uint64_t to_steps(double period, double dt) {
+   return std::max<uint64_t>(1, (uint64_t)std::llround(period / dt));
+}
+
+int main(int argc, char **argv) {
+   ros::init(argc, argv, "truck_sim_node");
+   ros::NodeHandle nh;
+   ros::NodeHandle private_nh("~");
+
+   std::string link_path, map_path;
+   double physics_rate, sensor_rate, scan_rate, control_rate;
+   double rate, lockstep_timeout, start_x, start_y, start_theta;
+   bool lockstep, trailer;
+   TruckParams params = default_truck_params();
+   double max_steer_deg = params.max_steer * 180.0 / M_PI;
+
+   private_nh.param<std::string>("link", link_path, "/tmp/ttyTRUCK");
+   private_nh.param<std::string>("map", map_path, "");
+   private_nh.param("x", start_x, 0.0);
+   private_nh.param("y", start_y, 0.0);
+   private_nh.param("theta", start_theta, 0.0);
+   private_nh.param("trailer", trailer, true);
+   private_nh.param("physics_rate", physics_rate, 200.0);
+   private_nh.param("sensor_rate", sensor_rate, 1000.0 / SERIAL_SEND_MS);
+   private_nh.param("scan_rate", scan_rate, 10.0);
+   private_nh.param("rate", rate, 1.0);
+   private_nh.param("lockstep", lockstep, false);
+   private_nh.param("control_rate", control_rate, 50.0);
+   private_nh.param("lockstep_timeout", lockstep_timeout, 0.5);
+   private_nh.param("wheelbase", params.wheelbase, params.wheelbase);
+   private_nh.param("trailer_length", params.trailer_length,
+                    params.trailer_length);
+   private_nh.param("hitch_offset", params.hitch_offset, params.hitch_offset);
+   private_nh.param("max_steer", max_steer_deg, max_steer_deg);
+   private_nh.param("max_speed", params.max_speed, params.max_speed);
+   private_nh.param("ticks_per_meter", params.ticks_per_meter,
+                    params.ticks_per_meter);
+   params.max_steer = max_steer_deg * M_PI / 180.0;
+
+   SimMap map;
+   if (!map_path.empty() && !map.load(map_path)) {
+      ROS_ERROR("cannot read the map %s", map_path.c_str());
+      return 1;
+   }
+   if (!open_pty(link_path)) {
+      return 1;
+   }
+
+   TruckSim truck(params, map);
+   truck.reset(start_x, start_y, start_theta, trailer);
+
+   ros::Publisher clock_publisher =
+         nh.advertise<rosgraph_msgs::Clock>("/clock", 1);
+   ros::Publisher scan_publisher =
+         nh.advertise<sensor_msgs::LaserScan>("scan_rplidar", 10);
+
+   double dt = 1.0 / physics_rate;
+   uint64_t tick_steps = to_steps(1.0 / CONTROL_RATE_HZ, dt);
+   uint64_t imu_steps = to_steps(IMU_PERIOD, dt);
+   uint64_t speed_steps = to_steps(WHEEL_SPEED_PERIOD, dt);
+   uint64_t tof_steps = to_steps(TOF_PERIOD, dt);
+   uint64_t sensor_steps = to_steps(1.0 / sensor_rate, dt);
+   uint64_t control_steps = to_steps(1.0 / control_rate, dt);
+   uint64_t scan_steps = to_steps(1.0 / scan_rate, dt);
+
+   SimTeensy teensy;
+   memset(&teensy, 0, sizeof(teensy));
+   teensy.cmd_time = -1.0;
+   teensy.applied_time = -1.0;
+   teensy.motor.rate_per_s = MOTOR_SLEW_PER_S;
+   teensy.steer.output = STEER_FAILSAFE;
+   teensy.steer.rate_per_s = STEER_SLEW_PER_S;
+   teensy.link_state = LINK_BRAKE;
+   teensy.last_ticks = truck.ticks();
+
+   CommandParser parser;
+   parser.frames = 0;
+   parser.skipped = 0;
+
+   // the sweep in progress; each step casts the rays that fall into it
+   sensor_msgs::LaserScan scan;
+   scan.header.frame_id = "laser";
+   scan.angle_min = -M_PI;
+   scan.angle_max = M_PI - 2 * M_PI / SCAN_SAMPLES;
+   scan.angle_increment = 2 * M_PI / SCAN_SAMPLES;
+   scan.scan_time = scan_steps * dt;
+   scan.time_increment = scan.scan_time / SCAN_SAMPLES;
+   scan.range_min = SCAN_RANGE_MIN;
+   scan.range_max = SCAN_RANGE_MAX;
+   scan.ranges.reserve(SCAN_SAMPLES);
+
+   uint64_t step = 0;
+   uint64_t dropped = 0;
+   uint64_t timeouts = 0;
+   uint64_t boundary_frames = 0; // command frames at the last boundary
+   uint64_t report_step = 0;
+   bool deadman = true;
+   int drive_mode = 1;
+   double target_speed = 0.0;
+   DriveMode mode = DRIVE_BRAKE;
+   ros::WallTime wall_start = ros::WallTime::now();
+   ros::WallTime report_start = wall_start;
+
+   while (ros::ok()) {
+      double now = step * dt;
+
+      private_nh.getParamCached("deadman", deadman);
+      private_nh.getParamCached("drive_mode", drive_mode);
+
+      receive_commands(&parser, &teensy, now);
+      if (step % tick_steps == 0) {
+         mode = control_tick(&teensy, params, deadman, now, &target_speed);
+      }
+      truck.step(dt, mode, target_speed, teensy.steer.output,
+                 teensy.fifth_output == FIFTH_LOCKED);
+      step++;
+      now = step * dt;
+
+      rosgraph_msgs::Clock clock;
+      clock.clock.fromSec(now);
+      clock_publisher.publish(clock);
+
+      if (step % imu_steps == 0) {
+         teensy.imu_angle = truck.imu_angle();
+      }
+      if (step % speed_steps == 0) {
+         teensy.wheel_speed = (int16_t)(truck.ticks() - teensy.last_ticks);
+         teensy.last_ticks = truck.ticks();
+      }
+      if (step % tof_steps == 0) {
+         teensy.right_tof = truck.tof_mm(RIGHT_TOF_MOUNT);
+         teensy.left_tof = truck.tof_mm(LEFT_TOF_MOUNT);
+         teensy.rear_tof = truck.tof_mm(REAR_TOF_MOUNT);
+      }
+      if (step % sensor_steps == 0 &&
+          !send_sensors(teensy, (int16_t)drive_mode)) {
+         dropped++;
+      }
+
+      // the scan turns counterclockwise, so each step adds the samples that
+      // were taken during it
+      size_t samples = (size_t)((step % scan_steps == 0 ? scan_steps :
+                                 step % scan_steps) * SCAN_SAMPLES /
+                                scan_steps);
+      if (scan.ranges.empty()) {
+         scan.header.stamp.fromSec(now - dt);
+      }
+      while (scan.ranges.size() < samples) {
+         double angle = scan.angle_min +
+                        scan.ranges.size() * scan.angle_increment;
+         double range = truck.range(RPLIDAR_MOUNT, angle, SCAN_RANGE_MAX);
+         scan.ranges.push_back(range < SCAN_RANGE_MAX ?
+                               (float)range : INFINITY);
+      }
+      if (step % scan_steps == 0) {
+         scan_publisher.publish(scan);
+         scan.ranges.clear();
+      }
+
+      if (lockstep && step % control_steps == 0) {
+         // until the first command the bridge may not be up yet, so only
+         // wait a little
+         if (parser.frames == boundary_frames &&
+             !wait_for_command(&parser, &teensy, now,
+                               parser.frames == 0 ?
+                               std::min(lockstep_timeout, 0.1) :
+                               lockstep_timeout) &&
+             parser.frames > 0) {
+            timeouts++;
+         }
+         boundary_frames = parser.frames;
+      }
+      else if (rate > 0) {
+         ros::WallTime due = wall_start + ros::WallDuration(now / rate);
+         double ahead = (due - ros::WallTime::now()).toSec();
+         if (ahead > 0) {
+            ros::WallDuration(ahead).sleep();
+         }
+      }
+
+      double wall_s = (ros::WallTime::now() - report_start).toSec();
+      if (wall_s >= REPORT_PERIOD) {
+         ROS_INFO("Simulation: %.1fx real time, t %.1f s, %lu commands, "
+                  "%lu lockstep timeouts, %lu sensor frames dropped, "
+                  "truck at (%.2f, %.2f) heading %.0f deg, trailer %s",
+                  (step - report_step) * dt / wall_s, now,
+                  (unsigned long)parser.frames, (unsigned long)timeouts,
+                  (unsigned long)dropped, truck.x(), truck.y(),
+                  truck.theta() * 180.0 / M_PI,
+                  truck.coupled() ? "coupled" : "parked");
+         report_start = ros::WallTime::now();
+         report_step = step;
+      }
+   }
+
+   if (!link_path.empty()) {
+      unlink(link_path.c_str());
+   }
+   close(pty_slave);
+   close(pty);
+   return 0;
+}
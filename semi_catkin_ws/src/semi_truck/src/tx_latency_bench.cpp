@@ -0,0 +1,193 @@
+/**
+ * @file Measures how long an actuator message takes from being published on
+ * teensy_actuator_data to its command frame arriving at the UART, through
+ * a running pi_comm_node whose ~port is the pseudo terminal that this node
+ * opens in place of the Teensy, see launch/semi_truck_tx_latency.launch.
+ *
+ *    tx_latency_bench [--link PATH] [--count N] [--rate HZ] [--delay S]
+ *
+ * Every message carries its number in steer_output, so the frames that
+ * arrive are matched to the time their message was published even when
+ * pi_comm_node drops some from its queue of one. Both times are taken on
+ * the monotonic clock of this process when the publish is called and when
+ * the read of the terminal returns the end of the frame, so the latency
+ * covers the serialization, the TCP hop, the queue and the UART write. The
+ * median, the 99th percentile and the largest latency are printed at the
+ * end.
+ */
+
+#include "semi_truck/Teensy_Actuators.h"
+#include "teensy_protocol.h"
+#include "uart_capture.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+
+#define DEFAULT_LINK "/tmp/ttyTXBENCH"
+
+struct BenchConfig {
+   BenchConfig()
+      : link(DEFAULT_LINK),
+        count(2000),
+        rate(50.0),
+        delay(1.0) {}
+
+   std::string link;
+   int count;    // messages to publish, at most 32767
+   double rate;  // messages per second
+   double delay; // seconds for the subscription to connect
+};
+
+/**
+ * @brief Reads the terminal until a deadline and stamps every command frame
+ * that is complete after a read with the time of that read.
+ *
+ * @param pending bytes read that do not make a whole frame yet
+ * @param arrived_s set at the steer_output of each frame that arrived
+ */
+static void read_frames(const ReplayPty &pty, double deadline_s,
+                        std::vector<uint8_t> *pending,
+                        std::vector<double> *arrived_s) {
+   uint8_t bytes[256];
+   double left_s;
+
+   while ((left_s = deadline_s - monotonic_s()) > 0) {
+      struct pollfd fd;
+      ssize_t count;
+
+      fd.fd = pty.master;
+      fd.events = POLLIN;
+      fd.revents = 0;
+      if (poll(&fd, 1, (int)(left_s * 1000) + 1) <= 0) {
+         continue;
+      }
+      while ((count = read(pty.master, bytes, sizeof(bytes))) > 0) {
+         pending->insert(pending->end(), bytes, bytes + count);
+      }
+      double now = monotonic_s();
+
+      for (const std::vector<int16_t> &frame : commands(*pending)) {
+         int16_t number = frame[1];
+
+         if (number >= 0 && number < (int)arrived_s->size() &&
+             (*arrived_s)[number] < 0) {
+            (*arrived_s)[number] = now;
+         }
+      }
+      // keep what may be the start of the next frame
+      if (pending->size() >= CMD_FRAME_SIZE_W_SYNC) {
+         pending->erase(pending->begin(),
+                        pending->end() - (CMD_FRAME_SIZE_W_SYNC - 1));
+      }
+   }
+}
+
+static double percentile(const std::vector<double> &sorted, double fraction) {
+   size_t i = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+
+   return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static int usage() {
+   fprintf(stderr,
+           "usage: tx_latency_bench [--link PATH] [--count N] [--rate HZ] "
+           "[--delay S]\n"
+           "  --link     path of the terminal for pi_comm_node's ~port, "
+           "default " DEFAULT_LINK "\n"
+           "  --count    messages to publish, default 2000\n"
+           "  --rate     messages per second, default 50\n"
+           "  --delay    seconds to wait after pi_comm_node subscribed, "
+           "default 1\n");
+   return 2;
+}
+
+int main(int argc, char **argv) {
+   BenchConfig config;
+   ReplayPty pty;
+   std::vector<uint8_t> pending;
+   std::vector<double> published_s;
+   std::vector<double> arrived_s;
+   std::vector<double> latency_us;
+   double next_s;
+
+   ros::init(argc, argv, "tx_latency_bench");
+   for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+
+      if (arg == "--link" && i + 1 < argc) {
+         config.link = argv[++i];
+      }
+      else if (arg == "--count" && i + 1 < argc) {
+         config.count = atoi(argv[++i]);
+      }
+      else if (arg == "--rate" && i + 1 < argc) {
+         config.rate = atof(argv[++i]);
+      }
+      else if (arg == "--delay" && i + 1 < argc) {
+         config.delay = atof(argv[++i]);
+      }
+      else {
+         return usage();
+      }
+   }
+   if (config.count <= 0 || config.count > 32767 || config.rate <= 0) {
+      return usage();
+   }
+
+   if (!open_pty(config.link, &pty)) {
+      return 1;
+   }
+
+   ros::NodeHandle nh;
+   ros::Publisher publisher = nh.advertise<semi_truck::Teensy_Actuators>(
+    "teensy_actuator_data", 1);
+
+   fprintf(stderr, "waiting for pi_comm_node to subscribe\n");
+   while (publisher.getNumSubscribers() == 0 && ros::ok()) {
+      read_frames(pty, monotonic_s() + 0.1, &pending, &arrived_s);
+   }
+   read_frames(pty, monotonic_s() + config.delay, &pending, &arrived_s);
+   pending.clear();
+
+   published_s.assign(config.count, -1.0);
+   arrived_s.assign(config.count, -1.0);
+   next_s = monotonic_s();
+   for (int i = 0; i < config.count && ros::ok(); i++) {
+      semi_truck::Teensy_Actuators msg;
+
+      msg.motor_output = 0;
+      msg.steer_output = (int16_t)i;
+      msg.fifth_output = FIFTH_LOCKED;
+      msg.motor_mode = MOTOR_MODE_THROTTLE;
+      published_s[i] = monotonic_s();
+      publisher.publish(msg);
+
+      next_s += 1.0 / config.rate;
+      read_frames(pty, next_s, &pending, &arrived_s);
+   }
+   read_frames(pty, monotonic_s() + 0.5, &pending, &arrived_s);
+   close_pty(config.link, &pty);
+
+   for (int i = 0; i < config.count; i++) {
+      if (arrived_s[i] >= 0) {
+         latency_us.push_back((arrived_s[i] - published_s[i]) * 1e6);
+      }
+   }
+   if (latency_us.empty()) {
+      printf("no command frames arrived, is pi_comm_node's ~port %s?\n",
+             config.link.c_str());
+      return 1;
+   }
+   std::sort(latency_us.begin(), latency_us.end());
+   printf("topic to UART latency of %zu of %d messages at %.0f Hz: "
+          "p50 %.0f us, p99 %.0f us, max %.0f us\n", latency_us.size(),
+          config.count, config.rate, percentile(latency_us, 0.5),
+          percentile(latency_us, 0.99), latency_us.back());
+   return 0;
+}
@@ -0,0 +1,211 @@
+#include "uart_capture.h"
+
+#include "semi_truck/Uart_Bytes.h"
+#include "teensy_protocol.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <ros/serialization.h>
+#include <flight_recorder/reader.h>
+
+static bool ends_with(const std::string &text, const std::string &suffix) {
+   return text.size() >= suffix.size() &&
+          text.compare(text.size() - suffix.size(), suffix.size(),
+                       suffix) == 0;
+}
+
+double monotonic_s() {
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+bool read_capture(const std::string &path, std::vector<UartRecord> *rx,
+                  std::vector<UartRecord> *tx) {
+   flight_recorder::RingReader reader;
+
+   if (!reader.open(path)) {
+      fprintf(stderr, "cannot read %s\n", path.c_str());
+      return false;
+   }
+
+   for (const flight_recorder::ChunkSummary &chunk : reader.chunks()) {
+      reader.read_chunk(chunk, [&](const flight_recorder::StreamInfo &stream,
+                                   int64_t stamp_ns, const uint8_t *data,
+                                   uint32_t size) {
+         std::vector<UartRecord> *records;
+         semi_truck::Uart_Bytes bytes;
+
+         if (ends_with(stream.topic, "/uart_rx")) {
+            records = rx;
+         }
+         else if (ends_with(stream.topic, "/uart_tx")) {
+            records = tx;
+         }
+         else {
+            return;
+         }
+         ros::serialization::IStream in(const_cast<uint8_t*>(data), size);
+         ros::serialization::deserialize(in, bytes);
+         records->push_back(UartRecord());
+         records->back().stamp_ns = stamp_ns;
+         records->back().data.swap(bytes.data);
+      });
+   }
+
+   if (rx->empty()) {
+      fprintf(stderr, "%s has no uart_rx stream, was pi_comm_node run with "
+              "~record_uart?\n", path.c_str());
+      return false;
+   }
+   return true;
+}
+
+bool open_pty(const std::string &link_path, ReplayPty *pty) {
+   struct termios options;
+   const char *slave_path;
+
+   pty->master = posix_openpt(O_RDWR | O_NOCTTY);
+   if (pty->master < 0 || grantpt(pty->master) < 0 ||
+       unlockpt(pty->master) < 0 ||
+       (slave_path = ptsname(pty->master)) == NULL) {
+      fprintf(stderr, "cannot open a pseudo terminal: %s\n", strerror(errno));
+      return false;
+   }
+
+   pty->slave = open(slave_path, O_RDWR | O_NOCTTY);
+   if (pty->slave < 0 || tcgetattr(pty->slave, &options) < 0) {
+      fprintf(stderr, "cannot open %s: %s\n", slave_path, strerror(errno));
+      return false;
+   }
+   cfmakeraw(&options);
+   tcsetattr(pty->slave, TCSANOW, &options);
+   fcntl(pty->master, F_SETFL, fcntl(pty->master, F_GETFL) | O_NONBLOCK);
+
+   unlink(link_path.c_str());
+   if (symlink(slave_path, link_path.c_str()) < 0) {
+      fprintf(stderr, "cannot link %s to %s: %s\n", link_path.c_str(),
+              slave_path, strerror(errno));
+      return false;
+   }
+   fprintf(stderr, "replaying on %s (%s)\n", slave_path, link_path.c_str());
+   return true;
+}
+
+void close_pty(const std::string &link_path, ReplayPty *pty) {
+   if (pty->slave >= 0) {
+      close(pty->slave);
+   }
+   if (pty->master >= 0) {
+      close(pty->master);
+   }
+   pty->master = pty->slave = -1;
+   unlink(link_path.c_str());
+}
+
+void pump(const ReplayPty &pty, const uint8_t **out, size_t *out_size,
+          double deadline_s, std::vector<uint8_t> *received) {
+   uint8_t bytes[256];
+
+   while (true) {
+      struct pollfd fd;
+      double left_s = deadline_s - monotonic_s();
+      ssize_t count;
+
+      if (*out_size == 0 && left_s <= 0) {
+         return;
+      }
+
+      fd.fd = pty.master;
+      fd.events = POLLIN | (*out_size > 0 ? POLLOUT : 0);
+      fd.revents = 0;
+      poll(&fd, 1, *out_size > 0 ? 100 : (int)(left_s * 1000) + 1);
+
+      while ((count = read(pty.master, bytes, sizeof(bytes))) > 0) {
+         received->insert(received->end(), bytes, bytes + count);
+      }
+
+      if (*out_size > 0 && (fd.revents & POLLOUT)) {
+         count = write(pty.master, *out, *out_size);
+         if (count > 0) {
+            *out += count;
+            *out_size -= count;
+            if (*out_size == 0) {
+               return;
+            }
+         }
+      }
+   }
+}
+
+int unread(const ReplayPty &pty) {
+   int count = 0;
+
+   ioctl(pty.slave, FIONREAD, &count);
+   return count;
+}
+
+std::vector<std::vector<int16_t> > commands(const std::vector<uint8_t> &bytes) {
+   std::vector<std::vector<int16_t> > frames;
+   size_t i = 0;
+
+   while (i + CMD_FRAME_SIZE_W_SYNC <= bytes.size()) {
+      if ((int16_t)(bytes[i] | bytes[i + 1] << 8) != CMD_FRAME_SYNC) {
+         i++;
+         continue;
+      }
+      frames.push_back(std::vector<int16_t>());
+      for (int word = 1; word <= COMMAND_WORDS; word++) {
+         frames.back().push_back(
+          (int16_t)(bytes[i + 2 * word] | bytes[i + 2 * word + 1] << 8));
+      }
+      i += CMD_FRAME_SIZE_W_SYNC;
+   }
+   return frames;
+}
+
+bool compare(const std::vector<UartRecord> &tx,
+             const std::vector<uint8_t> &received) {
+   std::vector<uint8_t> captured;
+   std::vector<std::vector<int16_t> > expected;
+   std::vector<std::vector<int16_t> > replayed;
+   size_t compared;
+   size_t differ = 0;
+   size_t first_difference = 0;
+
+   for (const UartRecord &record : tx) {
+      captured.insert(captured.end(), record.data.begin(), record.data.end());
+   }
+   expected = commands(captured);
+   replayed = commands(received);
+
+   compared = std::min(expected.size(), replayed.size());
+   for (size_t i = 0; i < compared; i++) {
+      if (expected[i] != replayed[i] && differ++ == 0) {
+         first_difference = i;
+      }
+   }
+
+   printf("commands: %zu captured, %zu replayed, %zu of %zu differ",
+          expected.size(), replayed.size(), differ, compared);
+   if (differ > 0) {
+      const std::vector<int16_t> &a = expected[first_difference];
+      const std::vector<int16_t> &b = replayed[first_difference];
+
+      printf(", first at %zu: %d %d %d %d instead of %d %d %d %d",
+             first_difference, b[0], b[1], b[2], b[3], a[0], a[1], a[2],
+             a[3]);
+   }
+   printf("\n");
+   return differ == 0 && expected.size() == replayed.size();
+}
@@ -0,0 +1,97 @@
+/**
+ * @file The parts of uart_replay that do not need a running ROS graph: the
+ * uart_rx and uart_tx records of a capture, the pseudo terminal that the
+ * bytes are replayed into, and the comparison of the commands that came back
+ * with the ones in the capture.
+ */
+
+#ifndef DAIMTRONICS_UART_CAPTURE_H
+#define DAIMTRONICS_UART_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// the words of a command frame that are compared: all but the seq, which
+// starts over with every run of pi_comm_node
+#define COMMAND_WORDS 4
+
+/**
+ * @brief The bytes that one read or write of pi_comm_node moved.
+ */
+struct UartRecord {
+   int64_t stamp_ns;
+   std::vector<uint8_t> data;
+};
+
+/**
+ * @brief A pseudo terminal; pi_comm_node opens the slave end by its link.
+ */
+struct ReplayPty {
+   ReplayPty() : master(-1), slave(-1) {}
+
+   int master;
+   int slave;
+};
+
+/**
+ * @brief Seconds on the monotonic clock, which the deadlines of pump() are
+ * on.
+ */
+double monotonic_s();
+
+/**
+ * @brief Reads the uart_rx and uart_tx streams out of a ring file, oldest
+ * first.
+ *
+ * @return false if the file cannot be read or has no uart_rx stream
+ */
+bool read_capture(const std::string &path, std::vector<UartRecord> *rx,
+                  std::vector<UartRecord> *tx);
+
+/**
+ * @brief Opens a pseudo terminal and links link_path to its slave end, the
+ * same way truck_sim_node does.
+ */
+bool open_pty(const std::string &link_path, ReplayPty *pty);
+
+/**
+ * @brief Closes both ends of the terminal and removes the link.
+ */
+void close_pty(const std::string &link_path, ReplayPty *pty);
+
+/**
+ * @brief Reads what pi_comm_node wrote until a deadline, and writes bytes to
+ * it if there are any, whichever comes first.
+ *
+ * @param out the bytes to write, advanced past the ones that were written
+ * @param out_size the number of bytes left to write
+ * @param deadline_s when to return without writing, see monotonic_s()
+ * @param received where the bytes that were read go
+ */
+void pump(const ReplayPty &pty, const uint8_t **out, size_t *out_size,
+          double deadline_s, std::vector<uint8_t> *received);
+
+/**
+ * @brief Number of bytes written to the terminal that pi_comm_node has not
+ * read yet.
+ */
+int unread(const ReplayPty &pty);
+
+/**
+ * @brief Splits a byte stream into the first COMMAND_WORDS words of its
+ * command frames, skipping bytes up to each sync value like the Teensy does.
+ */
+std::vector<std::vector<int16_t> > commands(const std::vector<uint8_t> &bytes);
+
+/**
+ * @brief Compares the commands written during the replay with the ones in
+ * the capture, in order, and prints how many differ.
+ *
+ * @return true if they are the same
+ */
+bool compare(const std::vector<UartRecord> &tx,
+             const std::vector<uint8_t> &received);
+
+#endif //DAIMTRONICS_UART_CAPTURE_H
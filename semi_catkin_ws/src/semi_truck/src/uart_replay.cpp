@@ -0,0 +1,249 @@
+/**
+ * @file Replays the raw UART bytes that pi_comm_node captured with
+ * ~record_uart into a pseudo terminal, so that pi_comm_node and the
+ * algorithm behind it can be run again on the exact byte stream that the
+ * Teensy sent, sync errors and all. Point pi_comm_node's ~port at the link
+ * of the terminal, see launch/semi_truck_replay.launch.
+ *
+ *    uart_replay CAPTURE [--link PATH] [--rate X] [--delay S] [--check]
+ *
+ * The replay drives /clock, so the nodes have to run with /use_sim_time set.
+ * pi_comm_node then reads the terminal on a ROS timer, and each uart_rx
+ * record is replayed in one step: its bytes are written, the clock is moved
+ * to the tick of that timer nearest to the record's stamp, and the replay
+ * waits until pi_comm_node has read the bytes and the algorithm has written
+ * as many command bytes as it did in the capture before the next record.
+ * Every record is so read in a poll of its own, at the time it was read
+ * in the capture, however loaded the machine is.
+ *
+ * --rate 1 paces the steps at the timing of the capture, 2 twice as fast,
+ * and 0 as fast as the nodes answer. The commands that pi_comm_node writes
+ * back are compared with the ones in the capture; with --check the exit
+ * status is 1 if they differ.
+ */
+
+#include "pi_comm_node.h"
+#include "teensy_protocol.h"
+#include "uart_capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+
+#define DEFAULT_LINK "/tmp/ttyREPLAY"
+
+// longest gap paced between two records, e.g. between runs in the same ring
+#define MAX_GAP_S 1.0
+// seconds to read the commands of pi_comm_node after the last byte is sent
+#define DRAIN_S 1.0
+// seconds to wait for the nodes to answer a step before moving on
+#define STEP_TIMEOUT_S 1.0
+// seconds between polls of the terminal while waiting
+#define POLL_S 0.001
+
+struct ReplayConfig {
+   ReplayConfig()
+      : link(DEFAULT_LINK),
+        rate(1.0),
+        delay(2.0),
+        check(false) {}
+
+   std::string capture;
+   std::string link;
+   double rate;  // 0 for as fast as the nodes answer
+   double delay; // seconds for the nodes to start and open the terminal
+   bool check;
+};
+
+static ReplayPty pty;
+static ros::Publisher clock_publisher;
+
+/**
+ * @brief Moves the simulated time of the nodes.
+ */
+static void publish_clock(int64_t stamp_ns) {
+   rosgraph_msgs::Clock clock;
+
+   clock.clock.fromNSec(stamp_ns);
+   clock_publisher.publish(clock);
+}
+
+/**
+ * @brief Reads what pi_comm_node writes until done() returns true or for at
+ * most STEP_TIMEOUT_S.
+ *
+ * @return false if it timed out
+ */
+template <typename Done>
+static bool wait_until(Done done, std::vector<uint8_t> *received) {
+   double deadline_s = monotonic_s() + STEP_TIMEOUT_S;
+   const uint8_t *nothing = NULL;
+   size_t none = 0;
+
+   while (!done()) {
+      if (monotonic_s() >= deadline_s || !ros::ok()) {
+         return false;
+      }
+      pump(pty, &nothing, &none, std::min(monotonic_s() + POLL_S, deadline_s),
+           received);
+   }
+   return true;
+}
+
+/**
+ * @brief Replays every uart_rx record in a step of its own, see the top of
+ * the file, and collects what pi_comm_node writes back.
+ *
+ * @param clock_ns the clock that was published while the nodes started
+ */
+static void replay(const ReplayConfig &config,
+                   const std::vector<UartRecord> &rx,
+                   const std::vector<UartRecord> &tx, int64_t clock_ns,
+                   std::vector<uint8_t> *received) {
+   const int64_t period_ns = 1000000000LL / LOOP_FREQUENCY;
+   double start_s;
+   double offset_s = 0;
+   size_t total = 0;
+   size_t next_tx = 0;
+   size_t expected = 0;
+   size_t timeouts = 0;
+
+   // commands from before the first record answer data that is not replayed
+   while (next_tx < tx.size() && tx[next_tx].stamp_ns < rx[0].stamp_ns) {
+      next_tx++;
+   }
+
+   start_s = monotonic_s();
+   for (size_t i = 0; i < rx.size() && ros::ok(); i++) {
+      const uint8_t *out = rx[i].data.data();
+      size_t out_size = rx[i].data.size();
+      int64_t tick_ns = clock_ns + period_ns;
+      int64_t next_ns = i + 1 < rx.size() ? rx[i + 1].stamp_ns : INT64_MAX;
+
+      // pi_comm_node's timer fires every period from the clock it started
+      // at, so the clock only ever moves by whole periods
+      if (rx[i].stamp_ns > tick_ns) {
+         tick_ns += (rx[i].stamp_ns - tick_ns + period_ns / 2) / period_ns *
+                    period_ns;
+      }
+      if (config.rate > 0) {
+         const uint8_t *nothing = NULL;
+         size_t none = 0;
+         double gap_s = (tick_ns - clock_ns) * 1e-9;
+
+         offset_s += std::min(gap_s, MAX_GAP_S);
+         pump(pty, &nothing, &none, start_s + offset_s / config.rate,
+              received);
+      }
+      pump(pty, &out, &out_size, 0, received);
+      total += rx[i].data.size();
+
+      publish_clock(tick_ns);
+      clock_ns = tick_ns;
+
+      // a poll reads whole frames, so less than one may be left over
+      if (!wait_until([] { return unread(pty) < SENSOR_FRAME_SIZE; },
+                      received)) {
+         timeouts++;
+      }
+
+      // the commands that answered this record in the capture
+      while (next_tx < tx.size() && tx[next_tx].stamp_ns < next_ns) {
+         expected += tx[next_tx++].data.size();
+      }
+      if (!wait_until([&] { return received->size() >= expected; },
+                      received)) {
+         timeouts++;
+         expected = received->size();
+      }
+   }
+
+   printf("replayed %zu bytes in %zu records in %.3f s, %.0f bytes/s, "
+          "%zu steps timed out\n", total, rx.size(),
+          monotonic_s() - start_s, total / (monotonic_s() - start_s),
+          timeouts);
+}
+
+static int usage() {
+   fprintf(stderr,
+           "usage: uart_replay CAPTURE [--link PATH] [--rate X] [--delay S] "
+           "[--check]\n"
+           "  CAPTURE    ring file of pi_comm_node with ~record_uart set\n"
+           "  --link     path of the terminal for pi_comm_node's ~port, "
+           "default " DEFAULT_LINK "\n"
+           "  --rate     1 for the timing of the capture, 0 for as fast as "
+           "the nodes answer\n"
+           "  --delay    seconds to wait for the nodes first, default 2\n"
+           "  --check    exit with 1 if the commands differ from the "
+           "capture\n");
+   return 2;
+}
+
+int main(int argc, char **argv) {
+   ReplayConfig config;
+   std::vector<UartRecord> rx;
+   std::vector<UartRecord> tx;
+   std::vector<uint8_t> received;
+   const uint8_t *nothing = NULL;
+   size_t none = 0;
+   int64_t clock_ns;
+   double start_s;
+   bool same;
+
+   ros::init(argc, argv, "uart_replay");
+   for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+
+      if (arg == "--check") {
+         config.check = true;
+      }
+      else if (arg == "--link" && i + 1 < argc) {
+         config.link = argv[++i];
+      }
+      else if (arg == "--rate" && i + 1 < argc) {
+         config.rate = atof(argv[++i]);
+      }
+      else if (arg == "--delay" && i + 1 < argc) {
+         config.delay = atof(argv[++i]);
+      }
+      else if (arg[0] != '-' && config.capture.empty()) {
+         config.capture = arg;
+      }
+      else {
+         return usage();
+      }
+   }
+   if (config.capture.empty() || config.rate < 0) {
+      return usage();
+   }
+
+   if (!read_capture(config.capture, &rx, &tx) ||
+       !open_pty(config.link, &pty)) {
+      return 1;
+   }
+
+   ros::NodeHandle nh;
+   clock_publisher = nh.advertise<rosgraph_msgs::Clock>("/clock", 1);
+
+   // the nodes start on the clock of one period before the first record, so
+   // that their first tick after it is the one that reads the record
+   clock_ns = rx[0].stamp_ns - 1000000000LL / LOOP_FREQUENCY;
+   start_s = monotonic_s();
+   while (monotonic_s() < start_s + config.delay && ros::ok()) {
+      publish_clock(clock_ns);
+      pump(pty, &nothing, &none, monotonic_s() + 0.1, &received);
+   }
+   // anything pi_comm_node writes before the replay starts is not compared
+   received.clear();
+
+   replay(config, rx, tx, clock_ns, &received);
+   pump(pty, &nothing, &none, monotonic_s() + DRAIN_S, &received);
+   same = compare(tx, received);
+
+   close_pty(config.link, &pty);
+   return config.check && !same ? 1 : 0;
+}
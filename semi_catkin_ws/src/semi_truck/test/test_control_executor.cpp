@@ -0,0 +1,172 @@
+/**
+ * @file Tests of the parts of the ControlExecutor that do not need ROS: the
+ * DurationHistogram that it keeps its statistics in, and how its schedule
+ * moves on after cycles that overrun, for every catch up policy, on made up
+ * times.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "control_executor.h"
+
+namespace {
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+typedef std::chrono::milliseconds ms;
+
+const ms PERIOD(10);
+
+TimePoint at_ms(int64_t time) {
+   return TimePoint(ms(time));
+}
+
+int64_t to_ms(TimePoint time) {
+   return std::chrono::duration_cast<ms>(time.time_since_epoch()).count();
+}
+
+/**
+ * @brief What a run of the control loop did on made up execution times.
+ */
+struct Schedule {
+   std::vector<int64_t> starts; // when each cycle started [ms]
+   uint64_t overruns;
+   uint64_t skipped;
+};
+
+/**
+ * @brief Runs the schedule of the control loop like run_loop() does, with
+ * cycles that take the given times and a sleep that is always on time.
+ */
+Schedule simulate(ControlExecutor::CatchUpPolicy policy, uint32_t max_catch_up,
+                  const std::vector<int64_t> &execution_ms) {
+   Schedule result = {std::vector<int64_t>(), 0, 0};
+   TimePoint next = at_ms(0);
+   TimePoint end = at_ms(0);
+
+   for (int64_t execution : execution_ms) {
+      TimePoint start = std::max(next, end);
+
+      end = start + ms(execution);
+      result.starts.push_back(to_ms(start));
+      ControlExecutor::ScheduleStep step = ControlExecutor::schedule(
+            policy, max_catch_up, std::chrono::duration_cast<
+            TimePoint::duration>(PERIOD), end, &next);
+      result.overruns += step.overrun;
+      result.skipped += step.skipped;
+   }
+   return result;
+}
+
+} // namespace
+
+TEST(DurationHistogram, Percentiles) {
+   DurationHistogram histogram(10);
+
+   for (uint32_t us = 0; us < 100; us++) {
+      histogram.record(us);
+   }
+   EXPECT_EQ(histogram.count(), 100u);
+   EXPECT_EQ(histogram.max(), 99u);
+   // the upper edge of the bin that holds the fraction
+   EXPECT_EQ(histogram.percentile(0.0), 10u);
+   EXPECT_EQ(histogram.percentile(0.5), 60u);
+   EXPECT_EQ(histogram.percentile(0.99), 100u);
+}
+
+TEST(DurationHistogram, OverflowBinReportsTheMax) {
+   DurationHistogram histogram(10);
+
+   // the 64 bins cover up to 640 us
+   for (int i = 0; i < 5; i++) {
+      histogram.record(5);
+   }
+   histogram.record(10000);
+
+   EXPECT_EQ(histogram.percentile(0.5), 10u);
+   EXPECT_EQ(histogram.percentile(0.99), 10000u);
+   EXPECT_EQ(histogram.max(), 10000u);
+
+   histogram.reset();
+   EXPECT_EQ(histogram.count(), 0u);
+   EXPECT_EQ(histogram.max(), 0u);
+   EXPECT_EQ(histogram.percentile(0.5), 0u);
+}
+
+TEST(DurationHistogram, ZeroBinWidthIsOneMicrosecond) {
+   // a rate fast enough that two periods are under 64 us
+   DurationHistogram histogram(0);
+
+   histogram.record(3);
+   EXPECT_EQ(histogram.percentile(0.5), 4u);
+}
+
+TEST(ControlExecutor, PeriodOfRate) {
+   EXPECT_EQ(ControlExecutor::period_of(50.0),
+             std::chrono::milliseconds(20));
+   EXPECT_THROW(ControlExecutor::period_of(0.0), std::invalid_argument);
+   EXPECT_THROW(ControlExecutor::period_of(-20.0), std::invalid_argument);
+   EXPECT_THROW(ControlExecutor::period_of(NAN), std::invalid_argument);
+}
+
+TEST(ControlExecutor, OnTimeCyclesKeepTheSchedule) {
+   for (auto policy : {ControlExecutor::SKIP_MISSED,
+                       ControlExecutor::RUN_MISSED,
+                       ControlExecutor::RESTART}) {
+      // a cycle that ends exactly when the next is due is not late
+      Schedule result = simulate(policy, 3, {3, 10, 9, 1});
+
+      EXPECT_EQ(result.starts, (std::vector<int64_t>{0, 10, 20, 30}));
+      EXPECT_EQ(result.overruns, 0u);
+      EXPECT_EQ(result.skipped, 0u);
+   }
+}
+
+TEST(ControlExecutor, SkipMissedStaysOnTheSchedule) {
+   // the second cycle runs into the ones due at 20 and 30
+   Schedule result = simulate(ControlExecutor::SKIP_MISSED, 3, {1, 25, 1, 1});
+
+   EXPECT_EQ(result.starts, (std::vector<int64_t>{0, 10, 40, 50}));
+   EXPECT_EQ(result.overruns, 1u);
+   EXPECT_EQ(result.skipped, 2u);
+}
+
+TEST(ControlExecutor, RunMissedCatchesUp) {
+   // the cycles due at 20 and 30 run back to back once it ends at 35
+   Schedule result = simulate(ControlExecutor::RUN_MISSED, 3, {1, 25, 1, 1, 1, 1});
+
+   EXPECT_EQ(result.starts,
+             (std::vector<int64_t>{0, 10, 35, 36, 40, 50}));
+   EXPECT_EQ(result.skipped, 0u);
+   // the first catch up cycle also ends after the next one was due
+   EXPECT_EQ(result.overruns, 2u);
+}
+
+TEST(ControlExecutor, RunMissedDropsBeyondMaxCatchUp) {
+   // ends at 95 with the 8 cycles from 20 to 90 due; the 3 newest run
+   Schedule result = simulate(ControlExecutor::RUN_MISSED, 3, {1, 85, 1, 1, 1, 1});
+
+   EXPECT_EQ(result.starts,
+             (std::vector<int64_t>{0, 10, 95, 96, 97, 100}));
+   EXPECT_EQ(result.skipped, 5u);
+}
+
+TEST(ControlExecutor, RunMissedWithoutCatchUpSkipsEverything) {
+   Schedule result = simulate(ControlExecutor::RUN_MISSED, 0, {1, 25, 1});
+
+   EXPECT_EQ(result.starts, (std::vector<int64_t>{0, 10, 40}));
+   EXPECT_EQ(result.skipped, 2u);
+}
+
+TEST(ControlExecutor, RestartStartsOverAfterTheLateCycle) {
+   Schedule result = simulate(ControlExecutor::RESTART, 3, {1, 25, 1, 1});
+
+   EXPECT_EQ(result.starts, (std::vector<int64_t>{0, 10, 45, 55}));
+   EXPECT_EQ(result.overruns, 1u);
+   EXPECT_EQ(result.skipped, 2u);
+}
@@ -0,0 +1,268 @@
+/**
+ * @file Tests of the ObstacleFusion on samples with known stamps: how the
+ * SampleRing finds the samples around a time, how they are interpolated or
+ * held, when they are too old to use, and how a scan is reduced to sectors.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "obstacle_fusion.h"
+
+namespace {
+
+const float INF = std::numeric_limits<float>::infinity();
+
+ros::Time at(double seconds) {
+   ros::Time time;
+   time.fromSec(seconds);
+   return time;
+}
+
+LidarLiteState reading(double seconds, float range) {
+   LidarLiteState state;
+
+   state.stamp = at(seconds);
+   state.range = range;
+   return state;
+}
+
+TeensyState tof(double seconds, int16_t left_mm, int16_t rear_mm) {
+   TeensyState sensors = {};
+
+   sensors.stamp = at(seconds);
+   sensors.left_TOF = left_mm;
+   sensors.rear_TOF = rear_mm;
+   return sensors;
+}
+
+} // namespace
+
+TEST(SampleRing, BracketFindsBothSides) {
+   SampleRing<LidarLiteState, 8> ring;
+   LidarLiteState before, after;
+
+   for (int i = 1; i <= 5; i++) {
+      ring.push(reading(i, i));
+   }
+
+   ASSERT_EQ(ring.bracket(at(2.5), &before, &after), 3);
+   EXPECT_EQ(before.range, 2.0f);
+   EXPECT_EQ(after.range, 3.0f);
+
+   // a sample at the time itself is the one before it
+   ASSERT_EQ(ring.bracket(at(3), &before, &after), 3);
+   EXPECT_EQ(before.range, 3.0f);
+   EXPECT_EQ(after.range, 4.0f);
+
+   ASSERT_EQ(ring.bracket(at(0.5), &before, &after), 2);
+   EXPECT_EQ(after.range, 1.0f);
+   ASSERT_EQ(ring.bracket(at(9), &before, &after), 1);
+   EXPECT_EQ(before.range, 5.0f);
+
+   SampleRing<LidarLiteState, 8> empty;
+   EXPECT_EQ(empty.bracket(at(1), &before, &after), 0);
+}
+
+TEST(SampleRing, BracketAfterWrap) {
+   SampleRing<LidarLiteState, 4> ring;
+   LidarLiteState before, after;
+
+   for (int i = 1; i <= 10; i++) {
+      ring.push(reading(i, i));
+   }
+
+   ASSERT_EQ(ring.bracket(at(8.5), &before, &after), 3);
+   EXPECT_EQ(before.range, 8.0f);
+   EXPECT_EQ(after.range, 9.0f);
+
+   // 7 is the oldest sample left, the ones before it were overwritten
+   ASSERT_EQ(ring.bracket(at(6.5), &before, &after), 2);
+   EXPECT_EQ(after.range, 7.0f);
+   ASSERT_EQ(ring.bracket(at(2), &before, &after), 2);
+   EXPECT_EQ(after.range, 7.0f);
+}
+
+TEST(SampleRing, BracketWhileTheWriterLaps) {
+   // a ring small enough that the writer laps the readers all the time;
+   // what they find must still be two neighbouring samples
+   SampleRing<LidarLiteState, 4> ring;
+   std::atomic<bool> running(true);
+   std::atomic<int> pushed(0);
+   uint64_t brackets = 0, both = 0, bad = 0;
+
+   // bursts that lap the readers, with pauses in which they find both
+   std::thread writer([&] {
+      for (int i = 1; running; i++) {
+         ring.push(reading(i, i));
+         pushed = i;
+         if (i % 100 == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+         }
+      }
+   });
+
+   while (brackets < 200000 || pushed < 1000) {
+      LidarLiteState before, after;
+      // from just after the newest sample to one that is being overwritten
+      double time = pushed.load() - (brackets % 4) + 0.5;
+      int found = ring.bracket(at(time), &before, &after);
+
+      if (((found & 1) && before.stamp > at(time)) ||
+          ((found & 2) && after.stamp <= at(time)) ||
+          (found == 3 && after.range != before.range + 1)) {
+         bad++;
+      }
+      both += found == 3;
+      brackets++;
+   }
+   running = false;
+   writer.join();
+
+   EXPECT_EQ(bad, 0u);
+   EXPECT_GT(both, 0u);
+}
+
+TEST(ObstacleFusion, InterpolatesBetweenSamples) {
+   FusionConfig config;
+   ObstacleFusion fusion;
+   ObstacleFrame frame;
+
+   fusion.configure(config);
+
+   fusion.add_lidar_lite(reading(1.0, 1.0f));
+   fusion.add_lidar_lite(reading(1.1, 2.0f));
+
+   fusion.assemble(at(1.025), &frame);
+   ASSERT_TRUE(frame.valid & ObstacleFrame::LIDAR_LITE);
+   EXPECT_NEAR(frame.lidar_lite, 1.25f, 1e-4);
+   EXPECT_NEAR(frame.lidar_lite_age, 0.025f, 1e-4);
+
+   fusion.assemble(at(1.075), &frame);
+   EXPECT_NEAR(frame.lidar_lite, 1.75f, 1e-4);
+   EXPECT_NEAR(frame.lidar_lite_age, 0.025f, 1e-4);
+
+   // past the last sample it is held, and ages
+   fusion.assemble(at(1.2), &frame);
+   EXPECT_EQ(frame.lidar_lite, 2.0f);
+   EXPECT_NEAR(frame.lidar_lite_age, 0.1f, 1e-4);
+   fusion.assemble(at(1.1 + config.lidar_lite_max_age + 0.01), &frame);
+   EXPECT_FALSE(frame.valid & ObstacleFrame::LIDAR_LITE);
+   EXPECT_EQ(frame.lidar_lite, INF);
+
+   // before the first one as well
+   fusion.assemble(at(0.95), &frame);
+   EXPECT_EQ(frame.lidar_lite, 1.0f);
+   EXPECT_NEAR(frame.lidar_lite_age, 0.05f, 1e-4);
+}
+
+TEST(ObstacleFusion, GapBetweenSamplesIsNotFresh) {
+   FusionConfig config;
+   ObstacleFusion fusion;
+   ObstacleFrame frame;
+
+   fusion.configure(config);
+
+   // a 2 s dropout with a single sample after it
+   fusion.add_lidar_lite(reading(1.0, 1.0f));
+   fusion.add_lidar_lite(reading(3.0, 3.0f));
+   fusion.add_tof(tof(1.0, 1000, 1000));
+   fusion.add_tof(tof(3.0, 3000, 3000));
+
+   fusion.assemble(at(2.0), &frame);
+   EXPECT_NEAR(frame.lidar_lite_age, 1.0f, 1e-4);
+   EXPECT_NEAR(frame.tof_age, 1.0f, 1e-4);
+   EXPECT_FALSE(frame.valid & ObstacleFrame::LIDAR_LITE);
+   EXPECT_FALSE(frame.valid & ObstacleFrame::TOF);
+   EXPECT_EQ(frame.lidar_lite, INF);
+   EXPECT_EQ(frame.left_tof, INF);
+
+   // close to either end of the gap the nearer sample is recent enough
+   fusion.assemble(at(2.9), &frame);
+   EXPECT_TRUE(frame.valid & ObstacleFrame::LIDAR_LITE);
+   EXPECT_NEAR(frame.lidar_lite_age, 0.1f, 1e-4);
+   EXPECT_NEAR(frame.lidar_lite, 2.9f, 1e-4);
+}
+
+TEST(ObstacleFusion, MissingReturnIsNotInterpolated) {
+   FusionConfig config;
+   ObstacleFusion fusion;
+   ObstacleFrame frame;
+
+   fusion.configure(config);
+
+   // the left sensor has no return at first, the rear one always has
+   fusion.add_tof(tof(1.0, 0, 1000));
+   fusion.add_tof(tof(1.05, 500, 2000));
+
+   fusion.assemble(at(1.01), &frame);
+   ASSERT_TRUE(frame.valid & ObstacleFrame::TOF);
+   EXPECT_EQ(frame.left_tof, INF);
+   EXPECT_NEAR(frame.rear_tof, 1.2f, 1e-4);
+
+   fusion.assemble(at(1.04), &frame);
+   EXPECT_EQ(frame.left_tof, 0.5f);
+   EXPECT_NEAR(frame.rear_tof, 1.8f, 1e-4);
+}
+
+TEST(ObstacleFusion, TofAgesOutWhenTheTeensyGoesSilent) {
+   FusionConfig config;
+   ObstacleFusion fusion;
+   ObstacleFrame frame;
+
+   fusion.configure(config);
+
+   for (int i = 0; i < 4; i++) {
+      // stamped when received, as pi_comm_node only publishes fresh data
+      fusion.add_tof(tof(10.0 + i * 0.05, 500, 0));
+   }
+
+   fusion.assemble(at(10.2), &frame);
+   EXPECT_TRUE(frame.valid & ObstacleFrame::TOF);
+   EXPECT_FLOAT_EQ(frame.left_tof, 0.5f);
+
+   fusion.assemble(at(10.15 + config.tof_max_age + 0.01), &frame);
+   EXPECT_FALSE(frame.valid & ObstacleFrame::TOF);
+   EXPECT_TRUE(std::isinf(frame.left_tof));
+}
+
+TEST(ObstacleFusion, SectorsWrapAroundTheOffset) {
+   FusionConfig config;
+   ObstacleFusion fusion;
+   RplidarState scan;
+   ObstacleFrame frame;
+
+   // the front is at 350 degrees, so FRONT spans 327.5 to 12.5
+   config.sector_offset = 350.0f;
+   fusion.configure(config);
+
+   scan.stamp = at(1.0);
+   for (int i = 0; i < RplidarState::NUM_BINS; i++) {
+      scan.range[i] = INF;
+   }
+   scan.range[5] = 1.0f;
+   scan.range[330] = 1.5f;
+   scan.range[30] = 3.0f;
+   scan.range[170] = 4.0f;
+   scan.range[325] = 5.0f;
+   fusion.add_rplidar(scan);
+
+   fusion.assemble(at(1.0), &frame);
+   ASSERT_TRUE(frame.valid & ObstacleFrame::RPLIDAR);
+   EXPECT_EQ(frame.sector[ObstacleFrame::FRONT], 1.0f);
+   EXPECT_EQ(frame.sector[ObstacleFrame::FRONT_LEFT], 3.0f);
+   EXPECT_EQ(frame.sector[ObstacleFrame::REAR], 4.0f);
+   EXPECT_EQ(frame.sector[ObstacleFrame::FRONT_RIGHT], 5.0f);
+   EXPECT_EQ(frame.sector[ObstacleFrame::LEFT], INF);
+   EXPECT_EQ(frame.sector[ObstacleFrame::RIGHT], INF);
+
+   // a scan older than rplidar_max_age leaves every sector clear
+   fusion.assemble(at(1.0 + config.rplidar_max_age + 0.01), &frame);
+   EXPECT_FALSE(frame.valid & ObstacleFrame::RPLIDAR);
+   EXPECT_EQ(frame.sector[ObstacleFrame::FRONT], INF);
+}
@@ -0,0 +1,237 @@
+/**
+ * @file Tests of the vehicle model of the simulator against closed form
+ * kinematics and a map of known walls, and how fast it runs on the arena
+ * map compared to real time.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "truck_sim.h"
+
+namespace {
+
+const double DT = 1.0 / 200; // the default ~physics_rate of truck_sim_node
+const int16_t STRAIGHT = 90;
+const int16_t FULL_LEFT = 0;
+
+/**
+ * @brief Steps the model for a time with the fifth wheel locked.
+ */
+void drive(TruckSim *truck, double seconds, DriveMode mode, double speed,
+           int16_t steer_output, bool fifth_locked = true) {
+   int steps = (int)std::lround(seconds / DT);
+
+   for (int i = 0; i < steps; i++) {
+      truck->step(DT, mode, speed, steer_output, fifth_locked);
+   }
+}
+
+double articulation(const TruckSim &truck) {
+   return std::remainder(truck.theta() - truck.trailer_heading(), 2 * M_PI);
+}
+
+/**
+ * @brief A wall from (x1, y1) to (x2, y2).
+ */
+Segment wall(double x1, double y1, double x2, double y2) {
+   Segment segment = {x1, y1, x2, y2};
+   return segment;
+}
+
+} // namespace
+
+TEST(TruckSim, DrivesStraight) {
+   TruckParams params = default_truck_params();
+   SimMap map;
+   TruckSim truck(params, map);
+
+   // ten time constants of the drivetrain to reach the speed
+   drive(&truck, 10 * params.speed_tau, DRIVE_POWER, 1.0, STRAIGHT);
+   EXPECT_NEAR(truck.speed(), 1.0, 1e-3);
+
+   double x = truck.x();
+   int16_t ticks = truck.ticks();
+   drive(&truck, 1.0, DRIVE_POWER, 1.0, STRAIGHT);
+   EXPECT_NEAR(truck.x() - x, 1.0, 1e-3);
+   EXPECT_EQ(truck.y(), 0.0);
+   EXPECT_EQ(truck.theta(), 0.0);
+   EXPECT_EQ(truck.trailer_heading(), 0.0);
+   EXPECT_EQ(truck.imu_angle(), 0);
+   EXPECT_NEAR(truck.ticks() - ticks, params.ticks_per_meter, 1.0);
+
+   // braking stops it in v^2 / 2a
+   x = truck.x();
+   drive(&truck, 1.0, DRIVE_BRAKE, 0.0, STRAIGHT);
+   EXPECT_EQ(truck.speed(), 0.0);
+   EXPECT_NEAR(truck.x() - x, 1.0 / (2 * params.brake_decel), 0.01);
+}
+
+TEST(TruckSim, ConstantSteerDrivesACircle) {
+   TruckParams params = default_truck_params();
+   SimMap map;
+   TruckSim truck(params, map);
+   const double speed = 0.5;
+   double radius = params.wheelbase / std::tan(params.max_steer);
+
+   drive(&truck, 10 * params.speed_tau, DRIVE_POWER, speed, FULL_LEFT);
+   ASSERT_NEAR(truck.speed(), speed, 1e-3);
+   EXPECT_NEAR(truck.steer_angle(), params.max_steer, 1e-9);
+
+   // the rear axle turns about a fixed center to its left
+   double center_x = truck.x() - radius * std::sin(truck.theta());
+   double center_y = truck.y() + radius * std::cos(truck.theta());
+   double theta = truck.theta();
+   drive(&truck, 1.0, DRIVE_POWER, speed, FULL_LEFT);
+   EXPECT_NEAR(std::remainder(truck.theta() - theta, 2 * M_PI),
+               std::remainder(speed / radius, 2 * M_PI), 1e-3);
+   for (int i = 0; i < 20; i++) {
+      drive(&truck, 0.5, DRIVE_POWER, speed, FULL_LEFT);
+      EXPECT_NEAR(std::hypot(truck.x() - center_x, truck.y() - center_y),
+                  radius, 0.01);
+   }
+
+   // the BNO055 counts clockwise
+   int16_t expected = (int16_t)std::lround(-truck.theta() * 180.0 / M_PI);
+   EXPECT_EQ(truck.imu_angle(), (expected % 360 + 360) % 360);
+
+   // the trailer settles where its axle rolls on a circle about the same
+   // center, behind the kingpin, up to the error of the Euler steps
+   double kingpin_radius = std::hypot(radius, params.hitch_offset);
+   EXPECT_NEAR(articulation(truck),
+               std::atan(params.hitch_offset / radius) +
+               std::asin(params.trailer_length / kingpin_radius), 0.005);
+}
+
+TEST(TruckSim, ArticulationIsLimited) {
+   TruckParams params = default_truck_params();
+   SimMap map;
+   TruckSim truck(params, map);
+
+   // reversing with the wheels turned folds the trailer up
+   double largest = 0.0;
+   for (int i = 0; i < 100; i++) {
+      drive(&truck, 0.1, DRIVE_POWER, -0.5, FULL_LEFT);
+      largest = std::max(largest, std::fabs(articulation(truck)));
+   }
+   EXPECT_NEAR(largest, params.max_articulation, 1e-9);
+   EXPECT_NEAR(std::fabs(articulation(truck)), params.max_articulation, 1e-9);
+
+   // and driving forward straightens it out again
+   drive(&truck, 10.0, DRIVE_POWER, 0.5, STRAIGHT);
+   EXPECT_LT(std::fabs(articulation(truck)), 0.01);
+}
+
+TEST(TruckSim, FifthWheelCouplesAndUncouples) {
+   TruckParams params = default_truck_params();
+   SimMap map;
+   TruckSim truck(params, map);
+
+   // unlocked while standing or reversing, the trailer stays on
+   drive(&truck, 0.5, DRIVE_BRAKE, 0.0, STRAIGHT, false);
+   drive(&truck, 0.2, DRIVE_POWER, -0.3, STRAIGHT, false);
+   EXPECT_TRUE(truck.coupled());
+   drive(&truck, 0.5, DRIVE_BRAKE, 0.0, STRAIGHT, false);
+
+   // driving off unlocked leaves it behind
+   drive(&truck, 0.2, DRIVE_POWER, 0.5, STRAIGHT, false);
+   EXPECT_FALSE(truck.coupled());
+   drive(&truck, 2.0, DRIVE_POWER, 0.5, FULL_LEFT, false);
+   EXPECT_FALSE(truck.coupled());
+   EXPECT_EQ(truck.trailer_heading(), 0.0);
+   EXPECT_EQ(truck.tof_mm(REAR_TOF_MOUNT), 0);
+
+   // locking it away from the kingpin does not pick the trailer up
+   drive(&truck, 1.0, DRIVE_BRAKE, 0.0, STRAIGHT, true);
+   EXPECT_FALSE(truck.coupled());
+
+   // backing up straight onto the kingpin does
+   TruckSim straight(params, map);
+   double kingpin_x = -params.hitch_offset;
+   drive(&straight, 0.5, DRIVE_POWER, 0.5, STRAIGHT, false);
+   ASSERT_FALSE(straight.coupled());
+   drive(&straight, 0.5, DRIVE_BRAKE, 0.0, STRAIGHT, true);
+   while (!straight.coupled() && straight.x() > -0.1) {
+      straight.step(DT, DRIVE_POWER, -0.2, STRAIGHT, true);
+   }
+   ASSERT_TRUE(straight.coupled());
+   EXPECT_NEAR(straight.x() - params.hitch_offset, kingpin_x,
+               params.couple_distance);
+
+   // and the trailer follows again
+   drive(&straight, 3.0, DRIVE_POWER, 0.5, FULL_LEFT);
+   EXPECT_TRUE(straight.coupled());
+   EXPECT_GT(std::fabs(articulation(straight)), 0.1);
+   EXPECT_NE(straight.tof_mm(REAR_TOF_MOUNT), 0);
+}
+
+TEST(TruckSim, RangesHitTheMap) {
+   TruckParams params = default_truck_params();
+   SimMap map;
+
+   map.add(wall(2.0, -5.0, 2.0, 5.0));   // ahead
+   map.add(wall(-5.0, 1.0, 5.0, 1.0));   // to the left
+   map.add(wall(-1.5, -5.0, -1.5, 5.0)); // behind the trailer
+   TruckSim truck(params, map);
+
+   // the lidar is 0.2 m ahead of the rear axle
+   EXPECT_NEAR(truck.range(RPLIDAR_MOUNT, 0.0, 8.0), 1.8, 1e-9);
+   EXPECT_NEAR(truck.range(RPLIDAR_MOUNT, -M_PI / 3, 8.0), 3.6, 1e-9);
+   EXPECT_NEAR(truck.range(RPLIDAR_MOUNT, M_PI / 2, 8.0), 1.0, 1e-9);
+   // it sees the front of the trailer behind it
+   EXPECT_NEAR(truck.range(RPLIDAR_MOUNT, M_PI, 8.0),
+               0.2 + params.hitch_offset - params.trailer_front, 1e-9);
+   EXPECT_EQ(truck.range(RPLIDAR_MOUNT, -M_PI / 2, 0.5), 0.5);
+
+   EXPECT_EQ(truck.tof_mm(LEFT_TOF_MOUNT),
+             (int16_t)std::lround((1.0 - LEFT_TOF_MOUNT.y) * 1000));
+   EXPECT_EQ(truck.tof_mm(RIGHT_TOF_MOUNT), 8190); // nothing within 2 m
+   double trailer_back = params.hitch_offset + params.trailer_length -
+                         REAR_TOF_MOUNT.x;
+   EXPECT_EQ(truck.tof_mm(REAR_TOF_MOUNT),
+             (int16_t)std::lround((1.5 - trailer_back) * 1000));
+
+   // turned to face the left wall, the lidar looks along the map's y axis
+   truck.reset(0.0, 0.0, M_PI / 2, true);
+   EXPECT_NEAR(truck.range(RPLIDAR_MOUNT, 0.0, 8.0), 0.8, 1e-9);
+   EXPECT_NEAR(truck.range(RPLIDAR_MOUNT, -M_PI / 2, 8.0), 2.0, 1e-9);
+   EXPECT_EQ(truck.imu_angle(), 270);
+}
+
+TEST(TruckSim, LockstepSpeed) {
+   // what truck_sim_node does per simulated second with its default rates,
+   // without ROS and the terminal: the model at 200 Hz, the three ToF
+   // sensors at 10 Hz and a 360 sample RPLIDAR scan at 10 Hz. In lockstep
+   // this bounds how much faster than real time the simulation can go.
+   SimMap map;
+   ASSERT_TRUE(map.load(std::string(__FILE__).substr(
+         0, std::string(__FILE__).rfind('/')) + "/../maps/arena.txt"));
+   ASSERT_EQ(map.segments().size(), 10u);
+   TruckSim truck(default_truck_params(), map);
+   const int seconds = 60;
+   double sum = 0.0;
+
+   auto start = std::chrono::steady_clock::now();
+   for (int step = 1; step <= seconds * 200; step++) {
+      truck.step(DT, DRIVE_POWER, 0.5, FULL_LEFT, true);
+      if (step % 20 == 0) {
+         sum += truck.tof_mm(RIGHT_TOF_MOUNT) + truck.tof_mm(LEFT_TOF_MOUNT) +
+                truck.tof_mm(REAR_TOF_MOUNT);
+      }
+      // the rays of the sweep that fall into this step
+      for (int i = 0; i < 360 / 20; i++) {
+         sum += truck.range(RPLIDAR_MOUNT, i * 2 * M_PI / 360, 8.0);
+      }
+   }
+   double wall_s = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+   printf("TruckSim on maps/arena.txt: %d s simulated in %.3f s, %.0fx real "
+          "time\n", seconds, wall_s, seconds / wall_s);
+   RecordProperty("speedup", (int)(seconds / wall_s));
+   EXPECT_GT(sum, 0.0);
+   EXPECT_GT(seconds / wall_s, 1.0);
+}
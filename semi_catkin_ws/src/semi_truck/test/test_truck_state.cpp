@@ -0,0 +1,285 @@
+/**
+ * @file Stress tests for the SeqLock and the TruckState built on it: one
+ * writer per value as fast as it can go, several readers, and every value
+ * that a reader gets must be one that was written as a whole. Also how many
+ * snapshots and writes per second the TruckState takes with that going on.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "truck_state.h"
+
+namespace {
+
+const int NUM_READERS = 3;
+const auto RUN_TIME = std::chrono::milliseconds(500);
+
+/**
+ * @brief A value of several words that has every word set to the same
+ * counter, so a torn read shows up as words that differ.
+ */
+template <size_t N>
+struct Counters {
+   uint32_t word[N];
+
+   void set(uint32_t count) {
+      for (size_t i = 0; i < N; i++) {
+         word[i] = count;
+      }
+   }
+
+   bool whole() const {
+      for (size_t i = 1; i < N; i++) {
+         if (word[i] != word[0]) {
+            return false;
+         }
+      }
+      return true;
+   }
+};
+
+/**
+ * @brief Runs a writer that stores values 1, 2, 3, ... with store(count)
+ * and NUM_READERS readers that call check(), which returns the count that it
+ * read or -1 for a torn read. Fails on a torn read or on a count going
+ * backwards, and returns the number of reads.
+ */
+template <typename Store, typename Check>
+uint64_t stress(Store store, Check check) {
+   std::atomic<bool> running(true);
+   std::atomic<uint64_t> reads(0);
+   std::atomic<uint64_t> torn(0);
+   std::atomic<uint64_t> backwards(0);
+   std::vector<std::thread> readers;
+   uint32_t count = 0;
+
+   for (int i = 0; i < NUM_READERS; i++) {
+      readers.emplace_back([&] {
+         int64_t last = 0;
+         uint64_t n = 0;
+
+         while (running.load(std::memory_order_relaxed)) {
+            int64_t value = check();
+            if (value < 0) {
+               torn++;
+            }
+            else if (value < last) {
+               backwards++;
+            }
+            else {
+               last = value;
+            }
+            n++;
+         }
+         reads += n;
+      });
+   }
+
+   auto end = std::chrono::steady_clock::now() + RUN_TIME;
+   while (std::chrono::steady_clock::now() < end) {
+      for (int i = 0; i < 1000; i++) {
+         store(++count);
+      }
+   }
+   running = false;
+   for (auto &reader : readers) {
+      reader.join();
+   }
+
+   EXPECT_EQ(torn.load(), 0u);
+   EXPECT_EQ(backwards.load(), 0u);
+   EXPECT_GT(count, 1000u);
+   return reads;
+}
+
+} // namespace
+
+TEST(SeqLock, RoundTripsOddSizes) {
+   struct Odd {
+      uint8_t a;
+      uint16_t b;
+      uint8_t c[9];
+   };
+   SeqLock<Odd> lock;
+   Odd in = {1, 0x2345, {1, 2, 3, 4, 5, 6, 7, 8, 9}};
+
+   lock.store(in);
+   Odd out = lock.load();
+   EXPECT_EQ(out.a, in.a);
+   EXPECT_EQ(out.b, in.b);
+   EXPECT_EQ(memcmp(out.c, in.c, sizeof(in.c)), 0);
+}
+
+TEST(SeqLock, ValidateRejectsReadDuringWrite) {
+   SeqLock<Counters<4>> lock;
+   Counters<4> value;
+   uint32_t seq;
+
+   value.set(1);
+   seq = lock.begin();
+   lock.store(value);
+   EXPECT_FALSE(lock.validate(seq));
+
+   seq = lock.begin();
+   EXPECT_TRUE(lock.validate(seq));
+}
+
+TEST(SeqLock, StressSmallValue) {
+   SeqLock<Counters<4>> lock;
+
+   uint64_t reads = stress(
+      [&](uint32_t count) {
+         Counters<4> value;
+         value.set(count);
+         lock.store(value);
+      },
+      [&]() -> int64_t {
+         Counters<4> value = lock.load();
+         return value.whole() ? value.word[0] : -1;
+      });
+   EXPECT_GT(reads, 0u);
+}
+
+TEST(SeqLock, StressLargeValue) {
+   // as large as an RplidarState, so a write takes long enough that readers
+   // often overlap it and have to retry
+   SeqLock<Counters<RplidarState::NUM_BINS>> lock;
+
+   uint64_t reads = stress(
+      [&](uint32_t count) {
+         Counters<RplidarState::NUM_BINS> value;
+         value.set(count);
+         lock.store(value);
+      },
+      [&]() -> int64_t {
+         Counters<RplidarState::NUM_BINS> value = lock.load();
+         return value.whole() ? value.word[0] : -1;
+      });
+   EXPECT_GT(reads, 0u);
+}
+
+TEST(TruckState, StressSnapshot) {
+   TruckState state;
+   std::atomic<bool> running(true);
+
+   // a second writer on another part, so snapshot() also retries when a
+   // different part changes under it
+   std::thread lidar_lite_writer([&] {
+      sensor_msgs::Range msg;
+      float range = 0;
+
+      while (running) {
+         msg.range = range++;
+         state.update_lidar_lite(msg);
+      }
+   });
+
+   uint64_t reads = stress(
+      [&](uint32_t count) {
+         RplidarState rplidar;
+         rplidar.stamp = ros::Time(count, 0);
+         for (int i = 0; i < RplidarState::NUM_BINS; i++) {
+            rplidar.range[i] = (float)count;
+         }
+         state.update_rplidar(rplidar);
+      },
+      [&]() -> int64_t {
+         TruckSnapshot snapshot;
+         state.snapshot(&snapshot);
+
+         float count = (float)snapshot.rplidar.stamp.sec;
+         for (int i = 0; i < RplidarState::NUM_BINS; i++) {
+            if (snapshot.rplidar.range[i] != count) {
+               return -1;
+            }
+         }
+         return snapshot.rplidar.stamp.sec;
+      });
+
+   running = false;
+   lidar_lite_writer.join();
+   EXPECT_GT(reads, 0u);
+}
+
+TEST(SeqLock, ReadCost) {
+   SeqLock<TeensyState> lock;
+   TeensyState value = {};
+   const int N = 1000000;
+
+   lock.store(value);
+   auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < N; i++) {
+      value = lock.load();
+      asm volatile("" : : "r"(&value) : "memory");
+   }
+   double ns = std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - start).count() / N;
+
+   // an uncontended read is a few loads, far below a mutex round trip
+   printf("SeqLock<TeensyState>::load: %.1f ns\n", ns);
+   RecordProperty("load_ns", (int)ns);
+   EXPECT_LT(ns, 1000.0);
+}
+
+TEST(TruckState, SnapshotThroughput) {
+   // one writer storing scans back to back, the worst case for snapshot(),
+   // against 1 to 4 readers. With fewer cores than threads a reader that
+   // runs while the writer is preempted in a store spins out its time slice,
+   // so the snapshot rate is only meaningful on the Pi's 4 cores.
+   const auto run_time = std::chrono::milliseconds(200);
+
+   for (int num_readers : {1, 2, 4}) {
+      TruckState state;
+      std::atomic<bool> running(true);
+      std::atomic<uint64_t> reads(0);
+      std::vector<std::thread> readers;
+      uint64_t writes = 0;
+
+      for (int i = 0; i < num_readers; i++) {
+         readers.emplace_back([&] {
+            TruckSnapshot snapshot;
+            uint64_t n = 0;
+
+            while (running.load(std::memory_order_relaxed)) {
+               state.snapshot(&snapshot);
+               asm volatile("" : : "r"(&snapshot) : "memory");
+               n++;
+            }
+            reads += n;
+         });
+      }
+
+      RplidarState rplidar;
+      for (int i = 0; i < RplidarState::NUM_BINS; i++) {
+         rplidar.range[i] = 1.0f;
+      }
+      auto start = std::chrono::steady_clock::now();
+      auto end = start + run_time;
+      while (std::chrono::steady_clock::now() < end) {
+         for (int i = 0; i < 100; i++) {
+            rplidar.stamp = ros::Time(writes++, 0);
+            state.update_rplidar(rplidar);
+         }
+      }
+      running = false;
+      for (auto &reader : readers) {
+         reader.join();
+      }
+      double s = std::chrono::duration<double>(
+         std::chrono::steady_clock::now() - start).count();
+
+      printf("TruckState, %d readers, 1 writer: %.0f snapshots/s, "
+             "%.0f writes/s\n", num_readers, reads / s, writes / s);
+      RecordProperty("snapshots_per_s_" + std::to_string(num_readers),
+                     (int)(reads / s));
+      RecordProperty("writes_per_s_" + std::to_string(num_readers),
+                     (int)(writes / s));
+      // the writer never waits for the readers
+      EXPECT_GT(writes, 1000u);
+   }
+}
@@ -0,0 +1,245 @@
+/**
+ * @file Records a small UART capture the way pi_comm_node does with
+ * ~record_uart, reads it back with read_capture(), replays its uart_rx
+ * records through the pseudo terminal of uart_replay to a stand in for
+ * pi_comm_node that answers with the captured commands, and checks what
+ * --check compares, also against captures with a damaged command.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <flight_recorder/recorder.h>
+#include "semi_truck/Teensy_Sensors.h"
+#include "semi_truck/Uart_Bytes.h"
+#include "teensy_protocol.h"
+#include "uart_capture.h"
+
+namespace {
+
+const int FRAMES = 20;
+const int64_t PERIOD_NS = SERIAL_SEND_MS * 1000000LL;
+
+void put_word(std::vector<uint8_t> *bytes, int16_t word) {
+   bytes->push_back((uint8_t)(word & 0xFF));
+   bytes->push_back((uint8_t)((word >> 8) & 0xFF));
+}
+
+/**
+ * @brief A sensor frame from the Teensy whose words count up from n.
+ */
+std::vector<uint8_t> sensor_frame(int n) {
+   std::vector<uint8_t> bytes;
+
+   put_word(&bytes, CMD_FRAME_SYNC);
+   for (int word = 1; word < SENSOR_FRAME_SIZE / 2; word++) {
+      put_word(&bytes, (int16_t)(n + word));
+   }
+   return bytes;
+}
+
+/**
+ * @brief The command frame that pi_comm_node answers sensor frame n with.
+ */
+std::vector<uint8_t> command_frame(int n, uint16_t seq) {
+   std::vector<uint8_t> bytes;
+
+   put_word(&bytes, CMD_FRAME_SYNC);
+   put_word(&bytes, (int16_t)(n % 100));  // motor_output
+   put_word(&bytes, (int16_t)(90 - n));   // steer_output
+   put_word(&bytes, FIFTH_LOCKED);        // fifth_output
+   put_word(&bytes, MOTOR_MODE_THROTTLE); // motor_mode
+   put_word(&bytes, (int16_t)seq);
+   return bytes;
+}
+
+/**
+ * @brief A ring file in /tmp with a capture of FRAMES sensor frames, each
+ * answered by a command, removed again after the test.
+ */
+class UartReplay : public ::testing::Test {
+protected:
+   void SetUp() override {
+      char path[] = "/tmp/uart_replay_testXXXXXX";
+      int fd = mkstemp(path);
+      flight_recorder::FlightRecorder recorder;
+      flight_recorder::RecorderConfig config;
+
+      ASSERT_GE(fd, 0);
+      close(fd);
+      path_ = path;
+      link_ = path_ + ".pty";
+      config.path = path_;
+      config.chunk_size = 64 * 1024;
+      config.num_chunks = 4;
+      ASSERT_TRUE(recorder.open(config));
+
+      uint16_t rx = recorder.add_stream<semi_truck::Uart_Bytes>(
+       "/pi_comm_node/uart_rx");
+      uint16_t tx = recorder.add_stream<semi_truck::Uart_Bytes>(
+       "/pi_comm_node/uart_tx");
+      // the decoded frames are in the same ring and are not replayed
+      uint16_t sensors = recorder.add_stream<semi_truck::Teensy_Sensors>(
+       "/pi_comm_node/teensy_sensor_data");
+      for (int i = 0; i < FRAMES; i++) {
+         semi_truck::Uart_Bytes bytes;
+         ros::Time stamp;
+
+         stamp.fromNSec(1000000000LL + i * PERIOD_NS);
+         bytes.data = sensor_frame(i);
+         ASSERT_TRUE(recorder.record(rx, stamp, bytes));
+         ASSERT_TRUE(recorder.record(sensors, stamp,
+                                     semi_truck::Teensy_Sensors()));
+         stamp.fromNSec(stamp.toNSec() + 1000000);
+         // a seq that the replay does not reproduce
+         bytes.data = command_frame(i, (uint16_t)(5000 + i));
+         ASSERT_TRUE(recorder.record(tx, stamp, bytes));
+      }
+      recorder.close();
+   }
+
+   void TearDown() override {
+      close_pty(link_, &pty_);
+      unlink(path_.c_str());
+   }
+
+   /**
+    * @brief Replays the rx records through the terminal like uart_replay
+    * does, while the other end reads each one and writes the commands that
+    * answered it, with seqs from 0 like a fresh pi_comm_node.
+    *
+    * @return what uart_replay read back from the terminal
+    */
+   std::vector<uint8_t> replay(const std::vector<UartRecord> &rx,
+                               const std::vector<UartRecord> &tx) {
+      std::vector<uint8_t> received;
+      const uint8_t *nothing = NULL;
+      size_t none = 0;
+      uint16_t seq = 0;
+      int node;
+
+      EXPECT_TRUE(open_pty(link_, &pty_));
+      node = open(link_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+      EXPECT_GE(node, 0);
+
+      for (size_t i = 0; i < rx.size(); i++) {
+         const uint8_t *out = rx[i].data.data();
+         size_t out_size = rx[i].data.size();
+         std::vector<uint8_t> read_back;
+
+         pump(pty_, &out, &out_size, 0, &received);
+         EXPECT_EQ(out_size, 0u);
+         // the terminal hands the bytes over a little later
+         double deadline_s = monotonic_s() + 1.0;
+         while (read_back.size() < rx[i].data.size() &&
+                monotonic_s() < deadline_s) {
+            uint8_t bytes[64];
+            ssize_t count = read(node, bytes, sizeof(bytes));
+
+            if (count > 0) {
+               read_back.insert(read_back.end(), bytes, bytes + count);
+            }
+         }
+         EXPECT_EQ(read_back, rx[i].data) << i;
+         EXPECT_EQ(unread(pty_), 0);
+
+         std::vector<uint8_t> answer = tx[i].data;
+         answer[CMD_FRAME_SIZE_W_SYNC - 2] = (uint8_t)(seq & 0xFF);
+         answer[CMD_FRAME_SIZE_W_SYNC - 1] = (uint8_t)(seq++ >> 8);
+         EXPECT_EQ(write(node, answer.data(), answer.size()),
+                   (ssize_t)answer.size());
+         pump(pty_, &nothing, &none, monotonic_s() + 0.01, &received);
+      }
+      pump(pty_, &nothing, &none, monotonic_s() + 0.1, &received);
+      close(node);
+      return received;
+   }
+
+   std::string path_;
+   std::string link_;
+   ReplayPty pty_;
+};
+
+} // namespace
+
+TEST_F(UartReplay, ReadsTheCapture) {
+   std::vector<UartRecord> rx;
+   std::vector<UartRecord> tx;
+
+   ASSERT_TRUE(read_capture(path_, &rx, &tx));
+   ASSERT_EQ(rx.size(), (size_t)FRAMES);
+   ASSERT_EQ(tx.size(), (size_t)FRAMES);
+   for (int i = 0; i < FRAMES; i++) {
+      EXPECT_EQ(rx[i].stamp_ns, 1000000000LL + i * PERIOD_NS);
+      EXPECT_EQ(rx[i].data, sensor_frame(i));
+      EXPECT_EQ(tx[i].stamp_ns, rx[i].stamp_ns + 1000000);
+      EXPECT_EQ(tx[i].data, command_frame(i, (uint16_t)(5000 + i)));
+   }
+
+   // a file that is not there is no capture
+   std::vector<UartRecord> none;
+   EXPECT_FALSE(read_capture(path_ + ".missing", &none, &none));
+}
+
+TEST_F(UartReplay, SameCommandsPassTheCheck) {
+   std::vector<UartRecord> rx;
+   std::vector<UartRecord> tx;
+
+   ASSERT_TRUE(read_capture(path_, &rx, &tx));
+   std::vector<uint8_t> received = replay(rx, tx);
+
+   // every command came back, only the seqs are different
+   ASSERT_EQ(received.size(), (size_t)FRAMES * CMD_FRAME_SIZE_W_SYNC);
+   EXPECT_EQ(commands(received).size(), (size_t)FRAMES);
+   EXPECT_TRUE(compare(tx, received));
+}
+
+TEST_F(UartReplay, DamagedCommandFailsTheCheck) {
+   std::vector<UartRecord> rx;
+   std::vector<UartRecord> tx;
+
+   ASSERT_TRUE(read_capture(path_, &rx, &tx));
+   std::vector<uint8_t> received = replay(rx, tx);
+   ASSERT_TRUE(compare(tx, received));
+
+   // a flipped bit in the steer_output of the 8th command
+   std::vector<UartRecord> damaged = tx;
+   damaged[7].data[4] ^= 0x01;
+   EXPECT_FALSE(compare(damaged, received));
+
+   // a command the replay did not write, or one more than the capture has
+   damaged = tx;
+   damaged.pop_back();
+   EXPECT_FALSE(compare(damaged, received));
+   std::vector<uint8_t> extra = received;
+   std::vector<uint8_t> frame = command_frame(FRAMES, 0);
+   extra.insert(extra.end(), frame.begin(), frame.end());
+   EXPECT_FALSE(compare(tx, extra));
+}
+
+TEST(UartCapture, CommandsSkipToTheSync) {
+   std::vector<uint8_t> bytes = {0x00, 0x80, 0x7F};
+   std::vector<uint8_t> frame = command_frame(3, 1);
+
+   bytes.insert(bytes.end(), frame.begin(), frame.end());
+   // a request frame is not a command
+   put_word(&bytes, CMD_FRAME_REQUEST_SYNC);
+   for (int i = 0; i < CMD_FRAME_SIZE / 2; i++) {
+      put_word(&bytes, 1);
+   }
+   frame = command_frame(4, 2);
+   bytes.insert(bytes.end(), frame.begin(), frame.end());
+   // a frame that is cut off is not one either
+   bytes.insert(bytes.end(), frame.begin(), frame.end() - 1);
+
+   std::vector<std::vector<int16_t> > frames = commands(bytes);
+   ASSERT_EQ(frames.size(), 2u);
+   EXPECT_EQ(frames[0], (std::vector<int16_t>{3, 87, FIFTH_LOCKED,
+                                              MOTOR_MODE_THROTTLE}));
+   EXPECT_EQ(frames[1][1], 86);
+}
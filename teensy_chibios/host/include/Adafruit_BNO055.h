@@ -0,0 +1,29 @@
+/**
+ * @file A simulated BNO055 for the host build. It reports the heading set
+ * with host_imu_set and takes about as long as an I2C read of the euler
+ * angles does on the car.
+ */
+
+#ifndef HOST_ADAFRUIT_BNO055_H
+#define HOST_ADAFRUIT_BNO055_H
+
+#include <stdint.h>
+#include "Adafruit_Sensor.h"
+
+#define BNO055_ADDRESS_A 0x28
+
+class Adafruit_BNO055 {
+public:
+   Adafruit_BNO055(int32_t sensor_id = -1,
+                   uint8_t address = BNO055_ADDRESS_A)
+      : sensor_id_(sensor_id) { (void)address; }
+
+   bool begin() { return true; }
+   void setExtCrystalUse(bool use) { (void)use; }
+   bool getEvent(sensors_event_t *event);
+
+private:
+   int32_t sensor_id_;
+};
+
+#endif //HOST_ADAFRUIT_BNO055_H
@@ -0,0 +1,26 @@
+/**
+ * @file The parts of the Adafruit unified sensor types that the firmware
+ * uses, for the host build.
+ */
+
+#ifndef HOST_ADAFRUIT_SENSOR_H
+#define HOST_ADAFRUIT_SENSOR_H
+
+#include <stdint.h>
+
+typedef struct {
+   float x;
+   float y;
+   float z;
+} sensors_vec_t;
+
+typedef struct {
+   int32_t version;
+   int32_t sensor_id;
+   int32_t type;
+   int32_t reserved0;
+   int32_t timestamp;
+   sensors_vec_t orientation;
+} sensors_event_t;
+
+#endif //HOST_ADAFRUIT_SENSOR_H
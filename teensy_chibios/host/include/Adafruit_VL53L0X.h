@@ -0,0 +1,39 @@
+/**
+ * @file A simulated VL53L0X for the host build. Each sensor reports the
+ * range set with host_tof_set for its I2C bus and takes as long as a
+ * measurement with the default timing budget does on the car.
+ */
+
+#ifndef HOST_ADAFRUIT_VL53L0X_H
+#define HOST_ADAFRUIT_VL53L0X_H
+
+#include <stdint.h>
+#include <Wire.h>
+
+#define VL53L0X_I2C_ADDR 0x29
+
+typedef int8_t VL53L0X_Error;
+#define VL53L0X_ERROR_NONE ((VL53L0X_Error)0)
+
+typedef struct {
+   uint32_t TimeStamp;
+   uint32_t MeasurementTimeUsec;
+   uint16_t RangeMilliMeter;
+   uint16_t RangeDMaxMilliMeter;
+   uint8_t RangeStatus; // 0 for a valid range, 4 for a phase failure
+} VL53L0X_RangingMeasurementData_t;
+
+class Adafruit_VL53L0X {
+public:
+   Adafruit_VL53L0X() : wire_(NULL) {}
+
+   bool begin(uint8_t i2c_addr = VL53L0X_I2C_ADDR, bool debug = false,
+              TwoWire *i2c = &Wire);
+   VL53L0X_Error rangingTest(VL53L0X_RangingMeasurementData_t *data,
+                             bool debug = false);
+
+private:
+   TwoWire *wire_;
+};
+
+#endif //HOST_ADAFRUIT_VL53L0X_H
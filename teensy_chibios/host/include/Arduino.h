@@ -0,0 +1,298 @@
+/**
+ * @file The subset of the Teensy 3 Arduino core that the firmware uses,
+ * implemented for a Linux host.
+ *
+ * - Time comes from CLOCK_MONOTONIC, counted from the start of the process.
+ * - GPIO pins are an array of levels. Inputs are driven with the functions
+ *   in host_sim.h, which also run the interrupts attached to the pin and
+ *   emulate FTM3 input capture on the pins muxed to it.
+ * - Interrupt handlers run on host threads while holding the interrupt
+ *   lock, which __disable_irq() takes, so they never overlap each other or
+ *   a section that has interrupts disabled.
+ * - Serial is the console on stdout and Serial1 is a pseudo terminal.
+ *
+ * This header must not include <time.h> or <pthread.h>: range_finder.cpp
+ * has a global named time, which is fine on the Teensy.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 4
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define F(string_literal) (string_literal)
+
+#define F_CPU 180000000
+#define F_BUS 60000000
+
+#define CORE_NUM_TOTAL_PINS 64
+
+uint32_t micros(void);
+uint32_t millis(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+uint8_t digitalRead(uint8_t pin);
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+
+/******************************* INTERRUPTS **********************************/
+
+enum IRQ_NUMBER_t {
+   IRQ_UART0_STATUS,
+   IRQ_FTM0,
+   IRQ_FTM1,
+   IRQ_FTM2,
+   IRQ_FTM3,
+   IRQ_PIT,
+   NVIC_NUM_INTERRUPTS
+};
+
+void __disable_irq(void);
+void __enable_irq(void);
+#define noInterrupts() __disable_irq()
+#define interrupts() __enable_irq()
+
+void attachInterruptVector(enum IRQ_NUMBER_t irq, void (*function)(void));
+void NVIC_ENABLE_IRQ(enum IRQ_NUMBER_t irq);
+void NVIC_DISABLE_IRQ(enum IRQ_NUMBER_t irq);
+
+extern "C" void uart0_status_isr(void);
+extern "C" void ftm3_isr(void);
+
+
+/******************************* REGISTERS ***********************************/
+
+/**
+ * @brief FTM3 as the firmware sees it. The channel registers are CnSC, CnV
+ * pairs, the same layout as on the Kinetis parts.
+ */
+typedef struct host_ftm_t {
+   volatile uint32_t sc;
+   volatile uint32_t cnt;
+   volatile uint32_t mod;
+   volatile uint32_t c[16];
+   volatile uint32_t cntin;
+   volatile uint32_t mode;
+} host_ftm_t;
+
+extern host_ftm_t host_ftm3;
+
+#define FTM3_SC (host_ftm3.sc)
+#define FTM3_CNT (host_ftm3.cnt)
+#define FTM3_MOD (host_ftm3.mod)
+#define FTM3_C0SC (host_ftm3.c[0])
+#define FTM3_C0V (host_ftm3.c[1])
+#define FTM3_CNTIN (host_ftm3.cntin)
+#define FTM3_MODE (host_ftm3.mode)
+
+#define FTM_SC_TOF 0x80
+#define FTM_SC_TOIE 0x40
+#define FTM_SC_CPWMS 0x20
+#define FTM_SC_CLKS(n) (((n) & 3) << 3)
+#define FTM_SC_PS(n) ((n) & 7)
+
+#define FTM_CSC_CHF 0x80
+#define FTM_CSC_CHIE 0x40
+#define FTM_CSC_MSB 0x20
+#define FTM_CSC_MSA 0x10
+#define FTM_CSC_ELSB 0x08
+#define FTM_CSC_ELSA 0x04
+
+#define FTM_MODE_WPDIS 0x04
+#define FTM_MODE_FTMEN 0x01
+
+#define PORT_PCR_MUX(n) (((n) & 7) << 8)
+#define PORT_PCR_PFE 0x10
+
+extern volatile uint32_t host_port_pcr[CORE_NUM_TOTAL_PINS];
+
+#define portConfigRegister(pin) (&host_port_pcr[(pin)])
+
+
+/******************************** TIMERS *************************************/
+
+/**
+ * @brief Calls a function from an interrupt at a fixed period, like the
+ * Teensy's PIT based IntervalTimer. The period is kept on an absolute
+ * schedule, so a late call does not delay the ones after it.
+ */
+class IntervalTimer {
+public:
+   IntervalTimer();
+   ~IntervalTimer();
+
+   bool begin(void (*function)(void), uint32_t period_us);
+   void end();
+
+private:
+   struct Impl;
+
+   static void *run(void *arg);
+
+   Impl *impl_;
+};
+
+
+/******************************** SERIAL *************************************/
+
+class Print {
+public:
+   virtual ~Print() {}
+
+   virtual size_t write(uint8_t b) = 0;
+   virtual size_t write(const uint8_t *buffer, size_t size);
+   size_t write(const char *buffer, size_t size) {
+      return write((const uint8_t*)buffer, size);
+   }
+   size_t write(const char *str) { return write(str, strlen(str)); }
+
+   size_t print(const char *str) { return write(str); }
+   size_t print(char c) { return write((uint8_t)c); }
+   size_t print(int n, int base = DEC) { return print((long)n, base); }
+   size_t print(unsigned int n, int base = DEC) {
+      return print((unsigned long)n, base);
+   }
+   size_t print(long n, int base = DEC);
+   size_t print(unsigned long n, int base = DEC);
+   size_t print(double n, int digits = 2);
+
+   size_t println() { return write("\r\n"); }
+   template <typename T>
+   size_t println(T value) { return print(value) + println(); }
+   template <typename T>
+   size_t println(T value, int format) {
+      return print(value, format) + println();
+   }
+
+   int printf(const char *format, ...)
+         __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+   Stream() : timeout_ms_(1000) {}
+
+   virtual int available() = 0;
+   virtual int read() = 0;
+   virtual int peek() = 0;
+
+   void setTimeout(uint32_t ms) { timeout_ms_ = ms; }
+
+   /**
+    * @brief Reads up to length bytes, waiting at most the stream timeout
+    * for each one, like the Arduino Stream.
+    */
+   size_t readBytes(char *buffer, size_t length);
+   size_t readBytes(uint8_t *buffer, size_t length) {
+      return readBytes((char*)buffer, length);
+   }
+
+private:
+   uint32_t timeout_ms_;
+};
+
+/**
+ * @brief The USB serial console, written to stdout. Nothing is ever read
+ * from it.
+ */
+class usb_serial_class : public Stream {
+public:
+   void begin(long baud) { (void)baud; }
+   void end() {}
+
+   size_t write(uint8_t b) override;
+   size_t write(const uint8_t *buffer, size_t size) override;
+   using Print::write;
+
+   int available() override { return 0; }
+   int read() override { return -1; }
+   int peek() override { return -1; }
+
+   operator bool() { return true; }
+};
+
+/**
+ * @brief A hardware UART backed by a pseudo terminal. begin() creates the
+ * pty and prints the path of its slave side, which the Pi side software can
+ * open like the real serial port. Received bytes go through a FIFO and the
+ * UART status interrupt into a receive buffer of the same size as the
+ * Teensy core's, so a slow reader loses bytes the same way it would on the
+ * car.
+ */
+class HardwareSerial : public Stream {
+public:
+   static const int RX_BUFFER_SIZE = 64;
+   static const int TX_BUFFER_SIZE = 64;
+
+   explicit HardwareSerial(enum IRQ_NUMBER_t irq);
+
+   void begin(uint32_t baud);
+   void end();
+
+   size_t write(uint8_t b) override;
+   size_t write(const uint8_t *buffer, size_t size) override;
+   using Print::write;
+
+   int available() override;
+   int read() override;
+   int peek() override;
+   int availableForWrite();
+   void flush();
+
+   /**
+    * @brief The path of the pty slave, or NULL before begin().
+    */
+   const char *path() const;
+
+   /**
+    * @brief Moves the bytes from the FIFO into the receive buffer. Called
+    * from the UART status interrupt.
+    */
+   void service();
+
+private:
+   struct Impl;
+
+   static void *receive(void *arg);
+   static void *transmit(void *arg);
+
+   Impl *impl_;
+   enum IRQ_NUMBER_t irq_;
+};
+
+extern usb_serial_class Serial;
+extern HardwareSerial Serial1;
+
+void setup(void);
+void loop(void);
+
+#endif //HOST_ARDUINO_H
@@ -0,0 +1,165 @@
+/**
+ * @file The subset of the ChibiOS/RT 4 API that the Teensy firmware uses,
+ * implemented on POSIX threads so the firmware can run on a Linux host.
+ *
+ * The kernel lock is one process-wide mutex. A thread that suspends itself,
+ * waits for events or waits on a mailbox sleeps on its own condition
+ * variable and gives the kernel lock up while it sleeps, the same way a
+ * ChibiOS thread leaves the critical zone when it is rescheduled. I-class
+ * functions must be called with the kernel lock held, S-class functions
+ * with it held from a thread.
+ *
+ * Thread priorities and working areas are accepted and ignored: the host
+ * scheduler decides which thread runs, so timing measured on the host shows
+ * the cost of the code and not the schedule the Teensy would produce.
+ */
+
+#ifndef HOST_CHRT_H
+#define HOST_CHRT_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CH_CFG_ST_FREQUENCY 1000 // system ticks per second, as on the Teensy
+
+typedef uint32_t systime_t;
+typedef intptr_t msg_t; // wide enough for the pointers sent through mailboxes
+typedef uint32_t eventmask_t;
+typedef uint32_t tprio_t;
+
+#define MSG_OK (msg_t)0
+#define MSG_TIMEOUT (msg_t)-1
+#define MSG_RESET (msg_t)-2
+
+#define TIME_IMMEDIATE ((systime_t)0)
+#define TIME_INFINITE ((systime_t)-1)
+
+#define S2ST(sec) ((systime_t)((uint32_t)(sec) * CH_CFG_ST_FREQUENCY))
+#define MS2ST(msec) ((systime_t)(((uint32_t)(msec) * CH_CFG_ST_FREQUENCY + \
+                                  999) / 1000))
+#define US2ST(usec) ((systime_t)(((uint32_t)(usec) * CH_CFG_ST_FREQUENCY + \
+                                  999999) / 1000000))
+
+#define LOWPRIO 2
+#define NORMALPRIO 128
+#define HIGHPRIO 255
+
+#define ALL_EVENTS ((eventmask_t)-1)
+#define EVENT_MASK(eid) ((eventmask_t)1 << (eventmask_t)(eid))
+
+typedef struct thread_t {
+   pthread_t handle;
+   pthread_cond_t wakeup;   // signalled when the thread is resumed
+   msg_t rdymsg;            // message passed by chThdResumeI
+   bool suspended;
+   eventmask_t epending;    // events signalled and not yet waited for
+   eventmask_t ewmask;      // events the thread is waiting for
+   void (*fn)(void *arg);
+   void *arg;
+} thread_t;
+
+typedef thread_t *thread_reference_t;
+
+#define THD_WORKING_AREA(s, n) uint8_t s[n]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+                            void (*pf)(void *arg), void *arg);
+thread_t *chThdGetSelfX(void);
+void chThdSleep(systime_t time);
+void chThdSleepUntil(systime_t time);
+#define chThdSleepSeconds(sec) chThdSleep(S2ST(sec))
+#define chThdSleepMilliseconds(msec) chThdSleep(MS2ST(msec))
+#define chThdSleepMicroseconds(usec) chThdSleep(US2ST(usec))
+msg_t chThdSuspendS(thread_reference_t *trp);
+msg_t chThdSuspendTimeoutS(thread_reference_t *trp, systime_t timeout);
+void chThdResumeI(thread_reference_t *trp, msg_t msg);
+void chThdResume(thread_reference_t *trp, msg_t msg);
+
+void chSysLock(void);
+void chSysUnlock(void);
+#define chSysLockFromISR() chSysLock()
+#define chSysUnlockFromISR() chSysUnlock()
+
+systime_t chVTGetSystemTime(void);
+#define chVTGetSystemTimeX() chVTGetSystemTime()
+
+typedef struct mutex_t {
+   pthread_mutex_t handle;
+} mutex_t;
+
+#define MUTEX_DECL(name) mutex_t name = {PTHREAD_MUTEX_INITIALIZER}
+
+void chMtxObjectInit(mutex_t *mp);
+void chMtxLock(mutex_t *mp);
+bool chMtxTryLock(mutex_t *mp);
+void chMtxUnlock(mutex_t *mp);
+
+typedef struct event_listener_t {
+   struct event_listener_t *next;
+   thread_t *listener;
+   eventmask_t events;
+} event_listener_t;
+
+typedef struct event_source_t {
+   event_listener_t *next;
+} event_source_t;
+
+#define EVENTSOURCE_DECL(name) event_source_t name = {NULL}
+
+void chEvtObjectInit(event_source_t *esp);
+void chEvtRegisterMask(event_source_t *esp, event_listener_t *elp,
+                       eventmask_t events);
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp);
+void chEvtBroadcastI(event_source_t *esp);
+void chEvtBroadcast(event_source_t *esp);
+void chEvtSignalI(thread_t *tp, eventmask_t events);
+void chEvtSignal(thread_t *tp, eventmask_t events);
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, systime_t timeout);
+#define chEvtWaitAny(events) chEvtWaitAnyTimeout(events, TIME_INFINITE)
+
+typedef struct memory_pool_t {
+   void *next;        // the first free block
+   size_t object_size;
+   void *(*provider)(size_t size, unsigned align);
+} memory_pool_t;
+
+#define MEMORYPOOL_DECL(name, size, provider) \
+   memory_pool_t name = {NULL, size, provider}
+
+void chPoolObjectInit(memory_pool_t *mp, size_t size,
+                      void *(*provider)(size_t size, unsigned align));
+void chPoolLoadArray(memory_pool_t *mp, void *p, size_t n);
+void *chPoolAllocI(memory_pool_t *mp);
+void *chPoolAlloc(memory_pool_t *mp);
+void chPoolFreeI(memory_pool_t *mp, void *objp);
+void chPoolFree(memory_pool_t *mp, void *objp);
+
+typedef struct mailbox_t {
+   msg_t *buffer;
+   size_t size;
+   size_t rd;
+   size_t cnt;
+   thread_t *reader; // a thread waiting in chMBFetch
+   thread_t *writer; // a thread waiting in chMBPost
+} mailbox_t;
+
+#define MAILBOX_DECL(name, buffer, size) \
+   mailbox_t name = {(msg_t*)(buffer), size, 0, 0, NULL, NULL}
+
+void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n);
+msg_t chMBPostI(mailbox_t *mbp, msg_t msg);
+msg_t chMBPost(mailbox_t *mbp, msg_t msg, systime_t timeout);
+msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp);
+msg_t chMBFetch(mailbox_t *mbp, msg_t *msgp, systime_t timeout);
+
+#define CH_IRQ_HANDLER(id) void id(void)
+#define CH_IRQ_PROLOGUE()
+#define CH_IRQ_EPILOGUE()
+
+void chBegin(void (*mainThread)());
+
+extern "C" void errorBlink(int n);
+
+#endif //HOST_CHRT_H
@@ -0,0 +1,41 @@
+/**
+ * @file The Arduino Servo library for the host build. The pulse width each
+ * servo outputs is kept per pin and can be read with host_servo_us.
+ */
+
+#ifndef HOST_SERVO_H
+#define HOST_SERVO_H
+
+#include <stdint.h>
+
+#define MIN_PULSE_WIDTH 544
+#define MAX_PULSE_WIDTH 2400
+#define DEFAULT_PULSE_WIDTH 1500
+
+class Servo {
+public:
+   Servo();
+
+   uint8_t attach(int pin);
+   uint8_t attach(int pin, int min, int max);
+   void detach();
+
+   /**
+    * @brief Values below MIN_PULSE_WIDTH are an angle from 0 to 180 degrees,
+    * larger values are a pulse width in microseconds.
+    */
+   void write(int value);
+   void writeMicroseconds(int value);
+
+   int read();
+   int readMicroseconds();
+   bool attached();
+
+private:
+   int pin_;
+   int min_;
+   int max_;
+   int us_;
+};
+
+#endif //HOST_SERVO_H
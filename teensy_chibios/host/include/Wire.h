@@ -0,0 +1,40 @@
+/**
+ * @file The Arduino Wire library for the host build. Nothing is connected to
+ * the buses; the sensor libraries are simulated above them. Like the real
+ * one it brings in Arduino.h.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+   explicit TwoWire(uint8_t bus) : bus_(bus) {}
+
+   void begin() {}
+   void setClock(uint32_t frequency) { (void)frequency; }
+
+   void beginTransmission(uint8_t address) { (void)address; }
+   uint8_t endTransmission(bool stop = true) { (void)stop; return 0; }
+   size_t write(uint8_t data) { (void)data; return 1; }
+   uint8_t requestFrom(uint8_t address, uint8_t quantity) {
+      (void)address;
+      (void)quantity;
+      return 0;
+   }
+   int available() { return 0; }
+   int read() { return -1; }
+
+   uint8_t bus() const { return bus_; }
+
+private:
+   uint8_t bus_;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+extern TwoWire Wire2;
+
+#endif //HOST_WIRE_H
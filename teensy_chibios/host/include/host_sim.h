@@ -0,0 +1,63 @@
+/**
+ * @file The controls of the simulated Teensy hardware: driving input pins,
+ * reading what the firmware writes to outputs and servos, and setting what
+ * the sensors report. Only the host build has these.
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds since the process started, without the 32 bit wrap
+ * of micros().
+ */
+uint64_t host_micros64(void);
+
+/**
+ * @brief Drives an input pin. A change of level runs the interrupt attached
+ * to the pin and, on a pin that is muxed to an FTM3 channel in input capture
+ * mode, latches the timer and runs ftm3_isr.
+ */
+void host_gpio_write(uint8_t pin, uint8_t level);
+
+/**
+ * @brief The level of a pin, whether the firmware or the simulation drove it.
+ */
+uint8_t host_gpio_read(uint8_t pin);
+
+/**
+ * @brief Drives a pin with a square wave from a background thread until
+ * host_gpio_stop is called. The pin is high for high_us out of every
+ * period_us, starting phase_us into the period.
+ */
+void host_gpio_square(uint8_t pin, uint32_t period_us, uint32_t high_us,
+                      uint32_t phase_us);
+
+void host_gpio_stop(uint8_t pin);
+
+/**
+ * @brief Runs the handler that is installed for an interrupt, holding the
+ * interrupt lock. Does nothing if the interrupt is not enabled.
+ */
+void host_irq_raise(int irq);
+
+/**
+ * @brief The pulse width in microseconds that the Servo attached to a pin
+ * is outputting, or -1 if no Servo is attached.
+ */
+int host_servo_us(uint8_t pin);
+
+/**
+ * @brief The heading in degrees that the BNO055 reports.
+ */
+void host_imu_set(float heading_deg);
+
+/**
+ * @brief The range in millimeters that a VL53L0X on an I2C bus (0 for Wire,
+ * 1 for Wire1 and so on) reports. A negative range reports a phase failure.
+ */
+void host_tof_set(uint8_t bus, int16_t range_mm);
+
+#endif //HOST_SIM_H
@@ -0,0 +1,6 @@
+#ifndef HOST_IMUMATHS_H
+#define HOST_IMUMATHS_H
+
+// the firmware includes this for the BNO055 library but uses none of it
+
+#endif //HOST_IMUMATHS_H
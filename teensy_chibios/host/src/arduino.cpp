@@ -0,0 +1,334 @@
+#include <Arduino.h>
+#include <host_sim.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+host_ftm_t host_ftm3;
+volatile uint32_t host_port_pcr[CORE_NUM_TOTAL_PINS];
+
+/**
+ * @brief The FTM3 channel that each pin reaches with PORT_PCR_MUX(3), or -1.
+ * Only the pins that the RC receiver uses are wired up.
+ */
+static int8_t ftm3_channel(uint8_t pin) {
+   switch (pin) {
+      case 35: return 4;
+      case 36: return 5;
+      case 37: return 6;
+      case 38: return 7;
+      default: return -1;
+   }
+}
+#define FTM3_MUX 3
+
+/**
+ * @brief The interrupt lock. It is recursive so that a handler may disable
+ * interrupts itself.
+ */
+static pthread_mutex_t irq_lock;
+static pthread_once_t irq_lock_once = PTHREAD_ONCE_INIT;
+
+static void irq_lock_init() {
+   pthread_mutexattr_t attr;
+
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   pthread_mutex_init(&irq_lock, &attr);
+   pthread_mutexattr_destroy(&attr);
+}
+
+void __disable_irq(void) {
+   pthread_once(&irq_lock_once, irq_lock_init);
+   pthread_mutex_lock(&irq_lock);
+}
+
+void __enable_irq(void) {
+   pthread_mutex_unlock(&irq_lock);
+}
+
+extern "C" void uart0_status_isr(void) {
+   Serial1.service();
+}
+
+extern "C" void ftm3_isr(void) __attribute__((weak));
+extern "C" void ftm3_isr(void) {
+}
+
+static void (*vectors[NVIC_NUM_INTERRUPTS])(void) = {
+   uart0_status_isr, NULL, NULL, NULL, ftm3_isr, NULL
+};
+static bool enabled[NVIC_NUM_INTERRUPTS] = {true};
+
+void attachInterruptVector(enum IRQ_NUMBER_t irq, void (*function)(void)) {
+   __disable_irq();
+   vectors[irq] = function;
+   __enable_irq();
+}
+
+void NVIC_ENABLE_IRQ(enum IRQ_NUMBER_t irq) {
+   enabled[irq] = true;
+}
+
+void NVIC_DISABLE_IRQ(enum IRQ_NUMBER_t irq) {
+   enabled[irq] = false;
+}
+
+void host_irq_raise(int irq) {
+   __disable_irq();
+   if (enabled[irq] && vectors[irq] != NULL) {
+      vectors[irq]();
+   }
+   __enable_irq();
+}
+
+
+/********************************* TIME **************************************/
+
+static struct timespec start_time;
+static pthread_once_t start_time_once = PTHREAD_ONCE_INIT;
+
+static void start_time_init() {
+   clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+uint64_t host_micros64(void) {
+   struct timespec now;
+
+   pthread_once(&start_time_once, start_time_init);
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)(now.tv_sec - start_time.tv_sec) * 1000000 +
+          (now.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+uint32_t micros(void) {
+   return (uint32_t)host_micros64();
+}
+
+uint32_t millis(void) {
+   return (uint32_t)(host_micros64() / 1000);
+}
+
+/**
+ * @brief Sleeps until an absolute number of microseconds since the start of
+ * the process.
+ */
+static void sleep_until_us(uint64_t wake_us) {
+   struct timespec ts;
+
+   pthread_once(&start_time_once, start_time_init);
+   ts.tv_sec = start_time.tv_sec + wake_us / 1000000;
+   ts.tv_nsec = start_time.tv_nsec + (wake_us % 1000000) * 1000;
+   if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+   }
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+   }
+}
+
+void delay(uint32_t ms) {
+   sleep_until_us(host_micros64() + (uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+   sleep_until_us(host_micros64() + us);
+}
+
+
+/********************************* GPIO **************************************/
+
+typedef struct pin_t {
+   volatile uint8_t level;
+   uint8_t mode;
+   void (*isr)(void);
+   int isr_mode;
+   pthread_t wave;
+   volatile bool wave_running;
+   uint32_t period_us;
+   uint32_t high_us;
+   uint32_t phase_us;
+} pin_t;
+
+static pin_t pins[CORE_NUM_TOTAL_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+   pins[pin].mode = mode;
+   if (mode == INPUT_PULLUP) {
+      pins[pin].level = HIGH;
+   }
+}
+
+uint8_t digitalRead(uint8_t pin) {
+   return pins[pin].level;
+}
+
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode) {
+   __disable_irq();
+   pins[pin].isr = function;
+   pins[pin].isr_mode = mode;
+   __enable_irq();
+}
+
+void detachInterrupt(uint8_t pin) {
+   __disable_irq();
+   pins[pin].isr = NULL;
+   __enable_irq();
+}
+
+/**
+ * @brief Latches the FTM3 counter into a channel that captures the edge,
+ * the way the timer does in hardware, and runs the FTM3 interrupt.
+ */
+static void ftm3_capture(uint8_t pin, bool rising) {
+   int8_t channel = ftm3_channel(pin);
+   volatile uint32_t *csc;
+   uint32_t ps = FTM3_SC & 7;
+
+   if (channel < 0 || ((host_port_pcr[pin] >> 8) & 7) != FTM3_MUX ||
+       (FTM3_SC & FTM_SC_CLKS(3)) == 0) {
+      return;
+   }
+
+   csc = &FTM3_C0SC + 2 * channel;
+   if (!(*csc & (rising ? FTM_CSC_ELSA : FTM_CSC_ELSB))) {
+      return;
+   }
+
+   *(csc + 1) = (uint16_t)((host_micros64() * (F_BUS / 1000000)) >> ps);
+   *csc |= FTM_CSC_CHF;
+   if (*csc & FTM_CSC_CHIE) {
+      host_irq_raise(IRQ_FTM3);
+   }
+}
+
+/**
+ * @brief Sets the level of a pin and runs whatever the edge triggers.
+ */
+static void set_level(uint8_t pin, uint8_t level) {
+   pin_t *p = &pins[pin];
+   bool rising;
+
+   __disable_irq();
+   level = level ? HIGH : LOW;
+   if (level == p->level) {
+      __enable_irq();
+      return;
+   }
+   p->level = level;
+   rising = level == HIGH;
+
+   if (p->isr != NULL && (p->isr_mode == CHANGE ||
+                          (p->isr_mode == RISING && rising) ||
+                          (p->isr_mode == FALLING && !rising))) {
+      p->isr();
+   }
+   ftm3_capture(pin, rising);
+   __enable_irq();
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+   set_level(pin, val);
+}
+
+void host_gpio_write(uint8_t pin, uint8_t level) {
+   set_level(pin, level);
+}
+
+uint8_t host_gpio_read(uint8_t pin) {
+   return pins[pin].level;
+}
+
+static void *wave_thread(void *arg) {
+   pin_t *p = (pin_t*)arg;
+   uint8_t pin = p - pins;
+   uint64_t start_us = host_micros64() + p->phase_us;
+
+   host_gpio_write(pin, LOW);
+   for (uint64_t t = start_us; p->wave_running; t += p->period_us) {
+      sleep_until_us(t);
+      host_gpio_write(pin, HIGH);
+      sleep_until_us(t + p->high_us);
+      host_gpio_write(pin, LOW);
+   }
+   return NULL;
+}
+
+void host_gpio_square(uint8_t pin, uint32_t period_us, uint32_t high_us,
+                      uint32_t phase_us) {
+   pin_t *p = &pins[pin];
+
+   host_gpio_stop(pin);
+   if (period_us == 0) {
+      return;
+   }
+
+   p->period_us = period_us;
+   p->high_us = high_us;
+   p->phase_us = phase_us;
+   p->wave_running = true;
+   if (pthread_create(&p->wave, NULL, wave_thread, p) != 0) {
+      perror("pthread_create");
+      abort();
+   }
+}
+
+void host_gpio_stop(uint8_t pin) {
+   pin_t *p = &pins[pin];
+
+   if (p->wave_running) {
+      p->wave_running = false;
+      pthread_join(p->wave, NULL);
+   }
+}
+
+
+/****************************** INTERVAL TIMER *******************************/
+
+struct IntervalTimer::Impl {
+   void (*function)(void);
+   uint32_t period_us;
+   volatile bool running;
+   pthread_t thread;
+};
+
+void *IntervalTimer::run(void *arg) {
+   Impl *impl = (Impl*)arg;
+   uint64_t next_us = host_micros64();
+
+   while (impl->running) {
+      next_us += impl->period_us;
+      sleep_until_us(next_us);
+      __disable_irq();
+      impl->function();
+      __enable_irq();
+   }
+   return NULL;
+}
+
+IntervalTimer::IntervalTimer() : impl_(NULL) {
+}
+
+IntervalTimer::~IntervalTimer() {
+   end();
+}
+
+bool IntervalTimer::begin(void (*function)(void), uint32_t period_us) {
+   end();
+   impl_ = new Impl();
+   impl_->function = function;
+   impl_->period_us = period_us;
+   impl_->running = true;
+   return pthread_create(&impl_->thread, NULL, run, impl_) == 0;
+}
+
+void IntervalTimer::end() {
+   if (impl_ != NULL) {
+      impl_->running = false;
+      pthread_join(impl_->thread, NULL);
+      delete impl_;
+      impl_ = NULL;
+   }
+}
@@ -0,0 +1,427 @@
+#include <ChRt.h>
+#include <Arduino.h>
+#include <host_sim.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief The kernel lock. Every thread_t condition variable is used with it.
+ */
+static pthread_mutex_t sys_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The thread_t of the calling thread. Threads that were not created
+ * with chThdCreateStatic, like the ones that inject interrupts, get one the
+ * first time they ask for it.
+ */
+static thread_local thread_t *self = NULL;
+
+
+static void thread_init(thread_t *tp) {
+   pthread_condattr_t attr;
+
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&tp->wakeup, &attr);
+   pthread_condattr_destroy(&attr);
+
+   tp->handle = pthread_self();
+   tp->rdymsg = MSG_OK;
+   tp->suspended = false;
+   tp->epending = 0;
+   tp->ewmask = 0;
+   tp->fn = NULL;
+   tp->arg = NULL;
+}
+
+
+thread_t *chThdGetSelfX(void) {
+   if (self == NULL) {
+      self = (thread_t*)calloc(1, sizeof(thread_t));
+      thread_init(self);
+   }
+   return self;
+}
+
+
+static void *thread_start(void *arg) {
+   thread_t *tp = (thread_t*)arg;
+
+   self = tp;
+   tp->fn(tp->arg);
+   return NULL;
+}
+
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+                            void (*pf)(void *arg), void *arg) {
+   thread_t *tp = (thread_t*)calloc(1, sizeof(thread_t));
+
+   (void)wsp;
+   (void)size;
+   (void)prio;
+
+   thread_init(tp);
+   tp->fn = pf;
+   tp->arg = arg;
+   if (pthread_create(&tp->handle, NULL, thread_start, tp) != 0) {
+      perror("pthread_create");
+      abort();
+   }
+   return tp;
+}
+
+
+/**
+ * @brief Converts a timeout in system ticks to an absolute CLOCK_MONOTONIC
+ * time for the condition variables.
+ */
+static struct timespec deadline(systime_t timeout) {
+   struct timespec ts;
+   uint64_t ns = (uint64_t)timeout * (1000000000ULL / CH_CFG_ST_FREQUENCY);
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   ns += ts.tv_nsec;
+   ts.tv_sec += ns / 1000000000ULL;
+   ts.tv_nsec = ns % 1000000000ULL;
+   return ts;
+}
+
+
+/**
+ * @brief Sleeps on the calling thread's condition variable until ready()
+ * returns true or the timeout expires. Must be called with the kernel lock
+ * held.
+ *
+ * @return the last value of ready()
+ */
+template <typename Ready>
+static bool wait_s(thread_t *tp, systime_t timeout, Ready ready) {
+   struct timespec ts;
+
+   if (timeout == TIME_INFINITE) {
+      while (!ready()) {
+         pthread_cond_wait(&tp->wakeup, &sys_lock);
+      }
+      return true;
+   }
+
+   ts = deadline(timeout);
+   while (!ready()) {
+      if (timeout == TIME_IMMEDIATE ||
+          pthread_cond_timedwait(&tp->wakeup, &sys_lock, &ts) == ETIMEDOUT) {
+         return ready();
+      }
+   }
+   return true;
+}
+
+
+void chThdSleep(systime_t time) {
+   struct timespec ts = deadline(time);
+
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+   }
+}
+
+
+void chThdSleepUntil(systime_t time) {
+   chThdSleep((systime_t)(time - chVTGetSystemTime()));
+}
+
+
+msg_t chThdSuspendTimeoutS(thread_reference_t *trp, systime_t timeout) {
+   thread_t *tp = chThdGetSelfX();
+
+   if (timeout == TIME_IMMEDIATE) {
+      return MSG_TIMEOUT;
+   }
+
+   *trp = tp;
+   tp->suspended = true;
+   if (!wait_s(tp, timeout, [tp] { return !tp->suspended; })) {
+      tp->suspended = false;
+      *trp = NULL;
+      return MSG_TIMEOUT;
+   }
+   return tp->rdymsg;
+}
+
+
+msg_t chThdSuspendS(thread_reference_t *trp) {
+   return chThdSuspendTimeoutS(trp, TIME_INFINITE);
+}
+
+
+void chThdResumeI(thread_reference_t *trp, msg_t msg) {
+   thread_t *tp = *trp;
+
+   if (tp != NULL) {
+      *trp = NULL;
+      tp->rdymsg = msg;
+      tp->suspended = false;
+      pthread_cond_signal(&tp->wakeup);
+   }
+}
+
+
+void chThdResume(thread_reference_t *trp, msg_t msg) {
+   chSysLock();
+   chThdResumeI(trp, msg);
+   chSysUnlock();
+}
+
+
+void chSysLock(void) {
+   pthread_mutex_lock(&sys_lock);
+}
+
+
+void chSysUnlock(void) {
+   pthread_mutex_unlock(&sys_lock);
+}
+
+
+systime_t chVTGetSystemTime(void) {
+   return (systime_t)(host_micros64() * CH_CFG_ST_FREQUENCY / 1000000);
+}
+
+
+void chMtxObjectInit(mutex_t *mp) {
+   pthread_mutex_init(&mp->handle, NULL);
+}
+
+
+void chMtxLock(mutex_t *mp) {
+   pthread_mutex_lock(&mp->handle);
+}
+
+
+bool chMtxTryLock(mutex_t *mp) {
+   return pthread_mutex_trylock(&mp->handle) == 0;
+}
+
+
+void chMtxUnlock(mutex_t *mp) {
+   pthread_mutex_unlock(&mp->handle);
+}
+
+
+void chEvtObjectInit(event_source_t *esp) {
+   esp->next = NULL;
+}
+
+
+void chEvtRegisterMask(event_source_t *esp, event_listener_t *elp,
+                       eventmask_t events) {
+   chSysLock();
+   elp->listener = chThdGetSelfX();
+   elp->events = events;
+   elp->next = esp->next;
+   esp->next = elp;
+   chSysUnlock();
+}
+
+
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp) {
+   event_listener_t **link;
+
+   chSysLock();
+   for (link = &esp->next; *link != NULL; link = &(*link)->next) {
+      if (*link == elp) {
+         *link = elp->next;
+         break;
+      }
+   }
+   chSysUnlock();
+}
+
+
+void chEvtSignalI(thread_t *tp, eventmask_t events) {
+   tp->epending |= events;
+   if (tp->epending & tp->ewmask) {
+      pthread_cond_signal(&tp->wakeup);
+   }
+}
+
+
+void chEvtSignal(thread_t *tp, eventmask_t events) {
+   chSysLock();
+   chEvtSignalI(tp, events);
+   chSysUnlock();
+}
+
+
+void chEvtBroadcastI(event_source_t *esp) {
+   for (event_listener_t *elp = esp->next; elp != NULL; elp = elp->next) {
+      chEvtSignalI(elp->listener, elp->events);
+   }
+}
+
+
+void chEvtBroadcast(event_source_t *esp) {
+   chSysLock();
+   chEvtBroadcastI(esp);
+   chSysUnlock();
+}
+
+
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, systime_t timeout) {
+   thread_t *tp = chThdGetSelfX();
+   eventmask_t m;
+
+   chSysLock();
+   tp->ewmask = events;
+   wait_s(tp, timeout, [tp, events] { return (tp->epending & events) != 0; });
+   m = tp->epending & events;
+   tp->epending &= ~m;
+   tp->ewmask = 0;
+   chSysUnlock();
+   return m;
+}
+
+
+void chPoolObjectInit(memory_pool_t *mp, size_t size,
+                      void *(*provider)(size_t size, unsigned align)) {
+   mp->next = NULL;
+   mp->object_size = size;
+   mp->provider = provider;
+}
+
+
+void chPoolFreeI(memory_pool_t *mp, void *objp) {
+   *(void**)objp = mp->next;
+   mp->next = objp;
+}
+
+
+void chPoolFree(memory_pool_t *mp, void *objp) {
+   chSysLock();
+   chPoolFreeI(mp, objp);
+   chSysUnlock();
+}
+
+
+void chPoolLoadArray(memory_pool_t *mp, void *p, size_t n) {
+   for (size_t i = 0; i < n; i++) {
+      chPoolFree(mp, (uint8_t*)p + i * mp->object_size);
+   }
+}
+
+
+void *chPoolAllocI(memory_pool_t *mp) {
+   void *objp = mp->next;
+
+   if (objp != NULL) {
+      mp->next = *(void**)objp;
+   }
+   else if (mp->provider != NULL) {
+      objp = mp->provider(mp->object_size, sizeof(void*));
+   }
+   return objp;
+}
+
+
+void *chPoolAlloc(memory_pool_t *mp) {
+   void *objp;
+
+   chSysLock();
+   objp = chPoolAllocI(mp);
+   chSysUnlock();
+   return objp;
+}
+
+
+void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n) {
+   mbp->buffer = buf;
+   mbp->size = n;
+   mbp->rd = 0;
+   mbp->cnt = 0;
+   mbp->reader = NULL;
+   mbp->writer = NULL;
+}
+
+
+msg_t chMBPostI(mailbox_t *mbp, msg_t msg) {
+   if (mbp->cnt == mbp->size) {
+      return MSG_TIMEOUT;
+   }
+
+   mbp->buffer[(mbp->rd + mbp->cnt) % mbp->size] = msg;
+   mbp->cnt++;
+   if (mbp->reader != NULL) {
+      pthread_cond_signal(&mbp->reader->wakeup);
+   }
+   return MSG_OK;
+}
+
+
+msg_t chMBPost(mailbox_t *mbp, msg_t msg, systime_t timeout) {
+   thread_t *tp = chThdGetSelfX();
+   msg_t rdymsg;
+
+   chSysLock();
+   mbp->writer = tp;
+   wait_s(tp, timeout, [mbp] { return mbp->cnt < mbp->size; });
+   mbp->writer = NULL;
+   rdymsg = chMBPostI(mbp, msg);
+   chSysUnlock();
+   return rdymsg;
+}
+
+
+msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp) {
+   if (mbp->cnt == 0) {
+      return MSG_TIMEOUT;
+   }
+
+   *msgp = mbp->buffer[mbp->rd];
+   mbp->rd = (mbp->rd + 1) % mbp->size;
+   mbp->cnt--;
+   if (mbp->writer != NULL) {
+      pthread_cond_signal(&mbp->writer->wakeup);
+   }
+   return MSG_OK;
+}
+
+
+msg_t chMBFetch(mailbox_t *mbp, msg_t *msgp, systime_t timeout) {
+   thread_t *tp = chThdGetSelfX();
+   msg_t rdymsg;
+
+   chSysLock();
+   mbp->reader = tp;
+   wait_s(tp, timeout, [mbp] { return mbp->cnt > 0; });
+   mbp->reader = NULL;
+   rdymsg = chMBFetchI(mbp, msgp);
+   chSysUnlock();
+   return rdymsg;
+}
+
+
+/**
+ * @brief Runs the continuation of the main thread and then loop() forever,
+ * like ChRt's chBegin. loop() is given a millisecond between calls so that
+ * an empty loop() does not keep a host core busy.
+ */
+void chBegin(void (*mainThread)()) {
+   chThdGetSelfX();
+
+   if (mainThread) {
+      mainThread();
+   }
+
+   while (true) {
+      loop();
+      chThdSleepMilliseconds(1);
+   }
+}
+
+
+extern "C" void errorBlink(int n) {
+   fprintf(stderr, "errorBlink(%d)\n", n);
+   abort();
+}
@@ -0,0 +1,129 @@
+#include <Arduino.h>
+#include <Adafruit_BNO055.h>
+#include <Adafruit_VL53L0X.h>
+#include <Servo.h>
+#include <Wire.h>
+#include <host_sim.h>
+
+#define IMU_READ_US 1000 // an I2C read of the euler angles at 400 kHz
+#define TOF_RANGING_US 33000 // the default VL53L0X timing budget
+#define NUM_WIRE_BUSES 3
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+TwoWire Wire2(2);
+
+static volatile int servo_us[CORE_NUM_TOTAL_PINS];
+static volatile float imu_heading = 0.0f;
+static volatile int16_t tof_range_mm[NUM_WIRE_BUSES];
+
+/********************************* SERVO *************************************/
+
+Servo::Servo()
+      : pin_(-1), min_(MIN_PULSE_WIDTH), max_(MAX_PULSE_WIDTH),
+        us_(DEFAULT_PULSE_WIDTH) {
+}
+
+uint8_t Servo::attach(int pin) {
+   return attach(pin, MIN_PULSE_WIDTH, MAX_PULSE_WIDTH);
+}
+
+uint8_t Servo::attach(int pin, int min, int max) {
+   if (pin < 0 || pin >= CORE_NUM_TOTAL_PINS) {
+      return 0;
+   }
+   pin_ = pin;
+   min_ = min;
+   max_ = max;
+   servo_us[pin_] = us_;
+   return 1;
+}
+
+void Servo::detach() {
+   if (pin_ >= 0) {
+      servo_us[pin_] = -1;
+      pin_ = -1;
+   }
+}
+
+void Servo::write(int value) {
+   if (value < MIN_PULSE_WIDTH) {
+      value = value < 0 ? 0 : (value > 180 ? 180 : value);
+      value = min_ + (long)value * (max_ - min_) / 180;
+   }
+   writeMicroseconds(value);
+}
+
+void Servo::writeMicroseconds(int value) {
+   us_ = value < min_ ? min_ : (value > max_ ? max_ : value);
+   if (pin_ >= 0) {
+      servo_us[pin_] = us_;
+   }
+}
+
+/**
+ * @brief Converts the pulse width back to an angle with the same rounding as
+ * the Teensy Servo library, so code that compares read() with the angle it
+ * wants behaves the same.
+ */
+int Servo::read() {
+   return (long)(us_ - min_ + 1) * 180 / (max_ - min_);
+}
+
+int Servo::readMicroseconds() {
+   return us_;
+}
+
+bool Servo::attached() {
+   return pin_ >= 0;
+}
+
+int host_servo_us(uint8_t pin) {
+   return pin < CORE_NUM_TOTAL_PINS && servo_us[pin] > 0 ? servo_us[pin] : -1;
+}
+
+
+/********************************* SENSORS ***********************************/
+
+bool Adafruit_BNO055::getEvent(sensors_event_t *event) {
+   delayMicroseconds(IMU_READ_US);
+
+   memset(event, 0, sizeof(*event));
+   event->sensor_id = sensor_id_;
+   event->timestamp = millis();
+   event->orientation.x = imu_heading;
+   return true;
+}
+
+void host_imu_set(float heading_deg) {
+   imu_heading = heading_deg;
+}
+
+bool Adafruit_VL53L0X::begin(uint8_t i2c_addr, bool debug, TwoWire *i2c) {
+   (void)i2c_addr;
+   (void)debug;
+   wire_ = i2c;
+   return true;
+}
+
+VL53L0X_Error Adafruit_VL53L0X::rangingTest(
+      VL53L0X_RangingMeasurementData_t *data, bool debug) {
+   int16_t range_mm = wire_ != NULL && wire_->bus() < NUM_WIRE_BUSES ?
+                      tof_range_mm[wire_->bus()] : -1;
+
+   (void)debug;
+   delayMicroseconds(TOF_RANGING_US);
+
+   memset(data, 0, sizeof(*data));
+   data->TimeStamp = millis();
+   data->MeasurementTimeUsec = TOF_RANGING_US;
+   data->RangeMilliMeter = range_mm < 0 ? 0 : range_mm;
+   data->RangeStatus = range_mm < 0 ? 4 : 0;
+   return VL53L0X_ERROR_NONE;
+}
+
+void host_tof_set(uint8_t bus, int16_t range_mm) {
+   if (bus < NUM_WIRE_BUSES) {
+      tof_range_mm[bus] = range_mm;
+   }
+}
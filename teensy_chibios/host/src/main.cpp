@@ -0,0 +1,140 @@
+/**
+ * @file The entry point of the host build. It sets up what the simulated
+ * hardware reports from the command line and then starts the firmware the
+ * way the Teensy core does, by calling setup() and loop().
+ */
+
+#include <Arduino.h>
+#include <host_sim.h>
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the pins that main.ino and RC_receiver.cpp use
+#define RC_THROTTLE_PIN 35
+#define RC_STEER_PIN 36
+#define RC_SW1_PIN 37
+#define RC_SW3_PIN 38
+#define HALL_PHASE_A_PIN 40
+#define HALL_PHASE_B_PIN 41
+#define HALL_PHASE_C_PIN 42
+
+#define RC_FRAME_US 20000 // the RC receiver sends every channel at 50 Hz
+
+static void usage(const char *name) {
+   fprintf(stderr,
+      "Usage: %s [options]\n"
+      "Runs the Teensy firmware on this host. Serial1 is a pty whose path\n"
+      "is printed at start up, or the path in $TEENSY_HOST_SERIAL1.\n"
+      "\n"
+      "  --rc T,S,SW1,SW3   RC pulse widths in us for the throttle, steering\n"
+      "                     and switch channels (default 1500,1500,1400,1500;\n"
+      "                     SW1 at 1100 presses the deadman switch)\n"
+      "  --hall HZ          hall sensor phase A frequency, negative to run\n"
+      "                     backwards (default 0)\n"
+      "  --imu DEG          heading that the IMU reports (default 0)\n"
+      "  --tof LEFT,RIGHT   ranges in mm that the ToF sensors report, -1 for\n"
+      "                     a phase failure (default 1000,1000)\n"
+      "  --duration S       exit after S seconds (default: run until killed)\n",
+      name);
+}
+
+/**
+ * @brief Sends the three hall sensor phases 120 degrees apart. Phase C
+ * leading phase B is forwards.
+ */
+static void hall_waves(double hz) {
+   uint32_t period_us;
+   bool forwards = hz >= 0;
+
+   if (hz == 0) {
+      host_gpio_stop(HALL_PHASE_A_PIN);
+      host_gpio_stop(HALL_PHASE_B_PIN);
+      host_gpio_stop(HALL_PHASE_C_PIN);
+      return;
+   }
+
+   period_us = (uint32_t)(1000000 / (forwards ? hz : -hz));
+   host_gpio_square(HALL_PHASE_A_PIN, period_us, period_us / 2, 0);
+   host_gpio_square(forwards ? HALL_PHASE_B_PIN : HALL_PHASE_C_PIN,
+                    period_us, period_us / 2, period_us / 3);
+   host_gpio_square(forwards ? HALL_PHASE_C_PIN : HALL_PHASE_B_PIN,
+                    period_us, period_us / 2, 2 * period_us / 3);
+}
+
+static void exit_after(int sig) {
+   (void)sig;
+   fflush(stdout);
+   _exit(0);
+}
+
+int main(int argc, char **argv) {
+   static const struct option options[] = {
+      {"rc", required_argument, NULL, 'r'},
+      {"hall", required_argument, NULL, 'h'},
+      {"imu", required_argument, NULL, 'i'},
+      {"tof", required_argument, NULL, 't'},
+      {"duration", required_argument, NULL, 'd'},
+      {"help", no_argument, NULL, '?'},
+      {NULL, 0, NULL, 0}
+   };
+   unsigned rc_us[4] = {1500, 1500, 1400, 1500};
+   int tof_mm[2] = {1000, 1000};
+   double hall_hz = 0;
+   unsigned duration_s = 0;
+   int opt;
+
+   while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+      switch (opt) {
+         case 'r':
+            if (sscanf(optarg, "%u,%u,%u,%u", &rc_us[0], &rc_us[1],
+                       &rc_us[2], &rc_us[3]) != 4) {
+               usage(argv[0]);
+               return 1;
+            }
+            break;
+         case 'h':
+            hall_hz = atof(optarg);
+            break;
+         case 'i':
+            host_imu_set(atof(optarg));
+            break;
+         case 't':
+            if (sscanf(optarg, "%d,%d", &tof_mm[0], &tof_mm[1]) != 2) {
+               usage(argv[0]);
+               return 1;
+            }
+            break;
+         case 'd':
+            duration_s = atoi(optarg);
+            break;
+         default:
+            usage(argv[0]);
+            return opt == '?' ? 0 : 1;
+      }
+   }
+
+   setvbuf(stdout, NULL, _IOLBF, 0);
+
+   // tof_lidar.cpp puts the left sensor on Wire1 and the right one on Wire2
+   host_tof_set(1, tof_mm[0]);
+   host_tof_set(2, tof_mm[1]);
+
+   host_gpio_square(RC_THROTTLE_PIN, RC_FRAME_US, rc_us[0], 0);
+   host_gpio_square(RC_STEER_PIN, RC_FRAME_US, rc_us[1], 0);
+   host_gpio_square(RC_SW1_PIN, RC_FRAME_US, rc_us[2], 0);
+   host_gpio_square(RC_SW3_PIN, RC_FRAME_US, rc_us[3], 0);
+   hall_waves(hall_hz);
+
+   if (duration_s > 0) {
+      signal(SIGALRM, exit_after);
+      alarm(duration_s);
+   }
+
+   setup();
+   while (true) {
+      loop();
+   }
+}
@@ -0,0 +1,440 @@
+#include <Arduino.h>
+#include <host_sim.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define UART_FIFO_SIZE 8 // depth of the UART0 FIFOs on the Kinetis parts
+#define UART_BITS_PER_BYTE 10 // start bit, 8 data bits and stop bit
+
+usb_serial_class Serial;
+HardwareSerial Serial1(IRQ_UART0_STATUS);
+
+
+/********************************* PRINT *************************************/
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+   size_t n = 0;
+
+   while (size--) {
+      n += write(*buffer++);
+   }
+   return n;
+}
+
+size_t Print::print(long n, int base) {
+   if (base == DEC) {
+      return printf("%ld", n);
+   }
+   if (n < 0) {
+      return print('-') + print((unsigned long)-n, base);
+   }
+   return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+   char buffer[8 * sizeof(long) + 1];
+   char *str = &buffer[sizeof(buffer) - 1];
+
+   if (base < 2) {
+      base = DEC;
+   }
+
+   *str = '\0';
+   do {
+      unsigned long digit = n % base;
+      n /= base;
+      *--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+   } while (n);
+
+   return write(str);
+}
+
+size_t Print::print(double n, int digits) {
+   return printf("%.*f", digits, n);
+}
+
+int Print::printf(const char *format, ...) {
+   char buffer[256];
+   va_list args;
+   int n;
+
+   va_start(args, format);
+   n = vsnprintf(buffer, sizeof(buffer), format, args);
+   va_end(args);
+
+   if (n < 0) {
+      return n;
+   }
+   return write(buffer, (size_t)n < sizeof(buffer) ? n : sizeof(buffer) - 1);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+   size_t count = 0;
+
+   while (count < length) {
+      uint32_t start_ms = millis();
+      int c;
+
+      while ((c = read()) < 0) {
+         if (millis() - start_ms >= timeout_ms_) {
+            return count;
+         }
+         delay(1);
+      }
+      buffer[count++] = (char)c;
+   }
+   return count;
+}
+
+
+/****************************** USB CONSOLE **********************************/
+
+size_t usb_serial_class::write(uint8_t b) {
+   return fwrite(&b, 1, 1, stdout);
+}
+
+size_t usb_serial_class::write(const uint8_t *buffer, size_t size) {
+   return fwrite(buffer, 1, size, stdout);
+}
+
+
+/******************************** UART ***************************************/
+
+/**
+ * @brief The receive and transmit paths of a UART. A reader thread plays the
+ * part of the receiver: it moves up to a FIFO's worth of bytes from the pty
+ * into the FIFO and raises the status interrupt, whose handler moves them on
+ * into the receive buffer. A transmitter thread plays the part of the
+ * transmitter: it takes a FIFO's worth of bytes out of the transmit buffer,
+ * raises the status interrupt for the room that this makes, and passes the
+ * bytes to the pty at the baud rate.
+ */
+struct HardwareSerial::Impl {
+   int master;
+   int slave;          // held open so the master survives the peer closing
+   char path[64];
+   pthread_t reader;
+   pthread_t transmitter;
+   uint32_t baud;
+
+   uint8_t fifo[UART_FIFO_SIZE];
+   int fifo_count;
+
+   uint8_t rx_buffer[RX_BUFFER_SIZE];
+   int rx_head;
+   int rx_tail;
+   uint32_t overruns;
+
+   // the transmit buffer, guarded by tx_lock rather than the interrupt lock
+   // so that a full buffer can be waited for. tx_cond is signalled whenever
+   // bytes are added or taken and when the transmitter goes idle
+   pthread_mutex_t tx_lock;
+   pthread_cond_t tx_cond;
+   uint8_t tx_buffer[TX_BUFFER_SIZE];
+   int tx_head;
+   int tx_tail;
+   bool tx_busy;       // bytes are in the buffer or on the wire
+};
+
+void *HardwareSerial::receive(void *arg) {
+   HardwareSerial *uart = (HardwareSerial*)arg;
+   Impl *impl = uart->impl_;
+   uint8_t bytes[UART_FIFO_SIZE];
+
+   while (true) {
+      struct pollfd pfd = {impl->master, POLLIN, 0};
+      ssize_t n;
+
+      if (poll(&pfd, 1, -1) < 0) {
+         continue;
+      }
+      n = ::read(impl->master, bytes, sizeof(bytes));
+      if (n <= 0) {
+         if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+            delay(10); // nobody has the pty open
+         }
+         continue;
+      }
+
+      __disable_irq();
+      for (ssize_t i = 0; i < n && impl->fifo_count < UART_FIFO_SIZE; i++) {
+         impl->fifo[impl->fifo_count++] = bytes[i];
+      }
+      __enable_irq();
+      host_irq_raise(uart->irq_);
+   }
+   return NULL;
+}
+
+/**
+ * @brief Writes bytes that have left the transmitter to the pty. When the
+ * pty is full because nobody is reading it, the stale bytes are thrown away
+ * like on a UART with nothing connected.
+ */
+static void send_to_pty(int master, int slave, const uint8_t *bytes,
+                        size_t size) {
+   size_t done = 0;
+
+   while (done < size) {
+      ssize_t n = ::write(master, bytes + done, size - done);
+
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if (errno == EAGAIN && slave >= 0) {
+            tcflush(slave, TCIFLUSH);
+            n = ::write(master, bytes + done, size - done);
+         }
+         if (n < 0) {
+            return;
+         }
+      }
+      done += n;
+   }
+}
+
+void *HardwareSerial::transmit(void *arg) {
+   HardwareSerial *uart = (HardwareSerial*)arg;
+   Impl *impl = uart->impl_;
+   uint8_t bytes[UART_FIFO_SIZE];
+   uint64_t wire_us = 0; // when the bytes on the wire have gone out
+
+   while (true) {
+      uint64_t now_us;
+      int n = 0;
+
+      pthread_mutex_lock(&impl->tx_lock);
+      while (impl->tx_head == impl->tx_tail) {
+         pthread_cond_wait(&impl->tx_cond, &impl->tx_lock);
+      }
+      while (n < UART_FIFO_SIZE && impl->tx_tail != impl->tx_head) {
+         bytes[n++] = impl->tx_buffer[impl->tx_tail];
+         impl->tx_tail = (impl->tx_tail + 1) % TX_BUFFER_SIZE;
+      }
+      pthread_cond_broadcast(&impl->tx_cond);
+      pthread_mutex_unlock(&impl->tx_lock);
+
+      // the FIFO took the bytes, so there is room in the buffer
+      host_irq_raise(uart->irq_);
+
+      now_us = host_micros64();
+      if (wire_us < now_us) {
+         wire_us = now_us;
+      }
+      wire_us += (uint64_t)n * UART_BITS_PER_BYTE * 1000000 / impl->baud;
+      now_us = host_micros64();
+      if (wire_us > now_us) {
+         delayMicroseconds(wire_us - now_us);
+      }
+      send_to_pty(impl->master, impl->slave, bytes, n);
+
+      // the transmission complete interrupt, once the buffer ran empty
+      pthread_mutex_lock(&impl->tx_lock);
+      bool idle = impl->tx_head == impl->tx_tail;
+      if (idle) {
+         impl->tx_busy = false;
+         pthread_cond_broadcast(&impl->tx_cond);
+      }
+      pthread_mutex_unlock(&impl->tx_lock);
+      if (idle) {
+         host_irq_raise(uart->irq_);
+      }
+   }
+   return NULL;
+}
+
+HardwareSerial::HardwareSerial(enum IRQ_NUMBER_t irq)
+      : impl_(NULL), irq_(irq) {
+}
+
+/**
+ * @brief Opens a pty in raw mode and starts receiving from it and
+ * transmitting to it. Bytes go out to the pty no faster than baud / 10 per
+ * second, like on the UART; bytes from the other side are taken as fast as
+ * it sends them. If the TEENSY_HOST_SERIAL1 environment variable names a
+ * path, a symlink to the pty is made there so the other side can use a
+ * fixed device name.
+ */
+void HardwareSerial::begin(uint32_t baud) {
+   struct termios tio;
+   const char *link;
+
+   if (impl_ != NULL) {
+      return;
+   }
+
+   impl_ = new Impl();
+   impl_->baud = baud > 0 ? baud : 9600;
+   pthread_mutex_init(&impl_->tx_lock, NULL);
+   pthread_cond_init(&impl_->tx_cond, NULL);
+   impl_->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+   if (impl_->master < 0 || grantpt(impl_->master) != 0 ||
+       unlockpt(impl_->master) != 0 ||
+       ptsname_r(impl_->master, impl_->path, sizeof(impl_->path)) != 0) {
+      perror("Serial1: cannot open a pty");
+      abort();
+   }
+
+   impl_->slave = open(impl_->path, O_RDWR | O_NOCTTY);
+   if (impl_->slave >= 0 && tcgetattr(impl_->slave, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(impl_->slave, TCSANOW, &tio);
+   }
+
+   link = getenv("TEENSY_HOST_SERIAL1");
+   if (link != NULL && link[0] != '\0') {
+      unlink(link);
+      if (symlink(impl_->path, link) != 0) {
+         perror("Serial1: cannot link the pty");
+      }
+   }
+   fprintf(stderr, "Serial1 is %s\n", link != NULL && link[0] != '\0' ?
+           link : impl_->path);
+
+   if (pthread_create(&impl_->reader, NULL, receive, this) != 0 ||
+       pthread_create(&impl_->transmitter, NULL, transmit, this) != 0) {
+      perror("pthread_create");
+      abort();
+   }
+}
+
+void HardwareSerial::end() {
+}
+
+const char *HardwareSerial::path() const {
+   return impl_ != NULL ? impl_->path : NULL;
+}
+
+void HardwareSerial::service() {
+   if (impl_ == NULL) {
+      return;
+   }
+
+   __disable_irq();
+   for (int i = 0; i < impl_->fifo_count; i++) {
+      int head = (impl_->rx_head + 1) % RX_BUFFER_SIZE;
+
+      if (head == impl_->rx_tail) {
+         impl_->overruns++;
+         continue;
+      }
+      impl_->rx_buffer[impl_->rx_head] = impl_->fifo[i];
+      impl_->rx_head = head;
+   }
+   impl_->fifo_count = 0;
+   __enable_irq();
+}
+
+int HardwareSerial::available() {
+   int n;
+
+   if (impl_ == NULL) {
+      return 0;
+   }
+
+   __disable_irq();
+   n = (impl_->rx_head - impl_->rx_tail + RX_BUFFER_SIZE) % RX_BUFFER_SIZE;
+   __enable_irq();
+   return n;
+}
+
+int HardwareSerial::peek() {
+   int c = -1;
+
+   if (impl_ == NULL) {
+      return -1;
+   }
+
+   __disable_irq();
+   if (impl_->rx_head != impl_->rx_tail) {
+      c = impl_->rx_buffer[impl_->rx_tail];
+   }
+   __enable_irq();
+   return c;
+}
+
+int HardwareSerial::read() {
+   int c = -1;
+
+   if (impl_ == NULL) {
+      return -1;
+   }
+
+   __disable_irq();
+   if (impl_->rx_head != impl_->rx_tail) {
+      c = impl_->rx_buffer[impl_->rx_tail];
+      impl_->rx_tail = (impl_->rx_tail + 1) % RX_BUFFER_SIZE;
+   }
+   __enable_irq();
+   return c;
+}
+
+/**
+ * @brief The room in the transmit buffer, which like in the Teensy core
+ * holds one byte less than its size.
+ */
+int HardwareSerial::availableForWrite() {
+   int used;
+
+   if (impl_ == NULL) {
+      return 0;
+   }
+
+   pthread_mutex_lock(&impl_->tx_lock);
+   used = (impl_->tx_head - impl_->tx_tail + TX_BUFFER_SIZE) % TX_BUFFER_SIZE;
+   pthread_mutex_unlock(&impl_->tx_lock);
+   return TX_BUFFER_SIZE - 1 - used;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+   return write(&b, 1);
+}
+
+/**
+ * @brief Puts the bytes into the transmit buffer, waiting for the
+ * transmitter to make room whenever it is full, like the Teensy core does.
+ */
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+   if (impl_ == NULL) {
+      return 0;
+   }
+
+   pthread_mutex_lock(&impl_->tx_lock);
+   for (size_t i = 0; i < size; i++) {
+      int head = (impl_->tx_head + 1) % TX_BUFFER_SIZE;
+
+      while (head == impl_->tx_tail) {
+         pthread_cond_broadcast(&impl_->tx_cond);
+         pthread_cond_wait(&impl_->tx_cond, &impl_->tx_lock);
+      }
+      impl_->tx_buffer[impl_->tx_head] = buffer[i];
+      impl_->tx_head = head;
+      impl_->tx_busy = true;
+   }
+   pthread_cond_broadcast(&impl_->tx_cond);
+   pthread_mutex_unlock(&impl_->tx_lock);
+   return size;
+}
+
+/**
+ * @brief Waits until every byte in the transmit buffer has gone out.
+ */
+void HardwareSerial::flush() {
+   if (impl_ == NULL) {
+      return;
+   }
+
+   pthread_mutex_lock(&impl_->tx_lock);
+   while (impl_->tx_busy) {
+      pthread_cond_wait(&impl_->tx_cond, &impl_->tx_lock);
+   }
+   pthread_mutex_unlock(&impl_->tx_lock);
+}
@@ -0,0 +1,275 @@
+/**
+ * @file Logs records into the black box in black_box.cpp, triggers and
+ * rearms it, and reads it out in dump frames, which are found and checked
+ * by bbox_next_frame() like teensy_black_box decode does on the Pi.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <Arduino.h>
+#include "../../src/main/include/black_box.h"
+
+// the firmware's loop() is not linked in, see chBegin in chibios.cpp
+void loop() {}
+
+namespace {
+
+/**
+ * @brief What a whole dump decodes to.
+ */
+struct Dump {
+   bbox_dump_header_t header;
+   std::vector<bbox_record_t> records;
+   uint32_t frames;
+};
+
+/**
+ * @brief Dumps the newest max_records records, 0 for all, into one buffer
+ * of frames.
+ */
+std::vector<uint8_t> dump_bytes(uint16_t max_records) {
+   std::vector<uint8_t> bytes;
+   uint8_t frame[BBOX_FRAME_MAX];
+   uint16_t size;
+   bbox_dump_t dump;
+
+   black_box_dump_begin(&dump, max_records);
+   while ((size = black_box_dump_frame(&dump, frame)) > 0) {
+      EXPECT_LE(size, BBOX_FRAME_MAX);
+      bytes.insert(bytes.end(), frame, frame + size);
+   }
+   black_box_dump_end(&dump);
+   return bytes;
+}
+
+/**
+ * @brief Decodes the frames in bytes, in order, skipping anything else.
+ */
+Dump decode(const std::vector<uint8_t> &bytes) {
+   Dump dump = {};
+   size_t offset = 0;
+   size_t used;
+   bbox_frame_t frame;
+
+   while (bbox_next_frame(bytes.data() + offset, bytes.size() - offset,
+                          &frame, &used)) {
+      offset += used;
+      EXPECT_EQ(frame.index, dump.frames);
+      if (frame.index == 0) {
+         EXPECT_EQ(frame.size, sizeof(dump.header));
+         memcpy(&dump.header, frame.payload, sizeof(dump.header));
+      }
+      else {
+         EXPECT_EQ(frame.size, frame.records * sizeof(bbox_record_t));
+         for (int i = 0; i < frame.records; i++) {
+            bbox_record_t record;
+
+            memcpy(&record, frame.payload + i * sizeof(record),
+                   sizeof(record));
+            dump.records.push_back(record);
+         }
+      }
+      dump.frames++;
+   }
+   return dump;
+}
+
+Dump dump_all(uint16_t max_records = 0) {
+   return decode(dump_bytes(max_records));
+}
+
+/**
+ * @brief Starts every test on an empty ring with the default decimation of
+ * the kinds that the tests log.
+ */
+class BlackBox : public ::testing::Test {
+protected:
+   void SetUp() override {
+      black_box_decimate(BBOX_HALL, 1);
+      black_box_decimate(BBOX_MOTOR, 4);
+      black_box_rearm();
+   }
+};
+
+} // namespace
+
+TEST_F(BlackBox, FreezesAfterThePostTrigger) {
+   for (int i = 0; i < 100; i++) {
+      black_box_log_at(BBOX_HALL, 0, i, i);
+   }
+   black_box_trigger(BBOX_TRIG_PI);
+   EXPECT_FALSE(black_box_frozen());
+
+   // the trigger record is the first of the ones after the trigger
+   for (int i = 0; i < BBOX_POST_TRIGGER - 2; i++) {
+      black_box_log_at(BBOX_HALL, 1, i, 1000 + i);
+   }
+   EXPECT_FALSE(black_box_frozen());
+   black_box_log_at(BBOX_HALL, 1, -1, 5000);
+   EXPECT_TRUE(black_box_frozen());
+
+   // a frozen ring takes nothing more, and only counts it
+   black_box_log_at(BBOX_HALL, 2, 0, 6000);
+   black_box_log_at(BBOX_HALL, 2, 0, 6001);
+   black_box_trigger(BBOX_TRIG_DEADMAN);
+
+   Dump dump = dump_all();
+   EXPECT_EQ(dump.header.version, BBOX_DUMP_VERSION);
+   EXPECT_EQ(dump.header.records, 100 + BBOX_POST_TRIGGER);
+   EXPECT_EQ(dump.header.trigger, BBOX_TRIG_PI);
+   EXPECT_EQ(dump.header.frozen, 1);
+   EXPECT_EQ(dump.header.lost, 2u);
+   ASSERT_EQ(dump.records.size(), 100u + BBOX_POST_TRIGGER);
+   EXPECT_EQ(dump.frames,
+             1u + (dump.records.size() + BBOX_DUMP_RECORDS - 1) /
+             BBOX_DUMP_RECORDS);
+   EXPECT_EQ(dump.records[99].time_us, 99u);
+   EXPECT_EQ(dump.records[100].kind, BBOX_TRIGGER);
+   EXPECT_EQ(dump.records[100].channel, BBOX_TRIG_PI);
+   EXPECT_EQ(dump.records.back().time_us, 5000u);
+   EXPECT_EQ(dump.records.back().value, -1);
+}
+
+TEST_F(BlackBox, Decimates) {
+   // every 4th motor output by default
+   for (int i = 1; i <= 10; i++) {
+      black_box_log_at(BBOX_MOTOR, 0, i, i);
+   }
+   black_box_decimate(BBOX_HALL, 3);
+   // a kind that does not exist and a rate of 0 change nothing
+   black_box_decimate(BBOX_NUM_KINDS, 2);
+   black_box_decimate(BBOX_HALL, 0);
+   for (int i = 1; i <= 7; i++) {
+      black_box_log_at(BBOX_HALL, 0, 100 + i, 100 + i);
+   }
+   black_box_log_at(BBOX_NUM_KINDS, 0, 0, 200);
+
+   Dump dump = dump_all();
+   ASSERT_EQ(dump.records.size(), 4u);
+   EXPECT_EQ(dump.records[0].value, 4);
+   EXPECT_EQ(dump.records[1].value, 8);
+   EXPECT_EQ(dump.records[2].value, 103);
+   EXPECT_EQ(dump.records[3].value, 106);
+   EXPECT_EQ(dump.header.decimation[BBOX_MOTOR], 4);
+   EXPECT_EQ(dump.header.decimation[BBOX_HALL], 3);
+   EXPECT_EQ(dump.header.decimation[BBOX_RC], 1);
+}
+
+TEST_F(BlackBox, RearmStartsOver) {
+   black_box_log_at(BBOX_HALL, 0, 1, 1);
+   black_box_trigger(BBOX_TRIG_LINK);
+   for (int i = 0; i < BBOX_POST_TRIGGER; i++) {
+      black_box_log_at(BBOX_HALL, 0, 2, 2);
+   }
+   ASSERT_TRUE(black_box_frozen());
+
+   black_box_rearm();
+   EXPECT_FALSE(black_box_frozen());
+   Dump dump = dump_all();
+   EXPECT_EQ(dump.header.records, 0u);
+   EXPECT_EQ(dump.header.trigger, BBOX_TRIG_NONE);
+   EXPECT_EQ(dump.header.frozen, 0);
+   EXPECT_EQ(dump.header.lost, 0u);
+   EXPECT_EQ(dump.frames, 1u);
+
+   // and it triggers again
+   black_box_log_at(BBOX_HALL, 0, 3, 3);
+   black_box_trigger(BBOX_TRIG_IMU);
+   dump = dump_all();
+   ASSERT_EQ(dump.records.size(), 2u);
+   EXPECT_EQ(dump.records[0].value, 3);
+   EXPECT_EQ(dump.header.trigger, BBOX_TRIG_IMU);
+}
+
+TEST_F(BlackBox, DumpWindowAcrossTheWrap) {
+   const uint32_t written = BBOX_DEPTH + 1000;
+
+   for (uint32_t i = 0; i < written; i++) {
+      black_box_log_at(BBOX_HALL, 0, (int16_t)i, i);
+   }
+
+   // the whole ring is the newest BBOX_DEPTH records, oldest first
+   Dump dump = dump_all();
+   ASSERT_EQ(dump.records.size(), (size_t)BBOX_DEPTH);
+   for (uint32_t i = 0; i < BBOX_DEPTH; i++) {
+      ASSERT_EQ(dump.records[i].time_us, written - BBOX_DEPTH + i) << i;
+   }
+
+   // a window that starts before the wrap and ends after it
+   dump = dump_all(1500);
+   EXPECT_EQ(dump.header.records, 1500u);
+   ASSERT_EQ(dump.records.size(), 1500u);
+   EXPECT_EQ(dump.records.front().time_us, written - 1500);
+   EXPECT_EQ(dump.records.back().time_us, written - 1);
+
+   // more than there are is all of them
+   dump = dump_all(BBOX_DEPTH + 1);
+   EXPECT_EQ(dump.records.size(), (size_t)BBOX_DEPTH);
+}
+
+TEST_F(BlackBox, DumpPausesLogging) {
+   uint8_t frame[BBOX_FRAME_MAX];
+   bbox_dump_t dump;
+
+   black_box_log_at(BBOX_HALL, 0, 1, 1);
+   black_box_dump_begin(&dump, 0);
+   black_box_log_at(BBOX_HALL, 0, 2, 2);
+   black_box_trigger(BBOX_TRIG_PI);
+   while (black_box_dump_frame(&dump, frame) > 0) {
+   }
+   black_box_dump_end(&dump);
+
+   Dump after = dump_all();
+   ASSERT_EQ(after.records.size(), 1u);
+   EXPECT_EQ(after.header.lost, 1u);
+   EXPECT_EQ(after.header.trigger, BBOX_TRIG_NONE);
+}
+
+TEST_F(BlackBox, ChecksumRejectsDamagedFrames) {
+   for (int i = 0; i < 3 * BBOX_DUMP_RECORDS; i++) {
+      black_box_log_at(BBOX_TOF, 1, 100 * i, 10 * i);
+   }
+   std::vector<uint8_t> bytes = dump_bytes(0);
+   size_t frame_size = BBOX_FRAME_HEADER_SIZE +
+                       BBOX_DUMP_RECORDS * sizeof(bbox_record_t) + 2;
+   size_t header_size = BBOX_FRAME_HEADER_SIZE +
+                        sizeof(bbox_dump_header_t) + 2;
+
+   ASSERT_EQ(bytes.size(), header_size + 3 * frame_size);
+   // the checksum is Fletcher-16 from the index to the end of the payload
+   uint16_t checksum = bytes[header_size - 2] | bytes[header_size - 1] << 8;
+   EXPECT_EQ(checksum, bbox_fletcher16(&bytes[2], header_size - 4));
+
+   // sensor frames and noise in between are skipped
+   std::vector<uint8_t> noisy(bytes.begin(), bytes.begin() + header_size);
+   for (int i = 0; i < SENSOR_FRAME_SIZE; i++) {
+      noisy.push_back(i == 0 ? (uint8_t)BBOX_DUMP_SYNC : 0x80);
+   }
+   noisy.insert(noisy.end(), bytes.begin() + header_size, bytes.end());
+   Dump dump = decode(noisy);
+   EXPECT_EQ(dump.frames, 4u);
+   ASSERT_EQ(dump.records.size(), 3u * BBOX_DUMP_RECORDS);
+   EXPECT_EQ(dump.records[7].value, 700);
+   EXPECT_EQ(dump.records[7].channel, 1);
+
+   // a flipped bit in the second record frame drops just that frame
+   std::vector<uint8_t> damaged = bytes;
+   damaged[header_size + frame_size + BBOX_FRAME_HEADER_SIZE + 3] ^= 0x10;
+   size_t offset = 0;
+   size_t used;
+   bbox_frame_t frame;
+   std::vector<uint16_t> indices;
+   while (bbox_next_frame(damaged.data() + offset, damaged.size() - offset,
+                          &frame, &used)) {
+      offset += used;
+      indices.push_back(frame.index);
+   }
+   EXPECT_EQ(indices, (std::vector<uint16_t>{0, 1, 3}));
+
+   // a frame that is cut off is waited for, not skipped
+   EXPECT_FALSE(bbox_next_frame(bytes.data(), header_size - 1, &frame,
+                                &used));
+   EXPECT_EQ(used, 0u);
+}
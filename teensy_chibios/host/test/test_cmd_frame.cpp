@@ -0,0 +1,200 @@
+/**
+ * @file Feeds byte streams from the Pi through the command parser in
+ * cmd_frame.cpp, the way teensy_serial_poll does as bytes come off the UART.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../../src/main/include/cmd_frame.h"
+
+namespace {
+
+/**
+ * @brief Appends a 16 bit word in the byte order of the Pi and the Teensy.
+ */
+void put_word(std::vector<uint8_t> *bytes, uint16_t word) {
+   bytes->push_back(word & 0xFF);
+   bytes->push_back(word >> 8);
+}
+
+std::vector<uint8_t> command(int16_t motor, int16_t steer, int16_t fifth,
+                             int16_t mode, uint16_t seq) {
+   std::vector<uint8_t> bytes;
+
+   put_word(&bytes, (uint16_t)CMD_FRAME_SYNC);
+   put_word(&bytes, motor);
+   put_word(&bytes, steer);
+   put_word(&bytes, fifth);
+   put_word(&bytes, mode);
+   put_word(&bytes, seq);
+   return bytes;
+}
+
+std::vector<uint8_t> request(uint16_t code, uint16_t arg0, uint16_t arg1) {
+   std::vector<uint8_t> bytes;
+
+   put_word(&bytes, (uint16_t)CMD_FRAME_REQUEST_SYNC);
+   put_word(&bytes, code);
+   put_word(&bytes, arg0);
+   put_word(&bytes, arg1);
+   put_word(&bytes, 0);
+   put_word(&bytes, 0);
+   return bytes;
+}
+
+/**
+ * @brief Feeds every byte and returns the commands that were completed, in
+ * order.
+ */
+std::vector<actuator_data_t> feed(cmd_frame_t *frame,
+                                  const std::vector<uint8_t> &bytes) {
+   std::vector<actuator_data_t> cmds;
+   actuator_data_t cmd;
+
+   for (uint8_t byte : bytes) {
+      if (cmd_frame_feed(frame, byte, &cmd)) {
+         cmds.push_back(cmd);
+      }
+   }
+   return cmds;
+}
+
+void append(std::vector<uint8_t> *bytes, const std::vector<uint8_t> &more) {
+   bytes->insert(bytes->end(), more.begin(), more.end());
+}
+
+} // namespace
+
+TEST(CmdFrame, ParsesCommand) {
+   cmd_frame_t frame;
+   cmd_frame_init(&frame);
+
+   auto cmds = feed(&frame, command(-100, 45, 1, 2, 0xBEEF));
+   ASSERT_EQ(cmds.size(), 1u);
+   EXPECT_EQ(cmds[0].motor_output, -100);
+   EXPECT_EQ(cmds[0].steer_output, 45);
+   EXPECT_EQ(cmds[0].fifth_output, 1);
+   EXPECT_EQ(cmds[0].motor_mode, 2);
+   EXPECT_EQ(cmds[0].seq, 0xBEEF);
+   EXPECT_EQ(frame.frames, 1u);
+   EXPECT_EQ(frame.skipped, 0u);
+}
+
+TEST(CmdFrame, CompletesOnLastByteOnly) {
+   cmd_frame_t frame;
+   actuator_data_t cmd;
+   auto bytes = command(1, 2, 3, 0, 4);
+
+   cmd_frame_init(&frame);
+   for (size_t i = 0; i + 1 < bytes.size(); i++) {
+      EXPECT_FALSE(cmd_frame_feed(&frame, bytes[i], &cmd)) << "byte " << i;
+   }
+   EXPECT_TRUE(cmd_frame_feed(&frame, bytes.back(), &cmd));
+   EXPECT_EQ(bytes.size(), 2u + CMD_FRAME_SIZE);
+}
+
+TEST(CmdFrame, ResyncsAfterGarbage) {
+   cmd_frame_t frame;
+   std::vector<uint8_t> bytes = {0x12, 0x34, 0x56};
+
+   cmd_frame_init(&frame);
+   append(&bytes, command(10, 20, 0, 0, 1));
+   auto cmds = feed(&frame, bytes);
+
+   ASSERT_EQ(cmds.size(), 1u);
+   EXPECT_EQ(cmds[0].seq, 1);
+   EXPECT_EQ(frame.skipped, 3u);
+}
+
+TEST(CmdFrame, StartsInTheMiddleOfAFrame) {
+   cmd_frame_t frame;
+   auto first = command(10, 20, 0, 0, 1);
+   std::vector<uint8_t> bytes(first.begin() + 5, first.end());
+
+   cmd_frame_init(&frame);
+   append(&bytes, command(11, 21, 0, 0, 2));
+   append(&bytes, command(12, 22, 0, 0, 3));
+   auto cmds = feed(&frame, bytes);
+
+   ASSERT_EQ(cmds.size(), 2u);
+   EXPECT_EQ(cmds[0].seq, 2);
+   EXPECT_EQ(cmds[1].seq, 3);
+}
+
+TEST(CmdFrame, RepeatedSyncLowByte) {
+   cmd_frame_t frame;
+   uint8_t sync_low = (uint16_t)CMD_FRAME_SYNC & 0xFF;
+   std::vector<uint8_t> bytes = {sync_low, sync_low};
+
+   // the second low byte is the one that starts the sync word
+   cmd_frame_init(&frame);
+   auto cmd = command(5, 6, 0, 0, 7);
+   bytes.insert(bytes.end(), cmd.begin() + 1, cmd.end());
+   auto cmds = feed(&frame, bytes);
+
+   ASSERT_EQ(cmds.size(), 1u);
+   EXPECT_EQ(cmds[0].seq, 7);
+   EXPECT_EQ(frame.skipped, 1u);
+}
+
+TEST(CmdFrame, SyncWordInPayloadIsData) {
+   cmd_frame_t frame;
+
+   cmd_frame_init(&frame);
+   auto cmds = feed(&frame, command(CMD_FRAME_SYNC, CMD_FRAME_REQUEST_SYNC,
+                                    0, 0, 9));
+
+   ASSERT_EQ(cmds.size(), 1u);
+   EXPECT_EQ(cmds[0].motor_output, CMD_FRAME_SYNC);
+   EXPECT_EQ(cmds[0].steer_output, CMD_FRAME_REQUEST_SYNC);
+   EXPECT_EQ(frame.skipped, 0u);
+}
+
+TEST(CmdFrame, RequestIsTakenOnce) {
+   cmd_frame_t frame;
+   cmd_request_t req;
+
+   cmd_frame_init(&frame);
+   EXPECT_FALSE(cmd_frame_take_request(&frame, &req));
+   EXPECT_TRUE(feed(&frame, request(3, 500, 7)).empty());
+
+   ASSERT_TRUE(cmd_frame_take_request(&frame, &req));
+   EXPECT_EQ(req.code, 3);
+   EXPECT_EQ(req.arg[0], 500);
+   EXPECT_EQ(req.arg[1], 7);
+   EXPECT_FALSE(cmd_frame_take_request(&frame, &req));
+   EXPECT_EQ(frame.frames, 1u);
+}
+
+TEST(CmdFrame, NewerRequestReplacesOlder) {
+   cmd_frame_t frame;
+   cmd_request_t req;
+   auto bytes = request(1, 0, 0);
+
+   cmd_frame_init(&frame);
+   append(&bytes, request(2, 0, 0));
+   feed(&frame, bytes);
+
+   ASSERT_TRUE(cmd_frame_take_request(&frame, &req));
+   EXPECT_EQ(req.code, 2);
+}
+
+TEST(CmdFrame, RequestsAndCommandsInterleave) {
+   cmd_frame_t frame;
+   cmd_request_t req;
+   auto bytes = command(1, 0, 0, 0, 1);
+
+   cmd_frame_init(&frame);
+   append(&bytes, request(4, 0, 0));
+   append(&bytes, command(2, 0, 0, 0, 2));
+   auto cmds = feed(&frame, bytes);
+
+   ASSERT_EQ(cmds.size(), 2u);
+   EXPECT_EQ(cmds[0].seq, 1);
+   EXPECT_EQ(cmds[1].seq, 2);
+   ASSERT_TRUE(cmd_frame_take_request(&frame, &req));
+   EXPECT_EQ(req.code, 4);
+   EXPECT_EQ(frame.frames, 3u);
+}
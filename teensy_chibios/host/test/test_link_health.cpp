@@ -0,0 +1,88 @@
+/**
+ * @file Grades command ages and sequence numbers with link_health.cpp the
+ * way the control and serial threads do.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../../src/main/include/link_health.h"
+
+#define TICK_US 5000 // one control period at 200 Hz
+
+TEST(LinkHealth, GradesCommandAge) {
+   uint32_t cmd_us = 1000000;
+
+   EXPECT_EQ(link_health_update(cmd_us, cmd_us), LINK_OK);
+   EXPECT_EQ(link_health_update(cmd_us, cmd_us + LINK_HOLD_MS * 1000 - 1),
+             LINK_OK);
+   EXPECT_EQ(link_health_update(cmd_us, cmd_us + LINK_HOLD_MS * 1000),
+             LINK_HOLD);
+   EXPECT_EQ(link_health_update(cmd_us, cmd_us + LINK_COAST_MS * 1000),
+             LINK_COAST);
+   EXPECT_EQ(link_health_update(cmd_us, cmd_us + LINK_BRAKE_MS * 1000),
+             LINK_BRAKE);
+}
+
+TEST(LinkHealth, BrakesBeforeFirstCommand) {
+   EXPECT_EQ(link_health_update(0, 123456), LINK_BRAKE);
+}
+
+TEST(LinkHealth, HandlesMicrosWrap) {
+   uint32_t cmd_us = 0xFFFFFFFF - 10000;
+
+   EXPECT_EQ(link_health_update(cmd_us, cmd_us + 20000), LINK_OK);
+}
+
+TEST(LinkHealth, MeasuresReactionOnce) {
+   uint32_t cmd_us = 2000000;
+   uint32_t now_us = cmd_us;
+   uint32_t braked_us = 0;
+
+   // the control loop ticks on after the last command, never exactly on
+   // the threshold
+   now_us += 1234;
+   while (link_health_update(cmd_us, now_us) != LINK_BRAKE) {
+      now_us += TICK_US;
+   }
+   braked_us = now_us;
+   EXPECT_GE(link_health_reaction_ms(), LINK_BRAKE_MS);
+   EXPECT_LE(link_health_reaction_ms(), LINK_BRAKE_MS + TICK_US / 1000);
+   EXPECT_EQ((uint32_t)link_health_reaction_ms(),
+             (braked_us - cmd_us) / 1000);
+
+   // staying braked does not measure it again
+   link_health_update(cmd_us, now_us + 10 * TICK_US);
+   EXPECT_EQ((uint32_t)link_health_reaction_ms(),
+             (braked_us - cmd_us) / 1000);
+}
+
+TEST(LinkHealth, CountsDroppedFrames) {
+   link_data_t link = {0};
+
+   link_health_rx(&link, 7);
+   EXPECT_EQ(link.dropped, 0u);
+   link_health_rx(&link, 8);
+   link_health_rx(&link, 11);
+   EXPECT_EQ(link.dropped, 2u);
+   EXPECT_EQ(link.rx_seq, 11);
+   EXPECT_EQ(link.rx_count, 3u);
+}
+
+TEST(LinkHealth, CountsAcrossSeqWrap) {
+   link_data_t link = {0};
+
+   link_health_rx(&link, 0xFFFE);
+   link_health_rx(&link, 0xFFFF);
+   link_health_rx(&link, 1);
+   EXPECT_EQ(link.dropped, 1u);
+}
+
+TEST(LinkHealth, IgnoresRepeatsAndRestarts) {
+   link_data_t link = {0};
+
+   // a repeated frame or a Pi that started counting again is not a gap
+   link_health_rx(&link, 100);
+   link_health_rx(&link, 100);
+   link_health_rx(&link, 3);
+   EXPECT_EQ(link.dropped, 0u);
+}
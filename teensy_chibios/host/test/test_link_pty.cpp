@@ -0,0 +1,204 @@
+/**
+ * @file Runs the whole host build of the firmware, talks to it over its
+ * Serial1 pty the way pi_comm_node does, and checks the link health that it
+ * reports: commands are acknowledged while they flow, and once they stop the
+ * truck goes through LINK_COAST to LINK_BRAKE at LINK_BRAKE_MS. It also
+ * checks that the sensor frames come at their fixed rate.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../src/main/include/cmd_frame.h"
+#include "../../src/main/include/link_health.h"
+#include "../../src/main/include/teensy_serial.h"
+
+#define HOST_BINARY "build/teensy_host"
+#define CMD_PERIOD_MS 20
+
+static uint32_t now_ms() {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief The firmware in a child process and the Pi's end of its pty.
+ */
+class Firmware {
+public:
+   Firmware() : pid_(-1), fd_(-1), count_(0) {
+      snprintf(path_, sizeof(path_), "/tmp/teensy_link_pty.%d", getpid());
+   }
+
+   ~Firmware() {
+      if (fd_ >= 0) {
+         close(fd_);
+      }
+      if (pid_ > 0) {
+         kill(pid_, SIGKILL);
+         waitpid(pid_, NULL, 0);
+      }
+      unlink(path_);
+   }
+
+   bool start() {
+      struct termios tio;
+      uint32_t start_ms = now_ms();
+
+      unlink(path_);
+      pid_ = fork();
+      if (pid_ == 0) {
+         int null = open("/dev/null", O_WRONLY);
+
+         dup2(null, STDOUT_FILENO);
+         dup2(null, STDERR_FILENO);
+         setenv("TEENSY_HOST_SERIAL1", path_, 1);
+         execl(HOST_BINARY, HOST_BINARY, "--duration", "15", (char*)NULL);
+         _exit(127);
+      }
+
+      while (fd_ < 0 && now_ms() - start_ms < 2000) {
+         fd_ = open(path_, O_RDWR | O_NOCTTY | O_NONBLOCK);
+         if (fd_ < 0) {
+            usleep(10000);
+         }
+      }
+      if (fd_ < 0 || tcgetattr(fd_, &tio) != 0) {
+         return false;
+      }
+      cfmakeraw(&tio);
+      return tcsetattr(fd_, TCSANOW, &tio) == 0;
+   }
+
+   void send_command(uint16_t seq) {
+      int16_t frame[1 + CMD_FRAME_SIZE / 2] = {
+         CMD_FRAME_SYNC, 10, 90, 0, 0, (int16_t)seq
+      };
+
+      ASSERT_EQ(write(fd_, frame, sizeof(frame)), (ssize_t)sizeof(frame));
+   }
+
+   /**
+    * @brief Reads sensor frames for up to timeout_ms and returns the first
+    * one, or false if none arrived.
+    */
+   bool read_sensors(sensor_data_t *sensors, uint32_t timeout_ms) {
+      uint32_t start_ms = now_ms();
+
+      while (true) {
+         if (take_frame(sensors)) {
+            return true;
+         }
+
+         uint32_t waited_ms = now_ms() - start_ms;
+         struct pollfd pfd = {fd_, POLLIN, 0};
+         ssize_t n;
+
+         if (waited_ms >= timeout_ms ||
+             poll(&pfd, 1, timeout_ms - waited_ms) <= 0) {
+            return false;
+         }
+         n = read(fd_, buffer_ + count_, sizeof(buffer_) - count_);
+         if (n > 0) {
+            count_ += n;
+         }
+      }
+   }
+
+private:
+   /**
+    * @brief Finds the sync word in the received bytes and takes the frame
+    * that follows it, dropping anything before it.
+    */
+   bool take_frame(sensor_data_t *sensors) {
+      int16_t sync = CMD_FRAME_SYNC;
+      size_t start = 0;
+
+      while (start + 2 <= count_ && memcmp(buffer_ + start, &sync, 2) != 0) {
+         start++;
+      }
+      memmove(buffer_, buffer_ + start, count_ - start);
+      count_ -= start;
+      if (count_ < SENSOR_FRAME_SIZE) {
+         return false;
+      }
+      memcpy(sensors, buffer_ + 2, sizeof(*sensors));
+      memmove(buffer_, buffer_ + SENSOR_FRAME_SIZE,
+              count_ - SENSOR_FRAME_SIZE);
+      count_ -= SENSOR_FRAME_SIZE;
+      return true;
+   }
+
+   char path_[64];
+   pid_t pid_;
+   int fd_;
+   uint8_t buffer_[1024];
+   size_t count_;
+};
+
+TEST(LinkPty, BrakesAfterCommandsStop) {
+   Firmware firmware;
+   sensor_data_t sensors;
+   uint16_t seq = 0;
+   int frames = 0;
+   bool seen_ok = false;
+   bool seen_coast = false;
+   uint32_t stop_ms;
+
+   ASSERT_TRUE(firmware.start()) << "cannot run " HOST_BINARY;
+   // the serial thread only starts after the sensors are set up, which
+   // takes a while
+   ASSERT_TRUE(firmware.read_sensors(&sensors, 5000));
+
+   // the Pi's command stream
+   uint32_t stream_ms = now_ms();
+   for (int i = 0; i < 1000 / CMD_PERIOD_MS; i++) {
+      uint32_t sent_ms = now_ms();
+
+      firmware.send_command(seq++);
+      for (uint32_t waited_ms = 0; waited_ms < CMD_PERIOD_MS;
+           waited_ms = now_ms() - sent_ms) {
+         if (!firmware.read_sensors(&sensors, CMD_PERIOD_MS - waited_ms)) {
+            continue;
+         }
+         frames++;
+         if (sensors.link_state == LINK_OK) {
+            seen_ok = true;
+            EXPECT_LT((uint16_t)(seq - 1 - sensors.rx_seq), 5);
+         }
+      }
+   }
+   EXPECT_TRUE(seen_ok);
+   // one frame every SERIAL_SEND_MS however many samples were posted
+   EXPECT_NEAR(frames, (now_ms() - stream_ms) / SERIAL_SEND_MS, 2);
+
+   stop_ms = now_ms();
+   while (now_ms() - stop_ms < 2 * LINK_BRAKE_MS) {
+      if (!firmware.read_sensors(&sensors, LINK_BRAKE_MS)) {
+         continue;
+      }
+      if (sensors.link_state == LINK_COAST) {
+         seen_coast = true;
+      }
+      if (sensors.link_state == LINK_BRAKE) {
+         break;
+      }
+   }
+
+   ASSERT_EQ(sensors.link_state, LINK_BRAKE);
+   EXPECT_TRUE(seen_coast);
+   // graded on every control tick, so within a tick and a bit of scheduling
+   EXPECT_GE(sensors.link_reaction_ms, LINK_BRAKE_MS);
+   EXPECT_LE(sensors.link_reaction_ms, LINK_BRAKE_MS + 20);
+}
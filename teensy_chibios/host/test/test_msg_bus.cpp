@@ -0,0 +1,171 @@
+/**
+ * @file Passes samples over the message bus in msg_bus.cpp between threads,
+ * on the ChibiOS shim, the way the sensor threads and the serial thread do.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include "../../src/main/include/msg_bus.h"
+
+// the firmware's loop() is not linked in, see chBegin in chibios.cpp
+void loop() {}
+
+namespace {
+
+#define EVT_BUS EVENT_MASK(1)
+
+/**
+ * @brief Sets the bus up once for the whole program, since its pool cannot
+ * be loaded twice, and checks that every test leaves it empty.
+ */
+class MsgBus : public ::testing::Test {
+protected:
+   static void SetUpTestCase() {
+      static bool loaded = false;
+
+      if (!loaded) {
+         msg_bus_setup();
+         loaded = true;
+      }
+   }
+
+   void TearDown() override {
+      bus_sample_t sample;
+
+      EXPECT_FALSE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+   }
+};
+
+} // namespace
+
+TEST_F(MsgBus, KeepsOrderAndTimestamps) {
+   bus_sample_t sample;
+
+   ASSERT_TRUE(msg_bus_post_i(SAMPLE_IMU_ANGLE, 90, 1000));
+   ASSERT_TRUE(msg_bus_post_i(SAMPLE_WHEEL_SPEED, -5, 2000));
+
+   ASSERT_TRUE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+   EXPECT_EQ(sample.type, SAMPLE_IMU_ANGLE);
+   EXPECT_EQ(sample.value, 90);
+   EXPECT_EQ(sample.time_us, 1000u);
+   ASSERT_TRUE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+   EXPECT_EQ(sample.type, SAMPLE_WHEEL_SPEED);
+   EXPECT_EQ(sample.value, -5);
+   EXPECT_EQ(sample.time_us, 2000u);
+}
+
+TEST_F(MsgBus, StampsPostWithMicros) {
+   bus_sample_t sample;
+   uint32_t before = micros();
+
+   ASSERT_TRUE(msg_bus_post(SAMPLE_LEFT_TOF, 300));
+   ASSERT_TRUE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+   EXPECT_GE((int32_t)(sample.time_us - before), 0);
+   EXPECT_LE((int32_t)(sample.time_us - micros()), 0);
+}
+
+TEST_F(MsgBus, DropsWhenFullWithoutBlocking) {
+   bus_sample_t sample;
+   uint32_t dropped = msg_bus_dropped();
+
+   for (int i = 0; i < MSG_BUS_DEPTH; i++) {
+      ASSERT_TRUE(msg_bus_post(SAMPLE_RIGHT_TOF, i)) << "sample " << i;
+   }
+   EXPECT_FALSE(msg_bus_post(SAMPLE_RIGHT_TOF, -1));
+   EXPECT_EQ(msg_bus_dropped(), dropped + 1);
+
+   // a fetched sample frees its block for the next post
+   ASSERT_TRUE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+   EXPECT_EQ(sample.value, 0);
+   EXPECT_TRUE(msg_bus_post(SAMPLE_RIGHT_TOF, MSG_BUS_DEPTH));
+
+   for (int i = 1; i <= MSG_BUS_DEPTH; i++) {
+      ASSERT_TRUE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+      EXPECT_EQ(sample.value, i);
+   }
+}
+
+TEST_F(MsgBus, FetchTimesOut) {
+   bus_sample_t sample;
+   uint32_t start = millis();
+
+   EXPECT_FALSE(msg_bus_fetch(&sample, MS2ST(20)));
+   EXPECT_GE(millis() - start, 19u);
+}
+
+TEST_F(MsgBus, SignalsListener) {
+   // the bus has no way to unregister, so the listener outlives the test
+   // and is registered once
+   static event_listener_t listener;
+   static bool listening = false;
+   bus_sample_t sample;
+
+   if (!listening) {
+      msg_bus_listen(&listener, EVT_BUS);
+      listening = true;
+   }
+   chEvtWaitAnyTimeout(ALL_EVENTS, TIME_IMMEDIATE);
+   std::thread poster([] {
+      delay(10);
+      msg_bus_post(SAMPLE_DRIVE_MODE, 2);
+   });
+
+   EXPECT_EQ(chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(1000)), EVT_BUS);
+   poster.join();
+   ASSERT_TRUE(msg_bus_fetch(&sample, TIME_IMMEDIATE));
+   EXPECT_EQ(sample.value, 2);
+
+   // no event is pending once the sample was taken
+   EXPECT_EQ(chEvtWaitAnyTimeout(ALL_EVENTS, TIME_IMMEDIATE), 0u);
+}
+
+TEST_F(MsgBus, ManyPostersOneReader) {
+   const int POSTERS = 4;
+   const int PER_POSTER = 5000;
+   std::atomic<int> posted(0);
+   std::vector<std::thread> posters;
+   std::vector<int> last(POSTERS, -1);
+   uint32_t dropped = msg_bus_dropped();
+   int fetched = 0;
+   bool in_order = true;
+
+   for (int p = 0; p < POSTERS; p++) {
+      posters.emplace_back([p, &posted] {
+         for (int i = 0; i < PER_POSTER; i++) {
+            if (msg_bus_post((uint8_t)p, (int16_t)i)) {
+               posted++;
+            }
+            if (i % 64 == 0) {
+               std::this_thread::yield();
+            }
+         }
+      });
+   }
+
+   // the samples of each poster come out in the order they were posted
+   bus_sample_t sample;
+   uint32_t idle_ms = millis();
+   while (millis() - idle_ms < 200) {
+      if (msg_bus_fetch(&sample, MS2ST(10))) {
+         in_order = in_order && sample.value > last[sample.type];
+         last[sample.type] = sample.value;
+         fetched++;
+         idle_ms = millis();
+      }
+   }
+   for (auto &poster : posters) {
+      poster.join();
+   }
+   while (msg_bus_fetch(&sample, TIME_IMMEDIATE)) {
+      fetched++;
+   }
+
+   EXPECT_TRUE(in_order);
+   EXPECT_EQ(fetched, posted.load());
+   EXPECT_EQ((int)(msg_bus_dropped() - dropped), POSTERS * PER_POSTER - posted);
+}
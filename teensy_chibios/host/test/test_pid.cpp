@@ -0,0 +1,130 @@
+/**
+ * @file Runs the fixed-point PidController in pid_controller.h against a
+ * simple plant model of the truck: a first-order lag from motor output to
+ * wheel speed, sampled at the MOTOR_PERIOD_MS that the firmware uses.
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include "../../src/main/include/pid_controller.h"
+
+#define PERIOD_MS 100
+
+/**
+ * @brief Wheel speed that settles at gain * output with time constant tau_s,
+ * plus a constant disturbance such as a slope.
+ */
+class Plant {
+public:
+   Plant(double gain, double tau_s, double disturbance = 0)
+      : gain_(gain), tau_s_(tau_s), disturbance_(disturbance), speed_(0) {}
+
+   int16_t step(int16_t output) {
+      double target = gain_ * output + disturbance_;
+
+      speed_ += (target - speed_) * (PERIOD_MS / 1000.0) / tau_s_;
+      return measurement();
+   }
+
+   int16_t measurement() const { return (int16_t)lround(speed_); }
+
+   double gain_;
+   double tau_s_;
+   double disturbance_;
+   double speed_;
+};
+
+TEST(Pid, ProportionalOnly) {
+   PidController<> pid(2.0f, 0, 0, 0, PERIOD_MS, -100, 100);
+
+   pid.reset(0);
+   EXPECT_EQ(pid.update(10, 0), 20);
+   EXPECT_EQ(pid.update(10, 15), -10);
+   EXPECT_EQ(pid.output(), -10);
+}
+
+TEST(Pid, ClampsOutput) {
+   PidController<> pid(10.0f, 0, 0, 0, PERIOD_MS, -40, 40);
+
+   pid.reset(0);
+   EXPECT_EQ(pid.update(100, 0), 40);
+   EXPECT_EQ(pid.update(-100, 0), -40);
+}
+
+TEST(Pid, FeedForwardWithoutError) {
+   PidController<> pid(1.0f, 0, 0, 0.5f, PERIOD_MS, -100, 100);
+
+   pid.reset(20);
+   EXPECT_EQ(pid.update(20, 20), 10);
+}
+
+TEST(Pid, IntegralRemovesSteadyStateError) {
+   // the speed controller's gains, against a plant with a disturbance that
+   // a P controller alone would leave an offset for
+   PidController<> pid(0.5f, 1.0f, 0, 0.1f, PERIOD_MS, -100, 100);
+   Plant plant(0.8, 0.3, -5);
+   int16_t speed = plant.measurement();
+
+   pid.reset(speed);
+   for (int i = 0; i < 200; i++) {
+      speed = plant.step(pid.update(30, speed));
+   }
+   EXPECT_NEAR(plant.speed_, 30, 0.6);
+}
+
+TEST(Pid, DerivativeOnMeasurementHasNoSetpointKick) {
+   PidController<> pd(1.0f, 0, 0.5f, 0, PERIOD_MS, -1000, 1000);
+   PidController<> p(1.0f, 0, 0, 0, PERIOD_MS, -1000, 1000);
+
+   pd.reset(0);
+   p.reset(0);
+   EXPECT_EQ(pd.update(50, 0), p.update(50, 0));
+
+   // a change of the measurement is damped: kd / period = 5 per unit
+   EXPECT_EQ(pd.update(50, 10), 40 - 50);
+}
+
+TEST(Pid, ResetPrimesDerivative) {
+   PidController<> pd(0, 0, 1.0f, 0, PERIOD_MS, -1000, 1000);
+
+   pd.reset(25);
+   EXPECT_EQ(pd.update(0, 25), 0);
+}
+
+TEST(Pid, AntiWindupRecoversQuickly) {
+   // the stop controller's gains and limit: the output saturates for a long
+   // time, and the integrator must not wind up while it does
+   PidController<> pid(0.2f, 2.0f, 0, 0, PERIOD_MS, -40, 40);
+   Plant weak(0.05, 0.2);
+   int16_t speed = 0;
+   int ticks = 0;
+
+   pid.reset(0);
+   for (int i = 0; i < 100; i++) {
+      speed = weak.step(pid.update(100, speed));
+      EXPECT_LE(pid.output(), 40);
+   }
+   EXPECT_GE(pid.output(), 39);
+
+   // once the error changes sign the output must leave saturation right
+   // away instead of unwinding a large integral first
+   while (pid.update(0, 50) > 0 && ticks < 100) {
+      ticks++;
+   }
+   EXPECT_LE(ticks, 3);
+}
+
+TEST(Pid, StopControllerBrakesToRest) {
+   PidController<> pid(0.2f, 2.0f, 0, 0, PERIOD_MS, -40, 40);
+   Plant plant(1.0, 0.5);
+   int16_t speed;
+
+   plant.speed_ = 40;
+   speed = plant.measurement();
+   pid.reset(speed);
+   for (int i = 0; i < 100; i++) {
+      speed = plant.step(pid.update(0, speed));
+   }
+   EXPECT_NEAR(plant.speed_, 0, 1.0);
+}
@@ -0,0 +1,141 @@
+/**
+ * @file Feeds synthetic RC pulse trains, as FTM3 capture values, through the
+ * decoder in rc_pulse.cpp.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../../src/main/include/rc_pulse.h"
+
+#define TICK_HZ (60000000 / 32) // F_BUS / 32, as RC_receiver.cpp sets up FTM3
+#define FRAME_MS 20
+
+/**
+ * @brief A 16 bit capture timer that wraps, and a clock in ms, for driving
+ * one channel with pulses of a given width.
+ */
+class PulseTrain {
+public:
+   explicit PulseTrain(uint16_t start_ticks = 0)
+      : ticks_(start_ticks), now_ms_(0) {
+      rc_pulse_init(&pulse_, TICK_HZ);
+   }
+
+   /**
+    * @brief Sends one frame: a pulse of width_us, then low for the rest of
+    * the frame.
+    *
+    * @return what rc_pulse_edge returned for the falling edge
+    */
+   bool send(uint32_t width_us) {
+      bool ended;
+
+      rc_pulse_edge(&pulse_, true, ticks_, now_ms_);
+      ticks_ += (uint16_t)((uint64_t)width_us * TICK_HZ / 1000000);
+      ended = rc_pulse_edge(&pulse_, false, ticks_, now_ms_);
+      ticks_ += (uint16_t)((uint64_t)(FRAME_MS * 1000 - width_us) *
+                           TICK_HZ / 1000000);
+      now_ms_ += FRAME_MS;
+      return ended;
+   }
+
+   void wait_ms(uint32_t ms) {
+      ticks_ += (uint16_t)((uint64_t)ms * TICK_HZ / 1000);
+      now_ms_ += ms;
+   }
+
+   rc_pulse_t pulse_;
+   uint16_t ticks_;
+   uint32_t now_ms_;
+};
+
+TEST(RcPulse, DecodesSteadyTrain) {
+   PulseTrain train;
+
+   for (int i = 0; i < 10; i++) {
+      EXPECT_TRUE(train.send(1500));
+   }
+   EXPECT_NEAR(train.pulse_.width_us, 1500, 1);
+   EXPECT_NEAR(train.pulse_.raw_us, 1500, 1);
+   EXPECT_EQ(train.pulse_.glitches, 0);
+   EXPECT_FALSE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+}
+
+TEST(RcPulse, ReportsFirstPulseRightAway) {
+   PulseTrain train;
+
+   train.send(1100);
+   EXPECT_NEAR(train.pulse_.width_us, 1100, 1);
+}
+
+TEST(RcPulse, HandlesTimerWrapInsidePulse) {
+   // the rising edge is captured just before the 16 bit timer wraps
+   PulseTrain train(0xFFFF - 100);
+
+   train.send(1900);
+   EXPECT_NEAR(train.pulse_.width_us, 1900, 1);
+}
+
+TEST(RcPulse, DropsPulsesOutOfRange) {
+   PulseTrain train;
+
+   for (int i = 0; i < 3; i++) {
+      train.send(1500);
+   }
+   EXPECT_TRUE(train.send(RC_PULSE_MIN_US - 100));
+   EXPECT_TRUE(train.send(RC_PULSE_MAX_US + 100));
+   EXPECT_EQ(train.pulse_.glitches, 2);
+   EXPECT_NEAR(train.pulse_.raw_us, RC_PULSE_MAX_US + 100, 1);
+   EXPECT_NEAR(train.pulse_.width_us, 1500, 1);
+}
+
+TEST(RcPulse, MedianRejectsSingleSpike) {
+   PulseTrain train;
+
+   for (int i = 0; i < 3; i++) {
+      train.send(1500);
+   }
+   train.send(2000);
+   EXPECT_NEAR(train.pulse_.width_us, 1500, 1);
+   train.send(1500);
+   EXPECT_NEAR(train.pulse_.width_us, 1500, 1);
+}
+
+TEST(RcPulse, MedianFollowsStep) {
+   PulseTrain train;
+
+   for (int i = 0; i < 3; i++) {
+      train.send(1500);
+   }
+   train.send(1900);
+   train.send(1900);
+   EXPECT_NEAR(train.pulse_.width_us, 1900, 1);
+}
+
+TEST(RcPulse, IgnoresFallingEdgeWithoutRisingEdge) {
+   rc_pulse_t pulse;
+
+   rc_pulse_init(&pulse, TICK_HZ);
+   EXPECT_FALSE(rc_pulse_edge(&pulse, false, 1234, 0));
+   EXPECT_EQ(pulse.glitches, 0);
+   EXPECT_TRUE(rc_pulse_lost(&pulse, 0));
+}
+
+TEST(RcPulse, DetectsSignalLoss) {
+   PulseTrain train;
+
+   EXPECT_TRUE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+   train.send(1500);
+   EXPECT_FALSE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+
+   train.wait_ms(RC_SIGNAL_TIMEOUT_MS - FRAME_MS);
+   EXPECT_FALSE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+   train.wait_ms(2 * FRAME_MS);
+   EXPECT_TRUE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+
+   // glitches alone do not bring the signal back
+   train.send(RC_PULSE_MAX_US + 500);
+   EXPECT_TRUE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+   train.send(1500);
+   EXPECT_FALSE(rc_pulse_lost(&train.pulse_, train.now_ms_));
+}
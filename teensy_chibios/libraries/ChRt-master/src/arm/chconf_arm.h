@@ -55,6 +55,12 @@
  *          of ticks that is safe to specify in a timeout directive.
  *          The value one is not valid, timeouts are rounded up to
  *          this value.
+ * @note    The Teensy 3 port only has the periodic SysTick. A tick-less
+ *          timer would have to be a 16-bit FTM clocked from the 31.25 kHz
+ *          MCG fixed frequency clock, where a 16-bit system time wraps
+ *          after 65536 / 31250 Hz, about 2.1 s, which is then the longest
+ *          timeout and the longest interval that chVTTimeElapsedSinceX()
+ *          can measure.
  */
 #define CH_CFG_ST_TIMEDELTA                 0 // WHG 2
 
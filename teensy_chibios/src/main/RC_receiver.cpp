@@ -1,87 +1,183 @@
 #include <Arduino.h>
 #include "include/RC_receiver.h"
+#include "include/rc_pulse.h"
+#include "include/black_box.h"
 
 //#define DEBUG
 
-float SW1_high_time = 0;
-volatile unsigned long SW1_time = 0;
+// FTM3 input capture channels 4-7 are muxed onto pins 35-38 (PTC8-PTC11)
+#define RC_THROTTLE_PIN 35
+#define RC_STEER_PIN 36
+#define RC_SW1_PIN 37
+#define RC_SW3_PIN 38
+#define RC_FTM_FIRST_CHANNEL 4
+#define RC_FTM_MUX 3 // ALT3 routes PTC8-PTC11 to FTM3_CH4-FTM3_CH7
+#define RC_FTM_PRESCALE 5 // bus clock / 32
+#define RC_FTM_TICK_HZ (F_BUS / 32)
+
+#define RC_WINDOW_US 75 // half-width of the pulse window for a switch mode
+
+/**
+ * @brief The pin for each RC channel, indexed by the RC_* channel numbers in
+ * system_data.h. Channel i is captured by FTM3 channel
+ * RC_FTM_FIRST_CHANNEL + i.
+ */
+static const uint8_t rc_pins[RC_NUM_CHANNELS] = {
+   RC_THROTTLE_PIN, RC_STEER_PIN, RC_SW1_PIN, RC_SW3_PIN
+};
+
+/**
+ * @brief The decoder state for every channel. It is written only by the FTM3
+ * interrupt and copied out with interrupts disabled by RC_receiver_read().
+ */
+static volatile rc_pulse_t rc_pulses[RC_NUM_CHANNELS];
+
+/**
+ * @brief Returns the status and control register of an FTM3 channel. The
+ * channel registers are laid out as CnSC, CnV pairs, so CnV immediately
+ * follows the returned register.
+ */
+static volatile uint32_t *ftm3_csc(uint8_t channel) {
+   return &FTM3_C0SC + 2 * channel;
+}
+
+/**
+ * @brief FTM3 interrupt: reads the capture value of every channel that saw an
+ * edge and hands it to the decoder. The timer latches the counter in
+ * hardware at the edge, so interrupt latency does not affect the measured
+ * pulse width. Each channel alternates between waiting for a rising and a
+ * falling edge so the edge direction is always known. Every pulse is logged
+ * in the black box as it was measured, before the glitch filter.
+ */
+extern "C" void ftm3_isr(void) {
+   uint32_t now_ms = millis();
+
+   for (uint8_t i = 0; i < RC_NUM_CHANNELS; i++) {
+      volatile uint32_t *csc = ftm3_csc(RC_FTM_FIRST_CHANNEL + i);
+      uint32_t status = *csc;
+
+      if (status & FTM_CSC_CHF) {
+         uint16_t ticks = *(csc + 1);
+         bool rising = status & FTM_CSC_ELSA;
+
+         // arm the opposite edge; writing CHF as 0 clears the flag
+         *csc = FTM_CSC_CHIE | (rising ? FTM_CSC_ELSB : FTM_CSC_ELSA);
+         if (rc_pulse_edge((rc_pulse_t*)&rc_pulses[i], rising, ticks,
+                           now_ms)) {
+            black_box_log(BBOX_RC, i, rc_pulses[i].raw_us);
+         }
+      }
+   }
+}
+
+/**
+ * @brief Maps the pulse width of a switch to a mode. A pulse that is within
+ * RC_WINDOW_US of center selects that mode; anything else leaves the mode
+ * unchanged.
+ */
+static void select_mode(uint16_t pulse_us, const uint16_t *centers,
+                        short num_modes, short *mode) {
+   for (short i = 0; i < num_modes; i++) {
+      if (pulse_us + RC_WINDOW_US >= centers[i] &&
+          pulse_us <= centers[i] + RC_WINDOW_US) {
+         *mode = i;
+         return;
+      }
+   }
+   //mode remains unchanged if high time does not fall in region
+}
+
 short SW1_mode = 0;
 /**
- * @brief This is the primary function reading Switch 1 on the receiver. It reads a
- * PWM signal that the RC receiver receives from the RC controller. Based on the
- * specific timing of the PWM, a deadman mode (either deadman switch pressed or
- * not pressed) is selected to send to the rest of the platform.
+ * @brief This is the primary function reading Switch 1 on the receiver.
+ * Based on the width of the PWM pulse that the RC receiver receives from the
+ * RC controller, a deadman mode (either deadman switch pressed or not
+ * pressed) is selected to send to the rest of the platform.
  *
+ * @param pulse_us the decoded pulse width of switch 1 in microseconds
  * @return the deadman mode of the semi-truck based on RC receiver signal
  */
-int16_t RC_receiver_SW1_fn(short PWM_PIN) {
-
-    short val = digitalRead(PWM_PIN);
-
-    if(val==HIGH){
-        SW1_time = micros();
-    } else if(val==LOW){
-        volatile unsigned long f_time = micros();
-        SW1_high_time = (float)(f_time - SW1_time)/1000;
-    }
-    if (SW1_high_time >= 1.35 && SW1_high_time <= 1.45){
-        SW1_mode = 0;
-    }
-    else if(SW1_high_time >= 1.05 && SW1_high_time <= 1.15){
-        SW1_mode = 1;
-    }
-    else{
-        //mode remains unchanged if high time does not fall in region
-    }
+int16_t RC_receiver_SW1_fn(uint16_t pulse_us) {
+   static const uint16_t centers[] = {1400, 1100};
+
+   select_mode(pulse_us, centers, 2, &SW1_mode);
 #ifdef DEBUG
-    Serial.print("SW1 mode = ");
-    Serial.println(SW1_mode);
+   Serial.print("SW1 mode = ");
+   Serial.println(SW1_mode);
 #endif
-    return SW1_mode;
+   return SW1_mode;
 }
 
-float SW3_high_time = 0;
-volatile unsigned long SW3_time = 0;
 short SW3_mode = 0;
-
 /**
- * @brief This is the primary function controlling the RC receiver. It reads a
- * PWM signal that the RC receiver receives from the RC controller. Based on
- * the specific timing of the PWM, a drive mode (either manual or one of the
- * autonomous algorithms on the Pi) is selected to control the vehicle.
+ * @brief This is the primary function reading Switch 3 on the receiver.
+ * Based on the width of the PWM pulse, a drive mode (either manual or one of
+ * the autonomous algorithms on the Pi) is selected to control the vehicle.
  *
+ * @param pulse_us the decoded pulse width of switch 3 in microseconds
  * @return the driving mode of the semi-truck based on RC receiver signal
  */
-int16_t RC_receiver_SW3_fn(short PWM_PIN) {
-    short val = digitalRead(PWM_PIN);
-
-    if(val==HIGH){
-        SW3_time = micros();
-    } else{
-        unsigned long f_time = micros();
-        SW3_high_time = (float)(f_time - SW3_time)/1000;
-    }
-
-    if (SW3_high_time >= 1.45 && SW3_high_time <= 1.55){
-        SW3_mode = 0;
-    }
-    else if(SW3_high_time >= 1.85 && SW3_high_time <= 1.95){
-        SW3_mode = 1;
-    }
-    else if(SW3_high_time >= 1.05 && SW3_high_time <= 1.15){
-        SW3_mode = 2;
-    }
-    else{
-        //mode remains unchanged if high time does not fall in region
-    }
+int16_t RC_receiver_SW3_fn(uint16_t pulse_us) {
+   static const uint16_t centers[] = {1500, 1900, 1100};
+
+   select_mode(pulse_us, centers, 3, &SW3_mode);
 #ifdef DEBUG
-    Serial.print("SW3 mode = ");
-    Serial.println(SW3_mode);
+   Serial.print("SW3 mode = ");
+   Serial.println(SW3_mode);
 #endif
-    return SW3_mode;
+   return SW3_mode;
 }
 
-void RC_receiver_setup() {
+/**
+ * @brief Copies the decoded pulse widths of every channel into the system
+ * snapshot. A channel that has not produced a valid pulse within
+ * RC_SIGNAL_TIMEOUT_MS has its bit cleared in rc_data->valid.
+ *
+ * @param rc_data the RC portion of the system data to fill in
+ */
+void RC_receiver_read(rc_data_t *rc_data) {
+   rc_pulse_t pulses[RC_NUM_CHANNELS];
+   uint32_t now_ms;
+
+   __disable_irq();
+   for (uint8_t i = 0; i < RC_NUM_CHANNELS; i++) {
+      pulses[i] = *(rc_pulse_t*)&rc_pulses[i];
+   }
+   now_ms = millis();
+   __enable_irq();
 
+   rc_data->valid = 0;
+   rc_data->glitches = 0;
+   for (uint8_t i = 0; i < RC_NUM_CHANNELS; i++) {
+      rc_data->pulse_us[i] = pulses[i].width_us;
+      rc_data->glitches += pulses[i].glitches;
+      if (!rc_pulse_lost(&pulses[i], now_ms)) {
+         rc_data->valid |= 1 << i;
+      }
+   }
 }
 
+/**
+ * @brief Sets up FTM3 as a free-running 16 bit timer and puts one channel
+ * per RC receiver output into input capture mode on the rising edge.
+ */
+void RC_receiver_setup() {
+   for (uint8_t i = 0; i < RC_NUM_CHANNELS; i++) {
+      rc_pulse_init((rc_pulse_t*)&rc_pulses[i], RC_FTM_TICK_HZ);
+   }
+
+   FTM3_SC = 0;
+   FTM3_MODE = FTM_MODE_WPDIS | FTM_MODE_FTMEN;
+   FTM3_CNTIN = 0;
+   FTM3_MOD = 0xFFFF;
+   FTM3_CNT = 0;
+
+   for (uint8_t i = 0; i < RC_NUM_CHANNELS; i++) {
+      *ftm3_csc(RC_FTM_FIRST_CHANNEL + i) = FTM_CSC_CHIE | FTM_CSC_ELSA;
+      *portConfigRegister(rc_pins[i]) = PORT_PCR_MUX(RC_FTM_MUX) |
+                                        PORT_PCR_PFE;
+   }
+
+   FTM3_SC = FTM_SC_CLKS(1) | FTM_SC_PS(RC_FTM_PRESCALE);
+   NVIC_ENABLE_IRQ(IRQ_FTM3);
+}
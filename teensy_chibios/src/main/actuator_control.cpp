@@ -0,0 +1,167 @@
+#include <Arduino.h>
+#include "include/actuator_control.h"
+#include "include/motor_driver.h"
+#include "include/steer_servo.h"
+#include "include/fifth_wheel.h"
+#include "include/link_health.h"
+#include "include/black_box.h"
+
+//#define DEBUG
+
+/**
+ * @brief An output that is slew-rate limited to rate_per_s per second. The
+ * rate need not be a whole number of units per tick: the part of a unit
+ * that a tick was allowed but could not move is carried, in units of
+ * 1/CONTROL_RATE_HZ, to the next tick.
+ */
+typedef struct slew_t {
+   int16_t output;
+   int16_t rate_per_s;
+   int32_t carry;
+} slew_t;
+
+/**
+ * @brief The number of control ticks that the stop or speed controller has
+ * been running for, used to run it at MOTOR_PERIOD_MS instead of every
+ * tick. A raw throttle is applied on every tick.
+ */
+static uint32_t controller_ticks = 0;
+
+/**
+ * @brief The output that the motor controllers asked for the last time they
+ * ran. The motor is slewed towards this value every tick.
+ */
+static int16_t motor_target = 0;
+
+/**
+ * @brief The outputs that were written to the motor and steering servo on
+ * the last tick.
+ */
+static slew_t motor = {0, MOTOR_SLEW_PER_S, 0};
+static slew_t steer = {STEER_FAILSAFE, STEER_SLEW_PER_S, 0};
+
+/**
+ * @brief The receive time of the last command that was applied, so the
+ * latency of each command is only measured once.
+ */
+static uint32_t applied_cmd_time_us = 0;
+
+/**
+ * @brief Moves an output one tick towards target, by at most rate_per_s /
+ * CONTROL_RATE_HZ on average.
+ *
+ * @return the new output
+ */
+static int16_t slew_limit(slew_t *slew, int16_t target) {
+   int32_t budget = slew->carry + slew->rate_per_s;
+   int16_t max_step = budget / CONTROL_RATE_HZ;
+
+   if (target > slew->output + max_step) {
+      slew->output += max_step;
+   }
+   else if (target < slew->output - max_step) {
+      slew->output -= max_step;
+   }
+   else {
+      slew->output = target;
+      slew->carry = 0;
+      return slew->output;
+   }
+   slew->carry = budget - (int32_t)max_step * CONTROL_RATE_HZ;
+   return slew->output;
+}
+
+/**
+ * @brief The primary function of the actuator output stage. It is called at
+ * CONTROL_RATE_HZ with one consistent snapshot of the actuator commands and
+ * updates the motor, steering servo and fifth wheel in the same tick.
+ *
+ * The motor and steering outputs are slew-rate limited. A raw throttle is
+ * applied on every tick; the stop and speed controllers run only every
+ * MOTOR_PERIOD_MS, the period their gains are tuned for, and the motor
+ * slews towards their last output in between. How the commands are applied
+ * depends on the health of the link to the Pi:
+ * - LINK_OK and LINK_HOLD apply the last command as is.
+ * - LINK_COAST applies no torque and holds the current steering angle.
+ * - LINK_BRAKE brakes with the stop controller and steers straight.
+ * A lost link always passes through LINK_COAST, whose raw throttle of 0 lets
+ * the stop controller run on the first LINK_BRAKE tick. By then the coasting
+ * motor output has slewed towards 0 for LINK_BRAKE_MS - LINK_COAST_MS, and
+ * it takes at most the stop controller's limit / MOTOR_SLEW_PER_S more to
+ * reach the braking output. The steering reaches STEER_FAILSAFE within 90 /
+ * STEER_SLEW_PER_S.
+ * The fifth wheel holds its last state unless the link is LINK_OK, so a lost
+ * link never drops the trailer.
+ *
+ * @param actuators the latest actuator commands from the Pi
+ * @param cmd_time_us the micros() time that the commands were received at
+ * @param link_state the state returned by link_health_update()
+ * @param deadman true if the dead man's switch is pressed
+ * @param wheel_speed speed of the truck read by the wheel speed sensor
+ * @return the time in microseconds from receiving the command to updating
+ * both the motor and the steering for it, or -1 if the command was already
+ * applied on an earlier tick or the speed controller has not run for it yet
+ */
+int32_t actuator_control_loop_fn(const actuator_data_t *actuators,
+                                 uint32_t cmd_time_us, int16_t link_state,
+                                 bool deadman, int16_t wheel_speed) {
+   bool linked = link_state == LINK_OK || link_state == LINK_HOLD;
+   bool motor_deadman = deadman && linked;
+   int16_t motor_mode = actuators->motor_mode;
+   int16_t motor_command = actuators->motor_output;
+   bool motor_applied = true;
+   int16_t steer_target;
+   int32_t latency_us = -1;
+
+   if (link_state == LINK_COAST) {
+      motor_deadman = deadman;
+      motor_mode = MOTOR_MODE_THROTTLE;
+      motor_command = 0;
+   }
+
+   if (motor_deadman && motor_mode != MOTOR_MODE_SPEED) {
+      motor_target = motor_control_fn(motor_deadman, motor_mode,
+                                      motor_command, wheel_speed);
+      controller_ticks = 0;
+   }
+   else if (controller_ticks++ % MOTOR_DECIMATION == 0) {
+      motor_target = motor_control_fn(motor_deadman, motor_mode,
+                                      motor_command, wheel_speed);
+   }
+   else {
+      motor_applied = false;
+   }
+
+   if (link_state == LINK_COAST) {
+      steer_target = steer.output;
+   }
+   else if (!linked || actuators->steer_output > 180 ||
+            actuators->steer_output < 0) {
+      steer_target = STEER_FAILSAFE;
+   }
+   else {
+      steer_target = actuators->steer_output;
+   }
+
+   slew_limit(&motor, motor_target);
+   slew_limit(&steer, steer_target);
+
+   motor_driver_loop_fn(motor.output);
+   steer_servo_loop_fn(steer.output);
+   black_box_log(BBOX_MOTOR, 0, motor.output);
+   black_box_log(BBOX_STEER, 0, steer.output);
+   if (link_state == LINK_OK) {
+      fifth_wheel_loop_fn(actuators->fifth_output);
+   }
+
+   if (link_state == LINK_OK && cmd_time_us != applied_cmd_time_us &&
+       motor_applied) {
+      applied_cmd_time_us = cmd_time_us;
+      latency_us = micros() - cmd_time_us;
+#ifdef DEBUG
+      Serial.printf("command latency: %li us\n", latency_us);
+#endif
+   }
+
+   return latency_us;
+}
@@ -0,0 +1,305 @@
+#include <Arduino.h>
+#include "include/black_box.h"
+
+#ifdef BLACK_BOX_SD
+#include <SD.h>
+#endif
+
+/**
+ * @brief The ring of records, the number of records written to it since the
+ * last rearm, and the state of the trigger. The ring is written from
+ * interrupts as well as threads, so all of this is only touched with
+ * interrupts disabled.
+ */
+static bbox_record_t ring[BBOX_DEPTH];
+static uint32_t head = 0;
+static uint8_t trigger = BBOX_TRIG_NONE;
+static uint32_t trigger_us = 0;
+static uint16_t post_left = 0; // records still to log after the trigger
+static bool frozen = false;
+static uint8_t readers = 0;    // dumps in progress, which pause logging
+static uint32_t lost = 0;
+
+/**
+ * @brief Only one in every decimation[kind] records of a kind is logged, so
+ * the fast samples do not push the slow ones out of the ring.
+ */
+static uint8_t decimation[BBOX_NUM_KINDS] = {
+   1, // BBOX_HALL
+   1, // BBOX_RC
+   1, // BBOX_IMU
+   1, // BBOX_TOF
+   1, // BBOX_WHEEL_SPEED
+   4, // BBOX_MOTOR, every 4th control tick
+   4, // BBOX_STEER
+   1, // BBOX_COMMAND
+   1, // BBOX_LINK
+   1, // BBOX_DEADMAN
+   1  // BBOX_TRIGGER
+};
+static uint8_t skipped[BBOX_NUM_KINDS] = {0};
+
+
+/**
+ * @brief Writes a record into the ring and freezes the ring once enough
+ * records have followed a trigger. Called with interrupts disabled.
+ */
+static void append(uint8_t kind, uint8_t channel, int16_t value,
+                   uint32_t time_us) {
+   bbox_record_t *record = &ring[head % BBOX_DEPTH];
+
+   record->time_us = time_us;
+   record->value = value;
+   record->kind = kind;
+   record->channel = channel;
+   head++;
+
+   if (trigger != BBOX_TRIG_NONE && --post_left == 0) {
+      frozen = true;
+   }
+}
+
+
+/**
+ * @brief Logs a sample that was taken now. Safe to call from threads and
+ * from interrupt handlers, but not with interrupts already disabled.
+ *
+ * @param kind one of the BBOX_* kinds
+ * @param channel which of several sensors of the kind took the sample
+ * @param value the sample
+ */
+void black_box_log(uint8_t kind, uint8_t channel, int16_t value) {
+   black_box_log_at(kind, channel, value, micros());
+}
+
+
+/**
+ * @brief Logs a sample that was taken earlier, e.g. at an edge that was
+ * timestamped in an interrupt and handled by a thread.
+ *
+ * @param time_us micros() when the sample was taken
+ */
+void black_box_log_at(uint8_t kind, uint8_t channel, int16_t value,
+                      uint32_t time_us) {
+   if (kind >= BBOX_NUM_KINDS) {
+      return;
+   }
+
+   __disable_irq();
+   if (frozen || readers > 0) {
+      lost++;
+   }
+   else if (++skipped[kind] >= decimation[kind]) {
+      skipped[kind] = 0;
+      append(kind, channel, value, time_us);
+   }
+   __enable_irq();
+}
+
+
+/**
+ * @brief Marks an event worth keeping. The ring goes on logging for
+ * BBOX_POST_TRIGGER more records and then freezes, so it holds what led up
+ * to the event and what followed it until it is dumped and rearmed. Only
+ * the first trigger after a rearm counts, and none while a dump is reading
+ * the ring.
+ *
+ * @param reason one of the BBOX_TRIG_* reasons
+ */
+void black_box_trigger(uint8_t reason) {
+   uint32_t now_us = micros();
+
+   __disable_irq();
+   if (trigger == BBOX_TRIG_NONE && !frozen && readers == 0) {
+      trigger = reason;
+      trigger_us = now_us;
+      post_left = BBOX_POST_TRIGGER;
+      append(BBOX_TRIGGER, reason, 0, now_us);
+   }
+   __enable_irq();
+}
+
+
+/**
+ * @brief Empties the ring and waits for the next trigger.
+ */
+void black_box_rearm() {
+   __disable_irq();
+   head = 0;
+   trigger = BBOX_TRIG_NONE;
+   trigger_us = 0;
+   post_left = 0;
+   frozen = false;
+   lost = 0;
+   for (uint8_t i = 0; i < BBOX_NUM_KINDS; i++) {
+      skipped[i] = 0;
+   }
+   __enable_irq();
+}
+
+
+bool black_box_frozen() {
+   bool is_frozen;
+
+   __disable_irq();
+   is_frozen = frozen;
+   __enable_irq();
+   return is_frozen;
+}
+
+
+/**
+ * @brief Sets how many records of a kind there are for every one that is
+ * logged.
+ */
+void black_box_decimate(uint8_t kind, uint8_t keep_one_in) {
+   if (kind >= BBOX_NUM_KINDS || keep_one_in == 0) {
+      return;
+   }
+
+   __disable_irq();
+   decimation[kind] = keep_one_in;
+   skipped[kind] = 0;
+   __enable_irq();
+}
+
+
+/**
+ * @brief Starts reading the ring out in dump frames. Logging is paused until
+ * black_box_dump_end, so the records cannot change while they are read.
+ *
+ * @param dump the reader to start
+ * @param max_records the newest records to dump, 0 to dump all of them
+ */
+void black_box_dump_begin(bbox_dump_t *dump, uint16_t max_records) {
+   uint32_t count;
+
+   memset(dump, 0, sizeof(*dump));
+
+   __disable_irq();
+   readers++;
+   count = head < BBOX_DEPTH ? head : BBOX_DEPTH;
+   if (max_records > 0 && max_records < count) {
+      count = max_records;
+   }
+   dump->first = head - count;
+   dump->header.trigger_us = trigger_us;
+   dump->header.lost = lost;
+   dump->header.trigger = trigger;
+   dump->header.frozen = frozen;
+   for (uint8_t i = 0; i < BBOX_NUM_KINDS; i++) {
+      dump->header.decimation[i] = decimation[i];
+   }
+   __enable_irq();
+
+   dump->header.now_us = micros();
+   dump->header.version = BBOX_DUMP_VERSION;
+   dump->header.records = count;
+}
+
+
+/**
+ * @brief Writes the next frame of a dump: the header first, then the
+ * records oldest first.
+ *
+ * @param dump the reader from black_box_dump_begin
+ * @param frame where to write the frame, BBOX_FRAME_MAX bytes
+ * @return the size of the frame, or 0 if the dump is done
+ */
+uint16_t black_box_dump_frame(bbox_dump_t *dump, uint8_t *frame) {
+   int16_t sync = BBOX_DUMP_SYNC;
+   uint8_t count = 0;
+   uint8_t size;
+   uint16_t checksum;
+
+   if (dump->next_frame == 0) {
+      size = sizeof(bbox_dump_header_t);
+      memcpy(frame + 6, &dump->header, size);
+   }
+   else if (dump->done < dump->header.records) {
+      // clamped before it is narrowed to the byte in the frame
+      uint16_t left = dump->header.records - dump->done;
+
+      count = left < BBOX_DUMP_RECORDS ? left : BBOX_DUMP_RECORDS;
+      size = count * sizeof(bbox_record_t);
+      for (uint8_t i = 0; i < count; i++) {
+         memcpy(frame + 6 + i * sizeof(bbox_record_t),
+                &ring[(dump->first + dump->done + i) % BBOX_DEPTH],
+                sizeof(bbox_record_t));
+      }
+      dump->done += count;
+   }
+   else {
+      return 0;
+   }
+
+   memcpy(frame, &sync, sizeof(sync));
+   memcpy(frame + 2, &dump->next_frame, sizeof(dump->next_frame));
+   frame[4] = count;
+   frame[5] = size;
+   checksum = bbox_fletcher16(frame + 2, 4 + size);
+   memcpy(frame + 6 + size, &checksum, sizeof(checksum));
+
+   dump->next_frame++;
+   return 8 + size;
+}
+
+
+/**
+ * @brief Finishes a dump and lets logging go on, unless the ring is frozen.
+ */
+void black_box_dump_end(bbox_dump_t *dump) {
+   (void)dump;
+
+   __disable_irq();
+   readers--;
+   __enable_irq();
+}
+
+
+#ifdef BLACK_BOX_SD
+/**
+ * @brief Writes the whole ring to a new file on the SD card, BBOX000.BIN,
+ * BBOX001.BIN and so on, in the same frames as a dump over Serial1, so the
+ * same decoder reads both. This takes far longer than a control period, so
+ * it must run on a low priority thread.
+ *
+ * @return false if there is no card or the file could not be written
+ */
+bool black_box_spill() {
+   static bool card = false;
+   static uint16_t file_num = 0;
+   uint8_t frame[BBOX_FRAME_MAX];
+   uint16_t size;
+   bbox_dump_t dump;
+   char name[16];
+   File file;
+
+   if (!card && !(card = SD.begin(BUILTIN_SDCARD))) {
+      return false;
+   }
+
+   do {
+      snprintf(name, sizeof(name), "BBOX%03u.BIN", file_num++);
+   } while (SD.exists(name) && file_num < 1000);
+
+   file = SD.open(name, FILE_WRITE);
+   if (!file) {
+      return false;
+   }
+
+   black_box_dump_begin(&dump, 0);
+   while ((size = black_box_dump_frame(&dump, frame)) > 0) {
+      file.write(frame, size);
+   }
+   black_box_dump_end(&dump);
+
+   file.close();
+   Serial.printf("black box written to %s\n", name);
+   return true;
+}
+#else
+bool black_box_spill() {
+   return false;
+}
+#endif
@@ -0,0 +1,107 @@
+#include "include/cmd_frame.h"
+
+#define SYNC_LOW ((uint8_t)((uint16_t)CMD_FRAME_SYNC & 0xFF))
+#define SYNC_HIGH ((uint8_t)((uint16_t)CMD_FRAME_SYNC >> 8))
+#define REQUEST_SYNC_LOW ((uint8_t)((uint16_t)CMD_FRAME_REQUEST_SYNC & 0xFF))
+#define REQUEST_SYNC_HIGH ((uint8_t)((uint16_t)CMD_FRAME_REQUEST_SYNC >> 8))
+
+
+/**
+ * @brief Reads a little endian 16 bit word out of the payload.
+ */
+static uint16_t payload_word(const cmd_frame_t *frame, uint8_t index) {
+   return frame->payload[2 * index] | (frame->payload[2 * index + 1] << 8);
+}
+
+
+void cmd_frame_init(cmd_frame_t *frame) {
+   frame->count = 0;
+   frame->synced = false;
+   frame->request = false;
+   frame->have_request = false;
+   frame->have_last = false;
+   frame->last_byte = 0;
+   frame->frames = 0;
+   frame->skipped = 0;
+}
+
+
+/**
+ * @brief Feeds one byte from the UART into the parser. Until the sync word
+ * has been seen, bytes are dropped one at a time, so the parser finds the
+ * start of the next frame even when the stream starts in the middle of one.
+ * A request frame completes without a command; the request is kept for
+ * cmd_frame_take_request instead.
+ *
+ * @param frame the parser state
+ * @param byte the next byte received from the Pi
+ * @param actuators where to write the command when the byte completes a
+ * frame; left unchanged otherwise
+ * @return true if the byte completed a frame
+ */
+bool cmd_frame_feed(cmd_frame_t *frame, uint8_t byte,
+                    actuator_data_t *actuators) {
+   if (!frame->synced) {
+      bool command = frame->have_last && frame->last_byte == SYNC_LOW &&
+                     byte == SYNC_HIGH;
+      bool request = frame->have_last && frame->last_byte == REQUEST_SYNC_LOW &&
+                     byte == REQUEST_SYNC_HIGH;
+
+      if (command || request) {
+         frame->synced = true;
+         frame->request = request;
+         frame->have_last = false;
+         frame->count = 0;
+         return false;
+      }
+      if (frame->have_last) {
+         frame->skipped++;
+      }
+      frame->last_byte = byte;
+      frame->have_last = true;
+      return false;
+   }
+
+   frame->payload[frame->count++] = byte;
+   if (frame->count < CMD_FRAME_SIZE) {
+      return false;
+   }
+
+   frame->synced = false;
+   frame->frames++;
+
+   if (frame->request) {
+      frame->request_data.code = payload_word(frame, 0);
+      frame->request_data.arg[0] = payload_word(frame, 1);
+      frame->request_data.arg[1] = payload_word(frame, 2);
+      frame->have_request = true;
+      return false;
+   }
+
+   // same order as the Teensy_Actuators message on the Pi
+   actuators->motor_output = (int16_t)payload_word(frame, 0);
+   actuators->steer_output = (int16_t)payload_word(frame, 1);
+   actuators->fifth_output = (int16_t)payload_word(frame, 2);
+   actuators->motor_mode = (int16_t)payload_word(frame, 3);
+   actuators->seq = payload_word(frame, 4);
+   return true;
+}
+
+
+/**
+ * @brief Takes the last request frame that the parser completed, if it has
+ * not been taken yet. A request that is not taken before the next one
+ * completes is replaced by it.
+ *
+ * @param frame the parser state
+ * @param request where to write the request
+ * @return true if there was a request
+ */
+bool cmd_frame_take_request(cmd_frame_t *frame, cmd_request_t *request) {
+   if (!frame->have_request) {
+      return false;
+   }
+   *request = frame->request_data;
+   frame->have_request = false;
+   return true;
+}
@@ -1,10 +1,55 @@
 #include "include/imu.h"
+#include "include/black_box.h"
+
+// change of the heading change from one sample to the next, in degrees,
+// that counts as a jerk and triggers the black box
+#define IMU_JERK_DEG 30
 
 /**
  * @brief A global variable, for the only Adafruit_BNO055 object in the system.
  */
 Adafruit_BNO055 bno = Adafruit_BNO055(55);
 
+/**
+ * @brief The last two headings in 1/16 degree, for finding jerks.
+ */
+static int16_t last_heading_16 = 0;
+static int16_t last_turn_16 = 0;
+static uint8_t num_headings = 0;
+
+
+/**
+ * @brief Logs the heading in the black box at the BNO055's own resolution
+ * of 1/16 degree, and triggers the black box if the heading changed by
+ * IMU_JERK_DEG more or less than it did between the last two samples.
+ */
+static void imu_black_box(float heading_deg) {
+   int16_t heading_16 = (int16_t)(heading_deg * 16 + 0.5f);
+   int16_t turn_16 = heading_16 - last_heading_16;
+   int16_t jerk_16;
+
+   // the heading wraps from 360 to 0 degrees
+   if (turn_16 > 180 * 16) {
+      turn_16 -= 360 * 16;
+   }
+   else if (turn_16 < -180 * 16) {
+      turn_16 += 360 * 16;
+   }
+   jerk_16 = turn_16 - last_turn_16;
+
+   black_box_log(BBOX_IMU, 0, heading_16);
+   if (num_headings >= 2 &&
+       (jerk_16 > IMU_JERK_DEG * 16 || jerk_16 < -IMU_JERK_DEG * 16)) {
+      black_box_trigger(BBOX_TRIG_IMU);
+   }
+
+   if (num_headings < 2) {
+      num_headings++;
+   }
+   last_turn_16 = turn_16;
+   last_heading_16 = heading_16;
+}
+
 /**
  * @brief The primary function for the IMU that reads and returns heading
  * data of the BNO055.The Adafruit_BNO055 library does most of the work here.
@@ -17,6 +62,7 @@ int16_t imu_loop_fn() {
    /* Get a new sensor event */
    sensors_event_t event;
    bno.getEvent(&event);
+   imu_black_box(event.orientation.x);
 
    /* Display the floating point data */
    //print_imu_data(&event);
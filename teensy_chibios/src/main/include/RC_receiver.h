@@ -2,12 +2,14 @@
 #define RC_RECEIVER_H
 
 #include <stdint.h>
-int16_t RC_receiver_SW1_fn(short PWM_PIN);
+#include "system_data.h"
 
-int16_t RC_receiver_SW2_fn(short PWM_PIN);
+int16_t RC_receiver_SW1_fn(uint16_t pulse_us);
 
-int16_t RC_receiver_SW3_fn(short PWM_PIN);
+int16_t RC_receiver_SW3_fn(uint16_t pulse_us);
+
+void RC_receiver_read(rc_data_t *rc_data);
 
 void RC_receiver_setup();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,12 @@
+#ifndef ACTUATOR_CONTROL_H
+#define ACTUATOR_CONTROL_H
+
+#include <stdint.h>
+#include "system_data.h"
+#include "teensy_protocol.h" // CONTROL_RATE_HZ and the slew rates
+
+int32_t actuator_control_loop_fn(const actuator_data_t *actuators,
+                                 uint32_t cmd_time_us, int16_t link_state,
+                                 bool deadman, int16_t wheel_speed);
+
+#endif //ACTUATOR_CONTROL_H
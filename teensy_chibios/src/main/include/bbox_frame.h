@@ -0,0 +1,90 @@
+#ifndef BBOX_FRAME_H
+#define BBOX_FRAME_H
+
+/**
+ * @file The checksum and the reading of black box dump frames, see
+ * bbox_dump_header_t in teensy_protocol.h for their layout. black_box.cpp
+ * writes the frames with bbox_fletcher16(), and teensy_black_box on the Pi
+ * and the host tests read them with bbox_next_frame(), so both ends check the
+ * same sum. Like teensy_protocol.h this needs nothing but the C library.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "teensy_protocol.h"
+
+#define BBOX_FRAME_HEADER_SIZE 6 // sync, index, records, size
+#define BBOX_FRAME_MAX (BBOX_FRAME_HEADER_SIZE + BBOX_DUMP_RECORDS * \
+                        sizeof(bbox_record_t) + 2)
+
+/**
+ * @brief A dump frame that passed its checksum. Frame 0 holds the header,
+ * the others hold records.
+ */
+typedef struct bbox_frame_t {
+   uint16_t index;
+   uint8_t records;
+   uint8_t size;           // bytes of payload
+   const uint8_t *payload; // points into the buffer that was searched
+} bbox_frame_t;
+
+/**
+ * @brief The Fletcher-16 sum that ends every dump frame, over the frame from
+ * its index to the end of its payload.
+ */
+static inline uint16_t bbox_fletcher16(const uint8_t *bytes, size_t size) {
+   uint16_t sum1 = 0;
+   uint16_t sum2 = 0;
+
+   for (size_t i = 0; i < size; i++) {
+      sum1 = (sum1 + bytes[i]) % 255;
+      sum2 = (sum2 + sum1) % 255;
+   }
+   return (sum2 << 8) | sum1;
+}
+
+/**
+ * @brief Finds the next dump frame in a buffer, skipping anything that is
+ * not one, e.g. the sensor frames the Teensy sends in between.
+ *
+ * @param data the bytes received or read from a file
+ * @param size the number of bytes in data
+ * @param frame set to the frame that was found
+ * @param used set to the number of bytes up to the end of the frame, or the
+ * number of bytes that can be thrown away if no frame was found
+ * @return true if a frame was found
+ */
+static inline bool bbox_next_frame(const uint8_t *data, size_t size,
+                                   bbox_frame_t *frame, size_t *used) {
+   size_t i = 0;
+
+   for (; i + BBOX_FRAME_HEADER_SIZE <= size; i++) {
+      const uint8_t *start = data + i;
+      size_t payload_size = start[5];
+      size_t sum_at = BBOX_FRAME_HEADER_SIZE + payload_size;
+
+      if ((int16_t)(start[0] | start[1] << 8) != BBOX_DUMP_SYNC ||
+          sum_at + 2 > BBOX_FRAME_MAX) {
+         continue;
+      }
+      if (i + sum_at + 2 > size) {
+         break; // wait for the rest of it
+      }
+      if ((uint16_t)(start[sum_at] | start[sum_at + 1] << 8) !=
+          bbox_fletcher16(start + 2, sum_at - 2)) {
+         continue;
+      }
+
+      frame->index = (uint16_t)(start[2] | start[3] << 8);
+      frame->records = start[4];
+      frame->size = payload_size;
+      frame->payload = start + BBOX_FRAME_HEADER_SIZE;
+      *used = i + sum_at + 2;
+      return true;
+   }
+
+   *used = i;
+   return false;
+}
+
+#endif //BBOX_FRAME_H
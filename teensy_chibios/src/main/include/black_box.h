@@ -0,0 +1,48 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+#include <stdint.h>
+#include "bbox_frame.h" // BBOX_FRAME_MAX
+#include "teensy_protocol.h"
+
+#define BBOX_DEPTH 8192 // records in the ring, 8 bytes each
+#define BBOX_POST_TRIGGER (BBOX_DEPTH / 4) // records kept after a trigger
+
+// build with -DBLACK_BOX_SD to also write every frozen ring to the SD card
+
+// the kinds of record, triggers, requests, dump frames and records are in
+// teensy_protocol.h, and the frame checksum in bbox_frame.h, which the Pi
+// side shares
+
+/**
+ * @brief The position of a reader in the ring.
+ */
+typedef struct bbox_dump_t {
+   bbox_dump_header_t header;
+   uint32_t first;      // index of the oldest record to dump
+   uint16_t next_frame; // 0 for the header
+   uint16_t done;       // records dumped so far
+} bbox_dump_t;
+
+void black_box_log(uint8_t kind, uint8_t channel, int16_t value);
+
+void black_box_log_at(uint8_t kind, uint8_t channel, int16_t value,
+                      uint32_t time_us);
+
+void black_box_trigger(uint8_t reason);
+
+void black_box_rearm();
+
+bool black_box_frozen();
+
+void black_box_decimate(uint8_t kind, uint8_t keep_one_in);
+
+void black_box_dump_begin(bbox_dump_t *dump, uint16_t max_records);
+
+uint16_t black_box_dump_frame(bbox_dump_t *dump, uint8_t *frame);
+
+void black_box_dump_end(bbox_dump_t *dump);
+
+bool black_box_spill();
+
+#endif //BLACK_BOX_H
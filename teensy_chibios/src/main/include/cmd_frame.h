@@ -0,0 +1,44 @@
+#ifndef CMD_FRAME_H
+#define CMD_FRAME_H
+
+#include <stdint.h>
+#include "system_data.h"
+#include "teensy_protocol.h" // CMD_FRAME_* sync words and size
+
+/**
+ * @brief A request from the Pi that is not an actuator command, e.g. to dump
+ * the black box. It is sent in a frame of the same size as a command, but
+ * starting with CMD_FRAME_REQUEST_SYNC.
+ */
+typedef struct cmd_request_t {
+   uint16_t code; // what is requested, e.g. BBOX_REQ_DUMP
+   uint16_t arg[2];
+} cmd_request_t;
+
+/**
+ * @brief The state of the incremental parser for the actuator command frames
+ * that the Pi sends. Bytes are fed in one at a time as they come off the
+ * UART, so the parser never waits for the rest of a frame, and it has no
+ * dependency on the Teensy hardware.
+ */
+typedef struct cmd_frame_t {
+   uint8_t payload[CMD_FRAME_SIZE];
+   uint8_t count;     // payload bytes received so far
+   bool synced;       // the sync word has been seen, payload bytes follow
+   bool request;      // the sync word was CMD_FRAME_REQUEST_SYNC
+   bool have_request; // request holds a request that was not taken yet
+   cmd_request_t request_data;
+   bool have_last;    // last_byte holds a byte that may start a sync word
+   uint8_t last_byte;
+   uint32_t frames;   // number of complete frames
+   uint32_t skipped;  // bytes dropped while looking for the sync word
+} cmd_frame_t;
+
+void cmd_frame_init(cmd_frame_t *frame);
+
+bool cmd_frame_feed(cmd_frame_t *frame, uint8_t byte,
+                    actuator_data_t *actuators);
+
+bool cmd_frame_take_request(cmd_frame_t *frame, cmd_request_t *request);
+
+#endif //CMD_FRAME_H
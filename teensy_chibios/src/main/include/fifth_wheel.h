@@ -2,8 +2,9 @@
 #define FIFTH_WHEEL_H
 
 #include <stdint.h>
+#include "teensy_protocol.h"
 
-#define LOCKED 1
+#define LOCKED FIFTH_LOCKED
 #define UNLOCKED 0
 
 void fifth_wheel_loop_fn(int16_t fifth_output);
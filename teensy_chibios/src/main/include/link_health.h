@@ -0,0 +1,14 @@
+#ifndef LINK_HEALTH_H
+#define LINK_HEALTH_H
+
+#include <stdint.h>
+#include "system_data.h"
+#include "teensy_protocol.h" // LINK_* states and their command ages
+
+void link_health_rx(link_data_t *link, uint16_t seq);
+
+int16_t link_health_update(uint32_t cmd_time_us, uint32_t now_us);
+
+uint16_t link_health_reaction_ms();
+
+#endif //LINK_HEALTH_H
@@ -2,11 +2,18 @@
 #define MOTOR_DRIVER_H
 
 #include <stdint.h>
+#include "teensy_protocol.h" // MOTOR_MODE_* and MOTOR_PERIOD_MS
+
 void motor_driver_loop_fn(int16_t motor_output);
 
 int16_t scale_output(int16_t motor_output);
 
 void motor_driver_setup(short motor_pin);
 
-int16_t stop_motor(int16_t wheel_speed, int16_t time_step);
+int16_t stop_motor(int16_t wheel_speed);
+
+int16_t speed_control(int16_t speed_setpoint, int16_t wheel_speed);
+
+int16_t motor_control_fn(bool deadman, int16_t motor_mode,
+                         int16_t motor_output, int16_t wheel_speed);
 #endif
@@ -0,0 +1,38 @@
+#ifndef MSG_BUS_H
+#define MSG_BUS_H
+
+#include <stdint.h>
+#include <ChRt.h>
+
+// the kinds of sample that are passed over the bus
+#define SAMPLE_IMU_ANGLE 0
+#define SAMPLE_WHEEL_SPEED 1
+#define SAMPLE_RIGHT_TOF 2
+#define SAMPLE_LEFT_TOF 3
+#define SAMPLE_REAR_TOF 4
+#define SAMPLE_DRIVE_MODE 5
+
+#define MSG_BUS_DEPTH 32 // samples that can be waiting at once
+
+/**
+ * @brief One timestamped reading from a sensor thread.
+ */
+typedef struct bus_sample_t {
+   uint32_t time_us; // micros() when the sample was taken
+   int16_t value;
+   uint8_t type;     // one of the SAMPLE_* kinds
+} bus_sample_t;
+
+void msg_bus_setup();
+
+bool msg_bus_post(uint8_t type, int16_t value);
+
+bool msg_bus_post_i(uint8_t type, int16_t value, uint32_t time_us);
+
+void msg_bus_listen(event_listener_t *listener, eventmask_t events);
+
+bool msg_bus_fetch(bus_sample_t *sample, systime_t timeout);
+
+uint32_t msg_bus_dropped();
+
+#endif //MSG_BUS_H
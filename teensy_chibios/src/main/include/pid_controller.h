@@ -0,0 +1,113 @@
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+#include <stdint.h>
+
+/**
+ * @brief A fixed-point PID controller that runs at a fixed sample period.
+ *
+ * Gains are given as floats when the controller is constructed and are
+ * converted once to signed fixed point with FRAC_BITS fractional bits, so
+ * update() only does integer math. The sample period is folded into the
+ * integral and derivative gains, which means update() must be called every
+ * period_ms milliseconds.
+ *
+ * - The integrator uses clamping anti-windup: it is held whenever the output
+ *   is saturated and the error would push it further into saturation, and it
+ *   is never allowed to exceed the output limits on its own.
+ * - The derivative term acts on the measurement instead of the error, so a
+ *   step in the setpoint does not produce a derivative kick.
+ * - A feed-forward gain scales the setpoint directly into the output.
+ *
+ * Setting ki or kd to 0 gives a PI or PD controller.
+ */
+template <uint8_t FRAC_BITS = 8>
+class PidController {
+public:
+   PidController(float kp, float ki, float kd, float kff,
+                 uint16_t period_ms, int16_t out_min, int16_t out_max)
+      : kp_(to_fixed(kp)),
+        ki_(to_fixed(ki * period_ms / 1000.0f)),
+        kd_(to_fixed(kd * 1000.0f / period_ms)),
+        kff_(to_fixed(kff)),
+        period_ms_(period_ms),
+        out_min_(out_min),
+        out_max_(out_max),
+        integral_(0),
+        last_measurement_(0),
+        output_(0) {}
+
+   /**
+    * @brief Clears the integrator and primes the derivative term so the first
+    * update after a reset does not see a jump in the measurement.
+    *
+    * @param measurement the current value of the controlled variable
+    */
+   void reset(int16_t measurement) {
+      integral_ = 0;
+      last_measurement_ = measurement;
+      output_ = 0;
+   }
+
+   /**
+    * @brief Runs one sample of the controller.
+    *
+    * @param setpoint the desired value of the controlled variable
+    * @param measurement the current value of the controlled variable
+    * @return the controller output, limited to [out_min, out_max]
+    */
+   int16_t update(int16_t setpoint, int16_t measurement) {
+      int32_t error = (int32_t)setpoint - measurement;
+      int32_t delta = (int32_t)measurement - last_measurement_;
+      int64_t base = (int64_t)kp_ * error - (int64_t)kd_ * delta +
+                     (int64_t)kff_ * setpoint;
+      int64_t integral = integral_ + (int64_t)ki_ * error;
+      int64_t out_min = (int64_t)out_min_ << FRAC_BITS;
+      int64_t out_max = (int64_t)out_max_ << FRAC_BITS;
+      int64_t output;
+
+      integral = clamp(integral, out_min, out_max);
+      output = base + integral;
+
+      // only commit the new integral if it does not wind further into
+      // saturation
+      if ((output > out_max && error > 0) || (output < out_min && error < 0)) {
+         output = base + integral_;
+      }
+      else {
+         integral_ = integral;
+      }
+
+      last_measurement_ = measurement;
+      output = clamp(output, out_min, out_max);
+      output_ = (int16_t)((output + (1 << (FRAC_BITS - 1))) >> FRAC_BITS);
+      return output_;
+   }
+
+   uint16_t period_ms() const { return period_ms_; }
+
+   int16_t output() const { return output_; }
+
+private:
+   static int32_t to_fixed(float value) {
+      float scaled = value * (1L << FRAC_BITS);
+      return (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+   }
+
+   static int64_t clamp(int64_t value, int64_t low, int64_t high) {
+      return value < low ? low : (value > high ? high : value);
+   }
+
+   const int32_t kp_;
+   const int32_t ki_;
+   const int32_t kd_;
+   const int32_t kff_;
+   const uint16_t period_ms_;
+   const int16_t out_min_;
+   const int16_t out_max_;
+   int64_t integral_;
+   int16_t last_measurement_;
+   int16_t output_;
+};
+
+#endif //PID_CONTROLLER_H
@@ -0,0 +1,37 @@
+#ifndef RC_PULSE_H
+#define RC_PULSE_H
+
+#include <stdint.h>
+
+#define RC_PULSE_MIN_US 800 // shortest pulse accepted from the receiver
+#define RC_PULSE_MAX_US 2200 // longest pulse accepted from the receiver
+#define RC_SIGNAL_TIMEOUT_MS 100 // no valid pulse for this long is signal loss
+#define RC_FILTER_LEN 3 // number of pulses in the median glitch filter
+
+/**
+ * @brief The decoding state for a single RC receiver channel. The edge
+ * timestamps are raw capture values from a free-running 16 bit timer, so this
+ * structure (and the functions that operate on it) have no dependency on
+ * the Teensy hardware and can be fed synthetic pulse trains.
+ */
+typedef struct rc_pulse_t {
+   uint32_t tick_khz;       // capture timer frequency in kHz
+   uint16_t rise_ticks;     // capture value of the last rising edge
+   bool high;               // a rising edge has been seen without a falling
+   uint16_t history[RC_FILTER_LEN]; // last accepted pulse widths (us)
+   uint8_t history_len;
+   uint8_t history_idx;
+   uint16_t width_us;       // filtered pulse width in microseconds
+   uint16_t raw_us;         // width of the last pulse, before any filtering
+   uint32_t last_valid_ms;  // time of the last accepted pulse
+   uint16_t glitches;       // number of pulses rejected as out of range
+} rc_pulse_t;
+
+void rc_pulse_init(rc_pulse_t *pulse, uint32_t tick_hz);
+
+bool rc_pulse_edge(rc_pulse_t *pulse, bool rising, uint16_t ticks,
+                   uint32_t now_ms);
+
+bool rc_pulse_lost(const rc_pulse_t *pulse, uint32_t now_ms);
+
+#endif //RC_PULSE_H
@@ -9,6 +9,10 @@ typedef struct sensor_data_t {
    int16_t right_TOF;
    int16_t left_TOF;
    int16_t rear_TOF;
+   uint16_t cmd_latency_us; // time from receiving a command to applying it
+   uint16_t rx_seq;         // sequence number of the last command received
+   int16_t link_state;      // LINK_* state of the link to the Pi
+   uint16_t link_reaction_ms; // time from the last command to braking
 } sensor_data_t;
 
 
@@ -16,15 +20,39 @@ typedef struct actuator_data_t {
    int16_t motor_output;
    int16_t steer_output;
    int16_t fifth_output;
+   int16_t motor_mode;
+   uint16_t seq;
 } actuator_data_t;
 
 
+typedef struct link_data_t {
+   uint16_t rx_seq;   // sequence number of the last command received
+   uint32_t rx_count; // number of commands received
+   uint32_t dropped;  // number of commands missed, from gaps in rx_seq
+} link_data_t;
+
+
+#define RC_THROTTLE 0
+#define RC_STEER 1
+#define RC_SW1 2
+#define RC_SW3 3
+#define RC_NUM_CHANNELS 4
+
+typedef struct rc_data_t {
+   uint16_t pulse_us[RC_NUM_CHANNELS]; // filtered pulse width per channel
+   uint8_t valid;                      // bit per channel with a live signal
+   uint16_t glitches;                  // pulses rejected on all channels
+} rc_data_t;
+
+
 typedef struct system_data_t {
-   bool updated;
    int16_t deadman;
    int16_t drive_mode;
    sensor_data_t sensors;
    actuator_data_t actuators;
+   uint32_t actuator_time_us; // micros() when the actuators were received
+   link_data_t link;
+   rc_data_t rc;
 } system_data_t;
 
 #endif
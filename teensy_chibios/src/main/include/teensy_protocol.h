@@ -0,0 +1,121 @@
+#ifndef TEENSY_PROTOCOL_H
+#define TEENSY_PROTOCOL_H
+
+/**
+ * @file What the Pi side has to know about the firmware: the frames on the
+ * UART, the grading of the link to the Pi, the black box dump and the timing
+ * of the control loop. The firmware and the semi_truck package (pi_comm_node,
+ * truck_sim_node, uart_replay and teensy_black_box) both include this file,
+ * so it holds only macros and plain structs and needs nothing but stdint.h.
+ *
+ * Every frame is little endian and starts with an int16 sync word.
+ */
+
+#include <stdint.h>
+
+// frames from the Pi: the sync word and 5 int16 words, motor_output,
+// steer_output, fifth_output, motor_mode and seq
+#define CMD_FRAME_SYNC -32000 // the word that starts every frame from the Pi
+#define CMD_FRAME_REQUEST_SYNC -31000 // starts a request frame instead
+#define CMD_FRAME_SIZE 10 // bytes in a frame after the sync word
+#define CMD_FRAME_SIZE_W_SYNC (2 + CMD_FRAME_SIZE)
+
+// frames to the Pi: CMD_FRAME_SYNC, the 9 int16 words of sensor_data_t and
+// the drive mode
+#define SENSOR_FRAME_SIZE 22
+#define SENSOR_FRAME_LINK_STATE 16 // byte offset of the link state word
+// period of the frames to the Pi. A frame takes 23 ms at 9600 baud, so 25 Hz
+// uses 57% of the link and leaves the UART buffer room to catch up
+#define SERIAL_SEND_MS 40
+#define SERIAL_BAUD 9600
+
+// graded response to the age of the last command received from the Pi
+#define LINK_OK 0 // commands are fresh and are applied as they are
+#define LINK_HOLD 1 // a few commands were missed, the last one is held
+#define LINK_COAST 2 // no torque is applied and the steering is held
+#define LINK_BRAKE 3 // the stop controller brakes, steering goes straight
+
+#define LINK_HOLD_MS 100 // command age at which the last command is held
+#define LINK_COAST_MS 250 // command age at which the motor coasts
+#define LINK_BRAKE_MS 500 // command age at which the truck is braked
+
+// the control loop, see actuator_control_loop_fn()
+#define CONTROL_RATE_HZ 200 // rate of the timer that triggers the control loop
+#define CONTROL_PERIOD_US (1000000 / CONTROL_RATE_HZ)
+#define MOTOR_MODE_THROTTLE 0 // motor_output is a throttle from -100 to 100
+#define MOTOR_MODE_SPEED 1 // motor_output is a wheel speed setpoint
+#define MOTOR_MODE_STOP 2 // braking to a stop, used when the deadman is off
+#define MOTOR_PERIOD_MS 100 // rate that motor_control_fn() is called at
+#define MOTOR_DECIMATION (CONTROL_RATE_HZ * MOTOR_PERIOD_MS / 1000)
+#define MOTOR_SLEW_PER_S 400 // fastest change of the motor output per second
+#define STEER_SLEW_PER_S 360 // fastest change of the steering angle per second
+#define STEER_FAILSAFE 90 // steering angle used when the link is lost
+#define FIFTH_LOCKED 1 // fifth_output that locks the fifth wheel
+
+// requests from the Pi to the black box, in request frames of the size of
+// a command: CMD_FRAME_REQUEST_SYNC, code, arg0, arg1 and 2 unused words
+#define BBOX_REQ_DUMP 1     // arg0: newest records to dump, 0 for all
+#define BBOX_REQ_REARM 2    // unfreeze the ring and start over
+#define BBOX_REQ_TRIGGER 3  // trigger the ring now
+#define BBOX_REQ_DECIMATE 4 // arg0: kind, arg1: keep 1 of every arg1 records
+
+// the kinds of black box record; channel and value depend on the kind
+#define BBOX_HALL 0        // hall sensor edge, value: encoder ticks
+#define BBOX_RC 1          // RC pulse, channel: RC_*, value: raw width (us)
+#define BBOX_IMU 2         // value: heading in 1/16 degree
+#define BBOX_TOF 3         // channel: 0 left, 1 right, value: range (mm)
+#define BBOX_WHEEL_SPEED 4 // value: wheel speed
+#define BBOX_MOTOR 5       // value: output written to the motor driver
+#define BBOX_STEER 6       // value: output written to the steering servo
+#define BBOX_COMMAND 7     // command from the Pi received, value: its seq
+#define BBOX_LINK 8        // link state changed, value: LINK_*
+#define BBOX_DEADMAN 9     // deadman changed, value: 1 pressed, 0 released
+#define BBOX_TRIGGER 10    // the ring was triggered, channel: BBOX_TRIG_*
+#define BBOX_NUM_KINDS 11
+#define BBOX_MAX_KINDS 16  // room in the dump header for more kinds
+
+// what triggered the ring to freeze
+#define BBOX_TRIG_NONE 0
+#define BBOX_TRIG_DEADMAN 1 // the deadman switch was released
+#define BBOX_TRIG_LINK 2    // the link to the Pi was lost
+#define BBOX_TRIG_IMU 3     // the IMU heading jerked
+#define BBOX_TRIG_PI 4      // the Pi asked for a trigger
+
+// the frames that the ring is dumped in, over Serial1 and to the SD card.
+// While a dump runs they take the place of the sensor frames
+#define BBOX_DUMP_SYNC -30000 // the word that starts every dump frame
+#define BBOX_DUMP_RECORDS 6   // records per frame
+#define BBOX_DUMP_VERSION 1
+
+/**
+ * @brief One sample in the black box ring.
+ */
+typedef struct bbox_record_t {
+   uint32_t time_us; // micros() when the sample was taken
+   int16_t value;
+   uint8_t kind;     // one of the BBOX_* kinds
+   uint8_t channel;
+} bbox_record_t;
+
+/**
+ * @brief The payload of the first frame of a dump. The frames are:
+ *
+ *    int16 BBOX_DUMP_SYNC, uint16 index, uint8 records, uint8 size,
+ *    size bytes of payload, uint16 Fletcher-16 of index to payload
+ *
+ * Frame 0 holds this header and no records, the frames after it hold the
+ * records oldest first.
+ */
+typedef struct bbox_dump_header_t {
+   uint32_t now_us;     // micros() when the dump started
+   uint32_t trigger_us; // micros() of the trigger, if there was one
+   uint32_t lost;       // records not logged since the last rearm
+   uint16_t version;    // BBOX_DUMP_VERSION
+   uint16_t records;    // records in the frames that follow
+   uint8_t trigger;     // BBOX_TRIG_* that froze the ring
+   uint8_t frozen;      // the ring was frozen when the dump started
+   uint8_t decimation[BBOX_MAX_KINDS];
+   uint8_t reserved[2];
+} bbox_dump_header_t;
+
+#endif //TEENSY_PROTOCOL_H
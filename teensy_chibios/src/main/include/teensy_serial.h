@@ -2,23 +2,57 @@
 #define TEENSY_SERIAL_H
 
 #include "system_data.h"
+#include "msg_bus.h"
+#include "teensy_protocol.h" // SENSOR_FRAME_SIZE, SERIAL_SEND_MS, SERIAL_BAUD
 
 #define HWSERIAL Serial1
 
-void teensy_serial_loop_fn(system_data_t *system_data);
+// events that wake the serial thread
+#define SERIAL_EVT_UART EVENT_MASK(0) // Serial1 received or sent bytes
+#define SERIAL_EVT_BUS EVENT_MASK(1) // a sample was posted on the message bus
+
+/**
+ * @brief Counters and latencies of the serial thread, printed to the console
+ * by print_serial_stats.
+ */
+typedef struct serial_stats_t {
+   uint32_t wakeups;       // times the serial thread woke up
+   uint32_t frames;        // commands received from the Pi
+   uint32_t skipped;       // bytes dropped while looking for a sync word
+   uint32_t sent;          // sensor frames sent to the Pi
+   uint32_t tx_full;       // sends put off because the UART had no room
+   uint16_t wake_us_last;  // UART interrupt to serial thread running
+   uint16_t wake_us_max;
+   uint16_t apply_us_last; // UART interrupt to command in the system data
+   uint16_t apply_us_max;
+} serial_stats_t;
+
+void teensy_serial_attach();
+
+void teensy_serial_woke(eventmask_t events);
+
+int teensy_serial_poll(actuator_data_t *cmds, int max_cmds, uint32_t *rx_us);
+
+void teensy_serial_command(const actuator_data_t *cmd, uint32_t rx_us,
+                           system_data_t *system_data);
+
+void teensy_serial_apply(const bus_sample_t *sample,
+                         system_data_t *system_data);
+
+bool teensy_serial_send(const sensor_data_t *sensors, int16_t drive_mode);
+
+bool teensy_serial_dump();
 
 void teensy_serial_setup();
 
 void set_sensor_msg(int user_input, sensor_data_t *data_ptr);
 
-void teensy_sync();
-
 void clear_buffer();
 
-void read_from_pi(actuator_data_t *actuators_ptr);
+void print_sensor_msg(const sensor_data_t *sensors_ptr);
 
-void print_sensor_msg(sensor_data_t *sensors_ptr);
+void print_actuator_msg(const actuator_data_t *actuators_ptr);
 
-void print_actuator_msg(actuator_data_t *actuators_ptr);
+void print_serial_stats();
 
 #endif
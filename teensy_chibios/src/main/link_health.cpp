@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include "include/link_health.h"
+
+//#define DEBUG
+
+/**
+ * @brief The link state from the last call to link_health_update().
+ */
+static int16_t link_state = LINK_BRAKE;
+
+/**
+ * @brief The command age at which the last link loss reached LINK_BRAKE,
+ * i.e. the measured time from the last good command to the safe state.
+ */
+static uint16_t reaction_ms = 0;
+
+/**
+ * @brief Records a command frame that was received from the Pi. Every frame
+ * carries a sequence number that the Pi increments, so gaps in the sequence
+ * are counted as dropped frames.
+ *
+ * @param link the link data in the system data
+ * @param seq the sequence number of the received frame
+ */
+void link_health_rx(link_data_t *link, uint16_t seq) {
+   uint16_t gap = seq - link->rx_seq;
+
+   if (link->rx_count > 0 && gap > 1 && gap < 0x8000) {
+      link->dropped += gap - 1;
+   }
+   link->rx_seq = seq;
+   link->rx_count++;
+}
+
+/**
+ * @brief Grades the health of the link to the Pi by the age of the last
+ * command. This is called on every tick of the control loop, so the link
+ * reaches LINK_BRAKE at most one control period after LINK_BRAKE_MS. The
+ * truck is not braked at that instant: see actuator_control_loop_fn for how
+ * long the motor output then takes to reach what the stop controller asks
+ * for.
+ *
+ * @param cmd_time_us the micros() time of the last command from the Pi, or
+ * 0 if no command has been received yet
+ * @param now_us the current micros() time
+ * @return one of LINK_OK, LINK_HOLD, LINK_COAST or LINK_BRAKE
+ */
+int16_t link_health_update(uint32_t cmd_time_us, uint32_t now_us) {
+   uint32_t age_ms = (now_us - cmd_time_us) / 1000;
+   int16_t state;
+
+   if (cmd_time_us == 0 || age_ms >= LINK_BRAKE_MS) {
+      state = LINK_BRAKE;
+   }
+   else if (age_ms >= LINK_COAST_MS) {
+      state = LINK_COAST;
+   }
+   else if (age_ms >= LINK_HOLD_MS) {
+      state = LINK_HOLD;
+   }
+   else {
+      state = LINK_OK;
+   }
+
+   if (state == LINK_BRAKE && link_state != LINK_BRAKE && cmd_time_us != 0) {
+      reaction_ms = age_ms > UINT16_MAX ? UINT16_MAX : age_ms;
+#ifdef DEBUG
+      Serial.printf("link lost, braking after %u ms\n", reaction_ms);
+#endif
+   }
+   link_state = state;
+
+   return state;
+}
+
+/**
+ * @brief Returns the measured time from the last good command to the safe
+ * state for the most recent link loss, or 0 if the link has not been lost.
+ */
+uint16_t link_health_reaction_ms() {
+   return reaction_ms;
+}
@@ -25,6 +25,10 @@
 #include "include/tof_lidar.h"
 #include "include/tca_selector.h"
 #include "include/hall_sensor.h"
+#include "include/actuator_control.h"
+#include "include/link_health.h"
+#include "include/msg_bus.h"
+#include "include/black_box.h"
 
 #include <ChRt.h>
 
@@ -38,12 +42,15 @@
 #define IMU_SCL_PIN 19
 #define TOF_LIDAR_SDA_PIN 18
 #define TOF_LIDAR_SCL_PIN 19
-#define RC_SW1_PIN 25
-#define RC_SW3_PIN 24
 #define HALL_PHASE_A_PIN 40
 #define HALL_PHASE_B_PIN 41
 #define HALL_PHASE_C_PIN 42
 
+#define SERIAL_IDLE_MS 100 // longest the serial thread sleeps without events
+#define SERIAL_STATS_MS 1000 // period of the serial statistics on the console
+#define SERIAL_MAX_CMDS 4 // commands applied per lock of the system_data
+#define BLACK_BOX_POLL_MS 100 // how often the SD thread checks for a freeze
+
 
 /***************************** STATIC VARIABLES ******************************/
 
@@ -52,13 +59,17 @@
  * resource is achieved through the use of ChibiOS's mutex library.
  *
  * Tasks that control a sensor will call the primary function to read that
- * sensor, obtain the mutex to for the system data, write the sensor data to
- * the system_data, and then release the mutex on the system_data.
+ * sensor and post the reading as a timestamped sample on the message bus
+ * (see msg_bus.cpp). The serial task takes the samples off the bus and
+ * writes them to the system_data while holding the mutex.
+ *
+ * The control task copies the actuator commands out of the system_data
+ * while holding the mutex, so every actuator is driven from the same
+ * consistent snapshot, and then runs the primary functions that control
+ * the actuators.
  *
- * Tasks that control actuators will read from the system_data (no mutex
- * needed as the system_data is effectively read-only for actuator tasks) to
- * receive the specific data that corresponds to their task and then run their
- * primary functions to control the actuators.
+ * Every sample is also logged in the black box (see black_box.cpp), at
+ * the full rate of the sensor rather than the rate of the link to the Pi.
  */
 static system_data_t system_data = {0};
 MUTEX_DECL(sysMtx);
@@ -76,32 +87,102 @@ static int16_t Encoder_ticks;
 /*************************** THREAD DECLARATION ******************************/
 
 /**
- * @brief Fifth Wheel Thread: Reads desired state of the fifth wheel from the
- * system_data and outputs a servo angle corresponding to locked or unlocked.
- *
- * This thread calls fifth_wheel_loop_fn() which is the primary function for the
- * fifth wheel and whose implementation is found in fifth_wheel.cpp.
+ * @brief Control Timer Interrupt Handler: Runs from a hardware interval timer
+ * (PIT) at CONTROL_RATE_HZ and awakens the control thread. If the control
+ * thread is still busy with the previous tick, the overrun is counted.
  */
-static THD_WORKING_AREA(fifth_wheel_wa, 64);
+static thread_reference_t control_trp = NULL;
+static IntervalTimer control_timer;
+static volatile uint32_t control_overruns = 0;
 
-static THD_FUNCTION(fifth_wheel_thread, arg) {
-   int16_t fifth_output;
+CH_IRQ_HANDLER(CONTROL_ISR_Fcn){
+    CH_IRQ_PROLOGUE();
 
-   while (true) {
-      //Serial.println("fifth wheel");
-      fifth_output = system_data.actuators.fifth_output;
+    chSysLockFromISR();
+    if (control_trp == NULL) {
+        control_overruns++;
+    }
+    chThdResumeI(&control_trp, (msg_t)0x1337);  /* Resuming the thread */
+    chSysUnlockFromISR();
 
-      fifth_wheel_loop_fn(fifth_output);
+    CH_IRQ_EPILOGUE();
+}
 
-      chThdSleepMilliseconds(300);
-   }
+/**
+ * @brief Control Thread: The single actuator output stage. On every tick of
+ * the control timer it takes one consistent snapshot of the actuator
+ * commands from the system_data and applies it to the motor, steering servo
+ * and fifth wheel together.
+ *
+ * The snapshot is taken with chMtxTryLock so that a thread holding the
+ * system_data mutex can never delay a tick; the previous snapshot is reused
+ * instead. The health of the link to the Pi is graded every tick (see
+ * link_health.cpp), so losing the link reaches LINK_BRAKE within
+ * LINK_BRAKE_MS plus one tick; the motor output then slews to the stop
+ * controller's output (see actuator_control.cpp). The link state, the
+ * command age at which braking started and the time from a command
+ * arriving over UART to the outputs being updated are written back to the
+ * system_data as telemetry for the Pi. Every change of the link state is
+ * logged in the black box, and losing the link triggers it.
+ *
+ * This thread calls actuator_control_loop_fn which is the primary function
+ * for the actuators and whose implementation is found in actuator_control.cpp
+ */
+static THD_WORKING_AREA(control_wa, 512);
+
+static THD_FUNCTION(control_thread, arg) {
+    actuator_data_t actuators = {0};
+    uint32_t cmd_time_us = 0;
+    bool deadman = false;
+    int16_t wheel_speed = 0;
+    int16_t link_state = LINK_BRAKE;
+    int16_t last_link_state;
+    int32_t latency_us = -1;
+    int32_t pending_latency_us = -1;
+
+    while (true) {
+        chSysLock();
+        chThdSuspendS(&control_trp); // wait for the control timer
+        chSysUnlock();
+
+        if (chMtxTryLock(&sysMtx)) {
+            actuators = system_data.actuators;
+            cmd_time_us = system_data.actuator_time_us;
+            deadman = system_data.deadman;
+            wheel_speed = system_data.sensors.wheel_speed;
+            system_data.sensors.link_state = link_state;
+            system_data.sensors.link_reaction_ms = link_health_reaction_ms();
+            if (pending_latency_us >= 0) {
+                system_data.sensors.cmd_latency_us =
+                    pending_latency_us > UINT16_MAX ? UINT16_MAX
+                                                    : pending_latency_us;
+                pending_latency_us = -1;
+            }
+            chMtxUnlock(&sysMtx);
+        }
+
+        last_link_state = link_state;
+        link_state = link_health_update(cmd_time_us, micros());
+        if (link_state != last_link_state) {
+            black_box_log(BBOX_LINK, 0, link_state);
+            if (link_state == LINK_BRAKE) {
+                black_box_trigger(BBOX_TRIG_LINK);
+            }
+        }
+        latency_us = actuator_control_loop_fn(&actuators, cmd_time_us,
+                                              link_state, deadman,
+                                              wheel_speed);
+        if (latency_us >= 0) {
+            pending_latency_us = latency_us;
+        }
+    }
 }
 
 
 
 /**
- * @brief IMU Thread: Reads euler angles from the BNO055 IMU and writes the
- * data to the system_data after obtaining the system_data mutex.
+ * @brief IMU Thread: Reads euler angles from the BNO055 IMU and posts the
+ * angle on the message bus.
  *
  * This thread calls imu_loop_fn() which is the primary function for the IMU
  * and whose implementation is found in imu.cpp.
@@ -116,11 +197,7 @@ static THD_FUNCTION(imu_thread, arg) {
       //Serial.println("imu");
       imu_angle = imu_loop_fn();
 
-
-      chMtxLock(&sysMtx);
-      system_data.sensors.imu_angle = imu_angle;
-      system_data.updated = true;
-      chMtxUnlock(&sysMtx);
+      msg_bus_post(SAMPLE_IMU_ANGLE, imu_angle);
 
       chThdSleepMilliseconds(50);
    }
@@ -128,45 +205,6 @@ static THD_FUNCTION(imu_thread, arg) {
 
 
 
-/**
- * @brief Motor Driver Thread: Reads motor output levels from the system data
- * and controls the motor based on this value.
- *
- * This thread calls motor_driver_loop_fn which is the primary function for
- * the motor and whose implementation is found in motor_driver.cpp.
- */
-static THD_WORKING_AREA(motor_driver_wa, 64);
-
-static THD_FUNCTION(motor_driver_thread, arg) {
-   int16_t motor_output;
-   int16_t wheel_speed;
-   int16_t time_step;
-   int16_t last_time = ST2MS(chVTGetSystemTime());
-   int16_t current_time = last_time;
-
-   while (true) {
-      motor_output = system_data.actuators.motor_output;
-      wheel_speed = system_data.sensors.wheel_speed;
-
-      current_time = ST2MS(chVTGetSystemTime());
-      time_step = current_time - last_time;
-
-      if (system_data.deadman) {
-
-         motor_driver_loop_fn(motor_output);
-      }
-      else {
-         motor_output = stop_motor(wheel_speed, time_step);
-         motor_driver_loop_fn(0);
-      }
-
-      last_time = current_time;
-      chThdSleepMilliseconds(100);
-   }
-}
-
-
-
 /**
  * @brief Left Time of Flight Lidar Thread: Reads the distance in millimeters
  * to the nearest object for the left Time of Flight sensor.
@@ -182,10 +220,8 @@ static THD_FUNCTION(left_tof_thread, arg) {
     while (true) {
         dist_mm = tof_left_loop_fn();
 
-        chMtxLock(&sysMtx);
-        system_data.sensors.left_TOF = dist_mm;
-        system_data.updated = true;
-        chMtxUnlock(&sysMtx);
+        msg_bus_post(SAMPLE_LEFT_TOF, dist_mm);
+        black_box_log(BBOX_TOF, 0, dist_mm);
 
         chThdSleepMilliseconds(100);
     }
@@ -208,10 +244,8 @@ static THD_FUNCTION(right_tof_thread, arg) {
     while (true) {
         dist_mm = tof_right_loop_fn();
 
-        chMtxLock(&sysMtx);
-        system_data.sensors.right_TOF = dist_mm;
-        system_data.updated = true;
-        chMtxUnlock(&sysMtx);
+        msg_bus_post(SAMPLE_RIGHT_TOF, dist_mm);
+        black_box_log(BBOX_TOF, 1, dist_mm);
 
         chThdSleepMilliseconds(100);
     }
@@ -219,140 +253,143 @@ static THD_FUNCTION(right_tof_thread, arg) {
 
 
 /**
- * @brief RC Receiver Switch 1 Interrupt Handler: Runs preemptive Chibios Interrupt
- * code and awakens the RC receiver Switch 1 thread.
- */
-static thread_reference_t rc_sw1_isr_trp = NULL;
-
-CH_IRQ_HANDLER(RC_SW1_ISR_Fcn){
-    CH_IRQ_PROLOGUE();
-
-    /* Wakes up the thread.*/
-    chSysLockFromISR();
-    chThdResumeI(&rc_sw1_isr_trp, (msg_t)0x1337);  /* Resuming the thread */
-    chSysUnlockFromISR();
-
-    CH_IRQ_EPILOGUE();
-}
-
-/**
- * @brief RC Receiver Switch 1 Thread: Reads auxiliary signals from the RC receiver switch 1
- * for determining if the deadman switch is pressed.
+ * @brief RC Receiver Thread: Copies the pulse widths that FTM3 has captured
+ * from the RC receiver into the system_data, and determines if the deadman
+ * switch is pressed and what drive mode the semi-truck is in. The deadman is
+ * written straight to the system_data because the control thread reads it
+ * from there; the drive mode is only reported to the Pi, so it is posted on
+ * the message bus like the sensor readings.
  *
- * This thread calls RC_receiver_SW1_fn which is the primary function for
- * the RC receiver switch 1 and whose implementation is found in RC_receiver.cpp
- */
-static THD_WORKING_AREA(rc_sw1_isr_wa_thd, 128);
-
-static THD_FUNCTION(rc_sw1_handler, arg) {
-
-    int16_t deadman_mode;
-    while (true) {
-
-        chSysLock();
-        chThdSuspendS(&rc_sw1_isr_trp); // wait for resume thread message
-        chSysUnlock();
-
-        deadman_mode = RC_receiver_SW1_fn(RC_SW1_PIN);
-
-        chMtxLock(&sysMtx);
-        system_data.deadman = deadman_mode;
-        system_data.updated = true;
-        chMtxUnlock(&sysMtx);
-    }
-}
-
-
-/**
- * @brief RC Receiver Switch 3 Interrupt Handler: Runs preemptive Chibios Interrupt
- * code and awakens the RC receiver Switch 3 thread.
- */
-static thread_reference_t rc_sw3_isr_trp = NULL;
-
-CH_IRQ_HANDLER(RC_SW3_ISR_Fcn){
-    CH_IRQ_PROLOGUE();
-
-    /* Wakes up the thread.*/
-    chSysLockFromISR();
-    chThdResumeI(&rc_sw3_isr_trp, (msg_t)0x1337);  /* Resuming the thread */
-    chSysUnlockFromISR();
-
-    CH_IRQ_EPILOGUE();
-}
-
-
-/**
- * @brief RC Receiver Switch 3 Thread: Reads auxiliary signals from the RC receiver switch 3
- * for determining what drive mode the semi-truck is in.
+ * The edges themselves are timestamped in hardware and decoded in the FTM3
+ * interrupt, so this thread only has to run once per RC frame (20 ms). If
+ * the deadman switch channel loses its signal, the deadman is treated as
+ * released, and if the drive mode switch loses its signal, the drive mode
+ * falls back to manual (0). Releasing the deadman switch triggers the black
+ * box.
  *
- * This thread calls RC_receiver_SW3_fn which is the primary function for
- * the RC receiver switch 3 and whose implementation is found in RC_receiver.cpp
+ * This thread calls RC_receiver_read, RC_receiver_SW1_fn and
+ * RC_receiver_SW3_fn whose implementations are found in RC_receiver.cpp
  */
-static THD_WORKING_AREA(rc_sw3_isr_wa_thd, 128);
+static THD_WORKING_AREA(rc_receiver_wa, 256);
 
-static THD_FUNCTION(rc_sw3_handler, arg) {
+static THD_FUNCTION(rc_receiver_thread, arg) {
+    rc_data_t rc_data;
+    int16_t deadman_mode;
+    int16_t last_deadman_mode = 0;
     int16_t drive_mode;
 
     while (true) {
-        chSysLock();
-        chThdSuspendS(&rc_sw3_isr_trp); // wait for resume thread message
-        chSysUnlock();
-
-        drive_mode = RC_receiver_SW3_fn(RC_SW3_PIN);
+        RC_receiver_read(&rc_data);
+
+        if (rc_data.valid & (1 << RC_SW1)) {
+            deadman_mode = RC_receiver_SW1_fn(rc_data.pulse_us[RC_SW1]);
+        }
+        else {
+            deadman_mode = 0;
+        }
+        if (rc_data.valid & (1 << RC_SW3)) {
+            drive_mode = RC_receiver_SW3_fn(rc_data.pulse_us[RC_SW3]);
+        }
+        else {
+            drive_mode = 0;
+        }
+
+        if (deadman_mode != last_deadman_mode) {
+            black_box_log(BBOX_DEADMAN, 0, deadman_mode);
+            if (!deadman_mode) {
+                black_box_trigger(BBOX_TRIG_DEADMAN);
+            }
+            last_deadman_mode = deadman_mode;
+        }
 
         chMtxLock(&sysMtx);
-        system_data.drive_mode = drive_mode;
-        system_data.updated = true;
+        system_data.rc = rc_data;
+        system_data.deadman = deadman_mode;
         chMtxUnlock(&sysMtx);
 
-    }
-}
+        msg_bus_post(SAMPLE_DRIVE_MODE, drive_mode);
 
-/**
- * @brief Steer Servo Thread: Controls the servo that dictates the driving
- * angle of the semi truck
- *
- * This thread calls steer_servo_loop_fn which is the primary function for
- * the steering servo and whose implementation is found in steer_servo.cpp
- */
-static THD_WORKING_AREA(steer_servo_wa, 64);
-
-static THD_FUNCTION(steer_servo_thread, arg) {
-   int16_t steer_output = 180;
-   steer_servo_loop_fn(steer_output);
-
-   while (true) {
-      //Serial.println("steer");
-      steer_output = system_data.actuators.steer_output;
-
-      steer_servo_loop_fn(steer_output);
-
-      chThdSleepMilliseconds(100);
-   }
+        chThdSleepMilliseconds(20);
+    }
 }
 
-
-
 /**
  * @brief Teensy Serial Thread: Communicates over the serial (UART) port to
  * relay system data between the Teensy and the Raspberry Pi.
  *
- * This thread calls serial_loop_fn() which is the primary function for the
- * serial communication and whose implementation is found in teensy_serial.cpp.
+ * The thread sleeps until it is woken by an event: the Serial1 interrupt
+ * signals it when bytes arrive from the Pi or the UART can take more bytes,
+ * and the message bus signals it when a sensor thread posts a sample. The
+ * bytes from the Pi are fed through a parser that never waits for the rest
+ * of a frame, so a command reaches the system_data one interrupt-to-thread
+ * wakeup after its last byte arrives, and the mutex is never held while
+ * waiting on the UART. The samples on the bus are applied to the system_data
+ * as they arrive, and the latest values go out to the Pi in one frame every
+ * SERIAL_SEND_MS, which the 9600 baud link can carry. A frame that the UART
+ * buffer cannot take whole is sent when the interrupt signals room for it,
+ * and the schedule starts over if it fell a whole period behind. While the
+ * Pi has the black box dumped, the dump frames go out in place of the sensor
+ * data.
+ *
+ * This thread calls the teensy_serial_* functions whose implementations are
+ * found in teensy_serial.cpp.
  */
 static THD_WORKING_AREA(teensy_serial_wa, 2048);
 
 static THD_FUNCTION(teensy_serial_thread, arg) {
+   event_listener_t bus_listener;
+   actuator_data_t cmds[SERIAL_MAX_CMDS];
+   bus_sample_t sample;
+   sensor_data_t sensors;
+   int16_t drive_mode;
+   uint32_t rx_us;
+   uint32_t stats_ms = millis();
+   uint32_t send_ms = millis() + SERIAL_SEND_MS;
+   int num_cmds;
+
    clear_buffer();
+   msg_bus_listen(&bus_listener, SERIAL_EVT_BUS);
+   teensy_serial_attach();
 
    while (true) {
-      //Serial.println("serial");
+      // sleep until the next frame is due, or until the UART has room for
+      // one that is overdue
+      int32_t to_send_ms = (int32_t)(send_ms - millis());
+      systime_t timeout = MS2ST(SERIAL_IDLE_MS);
 
-      chMtxLock(&sysMtx);
-      teensy_serial_loop_fn(&system_data);
-      chMtxUnlock(&sysMtx);
+      if (to_send_ms > 0 && to_send_ms < SERIAL_IDLE_MS) {
+         timeout = MS2ST(to_send_ms);
+      }
+      eventmask_t events = chEvtWaitAnyTimeout(ALL_EVENTS, timeout);
+      teensy_serial_woke(events);
+
+      do {
+         num_cmds = teensy_serial_poll(cmds, SERIAL_MAX_CMDS, &rx_us);
+
+         chMtxLock(&sysMtx);
+         for (int i = 0; i < num_cmds; i++) {
+            teensy_serial_command(&cmds[i], rx_us, &system_data);
+         }
+         while (msg_bus_fetch(&sample, TIME_IMMEDIATE)) {
+            teensy_serial_apply(&sample, &system_data);
+         }
+         sensors = system_data.sensors;
+         drive_mode = system_data.drive_mode;
+         chMtxUnlock(&sysMtx);
+      } while (num_cmds == SERIAL_MAX_CMDS);
+
+      if (!teensy_serial_dump() && (int32_t)(millis() - send_ms) >= 0 &&
+          teensy_serial_send(&sensors, drive_mode)) {
+         send_ms += SERIAL_SEND_MS;
+         if ((int32_t)(millis() - send_ms) >= 0) {
+            send_ms = millis() + SERIAL_SEND_MS;
+         }
+      }
 
-      chThdSleepMilliseconds(50);
+      if (millis() - stats_ms >= SERIAL_STATS_MS) {
+         print_serial_stats();
+         stats_ms = millis();
+      }
    }
 }
 
@@ -360,15 +397,18 @@ static THD_FUNCTION(teensy_serial_thread, arg) {
 
 /**
  * @brief Hall Sensor Interrupt Handler: Runs preemptive Chibios Interrupt
- * code and awakens the main Hall Sensor thread.
+ * code and awakens the main Hall Sensor thread. The time of the edge is
+ * kept for the black box.
  */
 static thread_reference_t hall_isr_trp = NULL;
+static volatile uint32_t hall_edge_us = 0;
 
 CH_IRQ_HANDLER(HALL_ISR_Fcn){
     CH_IRQ_PROLOGUE();
 
     /* Wakes up the thread.*/
     chSysLockFromISR();
+    hall_edge_us = micros();
     chThdResumeI(&hall_isr_trp, (msg_t)0x1337);  /* Resuming the thread */
     chSysUnlockFromISR();
 
@@ -393,6 +433,7 @@ static THD_FUNCTION(hall_sensor_thread, arg) {
         chSysUnlock();
 
         Encoder_ticks = hall_sensor_loop_fn(HALL_PHASE_B_PIN, HALL_PHASE_C_PIN);
+        black_box_log_at(BBOX_HALL, 0, Encoder_ticks, hall_edge_us);
     }
 }
 
@@ -406,14 +447,15 @@ static THD_FUNCTION(hall_sensor_thread, arg) {
 static THD_WORKING_AREA(speed_wa, 5120);
 
 static THD_FUNCTION(speed_thread, arg) {
+    int16_t wheel_speed;
 
     while (true) {
 
          Serial.print("encoder ticks: ");
          Serial.println(Encoder_ticks);
-        chMtxLock(&sysMtx);
-        system_data.sensors.wheel_speed = wheel_speed_loop_fn(Encoder_ticks);
-        chMtxUnlock(&sysMtx);
+        wheel_speed = wheel_speed_loop_fn(Encoder_ticks);
+        msg_bus_post(SAMPLE_WHEEL_SPEED, wheel_speed);
+        black_box_log(BBOX_WHEEL_SPEED, 0, wheel_speed);
 
         chThdSleepMilliseconds(100);
     }
@@ -421,6 +463,37 @@ static THD_FUNCTION(speed_thread, arg) {
 
 
 
+#ifdef BLACK_BOX_SD
+/**
+ * @brief Black Box Thread: Writes the black box to the SD card once it has
+ * frozen after a trigger, so the record of the event survives a power
+ * cycle even if it is never dumped over the serial link. It runs below
+ * every other thread, because writing the card takes far longer than any
+ * of their periods.
+ *
+ * This thread calls black_box_spill whose implementation is found in
+ * black_box.cpp
+ */
+static THD_WORKING_AREA(black_box_wa, 2048);
+
+static THD_FUNCTION(black_box_thread, arg) {
+    bool spilled = false;
+
+    while (true) {
+        if (!black_box_frozen()) {
+            spilled = false;
+        }
+        else if (!spilled) {
+            spilled = black_box_spill();
+        }
+
+        chThdSleepMilliseconds(BLACK_BOX_POLL_MS);
+    }
+}
+#endif
+
+
+
 /************************** THREAD INITIALIZATION ****************************/
 
 /**
@@ -431,25 +504,22 @@ static THD_FUNCTION(speed_thread, arg) {
  * of them are used until chThdCreateStatic(...) is called.
  */
 void chSetup() {
+    // the message bus has to be filled before any thread can post to it
+    msg_bus_setup();
 
-    chThdCreateStatic(fifth_wheel_wa, sizeof(fifth_wheel_wa),
-                     NORMALPRIO, fifth_wheel_thread, NULL);
+    chThdCreateStatic(control_wa, sizeof(control_wa),
+                     NORMALPRIO + 2, control_thread, NULL);
+    control_timer.begin(CONTROL_ISR_Fcn, CONTROL_PERIOD_US);
 
     chThdCreateStatic(imu_wa, sizeof(imu_wa),
                      NORMALPRIO, imu_thread, NULL);
 
-    chThdCreateStatic(motor_driver_wa, sizeof(motor_driver_wa),
-                     NORMALPRIO, motor_driver_thread, NULL);
-
     chThdCreateStatic(left_tof_wa, sizeof(left_tof_wa),
                      NORMALPRIO, left_tof_thread, NULL);
 
     chThdCreateStatic(right_tof_wa, sizeof(right_tof_wa),
                      NORMALPRIO, right_tof_thread, NULL);
 
-    chThdCreateStatic(steer_servo_wa, sizeof(steer_servo_wa),
-                     NORMALPRIO, steer_servo_thread, NULL);
-
     chThdCreateStatic(teensy_serial_wa, sizeof(teensy_serial_wa),
                      NORMALPRIO, teensy_serial_thread, NULL);
 
@@ -460,13 +530,13 @@ void chSetup() {
     chThdCreateStatic(speed_wa, sizeof(speed_wa),
                      NORMALPRIO, speed_thread, NULL);
 
-    chThdCreateStatic(rc_sw1_isr_wa_thd, sizeof(rc_sw1_isr_wa_thd),
-                     NORMALPRIO + 1, rc_sw1_handler, NULL);
-    attachInterrupt(digitalPinToInterrupt(RC_SW1_PIN), RC_SW1_ISR_Fcn, CHANGE);
+    chThdCreateStatic(rc_receiver_wa, sizeof(rc_receiver_wa),
+                     NORMALPRIO + 1, rc_receiver_thread, NULL);
 
-    chThdCreateStatic(rc_sw3_isr_wa_thd, sizeof(rc_sw3_isr_wa_thd),
-                     NORMALPRIO + 1, rc_sw3_handler, NULL);
-    attachInterrupt(digitalPinToInterrupt(RC_SW3_PIN), RC_SW3_ISR_Fcn, CHANGE);
+#ifdef BLACK_BOX_SD
+    chThdCreateStatic(black_box_wa, sizeof(black_box_wa),
+                     NORMALPRIO - 1, black_box_thread, NULL);
+#endif
 
 }
 
@@ -496,7 +566,7 @@ void setup() {
     // Setup the motor driver
     motor_driver_setup(MOTOR_PIN);
 
-    // Setup the RC receiver
+    // Setup the RC receiver input capture on FTM3 (pins 35-38)
     RC_receiver_setup();
 
     // Setup the ToF Lidar Sensor to make sure it is connected and reading
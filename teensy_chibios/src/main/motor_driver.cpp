@@ -1,17 +1,21 @@
 #include "include/motor_driver.h"
 #include <Arduino.h>
 #include <Servo.h>
+#include "include/pid_controller.h"
 
 #define WHEEL_SPEED_STOP 0 // wheel speed of 0 is no velocity
 #define MOTOR_STOP 90 // motor output of 90 is no torque
 #define FORWARDS 120 // motor output of 90 is no torque
 #define INIT_VALUE 68// this output is the same as the receiver outputs in idle
-#define KP 1
-#define KI 0.05f
-#define SAT_ERROR 1000 // max error sum that can accumulate for integral control
-#define MAX_TIME_STEP 500 // in millis
-#define WHEEL_SPEED_RANGE 1000 // max error from wheel speed
-#define MOTOR_RANGE 180 // max error from wheel speed
+#define STOP_KP 0.2f // proportional gain of the stop controller
+#define STOP_KI 2.0f // integral gain of the stop controller (per second)
+#define STOP_LIMIT 40 // largest braking output the stop controller may use
+#define STOP_DEADBAND 2 // wheel speeds this close to 0 count as stopped
+#define SPEED_KP 0.5f // proportional gain of the speed controller
+#define SPEED_KI 1.0f // integral gain of the speed controller (per second)
+#define SPEED_KD 0.0f // derivative gain of the speed controller (seconds)
+#define SPEED_KFF 0.1f // feed-forward from speed setpoint to motor output
+#define MOTOR_LIMIT 100 // motor_driver_loop_fn() takes -100 to 100
 #define FULL_REVERSE 1087 // Time in microseconds of pulse width corresponding
 // to full reverse
 #define FULL_FORWARD 1660 // Time in microseconds of pulse width corresponding to full forward
@@ -25,10 +29,27 @@
 static Servo motor;
 
 /**
- * @brief The accumulated error for integral control of the control loop
- * that stops the motor when the dead man's switch is not pressed.
+ * @brief The PI controller that brakes the truck to a stop when the dead
+ * man's switch is not pressed. Its output is limited to STOP_LIMIT so that
+ * braking never turns into driving hard in reverse.
  */
-static int16_t error_sum = 0;
+static PidController<> stop_controller(STOP_KP, STOP_KI, 0.0f, 0.0f,
+                                       MOTOR_PERIOD_MS, -STOP_LIMIT,
+                                       STOP_LIMIT);
+
+/**
+ * @brief The PID controller that holds the wheel speed at the setpoint sent
+ * by the Pi when the motor is in MOTOR_MODE_SPEED.
+ */
+static PidController<> speed_controller(SPEED_KP, SPEED_KI, SPEED_KD,
+                                        SPEED_KFF, MOTOR_PERIOD_MS,
+                                        -MOTOR_LIMIT, MOTOR_LIMIT);
+
+/**
+ * @brief The mode that motor_control_fn() ran in last time, so the
+ * controllers can be reset when the mode changes.
+ */
+static int16_t last_mode = MOTOR_MODE_THROTTLE;
 
 /**
  * @brief This is the primary function controlling the motor. It reads the
@@ -38,12 +59,18 @@ static int16_t error_sum = 0;
  * @param motor_output the output to the motor
  */
 void motor_driver_loop_fn(int16_t motor_output) {
+#ifdef DEBUG
    Serial.print("before scale :   ");
    Serial.println(motor_output);
+#endif
    motor_output = scale_output(motor_output);
+#ifdef DEBUG
    Serial.print("after scale:   ");
    Serial.println(motor_output);
-   motor.write(motor_output);
+#endif
+   if (motor_output != motor.read()) {
+      motor.write(motor_output);
+   }
 }
 
 /**
@@ -80,26 +107,63 @@ void motor_driver_setup(short motor_pin) {
 
 /**
  * @brief Runs a control loop to stop the motor based on the reported wheel
- * speed, and returns a value to be output to the motor
+ * speed, and returns a value to be output to the motor. Once the truck is
+ * within STOP_DEADBAND of stopped, the integrator is cleared and no torque
+ * is applied so the truck does not creep.
  *
  * @param wheel_speed speed of the truck read by the wheel speed sensor
- * @param time_step number of millis since the last time this task ran; used
- * in integral control
- * @return the output to the motor
+ * @return the output to the motor, between -STOP_LIMIT and STOP_LIMIT
  */
-int16_t stop_motor(int16_t wheel_speed, int16_t time_step) {
-   int16_t motor_output;
-   int16_t error_range = (KI * SAT_ERROR) + (KP * WHEEL_SPEED_RANGE);
-   int16_t error = WHEEL_SPEED_STOP - wheel_speed;
-
-   if (error_sum < SAT_ERROR && (time_step > 0 && time_step < MAX_TIME_STEP)) {
-      error_sum += time_step * error;
-      error_sum = error_sum > SAT_ERROR ? SAT_ERROR : error_sum;
+int16_t stop_motor(int16_t wheel_speed) {
+   if (wheel_speed <= STOP_DEADBAND && wheel_speed >= -STOP_DEADBAND) {
+      stop_controller.reset(wheel_speed);
+      return 0;
    }
 
-   motor_output = (((KP * error) + (KI * error_sum)) * (MOTOR_RANGE /
-    error_range)) + MOTOR_STOP;
+   return stop_controller.update(WHEEL_SPEED_STOP, wheel_speed);
+}
 
-   return motor_output;
+/**
+ * @brief Runs a control loop to hold the wheel speed at a setpoint.
+ *
+ * @param speed_setpoint the desired speed in the same units as wheel_speed
+ * @param wheel_speed speed of the truck read by the wheel speed sensor
+ * @return the output to the motor, between -100 and 100
+ */
+int16_t speed_control(int16_t speed_setpoint, int16_t wheel_speed) {
+   return speed_controller.update(speed_setpoint, wheel_speed);
 }
 
+/**
+ * @brief Picks the motor output for one period of the motor task. When the
+ * dead man's switch is released the stop controller brakes the truck;
+ * otherwise motor_output is either a raw throttle or a speed setpoint
+ * depending on motor_mode. Must be called every MOTOR_PERIOD_MS while the
+ * stop or speed controller is in use; a raw throttle may be picked on any
+ * tick.
+ *
+ * @param deadman true if the dead man's switch is pressed
+ * @param motor_mode MOTOR_MODE_THROTTLE or MOTOR_MODE_SPEED
+ * @param motor_output the throttle (-100 to 100) or speed setpoint
+ * @param wheel_speed speed of the truck read by the wheel speed sensor
+ * @return the output to pass to motor_driver_loop_fn()
+ */
+int16_t motor_control_fn(bool deadman, int16_t motor_mode,
+                         int16_t motor_output, int16_t wheel_speed) {
+   int16_t mode = deadman ? motor_mode : MOTOR_MODE_STOP;
+
+   if (mode != last_mode) {
+      stop_controller.reset(wheel_speed);
+      speed_controller.reset(wheel_speed);
+      last_mode = mode;
+   }
+
+   switch (mode) {
+      case MOTOR_MODE_STOP:
+         return stop_motor(wheel_speed);
+      case MOTOR_MODE_SPEED:
+         return speed_control(motor_output, wheel_speed);
+      default:
+         return motor_output;
+   }
+}
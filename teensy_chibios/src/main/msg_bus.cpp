@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include "include/msg_bus.h"
+
+/**
+ * @brief The samples travel in fixed size blocks from a memory pool, and the
+ * mailbox carries pointers to the filled blocks from the sensor threads to
+ * the serial thread. The mailbox has a slot for every block, so a post can
+ * only fail when the pool is empty, and it never blocks the sensor thread.
+ */
+static bus_sample_t sample_blocks[MSG_BUS_DEPTH];
+static MEMORYPOOL_DECL(sample_pool, sizeof(bus_sample_t), NULL);
+
+static msg_t sample_slots[MSG_BUS_DEPTH];
+static MAILBOX_DECL(sample_mailbox, sample_slots, MSG_BUS_DEPTH);
+
+/**
+ * @brief Broadcast after every sample that is posted, so a thread can wait
+ * for samples and for other events at the same time.
+ */
+static EVENTSOURCE_DECL(sample_event);
+
+/**
+ * @brief The number of samples that were dropped because every block was
+ * still waiting for the serial thread.
+ */
+static volatile uint32_t dropped = 0;
+
+
+/**
+ * @brief Fills the memory pool with the sample blocks. Must be called once
+ * before any thread posts to the bus.
+ */
+void msg_bus_setup() {
+   chPoolLoadArray(&sample_pool, sample_blocks, MSG_BUS_DEPTH);
+}
+
+
+/**
+ * @brief Posts a sample that was taken now from a thread. Never blocks.
+ *
+ * @param type the SAMPLE_* kind of the sample
+ * @param value the reading
+ * @return false if the bus was full and the sample was dropped
+ */
+bool msg_bus_post(uint8_t type, int16_t value) {
+   uint32_t time_us = micros();
+   bool posted;
+
+   chSysLock();
+   posted = msg_bus_post_i(type, value, time_us);
+   chSysUnlock();
+   return posted;
+}
+
+
+/**
+ * @brief Posts a sample from an interrupt handler or from within a locked
+ * section.
+ *
+ * @param type the SAMPLE_* kind of the sample
+ * @param value the reading
+ * @param time_us micros() when the sample was taken
+ * @return false if the bus was full and the sample was dropped
+ */
+bool msg_bus_post_i(uint8_t type, int16_t value, uint32_t time_us) {
+   bus_sample_t *sample = (bus_sample_t*)chPoolAllocI(&sample_pool);
+
+   if (sample == NULL) {
+      dropped++;
+      return false;
+   }
+
+   sample->time_us = time_us;
+   sample->value = value;
+   sample->type = type;
+   (void)chMBPostI(&sample_mailbox, (msg_t)sample);
+   chEvtBroadcastI(&sample_event);
+   return true;
+}
+
+
+/**
+ * @brief Registers the calling thread to have the given events signalled
+ * whenever a sample is posted. The samples are then taken off the bus with
+ * msg_bus_fetch and a timeout of TIME_IMMEDIATE.
+ *
+ * @param listener the listener to register, which must stay valid for as
+ * long as the thread listens
+ * @param events the events to signal
+ */
+void msg_bus_listen(event_listener_t *listener, eventmask_t events) {
+   chEvtRegisterMask(&sample_event, listener, events);
+}
+
+
+/**
+ * @brief Takes the oldest sample off the bus, waiting for one if there is
+ * none yet.
+ *
+ * @param sample where to copy the sample to
+ * @param timeout how long to wait, TIME_IMMEDIATE to not wait at all or
+ * TIME_INFINITE to wait forever
+ * @return false if no sample arrived before the timeout
+ */
+bool msg_bus_fetch(bus_sample_t *sample, systime_t timeout) {
+   msg_t block;
+
+   if (chMBFetch(&sample_mailbox, &block, timeout) != MSG_OK) {
+      return false;
+   }
+
+   *sample = *(bus_sample_t*)block;
+   chPoolFree(&sample_pool, (void*)block);
+   return true;
+}
+
+
+uint32_t msg_bus_dropped() {
+   return dropped;
+}
@@ -0,0 +1,109 @@
+#include "include/rc_pulse.h"
+
+/**
+ * @brief Returns the median of the accepted pulse widths in the filter
+ * history. With fewer than RC_FILTER_LEN pulses the newest one is used so
+ * that the channel reports a value as soon as the first pulse arrives.
+ */
+static uint16_t median_width(const rc_pulse_t *pulse, uint16_t newest) {
+   uint16_t a, b, c;
+
+   if (pulse->history_len < RC_FILTER_LEN) {
+      return newest;
+   }
+
+   a = pulse->history[0];
+   b = pulse->history[1];
+   c = pulse->history[2];
+
+   if ((a <= b && b <= c) || (c <= b && b <= a)) {
+      return b;
+   }
+   else if ((b <= a && a <= c) || (c <= a && a <= b)) {
+      return a;
+   }
+   return c;
+}
+
+/**
+ * @brief Resets the decoding state of a channel.
+ *
+ * @param pulse the channel to reset
+ * @param tick_hz the frequency of the timer that produces the capture values
+ */
+void rc_pulse_init(rc_pulse_t *pulse, uint32_t tick_hz) {
+   pulse->tick_khz = tick_hz / 1000;
+   pulse->rise_ticks = 0;
+   pulse->high = false;
+   pulse->history_len = 0;
+   pulse->history_idx = 0;
+   pulse->width_us = 0;
+   pulse->raw_us = 0;
+   pulse->last_valid_ms = 0;
+   pulse->glitches = 0;
+}
+
+/**
+ * @brief Feeds one captured edge into the decoder. This is called from the
+ * input capture interrupt, so it only does integer math on the channel
+ * state. Pulses outside of RC_PULSE_MIN_US to RC_PULSE_MAX_US are counted
+ * as glitches and dropped, and the accepted ones pass through a median
+ * filter to reject single-pulse spikes.
+ *
+ * @param pulse the channel that the edge belongs to
+ * @param rising true if the edge was a rising edge
+ * @param ticks the capture value of the timer at the edge
+ * @param now_ms the current time in milliseconds
+ * @return true if the edge ended a pulse, whose width is then in raw_us
+ * whether or not it was accepted
+ */
+bool rc_pulse_edge(rc_pulse_t *pulse, bool rising, uint16_t ticks,
+                   uint32_t now_ms) {
+   uint16_t width_ticks;
+   uint32_t width_us;
+
+   if (rising) {
+      pulse->rise_ticks = ticks;
+      pulse->high = true;
+      return false;
+   }
+
+   if (!pulse->high) {
+      // falling edge without a rising edge, e.g. right after start up
+      return false;
+   }
+   pulse->high = false;
+
+   // unsigned subtraction handles a single wrap of the 16 bit timer
+   width_ticks = ticks - pulse->rise_ticks;
+   width_us = ((uint32_t)width_ticks * 1000) / pulse->tick_khz;
+   pulse->raw_us = width_us > UINT16_MAX ? UINT16_MAX : width_us;
+
+   if (width_us < RC_PULSE_MIN_US || width_us > RC_PULSE_MAX_US) {
+      pulse->glitches++;
+      return true;
+   }
+
+   pulse->history[pulse->history_idx] = width_us;
+   pulse->history_idx = (pulse->history_idx + 1) % RC_FILTER_LEN;
+   if (pulse->history_len < RC_FILTER_LEN) {
+      pulse->history_len++;
+   }
+
+   pulse->width_us = median_width(pulse, width_us);
+   pulse->last_valid_ms = now_ms;
+   return true;
+}
+
+/**
+ * @brief Checks if a channel has stopped producing valid pulses, which
+ * happens when the transmitter is off or out of range.
+ *
+ * @param pulse the channel to check
+ * @param now_ms the current time in milliseconds
+ * @return true if no valid pulse was seen within RC_SIGNAL_TIMEOUT_MS
+ */
+bool rc_pulse_lost(const rc_pulse_t *pulse, uint32_t now_ms) {
+   return pulse->history_len == 0 ||
+          (now_ms - pulse->last_valid_ms) > RC_SIGNAL_TIMEOUT_MS;
+}
@@ -1,53 +1,299 @@
 #include <Arduino.h>
+#include <stddef.h>
 #include "include/teensy_serial.h"
+#include "include/cmd_frame.h"
+#include "include/link_health.h"
+#include "include/black_box.h"
 
-#define SHORT_SIZE 2
+// the Pi side only sees teensy_protocol.h, so the frame it expects must be
+// the one that is sent
+static_assert(SENSOR_FRAME_SIZE ==
+              sizeof(short) + sizeof(sensor_data_t) + sizeof(int16_t),
+              "SENSOR_FRAME_SIZE does not match sensor_data_t");
+static_assert(SENSOR_FRAME_LINK_STATE ==
+              sizeof(short) + offsetof(sensor_data_t, link_state),
+              "SENSOR_FRAME_LINK_STATE does not match sensor_data_t");
 
-#define ACT_DATA_SIZE_W_SYNC 8
-#define ACT_DATA_SIZE 6
-#define READ_CYCLES 2
-#define SYNC_VALUE -32000
+/**
+ * @brief The thread that is signalled from the UART interrupt, and the time
+ * of the last interrupt. Both are only written with the kernel locked.
+ */
+static thread_t *serial_thread = NULL;
+static volatile uint32_t uart_isr_us = 0;
+
+/**
+ * @brief The parser for the commands from the Pi and the statistics of the
+ * serial thread. Only the serial thread touches these.
+ */
+static cmd_frame_t cmd_frame;
+static serial_stats_t stats = {0};
+
+/**
+ * @brief The black box dump that is being sent to the Pi, if dumping is set.
+ * Only the serial thread touches these.
+ */
+static bbox_dump_t dump;
+static bool dumping = false;
+
+
+/**
+ * @brief Converts a time difference to the 16 bit latency fields, saturating
+ * at UINT16_MAX.
+ */
+static uint16_t clamp_us(uint32_t us) {
+   return us > UINT16_MAX ? UINT16_MAX : us;
+}
+
+
+extern "C" void uart0_status_isr(void);
+
+/**
+ * @brief UART Interrupt Handler: Replaces the Teensy core's interrupt for
+ * Serial1 (UART0). It runs the core handler, which moves bytes between the
+ * FIFOs and the Serial1 buffers, and then wakes the serial thread. The core
+ * raises the interrupt when the receive FIFO reaches its watermark, when the
+ * line goes idle after a frame and when the transmitter has room, so the
+ * thread wakes up both when a command arrives and when a pending frame to
+ * the Pi can be written.
+ */
+CH_IRQ_HANDLER(teensy_serial_isr) {
+   CH_IRQ_PROLOGUE();
+
+   uart0_status_isr();
+
+   chSysLockFromISR();
+   uart_isr_us = micros();
+   if (serial_thread != NULL) {
+      chEvtSignalI(serial_thread, SERIAL_EVT_UART);
+   }
+   chSysUnlockFromISR();
+
+   CH_IRQ_EPILOGUE();
+}
+
+
+/**
+ * @brief Makes the calling thread the one that is woken by the UART
+ * interrupt and installs the interrupt handler. Must be called from the
+ * serial thread after teensy_serial_setup.
+ */
+void teensy_serial_attach() {
+   cmd_frame_init(&cmd_frame);
+
+   chSysLock();
+   serial_thread = chThdGetSelfX();
+   chSysUnlock();
+
+   attachInterruptVector(IRQ_UART0_STATUS, teensy_serial_isr);
+}
+
+
+/**
+ * @brief Records how long the serial thread took to wake up after the UART
+ * interrupt. Called by the serial thread with the events it woke up for.
+ *
+ * @param events the events returned by chEvtWaitAnyTimeout
+ */
+void teensy_serial_woke(eventmask_t events) {
+   uint32_t isr_us;
+
+   stats.wakeups++;
+   if (!(events & SERIAL_EVT_UART)) {
+      return;
+   }
+
+   chSysLock();
+   isr_us = uart_isr_us;
+   chSysUnlock();
+
+   stats.wake_us_last = clamp_us(micros() - isr_us);
+   if (stats.wake_us_last > stats.wake_us_max) {
+      stats.wake_us_max = stats.wake_us_last;
+   }
+}
+
+
+/**
+ * @brief Carries out a request frame from the Pi. A dump is sent by
+ * teensy_serial_dump in place of the sensor data until it is done.
+ */
+static void teensy_serial_request(const cmd_request_t *request) {
+   switch (request->code) {
+      case BBOX_REQ_DUMP:
+         if (dumping) {
+            black_box_dump_end(&dump);
+         }
+         black_box_dump_begin(&dump, request->arg[0]);
+         dumping = true;
+         break;
+      case BBOX_REQ_REARM:
+         black_box_rearm();
+         break;
+      case BBOX_REQ_TRIGGER:
+         black_box_trigger(BBOX_TRIG_PI);
+         break;
+      case BBOX_REQ_DECIMATE:
+         black_box_decimate(request->arg[0], request->arg[1]);
+         break;
+   }
+}
+
+
+/**
+ * @brief Feeds every byte that the Pi has sent into the command parser
+ * without waiting for more. Requests are carried out as they are parsed.
+ * Stops early once max_cmds commands have been parsed, in which case the
+ * caller should call it again.
+ *
+ * @param cmds where to write the parsed commands, oldest first
+ * @param max_cmds the size of cmds
+ * @param rx_us set to the time of the last UART interrupt, which is when the
+ * bytes of the commands were last received
+ * @return the number of commands written to cmds
+ */
+int teensy_serial_poll(actuator_data_t *cmds, int max_cmds, uint32_t *rx_us) {
+   int num_cmds = 0;
+
+   chSysLock();
+   *rx_us = uart_isr_us;
+   chSysUnlock();
+
+   while (num_cmds < max_cmds && HWSERIAL.available() > 0) {
+      cmd_request_t request;
+
+      if (cmd_frame_feed(&cmd_frame, HWSERIAL.read(), &cmds[num_cmds])) {
+         print_actuator_msg(&cmds[num_cmds]);
+         num_cmds++;
+      }
+      if (cmd_frame_take_request(&cmd_frame, &request)) {
+         teensy_serial_request(&request);
+      }
+   }
+
+   stats.frames = cmd_frame.frames;
+   stats.skipped = cmd_frame.skipped;
+   return num_cmds;
+}
 
 
 /**
- * @brief The primary function for communicating between the Teensy and the
- * Pi over the Serial UART port.
+ * @brief Writes one command from the Pi into the system data. Called with
+ * the system_data mutex held, once per command in the order they arrived so
+ * that the link health sees every sequence number.
  *
+ * @param cmd the command parsed by teensy_serial_poll
+ * @param rx_us the time the command was received, from teensy_serial_poll
  * @param system_data a pointer to the system data that is declared
  * statically in main.ino.
  */
-void teensy_serial_loop_fn(system_data_t *system_data) {
-   short sync_value = SYNC_VALUE;
-   short waiting_bytes;
+void teensy_serial_command(const actuator_data_t *cmd, uint32_t rx_us,
+                           system_data_t *system_data) {
+   system_data->actuators = *cmd;
+   system_data->actuator_time_us = rx_us;
+   link_health_rx(&system_data->link, cmd->seq);
+   system_data->sensors.rx_seq = system_data->link.rx_seq;
+   black_box_log_at(BBOX_COMMAND, 0, cmd->seq, rx_us);
 
-   if (system_data->updated) {
-      Serial.print("Received from imu: ");
-      Serial.println(system_data->sensors.imu_angle, DEC);
+   stats.apply_us_last = clamp_us(micros() - rx_us);
+   if (stats.apply_us_last > stats.apply_us_max) {
+      stats.apply_us_max = stats.apply_us_last;
+   }
+}
 
-      if (HWSERIAL.availableForWrite()) {
-         print_sensor_msg(&system_data->sensors);
-         Serial.printf("sending sync data: %i\n", sync_value);
 
-         HWSERIAL.write((char*)&sync_value, sizeof(short));
-         HWSERIAL.write((char*)&(system_data->sensors), sizeof(sensor_data_t));
-         HWSERIAL.write((char*)&(system_data->drive_mode), sizeof(int16_t));
-         system_data->updated = false;
-      }
+/**
+ * @brief Writes one sample from the message bus into the system data. The
+ * frame to the Pi holds one value per sensor, so a newer sample of the same
+ * type replaces an older one from the same batch.
+ *
+ * @param sample the sample taken off the bus
+ * @param system_data a pointer to the system data that is declared
+ * statically in main.ino.
+ */
+void teensy_serial_apply(const bus_sample_t *sample,
+                         system_data_t *system_data) {
+   switch (sample->type) {
+      case SAMPLE_IMU_ANGLE:
+         system_data->sensors.imu_angle = sample->value;
+         break;
+      case SAMPLE_WHEEL_SPEED:
+         system_data->sensors.wheel_speed = sample->value;
+         break;
+      case SAMPLE_RIGHT_TOF:
+         system_data->sensors.right_TOF = sample->value;
+         break;
+      case SAMPLE_LEFT_TOF:
+         system_data->sensors.left_TOF = sample->value;
+         break;
+      case SAMPLE_REAR_TOF:
+         system_data->sensors.rear_TOF = sample->value;
+         break;
+      case SAMPLE_DRIVE_MODE:
+         system_data->drive_mode = sample->value;
+         break;
    }
+}
+
+
+/**
+ * @brief Sends one frame of sensor data to the Pi over the Serial UART port.
+ * The frame is only written if the UART buffer can take all of it, so the
+ * write never blocks the serial thread and a frame is never cut in two.
+ *
+ * @param sensors the sensor data to send
+ * @param drive_mode the drive mode selected on the RC transmitter
+ * @return false if the UART could not take the frame
+ */
+bool teensy_serial_send(const sensor_data_t *sensors, int16_t drive_mode) {
+   short sync_value = CMD_FRAME_SYNC;
+
+   if (HWSERIAL.availableForWrite() < (int)SENSOR_FRAME_SIZE) {
+      stats.tx_full++;
+      return false;
+   }
+   stats.sent++;
+
+   Serial.print("Received from imu: ");
+   Serial.println(sensors->imu_angle, DEC);
+   print_sensor_msg(sensors);
+   Serial.printf("sending sync data: %i\n", sync_value);
 
-   waiting_bytes = HWSERIAL.available();
-   Serial.printf("waiting bytes: %i\n", waiting_bytes);
-   // communicate with Pi and the ROS network
-   for (int i = 0; i < waiting_bytes/ACT_DATA_SIZE_W_SYNC; i++) {
-
-      teensy_sync();
-      waiting_bytes = HWSERIAL.available();
-      Serial.printf("waiting bytes: %i\n", waiting_bytes);
-      if (waiting_bytes >= ACT_DATA_SIZE) {
-         read_from_pi(&(system_data->actuators));
-         print_actuator_msg(&system_data->actuators);
+   HWSERIAL.write((char*)&sync_value, sizeof(short));
+   HWSERIAL.write((char*)sensors, sizeof(sensor_data_t));
+   HWSERIAL.write((char*)&drive_mode, sizeof(int16_t));
+   return true;
+}
+
+
+/**
+ * @brief Sends as many frames of a black box dump as the UART can take
+ * without waiting. Called instead of teensy_serial_send while a dump is
+ * going on; the UART interrupt wakes the serial thread again when there is
+ * room for more.
+ *
+ * @return false if no dump is going on
+ */
+bool teensy_serial_dump() {
+   uint8_t frame[BBOX_FRAME_MAX];
+   int room = HWSERIAL.availableForWrite();
+   uint16_t size;
+
+   if (!dumping) {
+      return false;
+   }
+
+   while (room >= (int)BBOX_FRAME_MAX) {
+      size = black_box_dump_frame(&dump, frame);
+      if (size == 0) {
+         black_box_dump_end(&dump);
+         dumping = false;
+         Serial.printf("black box dump sent\n");
+         break;
       }
+      HWSERIAL.write(frame, size);
+      room -= size;
    }
+   return true;
 }
 
 
@@ -57,7 +303,7 @@ void teensy_serial_loop_fn(system_data_t *system_data) {
  */
 void teensy_serial_setup(){
    Serial.begin(9600);
-   HWSERIAL.begin(9600);
+   HWSERIAL.begin(SERIAL_BAUD);
 }
 
 
@@ -73,47 +319,44 @@ void clear_buffer() {
 }
 
 
-/**
- * @brief Ensures that the data being read from the Pi is synced. It clears
- * the serial buffer up until it reads the designated SYNC_VALUE.
- */
-void teensy_sync() {
-   int16_t data;
-   byte data_buffer[2];
-
-   do {
-      HWSERIAL.readBytes(data_buffer, 2);
-      data = *((int16_t*)data_buffer);
-      Serial.printf("sync data: %i\n", data);
-   } while (data != SYNC_VALUE);
-}
-
-void read_from_pi(actuator_data_t *actuators_ptr) {
-   byte data_buffer[SHORT_SIZE];
-
-   HWSERIAL.readBytes(data_buffer, SHORT_SIZE);
-   actuators_ptr->motor_output = *((int16_t*)data_buffer);
-   HWSERIAL.readBytes(data_buffer, SHORT_SIZE);
-   actuators_ptr->steer_output = *((int16_t*)data_buffer);
-   HWSERIAL.readBytes(data_buffer, SHORT_SIZE);
-   actuators_ptr->fifth_output = *((int16_t*)data_buffer);
-
-   print_actuator_msg(actuators_ptr);
-}
-
-
-void print_sensor_msg(sensor_data_t *sensors_ptr) {
+void print_sensor_msg(const sensor_data_t *sensors_ptr) {
    Serial.printf("Sending to Pi:\t");
    Serial.printf("IMU angle: %i\t", sensors_ptr->imu_angle);
    Serial.printf("Wheel speed: %i\t", sensors_ptr->wheel_speed);
    Serial.printf("Right TOF: %i\t", sensors_ptr->right_TOF);
    Serial.printf("Left TOF: %i\t", sensors_ptr->left_TOF);
+   Serial.printf("Command latency: %u us\t", sensors_ptr->cmd_latency_us);
+   Serial.printf("Link state: %i\t", sensors_ptr->link_state);
 }
 
 
-void print_actuator_msg(actuator_data_t *actuators_ptr) {
+void print_actuator_msg(const actuator_data_t *actuators_ptr) {
    Serial.printf("Received from Pi:\t");
    Serial.printf("Motor output: %i\t", actuators_ptr->motor_output);
    Serial.printf("Steer output: %i\t", actuators_ptr->steer_output);
-   Serial.printf("Fifth output: %i\n", actuators_ptr->fifth_output);
+   Serial.printf("Fifth output: %i\t", actuators_ptr->fifth_output);
+   Serial.printf("Motor mode: %i\t", actuators_ptr->motor_mode);
+   Serial.printf("Seq: %u\n", actuators_ptr->seq);
+}
+
+
+/**
+ * @brief Prints the statistics of the serial thread to the console and
+ * starts over for the maximum latencies.
+ */
+void print_serial_stats() {
+   Serial.printf("Serial stats:\t");
+   Serial.printf("Wakeups: %lu\t", (unsigned long)stats.wakeups);
+   Serial.printf("Frames: %lu\t", (unsigned long)stats.frames);
+   Serial.printf("Skipped bytes: %lu\t", (unsigned long)stats.skipped);
+   Serial.printf("Sent: %lu\t", (unsigned long)stats.sent);
+   Serial.printf("UART full: %lu\t", (unsigned long)stats.tx_full);
+   Serial.printf("Bus drops: %lu\t", (unsigned long)msg_bus_dropped());
+   Serial.printf("UART to thread: %u us (max %u us)\t",
+                 stats.wake_us_last, stats.wake_us_max);
+   Serial.printf("UART to command: %u us (max %u us)\n",
+                 stats.apply_us_last, stats.apply_us_max);
+
+   stats.wake_us_max = 0;
+   stats.apply_us_max = 0;
 }
@@ -32,7 +32,7 @@ static bool sens2_initialized = false;
  */
 int16_t tof_left_loop_fn(){
     VL53L0X_RangingMeasurementData_t measure_left;
-    int16_t dist;
+    int16_t dist = 0; // out of range reads as no return, like no sensor
 
     if (sens1_initialized) {
         //Serial.print("Reading a measurement... ");
@@ -60,7 +60,7 @@ int16_t tof_left_loop_fn(){
  */
 int16_t tof_right_loop_fn(){
     VL53L0X_RangingMeasurementData_t measure_right;
-    int16_t dist;
+    int16_t dist = 0; // out of range reads as no return, like no sensor
 
     if (sens2_initialized) {
         //Serial.print("Reading a measurement... ");